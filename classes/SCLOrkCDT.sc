@@ -22,6 +22,9 @@ SCLOrkCDT {
 			var beatInBar = Float.from64Bits(msg[12], msg[13]);
 			var applyAtTime = Float.from64Bits(msg[14], msg[15]);
 			var applyAtBeat = Float.from64Bits(msg[16], msg[17]);
+			// Older clocks don't report round trip time or beat error.
+			var roundTripTime = if (msg.size > 21, { Float.from64Bits(msg[18], msg[19]) }, { nil });
+			var beatError = if (msg.size > 21, { Float.from64Bits(msg[20], msg[21]) }, { nil });
 			var diag = IdentityDictionary.newFrom([
 				\address, addr,
 				\cohortName, cohortName,
@@ -32,7 +35,9 @@ SCLOrkCDT {
 				\bar, bar,
 				\beatInBar, beatInBar,
 				\applyAtTime, applyAtTime,
-				\applyAtBeat, applyAtBeat
+				\applyAtBeat, applyAtBeat,
+				\roundTripTime, roundTripTime,
+				\beatError, beatError
 			]);
 			diagCallback.value(time, diag);
 			if (cohortPQMap.includesKey(cohortName).not, {
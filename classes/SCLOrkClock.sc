@@ -11,6 +11,7 @@ SCLOrkClock : TempoClock {
 	classvar roundTripTimeSum;
 	classvar sumIndex;
 	classvar <timeDiff;
+	classvar <roundTripTime;
 	classvar changeQueue;
 	classvar requestLastSent;
 	classvar clockSyncOSCFunc;
@@ -21,7 +22,7 @@ SCLOrkClock : TempoClock {
 	var stateQueue;
 	var beatSyncTask;
 
-	*startSync { |serverName = "sclork-s01.local"|
+	*startSync { |serverName = "sclork-s01.local", useConfab = false|
 		if (syncStarted.isNil, {
 			syncStarted = true;
 			clockMap = Dictionary.new;
@@ -32,48 +33,14 @@ SCLOrkClock : TempoClock {
 			roundTripTimeSum = 0.0;
 			sumIndex = 0;
 			timeDiff = 0.0;
+			roundTripTime = 0.0;
 			changeQueue = PriorityQueue.new;
 
-			clockSyncOSCFunc = OSCFunc.new({ | msg, time, addr |
-				var serverTime = Float.from64Bits(msg[1], msg[2]);
-				var currentTime = Main.elapsedTime;
-				var diff = currentTime - serverTime;
-				var roundTripTime = currentTime - requestLastSent;
-				var n;
-
-				if (timeDiffs[sumIndex].notNil, {
-					timeDiffSum = timeDiffSum - timeDiffs[sumIndex];
-					roundTripTimeSum = roundTripTimeSum - roundTripTimes[sumIndex];
-					n = historySize.asFloat;
-				}, {
-					n = (sumIndex + 1).asFloat;
-				});
-
-				timeDiffs[sumIndex] = diff;
-				roundTripTimes[sumIndex] = roundTripTime;
-				sumIndex = (sumIndex + 1) % historySize;
-				timeDiffSum = timeDiffSum + diff;
-				roundTripTimeSum = roundTripTimeSum + roundTripTime;
-				timeDiff = (timeDiffSum / n) - (roundTripTimeSum / (2.0 * n));
-			},
-			path: '/clockSyncSet',
-			recvPort: syncPort,
-			).permanent_(true);
-
-			// SkipJack waits for timeout before executing first time, so
-			// avoid situation where clocks created before first time sync
-			// have times way off and skew to adjust.
-			requestLastSent = Main.elapsedTime;
-			syncNetAddr.sendMsg('/clockSyncGet', syncPort);
-
-			syncTask = SkipJack.new({
-				requestLastSent = Main.elapsedTime;
-				syncNetAddr.sendMsg('/clockSyncGet', syncPort);
-			},
-			dt: 5.0,
-			stopTest: { false },
-			name: "SCLOrkClock Sync"
-			);
+			if (useConfab, {
+				SCLOrkClock.prBindConfabSync;
+			}, {
+				SCLOrkClock.prBindSync;
+			});
 
 			wire = SCLOrkWire.new(4248);
 			wire.onConnected = { | wire, status |
@@ -114,6 +81,64 @@ SCLOrkClock : TempoClock {
 		});
 	}
 
+	// Computes timeDiff from a rolling mean of individual /clockSyncGet round trips.
+	*prBindSync {
+		clockSyncOSCFunc = OSCFunc.new({ | msg, time, addr |
+			var serverTime = Float.from64Bits(msg[1], msg[2]);
+			var currentTime = Main.elapsedTime;
+			var diff = currentTime - serverTime;
+			var sampleRoundTrip = currentTime - requestLastSent;
+			var n;
+
+			if (timeDiffs[sumIndex].notNil, {
+				timeDiffSum = timeDiffSum - timeDiffs[sumIndex];
+				roundTripTimeSum = roundTripTimeSum - roundTripTimes[sumIndex];
+				n = historySize.asFloat;
+			}, {
+				n = (sumIndex + 1).asFloat;
+			});
+
+			timeDiffs[sumIndex] = diff;
+			roundTripTimes[sumIndex] = sampleRoundTrip;
+			sumIndex = (sumIndex + 1) % historySize;
+			timeDiffSum = timeDiffSum + diff;
+			roundTripTimeSum = roundTripTimeSum + sampleRoundTrip;
+			roundTripTime = roundTripTimeSum / n;
+			timeDiff = (timeDiffSum / n) - (roundTripTime / 2.0);
+		},
+		path: '/clockSyncSet',
+		recvPort: syncPort,
+		).permanent_(true);
+
+		// SkipJack waits for timeout before executing first time, so
+		// avoid situation where clocks created before first time sync
+		// have times way off and skew to adjust.
+		requestLastSent = Main.elapsedTime;
+		syncNetAddr.sendMsg('/clockSyncGet', syncPort);
+
+		syncTask = SkipJack.new({
+			requestLastSent = Main.elapsedTime;
+			syncNetAddr.sendMsg('/clockSyncGet', syncPort);
+		},
+		dt: 5.0,
+		stopTest: { false },
+		name: "SCLOrkClock Sync"
+		);
+	}
+
+	// Takes timeDiff from the smoothed mapping published by a confab process running with
+	// --clock_sync_host, which does the offset and drift estimation outside of the interpreter.
+	*prBindConfabSync {
+		clockSyncOSCFunc = OSCFunc.new({ | msg, time, addr |
+			var serverTime = Float.from64Bits(msg[1], msg[2]);
+			timeDiff = Main.elapsedTime - serverTime;
+			roundTripTime = Float.from64Bits(msg[5], msg[6]);
+		},
+		path: '/clockSyncUpdate',
+		recvPort: syncPort,
+		).permanent_(true);
+	}
+
 	*serverToLocalTime { | serverTime |
 		^(serverTime + timeDiff);
 	}
@@ -270,6 +295,9 @@ SCLOrkClock : TempoClock {
 		var localBeats = this.secs2beats(localTime);
 		var bar = this.bar;
 		var beatInBar = this.beatInBar;
+		// secs2beats above maps through the server state, so compare it with where the underlying
+		// TempoClock actually is at the same moment, which beatSyncTask only corrects periodically.
+		var beatError = super.secs2beats(localTime) - localBeats;
 		netAddr.sendMsg('/sclorkClockDiag',
 			currentState.cohortName,
 			localBeats.high32Bits, localBeats.low32Bits,
@@ -279,7 +307,9 @@ SCLOrkClock : TempoClock {
 			bar.high32Bits, bar.low32Bits,
 			beatInBar.high32Bits, beatInBar.low32Bits,
 			currentState.applyAtTime.high32Bits, currentState.applyAtTime.low32Bits,
-			currentState.applyAtBeat.high32Bits, currentState.applyAtBeat.low32Bits
+			currentState.applyAtBeat.high32Bits, currentState.applyAtBeat.low32Bits,
+			roundTripTime.high32Bits, roundTripTime.low32Bits,
+			beatError.high32Bits, beatError.low32Bits
 		);
 	}
 }
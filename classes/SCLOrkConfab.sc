@@ -4,32 +4,43 @@ SCLOrkConfab {
 
 	classvar confab;
 	classvar assetAddedFunc;
+	classvar assetDirectoryAddedFunc;
 	classvar assetErrorFunc;
 	classvar assetFoundFunc;
 	classvar assetLoadedFunc;
 	classvar listFoundFunc;
 	classvar listErrorFunc;
 	classvar listItemsFunc;
+	classvar emojiFoundFunc;
+	classvar assetSearchFunc;
+	classvar waveformFoundFunc;
 
 	classvar addCallbackMap;
 	classvar findCallbackMap;
 	classvar loadCallbackMap;
 	classvar listCallbackMap;
+	classvar emojiCallbackMap;
+	classvar searchCallbackMap;
+	classvar waveformCallbackMap;
 
 	*start { |
 		confabBindPort = 4248,
 		scBindPort = 4249,
 		pathToConfabBinary = nil,
-		pathToConfabDataDir = nil |
+		pathToConfabDataDir = nil,
+		clockSyncHost = nil |
 
 		confab = NetAddr.new("127.0.0.1", confabBindPort);
 		addCallbackMap = IdentityDictionary.new;
 		findCallbackMap = IdentityDictionary.new;
 		loadCallbackMap = IdentityDictionary.new;
 		listCallbackMap = IdentityDictionary.new;
+		emojiCallbackMap = Dictionary.new;
+		searchCallbackMap = Dictionary.new;
+		waveformCallbackMap = IdentityDictionary.new;
 
 		SCLOrkConfab.prBindResponseMessages(scBindPort);
-		SCLOrkConfab.prStartConfab;
+		SCLOrkConfab.prStartConfab(clockSyncHost: clockSyncHost);
 	}
 
 	*addAssetFile { |type, name, author, deprecates, lists, filePath, addCallback|
@@ -44,19 +55,45 @@ SCLOrkConfab {
 		addSerial = addSerial + 1;
 	}
 
+	*addAssetDirectory { |type, listName, author, directoryPath, addCallback|
+		addCallbackMap.put(addSerial, addCallback);
+		confab.sendMsg('/assetAddDirectory', addSerial, type, listName, author, directoryPath);
+		addSerial = addSerial + 1;
+	}
+
 	*findAssetById { |id, callback|
 		findCallbackMap.put(id, callback);
 		confab.sendMsg('/assetFind', id);
 	}
 
+	*findAssetsById { |ids, callback|
+		// Callback is called once per id, as each Asset is found.
+		ids.do({ |id| findCallbackMap.put(id, callback) });
+		confab.sendMsg('/assetFindBatch', *ids);
+	}
+
 	*findAssetByName { |name, callback|
 		findCallbackMap.put(name, callback);
 		confab.sendMsg('/assetFindName', name);
 	}
 
-	*loadAssetById { |id, callback|
+	*loadAssetById { |id, callback, sampleRate|
 		loadCallbackMap.put(id, callback);
-		confab.sendMsg('/assetLoad', id);
+		if (sampleRate.isNil, {
+			confab.sendMsg('/assetLoad', id);
+		}, {
+			// Ask for a 32-bit float WAV variant, at the original sample rate if zero.
+			if (sampleRate == 0, {
+				confab.sendMsg('/assetLoad', id, "float");
+			}, {
+				confab.sendMsg('/assetLoad', id, "float:%".format(sampleRate.asInteger));
+			});
+		});
+	}
+
+	*findWaveform { |id, width, callback|
+		waveformCallbackMap.put(id.asSymbol, callback);
+		confab.sendMsg('/assetWaveform', id, width);
 	}
 
 	*createList { |name, callback|
@@ -74,6 +111,26 @@ SCLOrkConfab {
 		confab.sendMsg('/listNext', listId, fromToken);
 	}
 
+	*getListPrevious { |listId, fromToken, callback|
+		listCallbackMap.put(listId, callback);
+		confab.sendMsg('/listPrevious', listId, fromToken);
+	}
+
+	*getListRange { |listId, fromTime, toTime, callback|
+		listCallbackMap.put(listId, callback);
+		confab.sendMsg('/listRange', listId, fromTime, toTime);
+	}
+
+	*lookupEmoji { |prefix, limit, callback|
+		emojiCallbackMap.put(prefix.asString, callback);
+		confab.sendMsg('/emojiLookup', prefix, limit);
+	}
+
+	*searchAssets { |query, limit, callback|
+		searchCallbackMap.put(query.asString, callback);
+		confab.sendMsg('/assetSearch', query, limit);
+	}
+
 	*isConfabRunning {
 		if (confabPid.notNil, {
 			^confabPid.pidRunning;
@@ -96,18 +153,45 @@ SCLOrkConfab {
 		'/assetAdded',
 		recvPort: recvPort);
 
+		assetDirectoryAddedFunc = OSCFunc.new({ | msg, time, addr |
+			var serial = msg[1];
+			var listKey = msg[2];
+			var callback = addCallbackMap.at(serial);
+			if (callback.notNil, {
+				addCallbackMap.removeAt(serial);
+				callback.value(listKey.asSymbol, (
+					files: msg[3],
+					uploaded: msg[4],
+					existing: msg[5],
+					failed: msg[6]
+				));
+			}, {
+				"confab got directory add callback on missing serial %".format(serial).postln;
+			});
+		},
+		'/assetDirectoryAdded',
+		recvPort: recvPort);
+
 		assetErrorFunc = OSCFunc.new({ |msg, time, addr|
 			var requestedKey = msg[1];
 			var errorMessage = msg[2];
 			var callback = findCallbackMap.at(requestedKey);
+			var waveformCallback = waveformCallbackMap.at(requestedKey);
 
 			"asset error: %".format(errorMessage).postln;
 
+			if (waveformCallback.notNil, {
+				waveformCallback.value(requestedKey, nil);
+				waveformCallbackMap.removeAt(requestedKey);
+			});
+
 			if (callback.notNil, {
 				callback.value(requestedKey, nil);
 				findCallbackMap.removeAt(requestedKey);
 			}, {
-				"confab got error callback on missing Asset id %".format(requestedKey).postln;
+				if (waveformCallback.isNil, {
+					"confab got error callback on missing Asset id %".format(requestedKey).postln;
+				});
 			});
 		},
 		'/assetError',
@@ -194,13 +278,73 @@ SCLOrkConfab {
 		},
 		'/listItems',
 		recvPort: recvPort);
+
+		emojiFoundFunc = OSCFunc.new({ |msg, time, addr|
+			var prefix = msg[1].asString;
+			var total = msg[2];
+			// Matches follow as pairs of emoji and description.
+			var matches = msg[3..].clump(2);
+			var callback = emojiCallbackMap.at(prefix);
+			if (callback.notNil, {
+				emojiCallbackMap.removeAt(prefix);
+				callback.value(prefix, total, matches);
+			}, {
+				"confab got emoji callback on missing prefix %".format(prefix).postln;
+			});
+		},
+		'/emojiFound',
+		recvPort: recvPort);
+
+		assetSearchFunc = OSCFunc.new({ |msg, time, addr|
+			var query = msg[1].asString;
+			var count = msg[2];
+			// Results follow as triplets of kind, either 'asset' or 'list', key, and name.
+			var results = msg[3..].clump(3);
+			var callback = searchCallbackMap.at(query);
+			if (callback.notNil, {
+				searchCallbackMap.removeAt(query);
+				callback.value(query, count, results);
+			}, {
+				"confab got search callback on missing query %".format(query).postln;
+			});
+		},
+		'/assetSearchResults',
+		recvPort: recvPort);
+
+		waveformFoundFunc = OSCFunc.new({ |msg, time, addr|
+			var requestedKey = msg[1];
+			var channels = msg[2];
+			var sampleRate = msg[3];
+			var duration = msg[4];
+			var width = msg[5];
+			var blob = msg[6];
+			var callback = waveformCallbackMap.at(requestedKey);
+			if (callback.notNil, {
+				// Blob is little-endian int16 triplets of min, max, and rms, for every channel of every column.
+				var peaks = Array.fill(blob.size.div(2), { |i|
+					((blob[(i * 2) + 1] << 8) | (blob[i * 2] & 255)) / 32767.0;
+				});
+				waveformCallbackMap.removeAt(requestedKey);
+				callback.value(requestedKey, (
+					channels: channels,
+					sampleRate: sampleRate,
+					duration: duration,
+					peaks: peaks.clump(3).clump(channels)
+				));
+			}, {
+				"confab got waveform callback on missing Asset id %".format(requestedKey).postln;
+			});
+		},
+		'/assetWaveformFound',
+		recvPort: recvPort);
 	}
 
 	*prStartConfab { |
 		confabBindPort = 4248,
 		scBindPort = 4249,
 		pathToConfabBinary = nil,
-		pathToConfabDataDir = nil |
+		pathToConfabDataDir = nil,
+		clockSyncHost = nil |
 		var command;
 		// Check if confab binary already running.
 		if (SCLOrkConfab.isConfabRunning, { ^true; });
@@ -237,6 +381,10 @@ SCLOrkConfab {
 			"--chatty=true",
 			"--data_directory=" ++ pathToConfabDataDir
 		];
+		// Have confab estimate clock offset for SCLOrkClock.startSync(useConfab: true).
+		if (clockSyncHost.notNil, {
+			command = command.add("--clock_sync_host=" ++ clockSyncHost);
+		});
 		command.postln;
 		confabPid = command.unixCmd({ | exitCode, exitPid |
 			SCLOrkConfab.prOnConfabExit(exitCode, exitPid)
@@ -0,0 +1,148 @@
+#include "AssetCache.hpp"
+
+#include <string>
+
+namespace {
+
+/*! Rounds value up to the next power of two, with a minimum of one.
+ */
+size_t roundUpToPowerOfTwo(size_t value) {
+    size_t power = 1;
+    while (power < value) {
+        power <<= 1;
+    }
+    return power;
+}
+
+}  // namespace
+
+namespace Confab {
+
+/*! Record holding its own copy of cached data, shared between the cache and any callers still holding it.
+ */
+class CacheRecord : public Record {
+public:
+    /*! Default constructor not supported, use makeEmptyRecord().
+     */
+    CacheRecord() = delete;
+
+    /*! Constructs a Record with a copy of data.
+     *
+     * \param data The data to copy.
+     */
+    explicit CacheRecord(const SizedPointer& data) :
+        m_data(data.dataChar(), data.size()) {
+    }
+
+    ~CacheRecord() override { }
+
+    /*! Always reports a non-empty Record, as empty Records are never cached.
+     *
+     * \return Always false.
+     */
+    bool empty() const override { return false; }
+
+    /*! A pointer to the cached data.
+     *
+     * \return A non-owning pointer to the data, valid for the lifetime of this Record.
+     */
+    const SizedPointer data() const override {
+        return SizedPointer(m_data.data(), m_data.size());
+    }
+
+    /*! Cached Records don't keep their database key.
+     *
+     * \return Always empty.
+     */
+    const SizedPointer key() const override {
+        return SizedPointer();
+    }
+
+private:
+    const std::string m_data;
+};
+
+AssetCache::AssetCache(size_t capacity, size_t shardCount) :
+    m_shardCapacity(0),
+    m_shards(roundUpToPowerOfTwo(shardCount)),
+    m_hits(0),
+    m_misses(0) {
+    m_shardCapacity = capacity / m_shards.size();
+}
+
+RecordPtr AssetCache::find(uint64_t key) {
+    Shard& shard = shardFor(key);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto found = shard.index.find(key);
+        if (found != shard.index.end()) {
+            // Move to the front of the LRU list.
+            shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+            ++m_hits;
+            return found->second->second;
+        }
+    }
+    ++m_misses;
+    return nullptr;
+}
+
+uint64_t AssetCache::epoch(uint64_t key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.epoch;
+}
+
+RecordPtr AssetCache::insert(uint64_t key, const SizedPointer& data, uint64_t epoch) {
+    RecordPtr record(new CacheRecord(data));
+    // Entries larger than a whole shard would only evict everything else and then be evicted themselves.
+    if (data.size() > m_shardCapacity) {
+        return record;
+    }
+
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.epoch != epoch) {
+        return record;
+    }
+
+    auto found = shard.index.find(key);
+    if (found != shard.index.end()) {
+        shard.size -= found->second->second->data().size();
+        shard.entries.erase(found->second);
+        shard.index.erase(found);
+    }
+
+    while (shard.size + data.size() > m_shardCapacity && !shard.entries.empty()) {
+        shard.size -= shard.entries.back().second->data().size();
+        shard.index.erase(shard.entries.back().first);
+        shard.entries.pop_back();
+    }
+
+    shard.entries.emplace_front(key, record);
+    shard.index.emplace(key, shard.entries.begin());
+    shard.size += data.size();
+    return record;
+}
+
+void AssetCache::erase(uint64_t key) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    ++shard.epoch;
+    auto found = shard.index.find(key);
+    if (found != shard.index.end()) {
+        shard.size -= found->second->second->data().size();
+        shard.entries.erase(found->second);
+        shard.index.erase(found);
+    }
+}
+
+size_t AssetCache::size() {
+    size_t total = 0;
+    for (auto& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.size;
+    }
+    return total;
+}
+
+}  // namespace Confab
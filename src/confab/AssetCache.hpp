@@ -0,0 +1,106 @@
+#ifndef SRC_CONFAB_ASSET_CACHE_HPP_
+#define SRC_CONFAB_ASSET_CACHE_HPP_
+
+#include "Record.hpp"
+#include "SizedPointer.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Confab {
+
+/*! Sharded, size-bounded LRU cache of FlatAsset records, keyed by requested Asset key.
+ *
+ * Cached Records own a copy of their data, so a hit costs a hash probe under one shard lock and a reference count
+ * increment, with no database iterator. Keys are spread across shards by their low bits, which are uniformly
+ * distributed for Asset keys, so concurrent lookups rarely contend.
+ *
+ * Lookups that miss and then fill the cache can race with invalidation, so fills are conditional on an epoch read
+ * before the lookup started. Any erase() on the shard in between causes the fill to be dropped.
+ */
+class AssetCache {
+public:
+    /*! Constructs an empty cache.
+     *
+     * \param capacity The maximum total size in bytes of cached data, divided evenly among the shards. A capacity of
+     *                 zero disables the cache.
+     * \param shardCount The number of independently locked shards, rounded up to a power of two.
+     */
+    explicit AssetCache(size_t capacity, size_t shardCount = 16);
+
+    /*! Looks up a cached Record, counting a hit or a miss.
+     *
+     * \param key The Asset key that was requested.
+     * \return The cached Record, or nullptr on a miss.
+     */
+    RecordPtr find(uint64_t key);
+
+    /*! The current epoch of the shard holding key, to pass to insert() after loading it from the database.
+     *
+     * \param key The Asset key about to be loaded.
+     * \return An opaque value that changes whenever the shard is invalidated.
+     */
+    uint64_t epoch(uint64_t key);
+
+    /*! Adds a copy of data to the cache, evicting least recently used entries from the shard to make room, unless
+     * the shard has been invalidated since epoch.
+     *
+     * \param key The Asset key that was requested.
+     * \param data The FlatAsset data to cache, which should already be verified.
+     * \param epoch The value returned by epoch() before data was loaded.
+     * \return A Record owning the copy, which is valid whether or not the entry was cached.
+     */
+    RecordPtr insert(uint64_t key, const SizedPointer& data, uint64_t epoch);
+
+    /*! Removes any cached entry for key, and invalidates any fills of the shard in flight.
+     *
+     * \param key The Asset key to remove.
+     */
+    void erase(uint64_t key);
+
+    /*! The number of find() calls that returned a cached Record.
+     *
+     * \return The hit count.
+     */
+    uint64_t hits() const { return m_hits; }
+
+    /*! The number of find() calls that returned nullptr.
+     *
+     * \return The miss count.
+     */
+    uint64_t misses() const { return m_misses; }
+
+    /*! The total size in bytes of the data currently cached.
+     *
+     * \return The cached size.
+     */
+    size_t size();
+
+private:
+    using Entry = std::pair<uint64_t, RecordPtr>;
+    struct Shard {
+        std::mutex mutex;
+        std::list<Entry> entries;
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+        size_t size = 0;
+        uint64_t epoch = 0;
+    };
+
+    Shard& shardFor(uint64_t key) { return m_shards[key & (m_shards.size() - 1)]; }
+
+    size_t m_shardCapacity;
+    std::vector<Shard> m_shards;
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_misses;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_ASSET_CACHE_HPP_
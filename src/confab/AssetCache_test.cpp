@@ -0,0 +1,81 @@
+#include "AssetCache.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+
+namespace {
+
+std::string recordString(const Confab::RecordPtr& record) {
+    return std::string(record->data().dataChar(), record->data().size());
+}
+
+}  // namespace
+
+TEST(AssetCacheTest, HitAndMissCounts) {
+    Confab::AssetCache cache(1024, 1);
+    std::string data("some asset data");
+    EXPECT_EQ(nullptr, cache.find(1));
+    EXPECT_EQ(1u, cache.misses());
+    cache.insert(1, Confab::SizedPointer(data.data(), data.size()), cache.epoch(1));
+    auto record = cache.find(1);
+    ASSERT_NE(nullptr, record);
+    EXPECT_EQ(data, recordString(record));
+    EXPECT_EQ(1u, cache.hits());
+    EXPECT_EQ(1u, cache.misses());
+}
+
+TEST(AssetCacheTest, EvictsLeastRecentlyUsed) {
+    Confab::AssetCache cache(30, 1);
+    std::string data("0123456789");
+    Confab::SizedPointer pointer(data.data(), data.size());
+    cache.insert(1, pointer, cache.epoch(1));
+    cache.insert(2, pointer, cache.epoch(2));
+    cache.insert(3, pointer, cache.epoch(3));
+    EXPECT_EQ(30u, cache.size());
+    // Touch 1, making 2 the least recently used.
+    EXPECT_NE(nullptr, cache.find(1));
+    cache.insert(4, pointer, cache.epoch(4));
+    EXPECT_EQ(30u, cache.size());
+    EXPECT_NE(nullptr, cache.find(1));
+    EXPECT_EQ(nullptr, cache.find(2));
+    EXPECT_NE(nullptr, cache.find(3));
+    EXPECT_NE(nullptr, cache.find(4));
+}
+
+TEST(AssetCacheTest, EraseInvalidatesInFlightFill) {
+    Confab::AssetCache cache(1024, 4);
+    std::string data("stale");
+    uint64_t epoch = cache.epoch(7);
+    cache.erase(7);
+    auto record = cache.insert(7, Confab::SizedPointer(data.data(), data.size()), epoch);
+    // The returned Record is still usable, but was not cached.
+    EXPECT_EQ(data, recordString(record));
+    EXPECT_EQ(nullptr, cache.find(7));
+
+    cache.insert(7, Confab::SizedPointer(data.data(), data.size()), cache.epoch(7));
+    EXPECT_NE(nullptr, cache.find(7));
+    cache.erase(7);
+    EXPECT_EQ(nullptr, cache.find(7));
+    EXPECT_EQ(0u, cache.size());
+}
+
+TEST(AssetCacheTest, RecordOutlivesEviction) {
+    Confab::AssetCache cache(10, 1);
+    std::string first("0123456789");
+    std::string second("abcdefghij");
+    cache.insert(1, Confab::SizedPointer(first.data(), first.size()), cache.epoch(1));
+    auto record = cache.find(1);
+    cache.insert(2, Confab::SizedPointer(second.data(), second.size()), cache.epoch(2));
+    EXPECT_EQ(nullptr, cache.find(1));
+    EXPECT_EQ(first, recordString(record));
+}
+
+TEST(AssetCacheTest, ZeroCapacityCachesNothing) {
+    Confab::AssetCache cache(0);
+    std::string data("x");
+    auto record = cache.insert(1, Confab::SizedPointer(data.data(), data.size()), cache.epoch(1));
+    EXPECT_EQ(data, recordString(record));
+    EXPECT_EQ(nullptr, cache.find(1));
+}
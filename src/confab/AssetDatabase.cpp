@@ -1,7 +1,13 @@
 #include "AssetDatabase.hpp"
 
 #include "Asset.hpp"
+#include "AssetCache.hpp"
+#include "BlobStore.hpp"
+#include "ChunkCodec.hpp"
+#include "Config.hpp"
 #include "Constants.hpp"
+#include "NameSearch.hpp"
+#include "PackFile.hpp"
 #include "schemas/FlatAsset_generated.h"
 #include "schemas/FlatAssetData_generated.h"
 #include "schemas/FlatList_generated.h"
@@ -10,10 +16,19 @@
 #include "leveldb/cache.h"
 #include "leveldb/db.h"
 #include "leveldb/write_batch.h"
+#include "xxhash.h"
 
 #include <array>
 #include <chrono>
 #include <cstring>
+#include <functional>
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <set>
+#include <string>
+#include <utility>
 
 namespace {
 
@@ -25,23 +40,113 @@ static const size_t kAssetKeySize = 9;
 
 /*! The size in bytes of the key associated with an AssetData entry in the database.
  *
- * Currently 17 bytes, counting one byte for the kData prefix, followed by 8 bytes of the Asset key, followed by
- * 8 bytes indicated the chunk number (starting from 1).
+ * Currently 17 bytes, counting one byte for the kAssetData prefix, followed by 8 bytes of the Asset key, followed by
+ * 8 bytes of the chunk number (starting from 0) in big-endian byte order, so that the chunks of an Asset are stored
+ * in order and can be read with a single sequential scan.
  */
 static const size_t kAssetDataKeySize = 17;
 
+/*! Number of keys examined per write batch during migration.
+ */
+static const size_t kMigrationBatchSize = 256;
+
+/*! Schema versions of the database, each reached once the migration of the same name is complete.
+ */
+enum SchemaVersion : uint64_t {
+    /*! Databases from before versions were recorded, with any of the older layouts below.
+     */
+    kSchemaInitial = 0,
+
+    /*! List entry keys have big-endian timestamps, under the kListEntry prefix.
+     */
+    kSchemaListEntries = 1,
+
+    /*! Every Asset and List name has name search entries.
+     */
+    kSchemaNameSearch = 2,
+
+    /*! AssetData entries are all in the data database.
+     */
+    kSchemaAssetData = 3
+};
+
+/*! Key holding the 8-byte big-endian schema version of the database.
+ */
+static const char* kSchemaVersionKey = "mSchemaVersion";
+
+/*! Key holding the progress of an interrupted migration, the 8-byte big-endian version the migration moves to,
+ * followed by the key to resume from.
+ */
+static const char* kMigrationProgressKey = "mMigration";
+
+/*! Key the database config was stored under before it moved to Config::getConfigKey(). It starts with the kAssetData
+ * prefix, so loadSchemaVersion() moves it out from among the chunk keys.
+ */
+static const char* kLegacyConfigKey = "confab-db-config";
+
+/*! Suffix appended to the metadata database path to name the directory of the data database.
+ */
+static const char* kDataDatabaseSuffix = "-data";
+
+/*! Suffix appended to the metadata database path to name the directory of AssetData blob segments.
+ */
+static const char* kBlobStoreSuffix = "-blobs";
+
+/*! Block size of the data database. Chunks are read mostly in sequence, so larger blocks than the LevelDB default
+ * mean fewer block reads per Asset, while keeping the cost of a single chunk read small.
+ */
+static const size_t kDataBlockSize = 16 * 1024;
+
+/*! Write buffer size of the data database, large enough that bulk uploads make few small level-0 files.
+ */
+static const size_t kDataWriteBufferSize = 16 * 1024 * 1024;
+
 /*! List key size, 9 bytes with one for the kList prefix, followed by 8 bytes of List key.
  */
 static const size_t kListKeySize = 9;
 
 /*! Addition to lists is done by creating a new key (with no associated value) constructed from the kListEntry prefix,
- * followed by the 64-bit List unique identifier, followed by a 64-bit nanosecond time stamp, which is intended to keep
- * a monotonically increasing part of the key for lexical ordering, followed at last by the key of the data being added,
- * to avoid the (small) possibility of key collision between two different threads adding a list element at the exact
- * same time. This makes for a total key size of (3 * 8) + 1 = 25 bytes.
+ * followed by the 64-bit List unique identifier, followed by a 64-bit microsecond time stamp in big-endian byte order,
+ * which keeps the entries of a List in lexical order by time of addition, followed at last by the key of the data being
+ * added, to avoid the (small) possibility of key collision between two different threads adding a list element at the
+ * exact same time. This makes for a total key size of (3 * 8) + 1 = 25 bytes.
  */
 static const size_t kListEntryKeySize = 25;
 
+/*! Waveform overview key size, 9 bytes with one for the kWaveform prefix, followed by 8 bytes of the Asset key.
+ */
+static const size_t kWaveformKeySize = 9;
+
+/*! Chain head index key size, 9 bytes with one for the kChainHead prefix, followed by 8 bytes of the Asset key.
+ */
+static const size_t kChainHeadKeySize = 9;
+
+/*! Chunk content key size, 17 bytes with one for the kChunkContent prefix, followed by the 8-byte hash of the chunk
+ * contents, a 4-byte collision index, and their 4-byte length, all in big-endian byte order. The collision index is
+ * zero unless distinct contents share the same hash and length. It takes the high bytes of what was once an 8-byte
+ * length, which were always zero, so keys written before it was added are unchanged.
+ */
+static const size_t kChunkContentKeySize = 17;
+
+/*! Chunk content value size, an encoded BlobStore::Location followed by an 8-byte big-endian reference count.
+ */
+static const size_t kChunkContentValueSize = Confab::BlobStore::kEncodedLocationSize + 8;
+
+/*! Chunk reference size, 4 bytes of kChunkReferenceMagic, followed by the chunk content key, followed by the 8-byte
+ * hash the FlatAssetData of this chunk carries for its own Asset.
+ */
+static const size_t kChunkReferenceSize = 4 + kChunkContentKeySize + 8;
+
+/*! Marks an AssetData value as a chunk reference. Like an encoded BlobStore::Location, this would be an impossibly
+ * large flatbuffer root offset, and its length differs from an encoded Location, so the three can be told apart.
+ */
+static const char kChunkReferenceMagic[4] = { '\xff', '\xff', 'C', 'R' };
+
+/*! Limit on the length of a chain of deprecations followed when storing an Asset, which also stops the walk if the
+ * deprecates links of stored Assets ever form a cycle.
+ */
+static const size_t kMaxChainLength = 4096;
+
 /*! Character prefixes to prepend to Asset or AssetData keys for database.
  */
 enum KeyPrefix : char {
@@ -49,28 +154,229 @@ enum KeyPrefix : char {
      */
     kAsset = 'a',
 
-    /*! Prefix for AssetData entries. Key is the kAssetData prefix, followed by 8 bytes of Asset key, followed by 8
-     * bytes of the chunk number.
+    /*! Prefix for AssetData entries, which live in the separate data database. Key is the kAssetData prefix, followed
+     * by 8 bytes of Asset key, followed by 8 bytes of the chunk number in big-endian order. Older versions of confab
+     * also stored these in the metadata database, from where they are moved in the background after opening.
      */
-    kAssetData = 'd',
+    kAssetData = 'c',
+
+    /*! Prefix for AssetData entries written by older versions of confab to the metadata database, with the chunk
+     * number in host byte order. These are re-keyed to kAssetData entries in the data database in the background
+     * after opening.
+     */
+    kLegacyAssetData = 'd',
 
     /*! Prefix for List metadata entries. Key is the kList prefix, followed by 8 bytes of the List key.
      */
     kList = 'l',
 
     /*! Prefix for List name entries. Key is the kListEntry prefix, followed by 8 bytes of the List key, followed by
-     * an 8-byte timestamp, then the final 8 bytes of Asset key. There are no data associated with these keys.
+     * an 8-byte big-endian timestamp, then the final 8 bytes of Asset key. There are no data associated with these keys.
+     */
+    kListEntry = 'i',
+
+    /*! Prefix for List entries written by older versions of confab, with the timestamp in host byte order. These are
+     * re-keyed to kListEntry entries when the database is opened.
+     */
+    kLegacyListEntry = 'e',
+
+    /*! Prefix for waveform overview entries derived from sample Assets. Key is the kWaveform prefix, followed by 8
+     * bytes of the Asset key. These are computed locally and never uploaded.
+     */
+    kWaveform = 'w',
+
+    /*! Prefix for chain head index entries. Key is the kChainHead prefix, followed by 8 bytes of the key of a
+     * deprecated Asset. The value is the 8-byte key of the most recent Asset in its chain of deprecations.
+     */
+    kChainHead = 'h',
+
+    /*! Prefix for name trigram entries, used for fuzzy name search. Key is the kNameTrigram prefix, followed by 3
+     * bytes of a trigram from NameSearch::trigrams(), then the kind of record named, either kAsset or kList, then 8
+     * bytes of its key. The value is the name as stored.
+     */
+    kNameTrigram = 'g',
+
+    /*! Prefix for entries left behind by deprecated Assets deleted by garbage collection. Key is the kPrunedAsset
+     * prefix, followed by 8 bytes of the deleted Asset key. The value is the 8-byte key of the Asset it deprecated, so
+     * that chains of deprecations can still be followed through it.
+     */
+    kPrunedAsset = 'p',
+
+    /*! Prefix for quarantine entries, recording Assets whose AssetData failed its hash check when scrubbed. Key is the
+     * kQuarantine prefix, followed by 8 bytes of the Asset key. The value is the 8-byte big-endian number of the first
+     * chunk found bad.
+     */
+    kQuarantine = 'k',
+
+    /*! Prefix for upstream queue entries, recording Assets added locally that are waiting to be uploaded. Key is the
+     * kUpstreamQueue prefix, followed by an 8-byte big-endian timestamp, then 8 bytes of the Asset key. The value is
+     * the FlatAsset record to upload.
+     */
+    kUpstreamQueue = 'q',
+
+    /*! Prefix for replication log entries, recording writes for follower servers to replay in order. Key is the
+     * kReplicationLog prefix, followed by an 8-byte big-endian sequence number. The value is made by
+     * encodeReplicationEntry().
+     */
+    kReplicationLog = 'r',
+
+    /*! Prefix for chunk content entries, which live in the data database and are shared by every AssetData chunk with
+     * the same contents. Key is made by makeChunkContentKey(), and the value is where the chunk is stored in the blob
+     * store followed by the number of AssetData entries referring to it.
+     */
+    kChunkContent = 's',
+
+    /*! Prefix for Asset type index entries. Key is made by makeTypeIndexPrefix() followed by an 8-byte big-endian
+     * timestamp and 8 bytes of the Asset key, so that the Assets of a type are stored in the order they were added.
+     * There are no data associated with these keys.
+     */
+    kTypeIndex = 't',
+
+    /*! Prefix for Asset author index entries. Key is made by makeAuthorIndexPrefix(), followed by an 8-byte
+     * big-endian timestamp and 8 bytes of the Asset key. Every Asset with an author has an entry for its own type, and
+     * another for type kAnyType, so the Assets of an author can be listed either by type or all together. There are no
+     * data associated with these keys.
      */
-    kListEntry = 'e'
+    kAuthorIndex = 'u',
+
+    /*! Prefix for name prefix entries, used for type-ahead name search. Key is the kNamePrefix prefix, followed by one
+     * of the NameSearch::wordSuffixes() of the name, a zero byte, then the kind of record named, either kAsset or
+     * kList, then 8 bytes of its key. The zero byte sorts exact matches before longer names. The value is the name as
+     * stored.
+     */
+    kNamePrefix = 'x',
+
+    /*! Prefix for chunk compression dictionary entries. Key is the kChunkDictionary prefix, followed by 4 bytes of
+     * big-endian Asset type, then 4 bytes of big-endian dictionary ID. The value is a zstd dictionary used to compress
+     * chunks of Assets of that type. Dictionaries are never replaced, as chunks compressed with them need them to
+     * be read.
+     */
+    kChunkDictionary = 'z'
 };
 
 static const char* kAssetNamePrefix = "na";
 static const char* kListNamePrefix = "nl";
 
+/*! Key present once name search entries had been added for every name stored by older versions of confab, written by
+ * versions of confab from before schema versions were recorded, and replaced by kSchemaNameSearch.
+ */
+static const char* kNameSearchBuiltKey = "mNameSearchBuilt";
+
+/*! Size of the record kind and key that end every name search entry.
+ */
+static const size_t kNameSearchSuffixSize = 9;
+
+/*! Maximum number of entries read per trigram of a fuzzy search query, to bound the cost of common trigrams.
+ */
+static const size_t kMaxTrigramPostings = 1024;
+
+/*! Maximum number of prefix entries read by a search, including those skipped as deprecated.
+ */
+static const size_t kMaxPrefixPostings = 4096;
+
+/*! Least NameSearch::similarity() of a fuzzy match to be included in search results.
+ */
+static const float kMinNameSimilarity = 0.3f;
+
+/*! Total size of the chunks kept as examples before training a compression dictionary for an Asset type. zstd
+ * recommends around a hundred times the size of the dictionary.
+ */
+static const size_t kDictionaryTrainingBytes = 1024 * 1024;
+
+/*! Largest compression dictionary trained for an Asset type.
+ */
+static const size_t kDictionarySize = 16 * 1024;
+
+/*! Size of a chunk dictionary key, with one byte for the kChunkDictionary prefix, then 4 bytes of big-endian type,
+ * then 4 bytes of big-endian dictionary ID.
+ */
+static const size_t kChunkDictionaryKeySize = 9;
+
+/*! Size of an upstream queue key, with one byte for the kUpstreamQueue prefix, then an 8-byte big-endian timestamp,
+ * then 8 bytes of Asset key.
+ */
+static const size_t kUpstreamQueueKeySize = 17;
+
+/*! Size of a replication log key, with one byte for the kReplicationLog prefix, then an 8-byte big-endian sequence
+ * number.
+ */
+static const size_t kReplicationLogKeySize = 9;
+
+/*! Size of the start of every replication log value, with one byte of ReplicationOp, then 8-byte big-endian key and
+ * argument.
+ */
+static const size_t kReplicationEntryHeaderSize = 17;
+
+/*! Key holding the 8-byte big-endian sequence number of the last replication log entry applied from a leader.
+ */
+static const char* kReplicationAppliedKey = "mReplicationApplied";
+
+/*! Key holding the Asset key a scrub pass stopped before, so the next pass resumes from it.
+ */
+static const char* kScrubPositionKey = "mScrubPosition";
+
+/*! Size of a quarantine key, with one byte for the kQuarantine prefix, then 8 bytes of Asset key.
+ */
+static const size_t kQuarantineKeySize = 9;
+
+/*! PackFile tables of entries from the metadata and data databases.
+ */
+static const char kPackMetadataTable = 'm';
+static const char kPackDataTable = 'd';
+
+/*! Approximate size in bytes of each write batch when importing a pack file.
+ */
+static const size_t kPackImportBatchSize = 16 * 1024 * 1024;
+
+/*! Number of entries between progress messages when exporting or importing a pack file.
+ */
+static const uint64_t kPackProgressInterval = 100000;
+
 /*! Maximum number of list entries the database will add an asset to.
  */
 static const size_t kAssetMaxListEntries = 8;
 
+/*! Type used in author index entries covering Assets of every type.
+ */
+static const uint32_t kAnyType = 0;
+
+/*! Type index prefix size, 5 bytes with one for the kTypeIndex prefix, followed by 4 bytes of big-endian Asset type.
+ */
+static const size_t kTypeIndexPrefixSize = 5;
+
+/*! Author index prefix size, 13 bytes with one for the kAuthorIndex prefix, followed by 8 bytes of the author key, then
+ * 4 bytes of big-endian Asset type.
+ */
+static const size_t kAuthorIndexPrefixSize = 13;
+
+/*! Size of the timestamp and Asset key that follow the prefix of every index entry.
+ */
+static const size_t kIndexEntrySuffixSize = 16;
+
+/*! Writes value in big-endian byte order, so that keys containing it sort in numerical order of value.
+ *
+ * \param value The value to write.
+ * \param bytesOut A pointer to at least 8 bytes to write value to.
+ */
+inline void writeBigEndian64(uint64_t value, char* bytesOut) noexcept {
+    for (auto i = 0; i < 8; ++i) {
+        bytesOut[i] = static_cast<char>((value >> (56 - (8 * i))) & 0xff);
+    }
+}
+
+/*! Reads a value written by writeBigEndian64().
+ *
+ * \param bytes A pointer to the 8 bytes to read.
+ * \return The value read.
+ */
+inline uint64_t readBigEndian64(const char* bytes) noexcept {
+    uint64_t value = 0;
+    for (auto i = 0; i < 8; ++i) {
+        value = (value << 8) | static_cast<uint8_t>(bytes[i]);
+    }
+    return value;
+}
+
 /*! Writes a byte sequence in keyOut suitable for storing or retrieving an Asset record from the database.
  *
  * \param key The key to format.
@@ -81,6 +387,16 @@ inline void makeAssetKey(uint64_t key, char* keyOut) noexcept {
     std::memcpy(keyOut + 1, reinterpret_cast<const char*>(&key), sizeof(uint64_t));
 }
 
+/*! Writes a byte sequence in keyOut for the quarantine entry of an Asset.
+ *
+ * \param key The key of the Asset.
+ * \param keyOut A pointer to where to store the key sequence, must be at least kQuarantineKeySize in size.
+ */
+inline void makeQuarantineKey(uint64_t key, char* keyOut) noexcept {
+    keyOut[0] = kQuarantine;
+    std::memcpy(keyOut + 1, &key, sizeof(uint64_t));
+}
+
 /*! Writes a byte sequence in keyOut suitable for storing or retrieving an AssetData record from the database.
  *
  * \param key The key to format.
@@ -90,14 +406,304 @@ inline void makeAssetKey(uint64_t key, char* keyOut) noexcept {
 inline void makeAssetDataKey(uint64_t key, uint64_t chunkNumber, char* keyOut) noexcept {
     keyOut[0] = kAssetData;
     std::memcpy(keyOut + 1, reinterpret_cast<const char*>(&key), sizeof(uint64_t));
+    writeBigEndian64(chunkNumber, keyOut + 9);
+}
+
+/*! Extracts the chunk number from an AssetData key made by makeAssetDataKey().
+ *
+ * \param key A pointer to an AssetData key, at least kAssetDataKeySize in size.
+ * \return The chunk number.
+ */
+inline uint64_t assetDataKeyChunk(const char* key) noexcept {
+    return readBigEndian64(key + 9);
+}
+
+/*! The number of AssetData chunks stored for an Asset, derived from its size. The chunk count in file Assets is one
+ * more than is ever stored when the size is a multiple of kDataChunkSize, including empty files, so can't be used.
+ *
+ * \param flatAsset The Asset.
+ * \return The number of chunks, which is 0 for Assets with inline data or no chunks.
+ */
+inline uint64_t storedChunkCount(const Confab::Data::FlatAsset* flatAsset) noexcept {
+    if (flatAsset->inlineData() || flatAsset->chunks() == 0) {
+        return 0;
+    }
+    return (flatAsset->size() + Confab::kDataChunkSize - 1) / Confab::kDataChunkSize;
+}
+
+/*! Writes the key an older version of confab would have used for an AssetData record.
+ */
+inline void makeLegacyAssetDataKey(uint64_t key, uint64_t chunkNumber, char* keyOut) noexcept {
+    keyOut[0] = kLegacyAssetData;
+    std::memcpy(keyOut + 1, reinterpret_cast<const char*>(&key), sizeof(uint64_t));
     std::memcpy(keyOut + 9, reinterpret_cast<const char*>(&chunkNumber), sizeof(uint64_t));
 }
 
+/*! Seeks iterator on the metadata database to an AssetData chunk stored there by an older version of confab, under
+ * either key format.
+ *
+ * \param iterator An iterator on the metadata database.
+ * \param key The Asset key.
+ * \param chunk The chunk number.
+ * \return true if iterator now points at the chunk, false if not found.
+ */
+inline bool seekLegacyAssetData(leveldb::Iterator* iterator, uint64_t key, uint64_t chunk) {
+    std::array<char, kAssetDataKeySize> assetDataKey;
+    makeAssetDataKey(key, chunk, assetDataKey.data());
+    leveldb::Slice assetDataSlice(assetDataKey.data(), kAssetDataKeySize);
+    iterator->Seek(assetDataSlice);
+    if (iterator->Valid() && iterator->key() == assetDataSlice) {
+        return true;
+    }
+    makeLegacyAssetDataKey(key, chunk, assetDataKey.data());
+    iterator->Seek(assetDataSlice);
+    return iterator->Valid() && iterator->key() == assetDataSlice;
+}
+
 inline void makeListKey(uint64_t key, char* keyOut) noexcept {
     keyOut[0] = kList;
     std::memcpy(keyOut + 1, reinterpret_cast<const char*>(&key), sizeof(uint64_t));
 }
 
+inline void makeWaveformKey(uint64_t key, char* keyOut) noexcept {
+    keyOut[0] = kWaveform;
+    std::memcpy(keyOut + 1, reinterpret_cast<const char*>(&key), sizeof(uint64_t));
+}
+
+inline void makeChainHeadKey(uint64_t key, char* keyOut) noexcept {
+    keyOut[0] = kChainHead;
+    std::memcpy(keyOut + 1, reinterpret_cast<const char*>(&key), sizeof(uint64_t));
+}
+
+inline void writeBigEndian32(uint32_t value, char* bytesOut) noexcept {
+    for (auto i = 0; i < 4; ++i) {
+        bytesOut[i] = static_cast<char>((value >> (24 - (8 * i))) & 0xff);
+    }
+}
+
+inline uint32_t readBigEndian32(const char* bytes) noexcept {
+    uint32_t value = 0;
+    for (auto i = 0; i < 4; ++i) {
+        value = (value << 8) | static_cast<uint8_t>(bytes[i]);
+    }
+    return value;
+}
+
+/*! Returns the prefix shared by the type index entries of every Asset of one type.
+ *
+ * \param type The Asset type.
+ * \return A kTypeIndexPrefixSize byte prefix.
+ */
+inline std::string makeTypeIndexPrefix(uint32_t type) {
+    std::string prefix(kTypeIndexPrefixSize, kTypeIndex);
+    writeBigEndian32(type, &prefix[1]);
+    return prefix;
+}
+
+/*! Returns the prefix shared by the author index entries of every Asset of one type by one author.
+ *
+ * \param author The author key.
+ * \param type The Asset type, or kAnyType for the entries covering every type.
+ * \return A kAuthorIndexPrefixSize byte prefix.
+ */
+inline std::string makeAuthorIndexPrefix(uint64_t author, uint32_t type) {
+    std::string prefix(kAuthorIndexPrefixSize, kAuthorIndex);
+    std::memcpy(&prefix[1], &author, sizeof(uint64_t));
+    writeBigEndian32(type, &prefix[9]);
+    return prefix;
+}
+
+/*! Returns an index entry key, made of the index prefix followed by the big-endian timestamp and the Asset key.
+ *
+ * \param prefix The index prefix, from makeTypeIndexPrefix() or makeAuthorIndexPrefix().
+ * \param timeStamp The time the Asset was stored, in microseconds.
+ * \param assetKey The key of the Asset.
+ * \return The index entry key.
+ */
+inline std::string makeIndexEntryKey(const std::string& prefix, uint64_t timeStamp, uint64_t assetKey) {
+    std::string key(prefix);
+    key.resize(prefix.size() + kIndexEntrySuffixSize);
+    writeBigEndian64(timeStamp, &key[prefix.size()]);
+    std::memcpy(&key[prefix.size() + 8], &assetKey, sizeof(uint64_t));
+    return key;
+}
+
+/*! Returns a name search entry key, made of prefix and term followed by the kind and key of the named record.
+ *
+ * \param prefix Either kNamePrefix or kNameTrigram.
+ * \param term A word suffix, followed by a zero byte, or a trigram.
+ * \param kind Either kAsset or kList.
+ * \param key The key of the named Asset or List.
+ * \return The name search entry key.
+ */
+inline std::string makeNameSearchKey(char prefix, const std::string& term, char kind, uint64_t key) {
+    std::string searchKey(1, prefix);
+    searchKey.append(term);
+    searchKey.push_back(kind);
+    searchKey.append(reinterpret_cast<const char*>(&key), sizeof(uint64_t));
+    return searchKey;
+}
+
+/*! Adds the prefix and trigram search entries for a name to batch.
+ *
+ * \param name The name as stored.
+ * \param kind Either kAsset or kList.
+ * \param key The key of the named Asset or List.
+ * \param batch The batch to add the entries to.
+ */
+inline void addNameSearchEntries(const std::string& name, char kind, uint64_t key, leveldb::WriteBatch& batch) {
+    std::string normalized = Confab::NameSearch::normalize(name);
+    for (const auto& suffix : Confab::NameSearch::wordSuffixes(normalized)) {
+        batch.Put(makeNameSearchKey(kNamePrefix, suffix + '\0', kind, key), name);
+    }
+    for (const auto& trigram : Confab::NameSearch::trigrams(normalized)) {
+        batch.Put(makeNameSearchKey(kNameTrigram, trigram, kind, key), name);
+    }
+}
+
+inline void makePrunedAssetKey(uint64_t key, char* keyOut) noexcept {
+    keyOut[0] = kPrunedAsset;
+    std::memcpy(keyOut + 1, reinterpret_cast<const char*>(&key), sizeof(uint64_t));
+}
+
+/*! Writes the content-addressed key under which chunks with the provided contents are stored.
+ *
+ * \param contents The data carried by a FlatAssetData chunk, without the rest of the flatbuffer.
+ * \param collision The collision index, counting up from zero for each distinct contents with the same key otherwise.
+ * \param keyOut A pointer to where to store the key sequence, must be at least kChunkContentKeySize in size.
+ */
+inline void makeChunkContentKey(const Confab::SizedPointer& contents, uint32_t collision, char* keyOut) noexcept {
+    keyOut[0] = kChunkContent;
+    writeBigEndian64(XXH64(contents.data(), contents.size(), 0), keyOut + 1);
+    writeBigEndian32(collision, keyOut + 9);
+    writeBigEndian32(static_cast<uint32_t>(contents.size()), keyOut + 13);
+}
+
+/*! Serializes a reference from an AssetData entry to the chunk content entry holding its data.
+ *
+ * \param contentKey The chunk content key, kChunkContentKeySize bytes.
+ * \param hash The hash carried by the FlatAssetData of the referring chunk.
+ * \param referenceOut A pointer to at least kChunkReferenceSize bytes.
+ */
+inline void encodeChunkReference(const char* contentKey, uint64_t hash, char* referenceOut) noexcept {
+    std::memcpy(referenceOut, kChunkReferenceMagic, sizeof(kChunkReferenceMagic));
+    std::memcpy(referenceOut + 4, contentKey, kChunkContentKeySize);
+    writeBigEndian64(hash, referenceOut + 4 + kChunkContentKeySize);
+}
+
+/*! Deserializes a chunk reference written by encodeChunkReference().
+ *
+ * \param value The AssetData value to decode.
+ * \param contentKeyOut A pointer to kChunkContentKeySize bytes to store the chunk content key in.
+ * \param hashOut Where to store the hash of the referring chunk.
+ * \return true if value was a chunk reference, false otherwise.
+ */
+inline bool decodeChunkReference(const leveldb::Slice& value, char* contentKeyOut, uint64_t& hashOut) noexcept {
+    if (value.size() != kChunkReferenceSize ||
+        std::memcmp(value.data(), kChunkReferenceMagic, sizeof(kChunkReferenceMagic)) != 0) {
+        return false;
+    }
+    std::memcpy(contentKeyOut, value.data() + 4, kChunkContentKeySize);
+    hashOut = readBigEndian64(value.data() + 4 + kChunkContentKeySize);
+    return true;
+}
+
+/*! Finds the blob holding a value in the data database, which is either a chunk content entry, or an AssetData entry
+ * written before chunks were content-addressed holding the blob Location directly.
+ *
+ * \param key The database key of the value.
+ * \param value The database value.
+ * \param locationOut Where to store the blob Location.
+ * \return true if the value refers directly to a blob, false otherwise.
+ */
+inline bool blobLocation(const leveldb::Slice& key, const leveldb::Slice& value,
+    Confab::BlobStore::Location& locationOut) noexcept {
+    if (key.size() == kChunkContentKeySize && key[0] == kChunkContent) {
+        return value.size() == kChunkContentValueSize &&
+            Confab::BlobStore::decodeLocation(value.data(), Confab::BlobStore::kEncodedLocationSize, locationOut);
+    }
+    return key.size() == kAssetDataKeySize && key[0] == kAssetData &&
+        Confab::BlobStore::decodeLocation(value.data(), value.size(), locationOut);
+}
+
+/*! Writes a byte sequence in keyOut for a List entry.
+ *
+ * \param listKey The key of the List.
+ * \param token The time stamp of the entry, or one of the kBeginList or kEndList sentinel values.
+ * \param assetKey The key of the Asset in the List.
+ * \param keyOut A pointer to where to store the key sequence, must be at least kListEntryKeySize in size.
+ */
+inline void makeListEntryKey(uint64_t listKey, uint64_t token, uint64_t assetKey, char* keyOut) noexcept {
+    keyOut[0] = kListEntry;
+    std::memcpy(keyOut + 1, &listKey, sizeof(uint64_t));
+    writeBigEndian64(token, keyOut + 9);
+    std::memcpy(keyOut + 17, &assetKey, sizeof(uint64_t));
+}
+
+/*! Extracts the <token, Asset key> pair from a List entry key made by makeListEntryKey().
+ *
+ * \param key A pointer to a List entry key, at least kListEntryKeySize in size.
+ * \param pairOut A pointer to two uint64_t values, to store the token and Asset key in.
+ */
+inline void listEntryKeyPair(const char* key, uint64_t* pairOut) noexcept {
+    pairOut[0] = readBigEndian64(key + 9);
+    std::memcpy(pairOut + 1, key + 17, sizeof(uint64_t));
+}
+
+inline void makeReplicationLogKey(uint64_t sequence, char* keyOut) noexcept {
+    keyOut[0] = kReplicationLog;
+    writeBigEndian64(sequence, keyOut + 1);
+}
+
+/*! Serializes a replication log value, with the header followed by the record, or for List items the Asset key.
+ *
+ * \param op The kind of write.
+ * \param key The key of the Asset or List written.
+ * \param argument The timestamp or chunk number, as for ReplicationEntry.
+ * \param record The FlatAsset or FlatList written, 8 big-endian bytes of Asset key for a List item, or empty.
+ * \return The encoded value.
+ */
+inline std::string encodeReplicationEntry(char op, uint64_t key, uint64_t argument,
+    const Confab::SizedPointer& record) {
+    std::string value(kReplicationEntryHeaderSize, '\0');
+    value[0] = op;
+    writeBigEndian64(key, &value[1]);
+    writeBigEndian64(argument, &value[9]);
+    value.append(record.dataChar(), record.size());
+    return value;
+}
+
+/*! Deserializes a replication log entry written with makeReplicationLogKey() and encodeReplicationEntry().
+ *
+ * \param key The database key of the entry.
+ * \param value The database value of the entry.
+ * \param entryOut Where to store the entry.
+ * \return true if the entry was well-formed, false otherwise.
+ */
+inline bool decodeReplicationEntry(const leveldb::Slice& key, const leveldb::Slice& value,
+    Confab::AssetDatabase::ReplicationEntry& entryOut) {
+    if (key.size() != kReplicationLogKeySize || key[0] != kReplicationLog ||
+        value.size() < kReplicationEntryHeaderSize) {
+        return false;
+    }
+    entryOut.sequence = readBigEndian64(key.data() + 1);
+    entryOut.op = static_cast<Confab::AssetDatabase::ReplicationOp>(value[0]);
+    entryOut.key = readBigEndian64(value.data() + 1);
+    entryOut.argument = readBigEndian64(value.data() + 9);
+    entryOut.assetKey = 0;
+    entryOut.record.clear();
+    size_t recordSize = value.size() - kReplicationEntryHeaderSize;
+    if (entryOut.op == Confab::AssetDatabase::kReplicateListItem) {
+        if (recordSize != sizeof(uint64_t)) {
+            return false;
+        }
+        entryOut.assetKey = readBigEndian64(value.data() + kReplicationEntryHeaderSize);
+    } else {
+        entryOut.record.assign(value.data() + kReplicationEntryHeaderSize, recordSize);
+    }
+    return true;
+}
+
 inline bool iteratorMatch(std::shared_ptr<leveldb::Iterator> iterator, char* key, size_t keySize) noexcept {
     return iterator->Valid() &&
            iterator->key().size() == keySize &&
@@ -158,70 +764,445 @@ private:
     std::shared_ptr<leveldb::Iterator> m_iterator;
 };
 
+/*! The BatchRecord holds one result of a batched lookup.
+ *
+ * Batched lookups share a single iterator, which moves on to the next key as soon as one is found, so each key and
+ * value is copied in to a buffer shared by all the Records returned from the batch. Values built in memory, with no
+ * key, are also returned this way.
+ */
+class BatchRecord : public Record {
+public:
+    /*! Default constructor not supported, use makeEmptyRecord().
+     */
+    BatchRecord() = delete;
 
-AssetDatabase::AssetDatabase() :
-    m_database(nullptr) {
-}
-
-AssetDatabase::~AssetDatabase() {
-}
-
-bool AssetDatabase::open(const char* path, bool createNew, int cacheSize) {
-    leveldb::Options options;
-    options.create_if_missing = createNew;
-    options.error_if_exists = createNew;
-    if (cacheSize > 0) {
-        options.block_cache = leveldb::NewLRUCache(cacheSize);
+    /*! Construct a record pointing in to a shared batch buffer.
+     *
+     * \param buffer The buffer holding the results of the batch.
+     * \param offset The offset of the key in buffer, followed immediately by the value.
+     * \param keySize The size of the key in bytes.
+     * \param dataSize The size of the value in bytes.
+     */
+    BatchRecord(std::shared_ptr<const std::string> buffer, size_t offset, size_t keySize, size_t dataSize) :
+        m_buffer(buffer),
+        m_offset(offset),
+        m_keySize(keySize),
+        m_dataSize(dataSize) {
     }
 
-    leveldb::DB* database = nullptr;
+    ~BatchRecord() override { }
 
-    leveldb::Status status = leveldb::DB::Open(options, path, &database);
-    if (!status.ok()) {
-        LOG(ERROR) << "Failure opening or creating database at '" << path << "'. LevelDB status: " << status.ToString();
-        return false;
-    } else {
-        LOG(INFO) << "Opened database file at '" << path << "'.";
+    /*! Always reports a non-empty Record, as keys that aren't found get an EmptyRecord instead.
+     *
+     * \return Always false.
+     */
+    bool empty() const override { return false; }
+
+    /*! A pointer to the value copied from the Database.
+     *
+     * \return A non-owning pointer to the data, valid for the lifetime of this Record.
+     */
+    const SizedPointer data() const override {
+        return SizedPointer(m_buffer->data() + m_offset + m_keySize, m_dataSize);
+    }
+
+    /*! The key associated with this Record.
+     *
+     * \return A non-owning pointer to the key data.
+     */
+    const SizedPointer key() const override {
+        return SizedPointer(m_buffer->data() + m_offset, m_keySize);
+    }
+
+private:
+    std::shared_ptr<const std::string> m_buffer;
+    size_t m_offset;
+    size_t m_keySize;
+    size_t m_dataSize;
+};
+
+/*! Returns a FlatAssetData record carrying the provided hash, with the contents of the stored one.
+ *
+ * Chunks with the same contents share one blob, holding the FlatAssetData first stored with those contents. Chunk
+ * hashes cover the whole file up to the end of the chunk, so a chunk from any other file with the same contents must
+ * be rebuilt around its own hash.
+ *
+ * \param blob The stored FlatAssetData record.
+ * \param hash The hash the returned FlatAssetData should carry.
+ * \return blob itself if it already carries hash, otherwise a rebuilt copy.
+ */
+inline RecordPtr withChunkHash(RecordPtr blob, uint64_t hash) {
+    if (blob->empty()) {
+        return blob;
+    }
+    auto stored = Data::GetFlatAssetData(blob->data().data());
+    if (stored->hash() == hash || !stored->data()) {
+        return blob;
+    }
+    flatbuffers::FlatBufferBuilder builder(blob->data().size() + 64);
+    auto contents = builder.CreateVector(stored->data()->data(), stored->data()->size());
+    Data::FlatAssetDataBuilder assetDataBuilder(builder);
+    assetDataBuilder.add_data(contents);
+    assetDataBuilder.add_hash(hash);
+    builder.Finish(assetDataBuilder.Finish());
+    auto buffer = std::make_shared<const std::string>(reinterpret_cast<const char*>(builder.GetBufferPointer()),
+        builder.GetSize());
+    return RecordPtr(new BatchRecord(buffer, 0, 0, buffer->size()));
+}
+
+/*! Reads a blob from the blob store, decompressing it if it was stored compressed.
+ *
+ * \param blobStore The store to read from.
+ * \param codec The codec to decompress with.
+ * \param location The blob to read.
+ * \return The stored FlatAssetData, or an empty Record on error.
+ */
+inline RecordPtr readChunkBlob(BlobStore& blobStore, const ChunkCodec& codec, const BlobStore::Location& location) {
+    RecordPtr blob = blobStore.read(location);
+    if (blob->empty() || !ChunkCodec::isCompressed(blob->data())) {
+        return blob;
+    }
+    auto chunk = std::make_shared<std::string>();
+    if (!codec.decompress(blob->data(), *chunk)) {
+        LOG(ERROR) << "failed to decompress chunk in blob segment " << location.segment << " at " << location.offset;
+        return makeEmptyRecord();
+    }
+    return RecordPtr(new BatchRecord(chunk, 0, 0, chunk->size()));
+}
+
+/*! Looks up every key in keys with the one provided iterator, visiting them in lexical order so the iterator only
+ * moves forward through the database.
+ *
+ * \param iterator The iterator to search with.
+ * \param keys The database keys to look up, in any order. May contain repeats.
+ * \param recordsOut Replaced with one Record for each key, in the same order as keys. Keys not found get an
+ *                   EmptyRecord.
+ * \return The number of keys found.
+ */
+inline size_t loadBatch(leveldb::Iterator* iterator, const std::vector<std::string>& keys,
+    std::vector<RecordPtr>& recordsOut) {
+    std::vector<size_t> order(keys.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&keys](size_t a, size_t b) {
+        return keys[a] < keys[b];
+    });
+
+    // Spans are kept as offsets while the buffer is still growing, and turned in to Records at the end.
+    auto buffer = std::make_shared<std::string>();
+    std::vector<std::pair<size_t, size_t>> spans(keys.size(), std::make_pair(0, 0));
+    std::vector<bool> found(keys.size(), false);
+    size_t foundCount = 0;
+    for (auto index : order) {
+        leveldb::Slice key(keys[index]);
+        // Batches often ask for neighboring keys, such as consecutive chunks of the same Asset, and stepping forward
+        // one entry is cheaper than a fresh Seek().
+        if (iterator->Valid() && iterator->key().compare(key) < 0) {
+            iterator->Next();
+        }
+        if (!iterator->Valid() || iterator->key().compare(key) != 0) {
+            iterator->Seek(key);
+        }
+        if (iterator->Valid() && iterator->key() == key) {
+            spans[index] = std::make_pair(buffer->size(), iterator->value().size());
+            buffer->append(key.data(), key.size());
+            buffer->append(iterator->value().data(), iterator->value().size());
+            found[index] = true;
+            ++foundCount;
+        }
+    }
+
+    recordsOut.clear();
+    recordsOut.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (found[i]) {
+            recordsOut.emplace_back(new BatchRecord(buffer, spans[i].first, keys[i].size(), spans[i].second));
+        } else {
+            recordsOut.push_back(makeEmptyRecord());
+        }
+    }
+    return foundCount;
+}
+
+
+AssetDatabase::AssetDatabase() :
+    m_database(nullptr),
+    m_dataDatabase(nullptr),
+    m_chunkBytesBeforeCompression(0),
+    m_chunkBytesAfterCompression(0),
+    m_dictionaryTraining(false),
+    m_schemaVersion(kSchemaInitial),
+    m_migrationKeysPerSecond(0),
+    m_quitMigration(false),
+    m_quitGarbageCollection(false),
+    m_quitScrub(false),
+    m_replicationLogging(false),
+    m_replicationSequence(0) {
+}
+
+AssetDatabase::~AssetDatabase() {
+    close();
+}
+
+bool AssetDatabase::open(const char* path, bool createNew, int cacheSize, int dataCacheSize, int assetCacheSize) {
+    // Metadata and AssetData live in separate databases, each with its own block cache, so that streaming a large
+    // Asset can't evict hot metadata, and compaction of bulk data doesn't hold up metadata writes.
+    leveldb::Options options;
+    options.create_if_missing = createNew;
+    options.error_if_exists = createNew;
+    if (cacheSize > 0) {
+        m_metadataCache.reset(leveldb::NewLRUCache(cacheSize));
+        options.block_cache = m_metadataCache.get();
+    }
+
+    leveldb::DB* database = nullptr;
+
+    leveldb::Status status = leveldb::DB::Open(options, path, &database);
+    if (!status.ok()) {
+        LOG(ERROR) << "Failure opening or creating database at '" << path << "'. LevelDB status: " << status.ToString();
+        return false;
+    } else {
+        LOG(INFO) << "Opened database file at '" << path << "'.";
     }
 
     m_database.reset(database);
 
+    // The data database is created alongside databases from older versions of confab, which had none.
+    std::string dataPath = std::string(path) + kDataDatabaseSuffix;
+    leveldb::Options dataOptions;
+    dataOptions.create_if_missing = true;
+    dataOptions.error_if_exists = createNew;
+    dataOptions.block_size = kDataBlockSize;
+    dataOptions.write_buffer_size = kDataWriteBufferSize;
+    if (dataCacheSize > 0) {
+        m_dataCache.reset(leveldb::NewLRUCache(dataCacheSize));
+        dataOptions.block_cache = m_dataCache.get();
+    }
+
+    database = nullptr;
+    status = leveldb::DB::Open(dataOptions, dataPath, &database);
+    if (!status.ok()) {
+        LOG(ERROR) << "Failure opening or creating data database at '" << dataPath << "'. LevelDB status: "
+            << status.ToString();
+        m_database.reset();
+        return false;
+    } else {
+        LOG(INFO) << "Opened data database file at '" << dataPath << "'.";
+    }
+
+    m_dataDatabase.reset(database);
+
+    std::string blobPath = std::string(path) + kBlobStoreSuffix;
+    m_blobStore.reset(new BlobStore);
+    if (!m_blobStore->open(blobPath)) {
+        LOG(ERROR) << "Failure opening blob store at '" << blobPath << "'.";
+        m_dataDatabase.reset();
+        m_database.reset();
+        return false;
+    }
+
+    m_assetCache.reset(new AssetCache(assetCacheSize > 0 ? assetCacheSize : 0));
+
+    m_chunkCodec.reset(new ChunkCodec);
+    loadChunkDictionaries();
+    loadQuarantine();
+
+    // Migrations to layouts that reads can't follow alongside the older one are run before the database is used.
+    m_quitMigration = false;
+    if (!loadSchemaVersion(createNew) || !runMigrations(false)) {
+        m_blobStore.reset();
+        m_dataDatabase.reset();
+        m_database.reset();
+        return false;
+    }
+
+    // The replication log continues from its last entry, if any, found by seeking just past the end of the log.
+    {
+        std::unique_ptr<leveldb::Iterator> logIterator(m_database->NewIterator(leveldb::ReadOptions()));
+        char endPrefix = kReplicationLog + 1;
+        logIterator->Seek(leveldb::Slice(&endPrefix, 1));
+        if (logIterator->Valid()) {
+            logIterator->Prev();
+        } else {
+            logIterator->SeekToLast();
+        }
+        if (logIterator->Valid() && logIterator->key().size() == kReplicationLogKeySize &&
+            logIterator->key()[0] == kReplicationLog) {
+            m_replicationSequence = readBigEndian64(logIterator->key().data() + 1);
+            LOG(INFO) << "replication log continues from sequence " << m_replicationSequence;
+        }
+    }
+
+    // The rest run while the database is in use, with reads following both layouts until they are complete.
+    if (m_schemaVersion < kSchemaVersion) {
+        LOG(INFO) << "database schema version " << m_schemaVersion << " is older than " << kSchemaVersion
+            << ", continuing migration in the background.";
+        m_migrationThread = std::thread(&AssetDatabase::runMigrations, this, true);
+    }
+
     return true;
 }
 
 void AssetDatabase::close() {
+    {
+        std::lock_guard<std::mutex> lock(m_garbageCollectionWaitMutex);
+        m_quitGarbageCollection = true;
+    }
+    m_garbageCollectionWait.notify_all();
+    if (m_garbageCollectionThread.joinable()) {
+        m_garbageCollectionThread.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_scrubWaitMutex);
+        m_quitScrub = true;
+    }
+    m_scrubWait.notify_all();
+    if (m_scrubThread.joinable()) {
+        m_scrubThread.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_migrationWaitMutex);
+        m_quitMigration = true;
+    }
+    m_migrationWait.notify_all();
+    if (m_migrationThread.joinable()) {
+        m_migrationThread.join();
+    }
+    if (m_dictionaryThread.joinable()) {
+        m_dictionaryThread.join();
+    }
+    if (m_assetCache) {
+        LOG(INFO) << "Asset cache hits: " << m_assetCache->hits() << ", misses: " << m_assetCache->misses();
+    }
+    if (m_chunkBytesBeforeCompression > 0) {
+        LOG(INFO) << "stored " << m_chunkBytesBeforeCompression << " bytes of new chunk contents in "
+            << m_chunkBytesAfterCompression << " bytes.";
+    }
+    // Databases must be closed before the caches they use are deleted.
+    m_blobStore.reset();
+    m_dataDatabase.reset();
     m_database.reset();
+    m_dataCache.reset();
+    m_metadataCache.reset();
+}
+
+void AssetDatabase::setMigrationKeysPerSecond(size_t keysPerSecond) {
+    m_migrationKeysPerSecond = keysPerSecond;
+}
+
+uint64_t AssetDatabase::schemaVersion() const {
+    return m_schemaVersion;
+}
+
+RecordPtr AssetDatabase::loadConfig() {
+    SizedPointer configKey = Config::getConfigKey();
+    std::shared_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
+    iterator->Seek(leveldb::Slice(configKey.dataChar(), configKey.size()));
+    if (!iterator->Valid() || iterator->key() != leveldb::Slice(configKey.dataChar(), configKey.size())) {
+        return makeEmptyRecord();
+    }
+    return RecordPtr(new DatabaseRecord(iterator));
+}
+
+bool AssetDatabase::storeConfig(const SizedPointer& config) {
+    SizedPointer configKey = Config::getConfigKey();
+    auto status = m_database->Put(leveldb::WriteOptions(), leveldb::Slice(configKey.dataChar(), configKey.size()),
+        leveldb::Slice(config.dataChar(), config.size()));
+    if (!status.ok()) {
+        LOG(ERROR) << "error storing database config, status: " << status.ToString();
+    }
+    return status.ok();
 }
 
 RecordPtr AssetDatabase::findAsset(uint64_t key) {
-    std::array<char, kAssetKeySize> assetKey;
-    makeAssetKey(key, assetKey.data());
+    RecordPtr cached = m_assetCache->find(key);
+    if (cached) {
+        return cached;
+    }
+    uint64_t cacheEpoch = m_assetCache->epoch(key);
+
+    // A single point read of the chain head index resolves a deprecated Asset to the current version.
+    uint64_t loadedKey = key;
+    std::array<char, kChainHeadKeySize> chainHeadKey;
+    makeChainHeadKey(key, chainHeadKey.data());
+    std::string chainHead;
+    auto status = m_database->Get(leveldb::ReadOptions(), leveldb::Slice(chainHeadKey.data(), kChainHeadKeySize),
+        &chainHead);
+    if (status.ok() && chainHead.size() == sizeof(uint64_t)) {
+        std::memcpy(&loadedKey, chainHead.data(), sizeof(uint64_t));
+    } else if (!status.ok() && !status.IsNotFound()) {
+        LOG(ERROR) << "error reading chain head for Asset " << Asset::keyToString(key) << ", status: "
+            << status.ToString();
+    }
 
+    std::array<char, kAssetKeySize> assetKey;
+    makeAssetKey(loadedKey, assetKey.data());
     std::shared_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
     iterator->Seek(leveldb::Slice(assetKey.data(), kAssetKeySize));
     if (!iteratorMatch(iterator, assetKey.data(), kAssetKeySize)) {
-        LOG(ERROR) << "Asset " << Asset::keyToString(key) << " not found in database.";
+        LOG(ERROR) << "Asset " << Asset::keyToString(loadedKey) << " not found in database.";
         return makeEmptyRecord();
     }
 
-    uint64_t loadedKey = key;
-    auto flatAsset = Data::GetFlatAsset(iterator->value().data());
-    while (flatAsset->deprecatedBy()) {
-        uint64_t deprecatedBy = flatAsset->deprecatedBy();
-        LOG(INFO) << "Asset " << Asset::keyToString(key) << " deprecated by " << Asset::keyToString(deprecatedBy)
-            << ", loading.";
-        makeAssetKey(deprecatedBy, assetKey.data());
-        iterator->Seek(leveldb::Slice(assetKey.data(), kAssetKeySize));
-        if (!iteratorMatch(iterator, assetKey.data(), kAssetKeySize)) {
-            LOG(ERROR) << "error loaded deprecating asset " << Asset::keyToString(deprecatedBy) << ".";
-            return makeEmptyRecord();
+    if (loadedKey != key) {
+        LOG(INFO) << "Loaded Asset " << Asset::keyToString(loadedKey) << " upon request to load deprecated asset "
+            << Asset::keyToString(key);
+    }
+
+    // Only verified records are cached, so cache hits can be trusted without verifying again.
+    SizedPointer assetData(iterator->value().data(), iterator->value().size());
+    auto verifier = flatbuffers::Verifier(assetData.data(), assetData.size());
+    if (!Data::VerifyFlatAssetBuffer(verifier)) {
+        LOG(ERROR) << "Asset " << Asset::keyToString(loadedKey) << " failed verification.";
+        return makeEmptyRecord();
+    }
+    return m_assetCache->insert(key, assetData, cacheEpoch);
+}
+
+uint64_t AssetDatabase::assetCacheHits() const {
+    return m_assetCache ? m_assetCache->hits() : 0;
+}
+
+uint64_t AssetDatabase::assetCacheMisses() const {
+    return m_assetCache ? m_assetCache->misses() : 0;
+}
+
+uint64_t AssetDatabase::chunkBytesBeforeCompression() const {
+    return m_chunkBytesBeforeCompression;
+}
+
+uint64_t AssetDatabase::chunkBytesAfterCompression() const {
+    return m_chunkBytesAfterCompression;
+}
+
+std::vector<RecordPtr> AssetDatabase::findAssets(const std::vector<uint64_t>& keys) {
+    leveldb::ReadOptions readOptions;
+    readOptions.snapshot = m_database->GetSnapshot();
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->NewIterator(readOptions));
+
+    // First pass resolves any deprecated Assets to the heads of their chains.
+    std::vector<std::string> databaseKeys(keys.size(), std::string(kChainHeadKeySize, '\0'));
+    for (size_t i = 0; i < keys.size(); ++i) {
+        makeChainHeadKey(keys[i], &databaseKeys[i][0]);
+    }
+    std::vector<RecordPtr> chainHeads;
+    loadBatch(iterator.get(), databaseKeys, chainHeads);
+
+    // Second pass loads the Assets themselves.
+    databaseKeys.assign(keys.size(), std::string(kAssetKeySize, '\0'));
+    for (size_t i = 0; i < keys.size(); ++i) {
+        uint64_t loadKey = keys[i];
+        if (!chainHeads[i]->empty() && chainHeads[i]->data().size() == sizeof(uint64_t)) {
+            std::memcpy(&loadKey, chainHeads[i]->data().data(), sizeof(uint64_t));
         }
-        flatAsset = Data::GetFlatAsset(iterator->value().data());
-        loadedKey = deprecatedBy;
+        makeAssetKey(loadKey, &databaseKeys[i][0]);
     }
-    LOG(INFO) << "Loaded Asset " << Asset::keyToString(loadedKey) << " upon request to load original asset "
-        << Asset::keyToString(key);
-    return RecordPtr(new DatabaseRecord(iterator));
+    std::vector<RecordPtr> records;
+    size_t found = loadBatch(iterator.get(), databaseKeys, records);
+
+    iterator.reset();
+    m_database->ReleaseSnapshot(readOptions.snapshot);
+    LOG(INFO) << "batch found " << found << " of " << keys.size() << " Assets.";
+    return records;
 }
 
 RecordPtr AssetDatabase::findNamedAsset(const std::string& name) {
@@ -241,6 +1222,12 @@ RecordPtr AssetDatabase::findNamedAsset(const std::string& name) {
 }
 
 bool AssetDatabase::storeAsset(uint64_t key, const SizedPointer& assetData) {
+    uint64_t timeStamp = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+    return storeAssetAt(key, assetData, timeStamp);
+}
+
+bool AssetDatabase::storeAssetAt(uint64_t key, const SizedPointer& assetData, uint64_t timeStamp) {
     leveldb::WriteBatch batch;
 
     // First we parse the Asset data to extract the name, if any.
@@ -251,68 +1238,1732 @@ bool AssetDatabase::storeAsset(uint64_t key, const SizedPointer& assetData) {
         name = kAssetNamePrefix + flatAsset->name()->str();
         LOG(INFO) << "adding name '" << flatAsset->name()->data() << "' lookup to asset " << Asset::keyToString(key);
         batch.Put(name, leveldb::Slice(reinterpret_cast<const char*>(&key), sizeof(uint64_t)));
+        addNameSearchEntries(flatAsset->name()->str(), kAsset, key, batch);
+    }
+
+    // Add any list entries to the batch.
+    char listKeys[kListEntryKeySize * kAssetMaxListEntries];
+    for (auto i = 0; i < flatAsset->lists()->size(); ++i) {
+        char* listKey = listKeys + (i * kListEntryKeySize);
+        makeListEntryKey(flatAsset->lists()->Get(i), timeStamp, key, listKey);
+        LOG(INFO) << "adding asset " << Asset::keyToString(key) << " to list " << Asset::keyToString(
+            flatAsset->lists()->data()[i]);
+        batch.Put(leveldb::Slice(listKey, kListEntryKeySize), leveldb::Slice());
+    }
+
+    // Add the secondary index entries, which like the name and list entries must live until the write.
+    std::vector<std::string> indexKeys;
+    indexKeys.push_back(makeIndexEntryKey(makeTypeIndexPrefix(flatAsset->type()), timeStamp, key));
+    if (flatAsset->author()) {
+        indexKeys.push_back(makeIndexEntryKey(makeAuthorIndexPrefix(flatAsset->author(), flatAsset->type()),
+            timeStamp, key));
+        indexKeys.push_back(makeIndexEntryKey(makeAuthorIndexPrefix(flatAsset->author(), kAnyType), timeStamp, key));
+    }
+    for (const auto& indexKey : indexKeys) {
+        batch.Put(indexKey, leveldb::Slice());
+    }
+
+    // Store actual Asset key/value pair.
+    std::array<char, kAssetKeySize> assetKey;
+    makeAssetKey(key, assetKey.data());
+    batch.Put(leveldb::Slice(assetKey.data(), kAssetKeySize), leveldb::Slice(assetData.dataChar(), assetData.size()));
+
+    // Assets that deprecate nothing start no chain, and can skip taking the chain lock.
+    std::unique_lock<std::mutex> chainLock(m_chainMutex, std::defer_lock);
+    std::vector<uint64_t> ancestors;
+    if (flatAsset->deprecates()) {
+        chainLock.lock();
+        addChainHeads(key, flatAsset->deprecates(), batch, ancestors);
+    }
+
+    auto status = writeLogged(batch, kReplicateAsset, key, timeStamp, assetData);
+    // Every key whose lookup could now resolve differently is dropped from the Asset cache, after the write so that
+    // any lookups racing with it can't fill the cache with the old result.
+    m_assetCache->erase(key);
+    for (auto ancestor : ancestors) {
+        m_assetCache->erase(ancestor);
+    }
+    if (status.ok()) {
+        LOG(INFO) << "Asset store " << Asset::keyToString(key) << " success.";
+    } else {
+        LOG(ERROR) << "Failed to store Asset " << Asset::keyToString(key) << " in database, status: "
+            << status.ToString();
+    }
+
+    return status.ok();
+}
+
+void AssetDatabase::addChainHeads(uint64_t key, uint64_t deprecates, leveldb::WriteBatch& batch,
+    std::vector<uint64_t>& ancestorsOut) {
+    std::array<char, kChainHeadKeySize> chainHeadKey;
+    std::string chainHead;
+
+    // If a newer Asset deprecating this one was stored first, as can happen when Assets are downloaded out of order,
+    // then that Asset remains the head of the chain.
+    uint64_t head = key;
+    makeChainHeadKey(key, chainHeadKey.data());
+    if (m_database->Get(leveldb::ReadOptions(), leveldb::Slice(chainHeadKey.data(), kChainHeadKeySize),
+            &chainHead).ok() && chainHead.size() == sizeof(uint64_t)) {
+        std::memcpy(&head, chainHead.data(), sizeof(uint64_t));
+    }
+
+    // Walk back through every ancestor, pointing each at the head. Any ancestors not yet stored locally end the walk,
+    // but still get an entry, so they resolve to the head if they arrive later.
+    std::array<char, kAssetKeySize> assetKey;
+    std::string assetValue;
+    uint64_t ancestor = deprecates;
+    size_t chainLength = 0;
+    while (ancestor && ancestor != key && chainLength < kMaxChainLength) {
+        makeChainHeadKey(ancestor, chainHeadKey.data());
+        batch.Put(leveldb::Slice(chainHeadKey.data(), kChainHeadKeySize),
+            leveldb::Slice(reinterpret_cast<const char*>(&head), sizeof(uint64_t)));
+        ancestorsOut.push_back(ancestor);
+        ++chainLength;
+
+        makeAssetKey(ancestor, assetKey.data());
+        if (m_database->Get(leveldb::ReadOptions(), leveldb::Slice(assetKey.data(), kAssetKeySize),
+                &assetValue).ok()) {
+            ancestor = Data::GetFlatAsset(assetValue.data())->deprecates();
+        } else {
+            // Deprecated Assets deleted by garbage collection leave behind the key of the Asset they deprecated.
+            makePrunedAssetKey(ancestor, assetKey.data());
+            if (!m_database->Get(leveldb::ReadOptions(), leveldb::Slice(assetKey.data(), kAssetKeySize),
+                    &assetValue).ok() || assetValue.size() != sizeof(uint64_t)) {
+                break;
+            }
+            std::memcpy(&ancestor, assetValue.data(), sizeof(uint64_t));
+        }
+    }
+
+    LOG(INFO) << "Asset " << Asset::keyToString(key) << " is head " << Asset::keyToString(head) << " of "
+        << chainLength << " deprecated Assets.";
+}
+
+RecordPtr AssetDatabase::loadAssetDataChunk(uint64_t key, uint64_t chunk) {
+    if (isQuarantined(key)) {
+        LOG(ERROR) << "not loading Asset Data " << Asset::keyToString(key) << " chunk: " << chunk
+            << ", Asset is quarantined.";
+        return makeEmptyRecord();
+    }
+
+    // While chunks are being migrated out of the metadata database, its iterator is created first. A chunk missing
+    // from the metadata snapshot was already copied to the data database before the data snapshot was taken, so one
+    // of the two will always find a migrating chunk.
+    std::shared_ptr<leveldb::Iterator> legacyIterator;
+    if (legacyAssetData()) {
+        legacyIterator.reset(m_database->NewIterator(leveldb::ReadOptions()));
+    }
+
+    std::array<char, kAssetDataKeySize> assetDataKey;
+    makeAssetDataKey(key, chunk, assetDataKey.data());
+    std::shared_ptr<leveldb::Iterator> iterator(m_dataDatabase->NewIterator(leveldb::ReadOptions()));
+    iterator->Seek(leveldb::Slice(assetDataKey.data(), kAssetDataKeySize));
+    if (iteratorMatch(iterator, assetDataKey.data(), kAssetDataKeySize)) {
+        LOG(INFO) << "Loaded Asset " << Asset::keyToString(key) << " chunk: " << chunk << ".";
+        return resolveAssetData(RecordPtr(new DatabaseRecord(iterator)));
+    }
+
+    if (legacyIterator && seekLegacyAssetData(legacyIterator.get(), key, chunk)) {
+        LOG(INFO) << "Loaded unmigrated Asset " << Asset::keyToString(key) << " chunk: " << chunk << ".";
+        return RecordPtr(new DatabaseRecord(legacyIterator));
+    }
+
+    LOG(ERROR) << "asset Data " << Asset::keyToString(key) << " chunk: " << chunk << " not found.";
+    return makeEmptyRecord();
+}
+
+std::vector<RecordPtr> AssetDatabase::loadAssetDataChunks(
+    const std::vector<std::pair<uint64_t, uint64_t>>& keyChunks) {
+    // See loadAssetDataChunk() for why the metadata snapshot must be taken first.
+    leveldb::ReadOptions legacyReadOptions;
+    if (legacyAssetData()) {
+        legacyReadOptions.snapshot = m_database->GetSnapshot();
+    }
+    leveldb::ReadOptions readOptions;
+    readOptions.snapshot = m_dataDatabase->GetSnapshot();
+    std::unique_ptr<leveldb::Iterator> iterator(m_dataDatabase->NewIterator(readOptions));
+
+    std::vector<std::string> databaseKeys(keyChunks.size(), std::string(kAssetDataKeySize, '\0'));
+    for (size_t i = 0; i < keyChunks.size(); ++i) {
+        makeAssetDataKey(keyChunks[i].first, keyChunks[i].second, &databaseKeys[i][0]);
+    }
+    std::vector<RecordPtr> records;
+    size_t found = loadBatch(iterator.get(), databaseKeys, records);
+    iterator.reset();
+    m_dataDatabase->ReleaseSnapshot(readOptions.snapshot);
+
+    if (legacyReadOptions.snapshot) {
+        if (found < keyChunks.size()) {
+            // Look up any missing chunks in the metadata database, under either key format.
+            std::unique_ptr<leveldb::Iterator> legacyIterator(m_database->NewIterator(legacyReadOptions));
+            std::vector<size_t> missing;
+            databaseKeys.clear();
+            for (size_t i = 0; i < keyChunks.size(); ++i) {
+                if (records[i]->empty()) {
+                    missing.push_back(i);
+                    databaseKeys.emplace_back(kAssetDataKeySize, '\0');
+                    makeAssetDataKey(keyChunks[i].first, keyChunks[i].second, &databaseKeys.back()[0]);
+                }
+            }
+            std::vector<RecordPtr> legacyRecords;
+            loadBatch(legacyIterator.get(), databaseKeys, legacyRecords);
+            for (size_t i = 0; i < missing.size(); ++i) {
+                if (legacyRecords[i]->empty()) {
+                    makeLegacyAssetDataKey(keyChunks[missing[i]].first, keyChunks[missing[i]].second,
+                        &databaseKeys[i][0]);
+                } else {
+                    records[missing[i]] = legacyRecords[i];
+                    ++found;
+                }
+            }
+            loadBatch(legacyIterator.get(), databaseKeys, legacyRecords);
+            for (size_t i = 0; i < missing.size(); ++i) {
+                if (records[missing[i]]->empty() && !legacyRecords[i]->empty()) {
+                    records[missing[i]] = legacyRecords[i];
+                    ++found;
+                }
+            }
+        }
+        m_database->ReleaseSnapshot(legacyReadOptions.snapshot);
+    }
+
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (!records[i]->empty() && isQuarantined(keyChunks[i].first)) {
+            LOG(ERROR) << "not loading Asset Data " << Asset::keyToString(keyChunks[i].first) << " chunk: "
+                << keyChunks[i].second << ", Asset is quarantined.";
+            records[i] = makeEmptyRecord();
+            --found;
+        }
+        records[i] = resolveAssetData(records[i]);
+    }
+    LOG(INFO) << "batch loaded " << found << " of " << keyChunks.size() << " Asset Data chunks.";
+    return records;
+}
+
+size_t AssetDatabase::loadAssetDataRange(uint64_t key, uint64_t firstChunk, uint64_t count,
+    std::function<bool(uint64_t, const SizedPointer&)> visitor) {
+    if (isQuarantined(key)) {
+        LOG(ERROR) << "not loading Asset Data " << Asset::keyToString(key) << ", Asset is quarantined.";
+        return 0;
+    }
+
+    // See loadAssetDataChunk() for why the metadata iterator must be created first.
+    std::unique_ptr<leveldb::Iterator> legacyIterator;
+    if (legacyAssetData()) {
+        legacyIterator.reset(m_database->NewIterator(leveldb::ReadOptions()));
+    }
+
+    std::array<char, kAssetDataKeySize> assetDataKey;
+    makeAssetDataKey(key, firstChunk, assetDataKey.data());
+    // A range is usually read once, in full, so its blocks are kept out of the cache in favor of random reads.
+    leveldb::ReadOptions readOptions;
+    readOptions.fill_cache = false;
+    std::unique_ptr<leveldb::Iterator> iterator(m_dataDatabase->NewIterator(readOptions));
+    iterator->Seek(leveldb::Slice(assetDataKey.data(), kAssetDataKeySize));
+
+    uint64_t endChunk = count > std::numeric_limits<uint64_t>::max() - firstChunk ?
+        std::numeric_limits<uint64_t>::max() : firstChunk + count;
+    uint64_t chunk = firstChunk;
+    while (chunk < endChunk) {
+        // Chunks are stored consecutively, so each chunk is found by Next() from the one before it. Any gap, whether
+        // a missing chunk or the end of this Asset's chunks, ends the range.
+        if (iterator->Valid() && iterator->key().size() == kAssetDataKeySize &&
+            std::memcmp(iterator->key().data(), assetDataKey.data(), 9) == 0 &&
+            assetDataKeyChunk(iterator->key().data()) == chunk) {
+            SizedPointer value(iterator->value().data(), iterator->value().size());
+            RecordPtr blob = loadChunkBlob(value);
+            if (blob && blob->empty()) {
+                break;
+            }
+            if (!visitor(chunk, blob ? blob->data() : value)) {
+                ++chunk;
+                break;
+            }
+            iterator->Next();
+        } else if (legacyIterator) {
+            // Not yet migrated, look the chunk up in the metadata database.
+            if (!seekLegacyAssetData(legacyIterator.get(), key, chunk)) {
+                break;
+            }
+            if (!visitor(chunk, SizedPointer(legacyIterator->value().data(), legacyIterator->value().size()))) {
+                ++chunk;
+                break;
+            }
+        } else {
+            break;
+        }
+        ++chunk;
+    }
+
+    if (chunk < endChunk) {
+        LOG(INFO) << "range read of Asset " << Asset::keyToString(key) << " stopped at chunk " << chunk << " of "
+            << firstChunk << " + " << count;
+    }
+    return chunk - firstChunk;
+}
+
+bool AssetDatabase::storeAssetDataChunk(uint64_t key, uint64_t chunk, const SizedPointer& flatAssetData) {
+    auto verifier = flatbuffers::Verifier(flatAssetData.data(), flatAssetData.size());
+    if (!Data::VerifyFlatAssetDataBuffer(verifier)) {
+        LOG(ERROR) << "Asset Data " << Asset::keyToString(key) << " chunk " << chunk << " failed verification.";
+        return false;
+    }
+    auto assetData = Data::GetFlatAssetData(flatAssetData.data());
+    if (!assetData->data()) {
+        LOG(ERROR) << "Asset Data " << Asset::keyToString(key) << " chunk " << chunk << " has no data.";
+        return false;
+    }
+
+    // Chunks are stored once per distinct contents, and each AssetData entry only refers to its contents by hash.
+    SizedPointer contents(assetData->data()->data(), assetData->data()->size());
+    std::array<char, kChunkContentKeySize> contentKey;
+    leveldb::Slice contentSlice(contentKey.data(), kChunkContentKeySize);
+    std::array<char, kChunkReferenceSize> reference;
+    leveldb::Slice referenceSlice(reference.data(), kChunkReferenceSize);
+    std::array<char, kAssetDataKeySize> assetDataKey;
+    makeAssetDataKey(key, chunk, assetDataKey.data());
+    leveldb::Slice assetDataSlice(assetDataKey.data(), kAssetDataKeySize);
+
+    // How new contents are stored depends on the type of their Asset, which clients upload before its chunks.
+    Asset::Type type = static_cast<Asset::Type>(storedAssetType(key));
+    if (ChunkCodec::policy(type) != ChunkCodec::kRaw && !m_chunkCodec->hasDictionary(type)) {
+        sampleChunkForDictionary(type, flatAssetData);
+    }
+
+    // Reference counts are read, modified, and written back in the same batch as the references themselves.
+    std::lock_guard<std::mutex> lock(m_chunkMutex);
+
+    // The hash and length in the content key can collide, so contents already stored under it are compared with these
+    // before being shared. Different contents move on to the next collision index, until either matching contents or
+    // a free key are found. Should contents earlier in that chain be released, later matching contents are stored
+    // again rather than shared, which costs space but never correctness.
+    std::string contentValue;
+    BlobStore::Location location;
+    bool stored = false;
+    leveldb::Status status;
+    for (uint32_t collision = 0; ; ++collision) {
+        makeChunkContentKey(contents, collision, contentKey.data());
+        status = m_dataDatabase->Get(leveldb::ReadOptions(), contentSlice, &contentValue);
+        if (!status.ok() || !blobLocation(contentSlice, contentValue, location)) {
+            break;
+        }
+        RecordPtr blob = readChunkBlob(*m_blobStore, *m_chunkCodec, location);
+        if (blob->empty()) {
+            LOG(ERROR) << "Failed to read chunk contents to compare with Asset Data " << Asset::keyToString(key)
+                << " chunk " << chunk;
+            return false;
+        }
+        // Damaged contents can't match, so they are passed over like a collision and left for the scrubber.
+        auto blobVerifier = flatbuffers::Verifier(blob->data().data(), blob->data().size());
+        if (Data::VerifyFlatAssetDataBuffer(blobVerifier)) {
+            auto storedData = Data::GetFlatAssetData(blob->data().data())->data();
+            if (storedData && storedData->size() == contents.size() &&
+                std::memcmp(storedData->data(), contents.data(), contents.size()) == 0) {
+                stored = true;
+                break;
+            }
+        }
+        LOG(WARNING) << "Asset Data " << Asset::keyToString(key) << " chunk " << chunk << " collides with different "
+            << "contents at collision index " << collision << ".";
+    }
+    if (!stored && !status.ok() && !status.IsNotFound()) {
+        LOG(ERROR) << "Failed to read chunk contents for Asset Data " << Asset::keyToString(key) << " chunk " << chunk
+            << ", status: " << status.ToString();
+        return false;
+    }
+    encodeChunkReference(contentKey.data(), assetData->hash(), reference.data());
+
+    leveldb::WriteBatch batch;
+    std::string existing;
+    status = m_dataDatabase->Get(leveldb::ReadOptions(), assetDataSlice, &existing);
+    if (!status.ok() && !status.IsNotFound()) {
+        LOG(ERROR) << "Failed to read Asset Data " << Asset::keyToString(key) << " chunk " << chunk << ", status: "
+            << status.ToString();
+        return false;
+    }
+    std::array<char, kChunkContentKeySize> existingContentKey;
+    uint64_t existingHash = 0;
+    if (status.ok() && decodeChunkReference(existing, existingContentKey.data(), existingHash)) {
+        if (existingContentKey == contentKey) {
+            // Already counted, this is a repeated upload of the same chunk. It is logged again all the same, in case
+            // the first upload was stored but failed to be logged.
+            if (existingHash != assetData->hash()) {
+                status = m_dataDatabase->Put(leveldb::WriteOptions(), assetDataSlice, referenceSlice);
+            }
+            if (status.ok() && m_replicationLogging) {
+                leveldb::WriteBatch logBatch;
+                status = writeLogged(logBatch, kReplicateAssetData, key, chunk, SizedPointer());
+            }
+            LOG(INFO) << "Asset Data " << Asset::keyToString(key) << " chunk " << chunk << " already stored.";
+            return status.ok();
+        }
+        if (!releaseChunkContent(existingContentKey.data(), 1, batch)) {
+            return false;
+        }
+    }
+
+    uint64_t references = 0;
+    if (stored) {
+        references = readBigEndian64(contentValue.data() + BlobStore::kEncodedLocationSize);
+    } else {
+        std::string compressed;
+        SizedPointer blobData = flatAssetData;
+        if (m_chunkCodec->compress(type, flatAssetData, compressed)) {
+            blobData = SizedPointer(compressed.data(), compressed.size());
+        }
+        if (!m_blobStore->append(blobData, location)) {
+            LOG(ERROR) << "Failed to append Asset Data " << Asset::keyToString(key) << " chunk " << chunk
+                << " to blob store.";
+            return false;
+        }
+        contentValue.assign(kChunkContentValueSize, '\0');
+        BlobStore::encodeLocation(location, &contentValue[0]);
+        m_chunkBytesBeforeCompression += flatAssetData.size();
+        m_chunkBytesAfterCompression += blobData.size();
+    }
+    writeBigEndian64(references + 1, &contentValue[BlobStore::kEncodedLocationSize]);
+    batch.Put(contentSlice, contentValue);
+    batch.Put(assetDataSlice, referenceSlice);
+    status = m_dataDatabase->Write(leveldb::WriteOptions(), &batch);
+
+    // The log is in the metadata database, so is written separately once the chunk is stored. Only the chunk number is
+    // logged, followers fetch the chunk itself.
+    if (status.ok() && m_replicationLogging) {
+        leveldb::WriteBatch logBatch;
+        status = writeLogged(logBatch, kReplicateAssetData, key, chunk, SizedPointer());
+    }
+
+    if (status.ok()) {
+        LOG(INFO) << "Asset Data store " << Asset::keyToString(key) << " chunk " << chunk << " success, "
+            << (references + 1) << " references to contents.";
+    } else {
+        LOG(ERROR) << "Failed to store Asset Data " << Asset::keyToString(key) << " chunk " << chunk << ", status: "
+            << status.ToString();
+    }
+
+    return status.ok();
+}
+
+size_t AssetDatabase::releaseAssetData(uint64_t key) {
+    if (legacyAssetData()) {
+        LOG(ERROR) << "not releasing Asset Data " << Asset::keyToString(key) << " while migration is running.";
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(m_chunkMutex);
+    leveldb::WriteBatch batch;
+    // Chunks of the same Asset can share contents, so releases are totaled before any reference count is changed.
+    std::map<std::string, uint64_t> released;
+    size_t chunks = 0;
+    std::array<char, kAssetDataKeySize> assetDataKey;
+    makeAssetDataKey(key, 0, assetDataKey.data());
+    std::array<char, kChunkContentKeySize> contentKey;
+    uint64_t hash = 0;
+    leveldb::ReadOptions scanOptions;
+    scanOptions.fill_cache = false;
+    std::unique_ptr<leveldb::Iterator> iterator(m_dataDatabase->NewIterator(scanOptions));
+    for (iterator->Seek(leveldb::Slice(assetDataKey.data(), kAssetDataKeySize)); iterator->Valid() &&
+            iterator->key().size() == kAssetDataKeySize &&
+            std::memcmp(iterator->key().data(), assetDataKey.data(), 9) == 0; iterator->Next()) {
+        batch.Delete(iterator->key());
+        ++chunks;
+        if (decodeChunkReference(iterator->value(), contentKey.data(), hash)) {
+            ++released[std::string(contentKey.data(), kChunkContentKeySize)];
+        }
+    }
+    iterator.reset();
+
+    for (const auto& contents : released) {
+        if (!releaseChunkContent(contents.first.data(), contents.second, batch)) {
+            return 0;
+        }
+    }
+    auto status = m_dataDatabase->Write(leveldb::WriteOptions(), &batch);
+    if (!status.ok()) {
+        LOG(ERROR) << "Failed to release Asset Data " << Asset::keyToString(key) << ", status: " << status.ToString();
+        return 0;
+    }
+    LOG(INFO) << "released " << chunks << " chunks of Asset Data " << Asset::keyToString(key) << ".";
+    return chunks;
+}
+
+bool AssetDatabase::releaseChunkContent(const char* contentKey, uint64_t count, leveldb::WriteBatch& batch) {
+    leveldb::Slice contentSlice(contentKey, kChunkContentKeySize);
+    std::string contentValue;
+    BlobStore::Location location;
+    auto status = m_dataDatabase->Get(leveldb::ReadOptions(), contentSlice, &contentValue);
+    if (status.IsNotFound()) {
+        return true;
+    }
+    if (!status.ok() || !blobLocation(contentSlice, contentValue, location)) {
+        LOG(ERROR) << "Failed to read chunk contents for release, status: " << status.ToString();
+        return false;
+    }
+    uint64_t references = readBigEndian64(contentValue.data() + BlobStore::kEncodedLocationSize);
+    if (references <= count) {
+        // The blob is now unreferenced, and its space is reclaimed by compactBlobSegments().
+        batch.Delete(contentSlice);
+    } else {
+        writeBigEndian64(references - count, &contentValue[BlobStore::kEncodedLocationSize]);
+        batch.Put(contentSlice, contentValue);
+    }
+    return true;
+}
+
+uint32_t AssetDatabase::storedAssetType(uint64_t key) {
+    std::array<char, kAssetKeySize> assetKey;
+    makeAssetKey(key, assetKey.data());
+    std::string assetValue;
+    if (!m_database->Get(leveldb::ReadOptions(), leveldb::Slice(assetKey.data(), kAssetKeySize), &assetValue).ok()) {
+        return Asset::kInvalid;
+    }
+    auto verifier = flatbuffers::Verifier(reinterpret_cast<const uint8_t*>(assetValue.data()), assetValue.size());
+    if (!Data::VerifyFlatAssetBuffer(verifier)) {
+        return Asset::kInvalid;
+    }
+    return Data::GetFlatAsset(assetValue.data())->type();
+}
+
+void AssetDatabase::sampleChunkForDictionary(uint32_t type, const SizedPointer& chunk) {
+    std::lock_guard<std::mutex> lock(m_dictionaryMutex);
+    // Another store may have finished training while this one waited for the lock.
+    if (m_chunkCodec->hasDictionary(static_cast<Asset::Type>(type))) {
+        return;
+    }
+    auto& samples = m_dictionarySamples[type];
+    if (m_dictionarySampleBytes[type] < kDictionaryTrainingBytes) {
+        samples.emplace_back(chunk.dataChar(), chunk.size());
+        m_dictionarySampleBytes[type] += chunk.size();
+        if (m_dictionarySampleBytes[type] < kDictionaryTrainingBytes) {
+            return;
+        }
+    }
+
+    // Training is too slow to hold up the store that completes the samples, so it runs in the background, and chunks
+    // keep being stored without the dictionary until it is ready. Types ready while another trains wait for their
+    // next store to start.
+    if (m_dictionaryTraining) {
+        return;
+    }
+    if (m_dictionaryThread.joinable()) {
+        m_dictionaryThread.join();
+    }
+    std::vector<std::string> trainingSamples;
+    trainingSamples.swap(samples);
+    m_dictionarySamples.erase(type);
+    m_dictionarySampleBytes.erase(type);
+    m_dictionaryTraining = true;
+    m_dictionaryThread = std::thread(&AssetDatabase::trainChunkDictionary, this, type, std::move(trainingSamples));
+}
+
+void AssetDatabase::trainChunkDictionary(uint32_t type, std::vector<std::string> samples) {
+    std::string dictionary = ChunkCodec::trainDictionary(samples, kDictionarySize);
+    bool added = false;
+    if (!dictionary.empty()) {
+        // The dictionary is durably stored before use, so no chunk is ever written that can't be read after a restart.
+        std::array<char, kChunkDictionaryKeySize> dictionaryKey;
+        dictionaryKey[0] = kChunkDictionary;
+        writeBigEndian32(type, dictionaryKey.data() + 1);
+        writeBigEndian32(ChunkCodec::dictionaryId(dictionary), dictionaryKey.data() + 5);
+        leveldb::WriteOptions writeOptions;
+        writeOptions.sync = true;
+        auto status = m_database->Put(writeOptions, leveldb::Slice(dictionaryKey.data(), kChunkDictionaryKeySize),
+            dictionary);
+        if (status.ok()) {
+            added = m_chunkCodec->addDictionary(static_cast<Asset::Type>(type), dictionary);
+        } else {
+            LOG(ERROR) << "failed to store chunk dictionary, status: " << status.ToString();
+        }
+    }
+
+    // Without a dictionary, sampling starts over, in case later chunks are more varied. With one, any samples kept
+    // during training are no longer needed.
+    std::lock_guard<std::mutex> lock(m_dictionaryMutex);
+    if (added) {
+        LOG(INFO) << "trained chunk dictionary of " << dictionary.size() << " bytes for Asset type " << type;
+        m_dictionarySamples.erase(type);
+        m_dictionarySampleBytes.erase(type);
+    }
+    m_dictionaryTraining = false;
+}
+
+void AssetDatabase::loadChunkDictionaries() {
+    char prefix = kChunkDictionary;
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
+    for (iterator->Seek(leveldb::Slice(&prefix, 1)); iterator->Valid() && iterator->key()[0] == kChunkDictionary;
+            iterator->Next()) {
+        if (iterator->key().size() != kChunkDictionaryKeySize) {
+            continue;
+        }
+        uint32_t type = readBigEndian32(iterator->key().data() + 1);
+        m_chunkCodec->addDictionary(static_cast<Asset::Type>(type), iterator->value().ToString());
+    }
+}
+
+RecordPtr AssetDatabase::resolveAssetData(RecordPtr record) {
+    if (record->empty()) {
+        return record;
+    }
+    RecordPtr blob = loadChunkBlob(record->data());
+    return blob ? blob : record;
+}
+
+RecordPtr AssetDatabase::loadChunkBlob(const SizedPointer& value) {
+    BlobStore::Location location;
+    std::array<char, kChunkContentKeySize> contentKey;
+    uint64_t hash = 0;
+    if (decodeChunkReference(leveldb::Slice(value.dataChar(), value.size()), contentKey.data(), hash)) {
+        leveldb::Slice contentSlice(contentKey.data(), kChunkContentKeySize);
+        std::string contentValue;
+        auto status = m_dataDatabase->Get(leveldb::ReadOptions(), contentSlice, &contentValue);
+        if (!status.ok() || !blobLocation(contentSlice, contentValue, location)) {
+            LOG(ERROR) << "chunk contents referred to by Asset Data not found, status: " << status.ToString();
+            return makeEmptyRecord();
+        }
+        return withChunkHash(readChunkBlob(*m_blobStore, *m_chunkCodec, location), hash);
+    }
+    if (BlobStore::decodeLocation(value.dataChar(), value.size(), location)) {
+        return readChunkBlob(*m_blobStore, *m_chunkCodec, location);
+    }
+    return nullptr;
+}
+
+size_t AssetDatabase::compactBlobSegments(double maxLiveFraction) {
+    // Segments retired by the last pass have had their keys pointed elsewhere since then, so any reader still using a
+    // Location in them has long since read it.
+    m_blobStore->releaseRetired();
+
+    std::map<uint32_t, size_t> used;
+    uint32_t activeSegment = m_blobStore->usage(used);
+
+    // First pass totals the space still referenced in each segment, by chunk content entries and by AssetData entries
+    // stored before chunks were content-addressed.
+    std::map<uint32_t, size_t> live;
+    leveldb::ReadOptions scanOptions;
+    scanOptions.fill_cache = false;
+    std::unique_ptr<leveldb::Iterator> iterator(m_dataDatabase->NewIterator(scanOptions));
+    BlobStore::Location location;
+    for (iterator->SeekToFirst(); iterator->Valid(); iterator->Next()) {
+        if (blobLocation(iterator->key(), iterator->value(), location)) {
+            live[location.segment] += BlobStore::storedSize(location.length);
+        }
+    }
+
+    std::map<uint32_t, size_t> compacting;
+    size_t reclaimed = 0;
+    for (const auto& segment : used) {
+        if (segment.first != activeSegment && live[segment.first] < segment.second * maxLiveFraction) {
+            compacting[segment.first] = live[segment.first];
+            reclaimed += segment.second - live[segment.first];
+        }
+    }
+    if (compacting.empty()) {
+        LOG(INFO) << "no blob segments need compaction.";
+        return 0;
+    }
+
+    // Second pass appends the live blobs of compacting segments again, and points their keys at the copies.
+    struct Relocation {
+        std::string key;
+        BlobStore::Location from;
+        BlobStore::Location to;
+    };
+    std::vector<Relocation> relocated;
+    auto writeRelocated = [this, &relocated]() {
+        // Copies must be durable before any key points at them.
+        if (!m_blobStore->sync()) {
+            return false;
+        }
+        // Stores and releases may have changed these entries since the scan, so each is read again under the chunk
+        // lock, and only moved if it still refers to the blob that was copied.
+        std::lock_guard<std::mutex> lock(m_chunkMutex);
+        leveldb::WriteBatch batch;
+        std::string value;
+        BlobStore::Location current;
+        for (const auto& entry : relocated) {
+            if (!m_dataDatabase->Get(leveldb::ReadOptions(), entry.key, &value).ok() ||
+                !blobLocation(entry.key, value, current) || current.segment != entry.from.segment ||
+                current.offset != entry.from.offset) {
+                continue;
+            }
+            // Chunk content entries keep their reference count after the Location.
+            BlobStore::encodeLocation(entry.to, &value[0]);
+            batch.Put(entry.key, value);
+        }
+        relocated.clear();
+        return m_dataDatabase->Write(leveldb::WriteOptions(), &batch).ok();
+    };
+    for (iterator->SeekToFirst(); iterator->Valid(); iterator->Next()) {
+        if (!blobLocation(iterator->key(), iterator->value(), location) ||
+            compacting.find(location.segment) == compacting.end()) {
+            continue;
+        }
+        RecordPtr blob = m_blobStore->read(location);
+        BlobStore::Location newLocation;
+        if (blob->empty() || !m_blobStore->append(blob->data(), newLocation)) {
+            LOG(ERROR) << "error relocating blob from segment " << location.segment << ", abandoning compaction.";
+            return 0;
+        }
+        relocated.push_back({ iterator->key().ToString(), location, newLocation });
+        if (relocated.size() >= kMigrationBatchSize && !writeRelocated()) {
+            LOG(ERROR) << "error writing relocated blobs, abandoning compaction.";
+            return 0;
+        }
+    }
+    iterator.reset();
+    if (!relocated.empty() && !writeRelocated()) {
+        LOG(ERROR) << "error writing relocated blobs, abandoning compaction.";
+        return 0;
+    }
+
+    for (const auto& segment : compacting) {
+        m_blobStore->retire(segment.first);
+    }
+    LOG(INFO) << "compacted " << compacting.size() << " blob segments, reclaiming " << reclaimed << " bytes.";
+    return reclaimed;
+}
+
+AssetDatabase::GarbageCollectionStats AssetDatabase::collectGarbage(const GarbageCollectionOptions& options) {
+    std::lock_guard<std::mutex> lock(m_garbageCollectionMutex);
+    GarbageCollectionStats stats;
+    m_nextAbandonedCandidates.clear();
+
+    collectAssets(options, stats);
+    // Until migration from an older database is complete, AssetData may still be in the metadata database.
+    if (!legacyAssetData()) {
+        collectOrphanedAssetData(options, stats);
+    }
+    collectStaleKeys(options, stats);
+    if (options.replicationLogRetain > 0) {
+        collectReplicationLog(options, stats);
+    }
+
+    if (m_quitGarbageCollection) {
+        LOG(INFO) << "garbage collection stopped before end of pass.";
+    } else {
+        // Candidates not found again by this pass have since been completed or deleted, so are forgotten.
+        m_abandonedCandidates.swap(m_nextAbandonedCandidates);
+        stats.bytesReclaimed += compactBlobSegments();
+    }
+
+    LOG(INFO) << "garbage collection deleted " << stats.deprecatedAssets << " deprecated Assets, "
+        << stats.incompleteAssets << " incomplete Assets, " << stats.orphanedAssetData << " orphaned AssetData chunks, "
+        << stats.staleNames << " stale names, " << stats.staleIndexEntries << " stale index entries, "
+        << stats.staleSearchEntries << " stale search entries, " << stats.legacyKeys << " legacy keys, and "
+        << stats.replicationLogEntries << " replication log entries, reclaiming about "
+        << stats.bytesReclaimed << " bytes.";
+    return stats;
+}
+
+void AssetDatabase::startGarbageCollection(const GarbageCollectionOptions& options, std::chrono::seconds interval) {
+    if (m_garbageCollectionThread.joinable()) {
+        LOG(ERROR) << "garbage collection already started.";
+        return;
+    }
+    m_quitGarbageCollection = false;
+    m_garbageCollectionThread = std::thread(&AssetDatabase::runGarbageCollection, this, options, interval);
+}
+
+void AssetDatabase::collectAssets(const GarbageCollectionOptions& options, GarbageCollectionStats& stats) {
+    auto start = std::chrono::steady_clock::now();
+    size_t examined = 0;
+    char prefix = kAsset;
+    std::string resumeKey(&prefix, 1);
+    std::string compactBegin;
+    std::string compactEnd;
+    leveldb::ReadOptions scanOptions;
+    scanOptions.fill_cache = false;
+    std::array<char, kChainHeadKeySize> chainHeadKey;
+    std::array<char, kAssetDataKeySize> lastChunkKey;
+    std::string value;
+
+    while (!m_quitGarbageCollection) {
+        leveldb::WriteBatch batch;
+        std::map<uint64_t, size_t> pruned;
+        std::map<uint64_t, size_t> incomplete;
+        size_t batchExamined = 0;
+        // Each batch starts new iterators, so it sees the deletions written by the batch before.
+        std::unique_ptr<leveldb::Iterator> iterator(m_database->NewIterator(scanOptions));
+        std::unique_ptr<leveldb::Iterator> dataIterator(m_dataDatabase->NewIterator(scanOptions));
+        for (iterator->Seek(resumeKey); iterator->Valid() && iterator->key()[0] == kAsset &&
+                batchExamined < options.batchSize; iterator->Next()) {
+            ++batchExamined;
+            auto verifier = flatbuffers::Verifier(reinterpret_cast<const uint8_t*>(iterator->value().data()),
+                iterator->value().size());
+            if (iterator->key().size() != kAssetKeySize || !Data::VerifyFlatAssetBuffer(verifier)) {
+                continue;
+            }
+            uint64_t key = 0;
+            std::memcpy(&key, iterator->key().data() + 1, sizeof(uint64_t));
+            auto flatAsset = Data::GetFlatAsset(iterator->value().data());
+
+            // Each chain is walked once, back from its current version, which is the only one without a chain head
+            // index entry.
+            makeChainHeadKey(key, chainHeadKey.data());
+            bool isHead = m_database->Get(leveldb::ReadOptions(),
+                leveldb::Slice(chainHeadKey.data(), kChainHeadKeySize), &value).IsNotFound();
+            if (isHead && flatAsset->deprecates()) {
+                pruneChain(key, flatAsset->deprecates(), options.retainDeprecated, batch, pruned);
+            }
+
+            // Chunks are uploaded in order, so an upload that stopped part way is missing at least its last chunk.
+            uint64_t chunks = storedChunkCount(flatAsset);
+            if (options.deleteIncompleteAssets && !legacyAssetData() && chunks > 0) {
+                makeAssetDataKey(key, chunks - 1, lastChunkKey.data());
+                leveldb::Slice lastChunkSlice(lastChunkKey.data(), kAssetDataKeySize);
+                dataIterator->Seek(lastChunkSlice);
+                bool complete = dataIterator->Valid() && dataIterator->key() == lastChunkSlice;
+                if (!complete && abandonedPastGrace(key, options)) {
+                    batch.Delete(iterator->key());
+                    incomplete[key] = iterator->key().size() + iterator->value().size();
+                }
+            }
+        }
+        resumeKey = iterator->Valid() && iterator->key()[0] == kAsset ? iterator->key().ToString() : std::string();
+        iterator.reset();
+        dataIterator.reset();
+
+        if (pruned.size() || incomplete.size()) {
+            auto status = m_database->Write(leveldb::WriteOptions(), &batch);
+            if (!status.ok()) {
+                LOG(ERROR) << "error writing garbage collection of Assets, status: " << status.ToString();
+                return;
+            }
+            // AssetData is released after the Assets are deleted, so if interrupted it is collected as orphaned.
+            for (auto deleted : { &pruned, &incomplete }) {
+                for (const auto& asset : *deleted) {
+                    m_assetCache->erase(asset.first);
+                    size_t chunks = releaseAssetData(asset.first);
+                    stats.bytesReclaimed += asset.second + (chunks * (kAssetDataKeySize + kChunkReferenceSize));
+                    std::array<char, kAssetKeySize> assetKey;
+                    makeAssetKey(asset.first, assetKey.data());
+                    std::string deletedKey(assetKey.data(), kAssetKeySize);
+                    if (compactBegin.empty() || deletedKey < compactBegin) {
+                        compactBegin = deletedKey;
+                    }
+                    if (deletedKey > compactEnd) {
+                        compactEnd = deletedKey;
+                    }
+                }
+            }
+            stats.deprecatedAssets += pruned.size();
+            stats.incompleteAssets += incomplete.size();
+        }
+
+        examined += batchExamined;
+        if (resumeKey.empty() || !throttleGarbageCollection(options, examined, start)) {
+            break;
+        }
+    }
+
+    if (!compactBegin.empty()) {
+        leveldb::Slice begin(compactBegin);
+        leveldb::Slice end(compactEnd);
+        m_database->CompactRange(&begin, &end);
+    }
+}
+
+void AssetDatabase::pruneChain(uint64_t head, uint64_t deprecates, size_t retainDeprecated,
+    leveldb::WriteBatch& batch, std::map<uint64_t, size_t>& prunedOut) {
+    std::array<char, kAssetKeySize> assetKey;
+    std::array<char, kAssetKeySize> prunedKey;
+    std::string assetValue;
+    uint64_t ancestor = deprecates;
+    size_t depth = 1;
+    while (ancestor && ancestor != head && depth <= kMaxChainLength) {
+        makeAssetKey(ancestor, assetKey.data());
+        makePrunedAssetKey(ancestor, prunedKey.data());
+        if (m_database->Get(leveldb::ReadOptions(), leveldb::Slice(assetKey.data(), kAssetKeySize),
+                &assetValue).ok()) {
+            auto verifier = flatbuffers::Verifier(reinterpret_cast<const uint8_t*>(assetValue.data()),
+                assetValue.size());
+            if (!Data::VerifyFlatAssetBuffer(verifier)) {
+                break;
+            }
+            uint64_t next = Data::GetFlatAsset(assetValue.data())->deprecates();
+            if (depth > retainDeprecated) {
+                // The chain head index entry is kept, so the deleted Asset is still found as the head of its chain.
+                batch.Delete(leveldb::Slice(assetKey.data(), kAssetKeySize));
+                batch.Put(leveldb::Slice(prunedKey.data(), kAssetKeySize),
+                    leveldb::Slice(reinterpret_cast<const char*>(&next), sizeof(uint64_t)));
+                prunedOut[ancestor] = kAssetKeySize + assetValue.size();
+            }
+            ancestor = next;
+        } else {
+            if (!m_database->Get(leveldb::ReadOptions(), leveldb::Slice(prunedKey.data(), kAssetKeySize),
+                    &assetValue).ok() || assetValue.size() != sizeof(uint64_t)) {
+                break;
+            }
+            // Everything older than an Asset deleted by an earlier pass was deleted along with it.
+            if (depth > retainDeprecated) {
+                break;
+            }
+            std::memcpy(&ancestor, assetValue.data(), sizeof(uint64_t));
+        }
+        ++depth;
+    }
+}
+
+void AssetDatabase::collectOrphanedAssetData(const GarbageCollectionOptions& options, GarbageCollectionStats& stats) {
+    auto start = std::chrono::steady_clock::now();
+    size_t examined = 0;
+    char prefix = kAssetData;
+    std::string resumeKey(&prefix, 1);
+    std::string compactBegin;
+    std::string compactEnd;
+    leveldb::ReadOptions scanOptions;
+    scanOptions.fill_cache = false;
+    std::array<char, kAssetKeySize> assetKey;
+    std::array<char, kAssetDataKeySize> skipKey;
+    std::string value;
+
+    while (!m_quitGarbageCollection) {
+        std::vector<uint64_t> orphans;
+        size_t batchExamined = 0;
+        std::unique_ptr<leveldb::Iterator> iterator(m_dataDatabase->NewIterator(scanOptions));
+        iterator->Seek(resumeKey);
+        while (iterator->Valid() && iterator->key()[0] == kAssetData && batchExamined < options.batchSize) {
+            ++batchExamined;
+            if (iterator->key().size() != kAssetDataKeySize) {
+                iterator->Next();
+                continue;
+            }
+            uint64_t key = 0;
+            std::memcpy(&key, iterator->key().data() + 1, sizeof(uint64_t));
+            makeAssetKey(key, assetKey.data());
+            if (m_database->Get(leveldb::ReadOptions(), leveldb::Slice(assetKey.data(), kAssetKeySize),
+                    &value).IsNotFound() && abandonedPastGrace(key, options)) {
+                orphans.push_back(key);
+            }
+
+            // Only the first chunk of each Asset needs examining, so skip past the rest.
+            makeAssetDataKey(key, std::numeric_limits<uint64_t>::max(), skipKey.data());
+            leveldb::Slice skipSlice(skipKey.data(), kAssetDataKeySize);
+            iterator->Seek(skipSlice);
+            if (iterator->Valid() && iterator->key() == skipSlice) {
+                iterator->Next();
+            }
+        }
+        resumeKey = iterator->Valid() && iterator->key()[0] == kAssetData ? iterator->key().ToString() :
+            std::string();
+        iterator.reset();
+
+        for (auto key : orphans) {
+            size_t chunks = releaseAssetData(key);
+            stats.orphanedAssetData += chunks;
+            stats.bytesReclaimed += chunks * (kAssetDataKeySize + kChunkReferenceSize);
+            makeAssetDataKey(key, 0, skipKey.data());
+            std::string firstChunk(skipKey.data(), kAssetDataKeySize);
+            if (compactBegin.empty() || firstChunk < compactBegin) {
+                compactBegin = firstChunk;
+            }
+            makeAssetDataKey(key, std::numeric_limits<uint64_t>::max(), skipKey.data());
+            std::string lastChunk(skipKey.data(), kAssetDataKeySize);
+            if (lastChunk > compactEnd) {
+                compactEnd = lastChunk;
+            }
+        }
+
+        examined += batchExamined;
+        if (resumeKey.empty() || !throttleGarbageCollection(options, examined, start)) {
+            break;
+        }
+    }
+
+    if (!compactBegin.empty()) {
+        leveldb::Slice begin(compactBegin);
+        leveldb::Slice end(compactEnd);
+        m_dataDatabase->CompactRange(&begin, &end);
+    }
+}
+
+void AssetDatabase::collectStaleKeys(const GarbageCollectionOptions& options, GarbageCollectionStats& stats) {
+    auto start = std::chrono::steady_clock::now();
+    size_t examined = 0;
+    leveldb::ReadOptions scanOptions;
+    scanOptions.fill_cache = false;
+
+    // Deletes every key from begin up to end for which isStale returns true, compacting the range afterwards.
+    auto sweep = [this, &options, &stats, &examined, &start, &scanOptions](const std::string& begin,
+        const std::string& end, std::function<bool(const leveldb::Slice&, const leveldb::Slice&)> isStale) {
+        std::string resumeKey = begin;
+        size_t deleted = 0;
+        while (!m_quitGarbageCollection) {
+            leveldb::WriteBatch batch;
+            size_t batchDeleted = 0;
+            size_t batchExamined = 0;
+            std::unique_ptr<leveldb::Iterator> iterator(m_database->NewIterator(scanOptions));
+            for (iterator->Seek(resumeKey); iterator->Valid() && iterator->key().compare(end) < 0 &&
+                    batchExamined < options.batchSize; iterator->Next()) {
+                ++batchExamined;
+                if (isStale(iterator->key(), iterator->value())) {
+                    batch.Delete(iterator->key());
+                    stats.bytesReclaimed += iterator->key().size() + iterator->value().size();
+                    ++batchDeleted;
+                }
+            }
+            resumeKey = iterator->Valid() && iterator->key().compare(end) < 0 ? iterator->key().ToString() :
+                std::string();
+            iterator.reset();
+
+            if (batchDeleted > 0) {
+                auto status = m_database->Write(leveldb::WriteOptions(), &batch);
+                if (!status.ok()) {
+                    LOG(ERROR) << "error writing garbage collection of stale keys, status: " << status.ToString();
+                    return deleted;
+                }
+                deleted += batchDeleted;
+            }
+
+            examined += batchExamined;
+            if (resumeKey.empty() || !throttleGarbageCollection(options, examined, start)) {
+                break;
+            }
+        }
+        if (deleted > 0) {
+            leveldb::Slice beginSlice(begin);
+            leveldb::Slice endSlice(end);
+            m_database->CompactRange(&beginSlice, &endSlice);
+        }
+        return deleted;
+    };
+
+    // Keys in either legacy format that migration skipped, such as any of the wrong size. Legacy AssetData keys are
+    // left alone until their migration is complete. Both prefixes sort next to each other, with nothing in between.
+    std::string legacyBegin(1, legacyAssetData() ? kLegacyListEntry : kLegacyAssetData);
+    std::string legacyEnd(1, kLegacyListEntry + 1);
+    stats.legacyKeys += sweep(legacyBegin, legacyEnd, [](const leveldb::Slice&, const leveldb::Slice&) {
+        return true;
+    });
+
+    // Index entries of Assets that were deleted. Both index prefixes sort next to each other, with nothing in between.
+    std::string indexBegin(1, kTypeIndex);
+    std::string indexEnd(1, kAuthorIndex + 1);
+    std::array<char, kAssetKeySize> indexedAssetKey;
+    std::string indexedValue;
+    stats.staleIndexEntries += sweep(indexBegin, indexEnd, [this, &indexedAssetKey, &indexedValue](
+        const leveldb::Slice& indexKey, const leveldb::Slice&) {
+        if (indexKey.size() < kTypeIndexPrefixSize + kIndexEntrySuffixSize) {
+            return true;
+        }
+        uint64_t key = 0;
+        std::memcpy(&key, indexKey.data() + indexKey.size() - sizeof(uint64_t), sizeof(uint64_t));
+        makeAssetKey(key, indexedAssetKey.data());
+        return m_database->Get(leveldb::ReadOptions(), leveldb::Slice(indexedAssetKey.data(), kAssetKeySize),
+            &indexedValue).IsNotFound();
+    });
+
+    // Search entries of Assets and Lists that were deleted, in both the trigram and prefix ranges.
+    std::array<char, kAssetKeySize> searchedKey;
+    std::string searchedValue;
+    auto isStaleSearchEntry = [this, &searchedKey, &searchedValue](const leveldb::Slice& searchKey,
+        const leveldb::Slice&) {
+        if (searchKey.size() < 1 + kNameSearchSuffixSize) {
+            return true;
+        }
+        char kind = searchKey[searchKey.size() - kNameSearchSuffixSize];
+        if (kind != kAsset && kind != kList) {
+            return true;
+        }
+        // Asset and List keys have the same layout, differing only in their prefix.
+        searchedKey[0] = kind;
+        std::memcpy(searchedKey.data() + 1, searchKey.data() + searchKey.size() - sizeof(uint64_t), sizeof(uint64_t));
+        return m_database->Get(leveldb::ReadOptions(), leveldb::Slice(searchedKey.data(), kAssetKeySize),
+            &searchedValue).IsNotFound();
+    };
+    stats.staleSearchEntries += sweep(std::string(1, kNameTrigram), std::string(1, kNameTrigram + 1),
+        isStaleSearchEntry);
+    stats.staleSearchEntries += sweep(std::string(1, kNamePrefix), std::string(1, kNamePrefix + 1),
+        isStaleSearchEntry);
+
+    // Names of Assets that are no longer found, either directly or as the head of a chain.
+    std::string namesBegin(kAssetNamePrefix);
+    std::string namesEnd(namesBegin);
+    namesEnd.back() += 1;
+    std::array<char, kChainHeadKeySize> chainHeadKey;
+    std::array<char, kAssetKeySize> assetKey;
+    std::string value;
+    stats.staleNames += sweep(namesBegin, namesEnd, [this, &chainHeadKey, &assetKey, &value](
+        const leveldb::Slice&, const leveldb::Slice& nameValue) {
+        if (nameValue.size() != sizeof(uint64_t)) {
+            return true;
+        }
+        uint64_t key = 0;
+        std::memcpy(&key, nameValue.data(), sizeof(uint64_t));
+        makeChainHeadKey(key, chainHeadKey.data());
+        if (m_database->Get(leveldb::ReadOptions(), leveldb::Slice(chainHeadKey.data(), kChainHeadKeySize),
+                &value).ok() && value.size() == sizeof(uint64_t)) {
+            std::memcpy(&key, value.data(), sizeof(uint64_t));
+        }
+        makeAssetKey(key, assetKey.data());
+        return m_database->Get(leveldb::ReadOptions(), leveldb::Slice(assetKey.data(), kAssetKeySize),
+            &value).IsNotFound();
+    });
+}
+
+void AssetDatabase::collectReplicationLog(const GarbageCollectionOptions& options, GarbageCollectionStats& stats) {
+    uint64_t last = m_replicationSequence;
+    if (last <= options.replicationLogRetain) {
+        return;
+    }
+    // Entries up to and including cutoff are deleted.
+    uint64_t cutoff = last - options.replicationLogRetain;
+    auto start = std::chrono::steady_clock::now();
+    size_t examined = 0;
+    std::array<char, kReplicationLogKeySize> logKey;
+    makeReplicationLogKey(0, logKey.data());
+    std::string begin(logKey.data(), kReplicationLogKeySize);
+    std::string resumeKey = begin;
+    makeReplicationLogKey(cutoff + 1, logKey.data());
+    std::string end(logKey.data(), kReplicationLogKeySize);
+    while (!m_quitGarbageCollection) {
+        leveldb::WriteBatch batch;
+        size_t batchExamined = 0;
+        std::unique_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
+        for (iterator->Seek(resumeKey); iterator->Valid() && iterator->key().compare(end) < 0 &&
+                batchExamined < options.batchSize; iterator->Next()) {
+            batch.Delete(iterator->key());
+            ++batchExamined;
+        }
+        resumeKey = iterator->Valid() && iterator->key().compare(end) < 0 ? iterator->key().ToString() :
+            std::string();
+        iterator.reset();
+
+        if (batchExamined > 0) {
+            auto status = m_database->Write(leveldb::WriteOptions(), &batch);
+            if (!status.ok()) {
+                LOG(ERROR) << "error writing garbage collection of replication log, status: " << status.ToString();
+                return;
+            }
+            stats.replicationLogEntries += batchExamined;
+        }
+
+        examined += batchExamined;
+        if (resumeKey.empty() || !throttleGarbageCollection(options, examined, start)) {
+            break;
+        }
+    }
+    if (stats.replicationLogEntries > 0) {
+        leveldb::Slice beginSlice(begin);
+        leveldb::Slice endSlice(end);
+        m_database->CompactRange(&beginSlice, &endSlice);
+    }
+}
+
+bool AssetDatabase::abandonedPastGrace(uint64_t key, const GarbageCollectionOptions& options) {
+    auto now = std::chrono::steady_clock::now();
+    auto found = m_abandonedCandidates.find(key);
+    if (found != m_abandonedCandidates.end() && now - found->second >= options.abandonedGracePeriod) {
+        return true;
+    }
+    m_nextAbandonedCandidates.emplace(key, found != m_abandonedCandidates.end() ? found->second : now);
+    return false;
+}
+
+bool AssetDatabase::throttleGarbageCollection(const GarbageCollectionOptions& options, size_t examined,
+    std::chrono::steady_clock::time_point start) {
+    if (options.keysPerSecond > 0) {
+        auto due = start + std::chrono::microseconds((examined * 1000000) / options.keysPerSecond);
+        std::unique_lock<std::mutex> lock(m_garbageCollectionWaitMutex);
+        m_garbageCollectionWait.wait_until(lock, due, [this] { return m_quitGarbageCollection.load(); });
+    }
+    return !m_quitGarbageCollection;
+}
+
+void AssetDatabase::runGarbageCollection(GarbageCollectionOptions options, std::chrono::seconds interval) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_garbageCollectionWaitMutex);
+            if (m_garbageCollectionWait.wait_for(lock, interval, [this] { return m_quitGarbageCollection.load(); })) {
+                break;
+            }
+        }
+        collectGarbage(options);
+    }
+}
+
+AssetDatabase::ScrubStats AssetDatabase::scrub(const ScrubOptions& options) {
+    std::lock_guard<std::mutex> lock(m_scrubMutex);
+    ScrubStats stats;
+    // AssetData still in the metadata database is checked by the migration moving it, not here.
+    if (legacyAssetData()) {
+        LOG(INFO) << "not scrubbing while AssetData migration is running.";
+        return stats;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::string resumeKey;
+    if (m_database->Get(leveldb::ReadOptions(), kScrubPositionKey, &resumeKey).ok() && resumeKey.size() > 0 &&
+        resumeKey[0] == kAsset) {
+        LOG(INFO) << "resuming scrub from last checkpoint.";
+    } else {
+        resumeKey.assign(1, kAsset);
+    }
+    leveldb::ReadOptions scanOptions;
+    scanOptions.fill_cache = false;
+    std::array<char, kAssetKeySize> assetKey;
+    bool complete = false;
+
+    while (!complete && !m_quitScrub) {
+        // Each batch starts a new iterator, so none is held open for the length of the pass.
+        std::vector<std::pair<uint64_t, uint64_t>> assetChunks;
+        std::string batchEndKey;
+        {
+            size_t examined = 0;
+            std::unique_ptr<leveldb::Iterator> iterator(m_database->NewIterator(scanOptions));
+            for (iterator->Seek(resumeKey); iterator->Valid() && iterator->key()[0] == kAsset &&
+                    examined < options.batchSize; iterator->Next()) {
+                ++examined;
+                batchEndKey.assign(iterator->key().data(), iterator->key().size());
+                batchEndKey.push_back('\0');
+                auto verifier = flatbuffers::Verifier(reinterpret_cast<const uint8_t*>(iterator->value().data()),
+                    iterator->value().size());
+                if (iterator->key().size() != kAssetKeySize || !Data::VerifyFlatAssetBuffer(verifier)) {
+                    continue;
+                }
+                uint64_t key = 0;
+                std::memcpy(&key, iterator->key().data() + 1, sizeof(uint64_t));
+                auto flatAsset = Data::GetFlatAsset(iterator->value().data());
+                uint64_t chunks = storedChunkCount(flatAsset);
+                if (chunks > 0) {
+                    assetChunks.emplace_back(key, chunks);
+                }
+            }
+            complete = !iterator->Valid() || iterator->key()[0] != kAsset;
+        }
+
+        for (const auto& asset : assetChunks) {
+            uint64_t badChunk = 0;
+            ScrubResult result = scrubAsset(asset.first, asset.second, options, start, stats, badChunk);
+            if (result == kScrubCorrupt) {
+                // Garbage collection may delete chunks while they are being checked, so corruption is confirmed with
+                // a second check before quarantine.
+                result = scrubAsset(asset.first, asset.second, options, start, stats, badChunk);
+            }
+            if (result == kScrubStopped) {
+                makeAssetKey(asset.first, assetKey.data());
+                batchEndKey.assign(assetKey.data(), kAssetKeySize);
+                complete = false;
+                break;
+            }
+            ++stats.assets;
+            if (result == kScrubIncomplete) {
+                ++stats.incompleteAssets;
+            } else if (result == kScrubCorrupt) {
+                if (quarantine(asset.first, badChunk)) {
+                    ++stats.quarantinedAssets;
+                }
+            } else if (isQuarantined(asset.first) && releaseQuarantine(asset.first)) {
+                LOG(INFO) << "Asset " << Asset::keyToString(asset.first)
+                    << " checked intact, released from quarantine.";
+                ++stats.restoredAssets;
+            }
+        }
+        if (!batchEndKey.empty()) {
+            resumeKey.swap(batchEndKey);
+        }
+
+        // The checkpoint is cleared at the end of the pass, so the next one starts over from the first Asset.
+        auto status = complete ? m_database->Delete(leveldb::WriteOptions(), kScrubPositionKey) :
+            m_database->Put(leveldb::WriteOptions(), kScrubPositionKey, resumeKey);
+        if (!status.ok()) {
+            LOG(ERROR) << "error writing scrub checkpoint, status: " << status.ToString();
+        }
+    }
+
+    if (complete) {
+        stats.staleQuarantineEntries = collectQuarantine();
+    } else {
+        LOG(INFO) << "scrub stopped before end of pass, will resume from checkpoint.";
+    }
+    LOG(INFO) << "scrub checked " << stats.assets << " Assets, " << stats.chunks << " chunks, and " << stats.bytes
+        << " bytes, finding " << stats.incompleteAssets << " incomplete Assets, quarantining "
+        << stats.quarantinedAssets << " Assets, and releasing " << stats.restoredAssets << " intact and "
+        << stats.staleQuarantineEntries << " deleted Assets from quarantine.";
+    return stats;
+}
+
+void AssetDatabase::startScrubbing(const ScrubOptions& options, std::chrono::seconds interval) {
+    if (m_scrubThread.joinable()) {
+        LOG(ERROR) << "scrubbing already started.";
+        return;
+    }
+    m_quitScrub = false;
+    m_scrubThread = std::thread(&AssetDatabase::runScrubbing, this, options, interval);
+}
+
+bool AssetDatabase::isQuarantined(uint64_t key) {
+    std::lock_guard<std::mutex> lock(m_quarantineMutex);
+    return m_quarantined.count(key) > 0;
+}
+
+std::vector<uint64_t> AssetDatabase::quarantinedAssets() {
+    std::lock_guard<std::mutex> lock(m_quarantineMutex);
+    return std::vector<uint64_t>(m_quarantined.begin(), m_quarantined.end());
+}
+
+AssetDatabase::ScrubResult AssetDatabase::scrubAsset(uint64_t key, uint64_t chunks, const ScrubOptions& options,
+    std::chrono::steady_clock::time_point start, ScrubStats& stats, uint64_t& badChunkOut) {
+    std::array<char, kAssetDataKeySize> assetDataKey;
+    makeAssetDataKey(key, 0, assetDataKey.data());
+    leveldb::ReadOptions scanOptions;
+    scanOptions.fill_cache = false;
+    std::unique_ptr<leveldb::Iterator> iterator(m_dataDatabase->NewIterator(scanOptions));
+    iterator->Seek(leveldb::Slice(assetDataKey.data(), kAssetDataKeySize));
+
+    std::array<char, kChunkContentKeySize> contentKey;
+    std::string contentValue;
+    XXH64_state_t* hashState = XXH64_createState();
+    XXH64_reset(hashState, 0);
+    ScrubResult result = kScrubIntact;
+    for (uint64_t chunk = 0; chunk < chunks; ++chunk, iterator->Next()) {
+        if (!iterator->Valid() || iterator->key().size() != kAssetDataKeySize ||
+            std::memcmp(iterator->key().data(), assetDataKey.data(), 9) != 0 ||
+            assetDataKeyChunk(iterator->key().data()) != chunk) {
+            result = kScrubIncomplete;
+            break;
+        }
+        badChunkOut = chunk;
+        result = kScrubCorrupt;
+
+        // Blobs are checked against their own hash before they are decoded, so damaged contents are never parsed.
+        // Shared contents carry the hash of whichever chunk stored them first, so the reference holds this one.
+        uint64_t expectedHash = 0;
+        bool referenced = decodeChunkReference(iterator->value(), contentKey.data(), expectedHash);
+        BlobStore::Location location;
+        bool inBlob = false;
+        if (referenced) {
+            leveldb::Slice contentSlice(contentKey.data(), kChunkContentKeySize);
+            auto status = m_dataDatabase->Get(scanOptions, contentSlice, &contentValue);
+            if (!status.ok() || !blobLocation(contentSlice, contentValue, location)) {
+                LOG(ERROR) << "Asset " << Asset::keyToString(key) << " chunk " << chunk << " contents not found.";
+                break;
+            }
+            inBlob = true;
+        } else {
+            inBlob = blobLocation(iterator->key(), iterator->value(), location);
+        }
+        RecordPtr blob;
+        SizedPointer flatAssetData(iterator->value().data(), iterator->value().size());
+        if (inBlob) {
+            if (!m_blobStore->verify(location)) {
+                LOG(ERROR) << "Asset " << Asset::keyToString(key) << " chunk " << chunk << " blob in segment "
+                    << location.segment << " at " << location.offset << " failed its hash check.";
+                break;
+            }
+            blob = readChunkBlob(*m_blobStore, *m_chunkCodec, location);
+            if (blob->empty()) {
+                break;
+            }
+            flatAssetData = blob->data();
+        }
+        auto verifier = flatbuffers::Verifier(flatAssetData.data(), flatAssetData.size());
+        if (!Data::VerifyFlatAssetDataBuffer(verifier)) {
+            LOG(ERROR) << "Asset " << Asset::keyToString(key) << " chunk " << chunk << " failed verification.";
+            break;
+        }
+        auto assetData = Data::GetFlatAssetData(flatAssetData.data());
+        if (!referenced) {
+            expectedHash = assetData->hash();
+        }
+
+        // Each chunk hash covers the Asset data up to the end of that chunk.
+        size_t size = assetData->data() ? assetData->data()->size() : 0;
+        if (size > 0) {
+            XXH64_update(hashState, assetData->data()->data(), size);
+        }
+        uint64_t digest = XXH64_digest(hashState);
+        if (digest != expectedHash) {
+            LOG(ERROR) << "Asset " << Asset::keyToString(key) << " chunk " << chunk << " computed hash "
+                << Asset::keyToString(digest) << " expected " << Asset::keyToString(expectedHash);
+            break;
+        }
+        if (chunk + 1 == chunks && digest != key) {
+            LOG(ERROR) << "Asset " << Asset::keyToString(key) << " computed hash " << Asset::keyToString(digest)
+                << " of all its chunks.";
+            break;
+        }
+        ++stats.chunks;
+        stats.bytes += size;
+        result = kScrubIntact;
+        if (!throttleScrub(options, stats.bytes, start)) {
+            result = kScrubStopped;
+            break;
+        }
+    }
+    XXH64_freeState(hashState);
+    return result;
+}
+
+bool AssetDatabase::throttleScrub(const ScrubOptions& options, size_t bytes,
+    std::chrono::steady_clock::time_point start) {
+    if (options.bytesPerSecond > 0) {
+        auto due = start + std::chrono::microseconds((static_cast<uint64_t>(bytes) * 1000000) / options.bytesPerSecond);
+        std::unique_lock<std::mutex> lock(m_scrubWaitMutex);
+        m_scrubWait.wait_until(lock, due, [this] { return m_quitScrub.load(); });
+    }
+    return !m_quitScrub;
+}
+
+void AssetDatabase::runScrubbing(ScrubOptions options, std::chrono::seconds interval) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_scrubWaitMutex);
+            if (m_scrubWait.wait_for(lock, interval, [this] { return m_quitScrub.load(); })) {
+                break;
+            }
+        }
+        scrub(options);
+    }
+}
+
+void AssetDatabase::loadQuarantine() {
+    std::lock_guard<std::mutex> lock(m_quarantineMutex);
+    m_quarantined.clear();
+    char prefix = kQuarantine;
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
+    for (iterator->Seek(leveldb::Slice(&prefix, 1)); iterator->Valid() && iterator->key()[0] == kQuarantine;
+            iterator->Next()) {
+        if (iterator->key().size() != kQuarantineKeySize) {
+            continue;
+        }
+        uint64_t key = 0;
+        std::memcpy(&key, iterator->key().data() + 1, sizeof(uint64_t));
+        m_quarantined.insert(key);
+    }
+    if (m_quarantined.size() > 0) {
+        LOG(WARNING) << m_quarantined.size() << " Assets are quarantined for failing their hash check.";
+    }
+}
+
+bool AssetDatabase::quarantine(uint64_t key, uint64_t badChunk) {
+    std::array<char, kQuarantineKeySize> quarantineKey;
+    makeQuarantineKey(key, quarantineKey.data());
+    std::array<char, sizeof(uint64_t)> value;
+    writeBigEndian64(badChunk, value.data());
+    std::lock_guard<std::mutex> lock(m_quarantineMutex);
+    if (m_quarantined.count(key)) {
+        return false;
+    }
+    auto status = m_database->Put(leveldb::WriteOptions(), leveldb::Slice(quarantineKey.data(), kQuarantineKeySize),
+        leveldb::Slice(value.data(), value.size()));
+    if (!status.ok()) {
+        LOG(ERROR) << "error quarantining Asset " << Asset::keyToString(key) << ", status: " << status.ToString();
+        return false;
+    }
+    m_quarantined.insert(key);
+    LOG(ERROR) << "quarantined Asset " << Asset::keyToString(key) << ", chunk " << badChunk
+        << " failed its hash check.";
+    return true;
+}
+
+bool AssetDatabase::releaseQuarantine(uint64_t key) {
+    std::array<char, kQuarantineKeySize> quarantineKey;
+    makeQuarantineKey(key, quarantineKey.data());
+    std::lock_guard<std::mutex> lock(m_quarantineMutex);
+    auto status = m_database->Delete(leveldb::WriteOptions(),
+        leveldb::Slice(quarantineKey.data(), kQuarantineKeySize));
+    if (!status.ok()) {
+        LOG(ERROR) << "error releasing Asset " << Asset::keyToString(key) << " from quarantine, status: "
+            << status.ToString();
+        return false;
+    }
+    m_quarantined.erase(key);
+    return true;
+}
+
+size_t AssetDatabase::collectQuarantine() {
+    std::array<char, kAssetKeySize> assetKey;
+    std::string value;
+    size_t released = 0;
+    for (uint64_t key : quarantinedAssets()) {
+        makeAssetKey(key, assetKey.data());
+        if (m_database->Get(leveldb::ReadOptions(), leveldb::Slice(assetKey.data(), kAssetKeySize),
+                &value).IsNotFound() && releaseQuarantine(key)) {
+            ++released;
+        }
+    }
+    return released;
+}
+
+RecordPtr AssetDatabase::loadWaveform(uint64_t key) {
+    std::array<char, kWaveformKeySize> waveformKey;
+    makeWaveformKey(key, waveformKey.data());
+    std::shared_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
+    iterator->Seek(leveldb::Slice(waveformKey.data(), kWaveformKeySize));
+    if (!iteratorMatch(iterator, waveformKey.data(), kWaveformKeySize)) {
+        LOG(INFO) << "no waveform found for Asset " << Asset::keyToString(key);
+        return makeEmptyRecord();
+    }
+
+    return RecordPtr(new DatabaseRecord(iterator));
+}
+
+bool AssetDatabase::storeWaveform(uint64_t key, const SizedPointer& peaks) {
+    std::array<char, kWaveformKeySize> waveformKey;
+    makeWaveformKey(key, waveformKey.data());
+    auto status = m_database->Put(leveldb::WriteOptions(), leveldb::Slice(waveformKey.data(), kWaveformKeySize),
+        leveldb::Slice(peaks.dataChar(), peaks.size()));
+
+    if (status.ok()) {
+        LOG(INFO) << "Waveform store for Asset " << Asset::keyToString(key) << " success.";
+    } else {
+        LOG(ERROR) << "Failed to store waveform for Asset " << Asset::keyToString(key) << ", status: "
+            << status.ToString();
+    }
+
+    return status.ok();
+}
+
+// static
+const std::vector<AssetDatabase::Migration>& AssetDatabase::migrations() {
+    static_assert(kSchemaAssetData == kSchemaVersion, "the last migration must reach the current schema version");
+    // List entries are small, with no values, so are migrated before the database is used, which keeps List iteration
+    // to a single scan. Names without search entries would go unfound, so are also indexed before use. AssetData
+    // reads look in both databases, so it can move while the database is in use.
+    static const std::vector<Migration> kMigrations = {
+        { kSchemaListEntries, "big-endian List entry keys", false, &AssetDatabase::migrateListEntries, nullptr },
+        { kSchemaNameSearch, "name search entries", false, &AssetDatabase::buildNameSearchIndex, nullptr },
+        { kSchemaAssetData, "AssetData in the data database", true, &AssetDatabase::migrateAssetData,
+            &AssetDatabase::finishAssetDataMigration }
+    };
+    return kMigrations;
+}
+
+bool AssetDatabase::loadSchemaVersion(bool createNew) {
+    // The config is moved to its current key first, unless one is already there, so it is found by the config check
+    // that follows open().
+    std::string value;
+    auto status = m_database->Get(leveldb::ReadOptions(), kLegacyConfigKey, &value);
+    if (status.ok()) {
+        SizedPointer configKey = Config::getConfigKey();
+        leveldb::Slice configSlice(configKey.dataChar(), configKey.size());
+        std::string current;
+        leveldb::WriteBatch batch;
+        status = m_database->Get(leveldb::ReadOptions(), configSlice, &current);
+        if (status.IsNotFound()) {
+            batch.Put(configSlice, value);
+        }
+        batch.Delete(kLegacyConfigKey);
+        if (status.ok() || status.IsNotFound()) {
+            status = m_database->Write(leveldb::WriteOptions(), &batch);
+        }
+        if (!status.ok()) {
+            LOG(ERROR) << "error moving database config to its current key, status: " << status.ToString();
+            return false;
+        }
+        LOG(INFO) << "moved database config from " << kLegacyConfigKey << " to its current key.";
+    } else if (!status.IsNotFound()) {
+        LOG(ERROR) << "error reading legacy database config, status: " << status.ToString();
+        return false;
+    }
+
+    status = m_database->Get(leveldb::ReadOptions(), kSchemaVersionKey, &value);
+    if (status.ok() && value.size() == sizeof(uint64_t)) {
+        m_schemaVersion = readBigEndian64(value.data());
+        if (m_schemaVersion > kSchemaVersion) {
+            LOG(ERROR) << "database schema version " << m_schemaVersion << " is newer than version " << kSchemaVersion
+                << " supported by this confab.";
+            return false;
+        }
+        return true;
+    }
+    if (!status.ok() && !status.IsNotFound()) {
+        LOG(ERROR) << "error reading database schema version, status: " << status.ToString();
+        return false;
     }
 
-    // Add any list entries to the batch.
-    char listKeys[kListEntryKeySize * kAssetMaxListEntries];
-    uint64_t timeStamp = flatAsset->lists()->size() ?
-        std::chrono::duration_cast<std::chrono::microseconds>(
-        std::chrono::high_resolution_clock::now().time_since_epoch()).count() : 0;
-    for (auto i = 0; i < flatAsset->lists()->size(); ++i) {
-        char* listKey = listKeys + (i * kListEntryKeySize);
-        listKey[0]  = kListEntry;
-        std::memcpy(listKey + 1, flatAsset->lists()->data() + i, sizeof(uint64_t));
-        std::memcpy(listKey + 9, &timeStamp, sizeof(uint64_t));
-        std::memcpy(listKey + 17, &key, sizeof(uint64_t));
-        LOG(INFO) << "adding asset " << Asset::keyToString(key) << " to list " << Asset::keyToString(
-            flatAsset->lists()->data()[i]);
-        batch.Put(leveldb::Slice(listKey, kListEntryKeySize), leveldb::Slice());
+    // New databases start out current. Older ones may be in any earlier layout, except that the name search index
+    // marked itself built, so the migrations before it are run again, finding nothing to do if already done.
+    uint64_t version = kSchemaVersion;
+    if (!createNew) {
+        std::string built;
+        version = m_database->Get(leveldb::ReadOptions(), kNameSearchBuiltKey, &built).ok() ? kSchemaNameSearch :
+            kSchemaInitial;
+    }
+    std::array<char, sizeof(uint64_t)> versionValue;
+    writeBigEndian64(version, versionValue.data());
+    leveldb::WriteBatch batch;
+    batch.Put(kSchemaVersionKey, leveldb::Slice(versionValue.data(), versionValue.size()));
+    batch.Delete(kNameSearchBuiltKey);
+    status = m_database->Write(leveldb::WriteOptions(), &batch);
+    if (!status.ok()) {
+        LOG(ERROR) << "error recording database schema version, status: " << status.ToString();
+        return false;
     }
+    m_schemaVersion = version;
+    LOG(INFO) << "recorded database schema version " << version;
+    return true;
+}
 
-    // Store actual Asset key/value pair.
-    std::array<char, kAssetKeySize> assetKey;
-    makeAssetKey(key, assetKey.data());
-    batch.Put(leveldb::Slice(assetKey.data(), kAssetKeySize), leveldb::Slice(assetData.dataChar(), assetData.size()));
+bool AssetDatabase::runMigrations(bool background) {
+    auto start = std::chrono::steady_clock::now();
+    size_t totalExamined = 0;
+    for (const auto& migration : migrations()) {
+        if (migration.version <= m_schemaVersion) {
+            continue;
+        }
+        if (migration.background && !background) {
+            return true;
+        }
 
-    auto status = m_database->Write(leveldb::WriteOptions(), &batch);
-    if (status.ok()) {
-        LOG(INFO) << "Asset store " << Asset::keyToString(key) << " success.";
-    } else {
-        LOG(ERROR) << "Failed to store Asset " << Asset::keyToString(key) << " in database, status: "
-            << status.ToString();
-    }
+        // Progress is recorded in the same write as each batch of changes, so an interrupted migration picks up after
+        // the last batch written.
+        std::string position;
+        std::string progress;
+        if (m_database->Get(leveldb::ReadOptions(), kMigrationProgressKey, &progress).ok() &&
+            progress.size() >= sizeof(uint64_t) && readBigEndian64(progress.data()) == migration.version) {
+            position = progress.substr(sizeof(uint64_t));
+            LOG(INFO) << "resuming migration to schema version " << migration.version << ", " << migration.description;
+        } else {
+            LOG(INFO) << "starting migration to schema version " << migration.version << ", " << migration.description;
+        }
 
-    return status.ok();
+        size_t migrated = 0;
+        std::array<char, sizeof(uint64_t)> versionValue;
+        writeBigEndian64(migration.version, versionValue.data());
+        while (true) {
+            if (m_quitMigration) {
+                LOG(INFO) << "paused migration to schema version " << migration.version << " after " << migrated
+                    << " keys, will resume on next open.";
+                return false;
+            }
+            leveldb::WriteBatch batch;
+            leveldb::WriteBatch dataBatch;
+            size_t examined = 0;
+            // Steps that write to the data database first check what it already holds, so m_chunkMutex is held until
+            // dataBatch is written, keeping storeAssetDataChunk() from writing in between.
+            std::unique_lock<std::mutex> chunkLock(m_chunkMutex);
+            if (!(this->*migration.step)(position, batch, dataBatch, examined)) {
+                LOG(ERROR) << "error migrating to schema version " << migration.version << " after " << migrated
+                    << " keys.";
+                return false;
+            }
+            if (examined > 0) {
+                std::string progressValue(versionValue.data(), versionValue.size());
+                progressValue.append(position);
+                batch.Put(kMigrationProgressKey, progressValue);
+            } else {
+                batch.Put(kSchemaVersionKey, leveldb::Slice(versionValue.data(), versionValue.size()));
+                batch.Delete(kMigrationProgressKey);
+            }
+
+            // The copies must be durable before any originals are deleted, as the two databases have separate logs.
+            if (dataBatch.ApproximateSize() > leveldb::WriteBatch().ApproximateSize()) {
+                leveldb::WriteOptions syncOptions;
+                syncOptions.sync = true;
+                if (!m_blobStore->sync()) {
+                    LOG(ERROR) << "error syncing migrated blobs.";
+                    return false;
+                }
+                auto status = m_dataDatabase->Write(syncOptions, &dataBatch);
+                if (!status.ok()) {
+                    LOG(ERROR) << "error writing migrated data keys, status: " << status.ToString();
+                    return false;
+                }
+            }
+            chunkLock.unlock();
+            auto status = m_database->Write(leveldb::WriteOptions(), &batch);
+            if (!status.ok()) {
+                LOG(ERROR) << "error writing migrated keys, status: " << status.ToString();
+                return false;
+            }
+            if (examined == 0) {
+                break;
+            }
+            migrated += examined;
+            totalExamined += examined;
+            if (background && !throttleMigration(totalExamined, start)) {
+                LOG(INFO) << "paused migration to schema version " << migration.version << " after " << migrated
+                    << " keys, will resume on next open.";
+                return false;
+            }
+        }
+
+        m_schemaVersion = migration.version;
+        LOG(INFO) << "migrated database to schema version " << migration.version << ", " << migration.description
+            << ", examining " << migrated << " keys.";
+        if (migration.finish) {
+            (this->*migration.finish)();
+        }
+    }
+    return true;
 }
 
-RecordPtr AssetDatabase::loadAssetDataChunk(uint64_t key, uint64_t chunk) {
-    std::array<char, kAssetDataKeySize> assetDataKey;
-    makeAssetDataKey(key, chunk, assetDataKey.data());
-    std::shared_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
-    iterator->Seek(leveldb::Slice(assetDataKey.data(), kAssetDataKeySize));
-    if (!iteratorMatch(iterator, assetDataKey.data(), kAssetDataKeySize)) {
-        LOG(ERROR) << "asset Data " << Asset::keyToString(key) << " chunk: " << chunk << " not found.";
-    } else {
-        LOG(INFO) << "Loaded Asset " << Asset::keyToString(key) << " chunk: " << chunk << ".";
+bool AssetDatabase::throttleMigration(size_t examined, std::chrono::steady_clock::time_point start) {
+    size_t keysPerSecond = m_migrationKeysPerSecond;
+    if (keysPerSecond > 0) {
+        auto due = start + std::chrono::microseconds((examined * 1000000) / keysPerSecond);
+        std::unique_lock<std::mutex> lock(m_migrationWaitMutex);
+        m_migrationWait.wait_until(lock, due, [this] { return m_quitMigration.load(); });
     }
+    return !m_quitMigration;
+}
 
-    return RecordPtr(new DatabaseRecord(iterator));
+bool AssetDatabase::legacyAssetData() const {
+    return m_schemaVersion < kSchemaAssetData;
 }
 
-bool AssetDatabase::storeAssetDataChunk(uint64_t key, uint64_t chunk, const SizedPointer& flatAssetData) {
+bool AssetDatabase::migrateAssetData(std::string& position, leveldb::WriteBatch& batch, leveldb::WriteBatch& dataBatch,
+    size_t& examinedOut) {
+    if (position.empty()) {
+        position.assign(1, kAssetData);
+    }
     std::array<char, kAssetDataKeySize> assetDataKey;
-    makeAssetDataKey(key, chunk, assetDataKey.data());
-    auto status = m_database->Put(leveldb::WriteOptions(), leveldb::Slice(assetDataKey.data(), kAssetDataKeySize),
-        leveldb::Slice(flatAssetData.dataChar(), flatAssetData.size()));
-
-    if (status.ok()) {
-        LOG(INFO) << "Asset Data store " << Asset::keyToString(key) << " chunk " << chunk << " success.";
-    } else {
-        LOG(ERROR) << "Failed to store Asset Data " << Asset::keyToString(key) << " chunk " << chunk << ", status: "
-            << status.ToString();
+    std::array<char, BlobStore::kEncodedLocationSize> encodedLocation;
+    std::string existing;
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
+    // Both AssetData prefixes sort next to each other, with nothing in between.
+    for (iterator->Seek(position); iterator->Valid() &&
+            (iterator->key()[0] == kAssetData || iterator->key()[0] == kLegacyAssetData) &&
+            examinedOut < kMigrationBatchSize; iterator->Next()) {
+        ++examinedOut;
+        position.assign(iterator->key().data(), iterator->key().size());
+        position.push_back('\0');
+        if (iterator->key().size() != kAssetDataKeySize) {
+            continue;
+        }
+        if (iterator->key()[0] == kAssetData) {
+            std::memcpy(assetDataKey.data(), iterator->key().data(), kAssetDataKeySize);
+        } else {
+            uint64_t key = 0;
+            uint64_t chunk = 0;
+            std::memcpy(&key, iterator->key().data() + 1, sizeof(uint64_t));
+            std::memcpy(&chunk, iterator->key().data() + 9, sizeof(uint64_t));
+            makeAssetDataKey(key, chunk, assetDataKey.data());
+        }
+        batch.Delete(iterator->key());
+
+        // A chunk already in the data database was stored again since this migration started, with its contents
+        // counted and shared. The copy here would overwrite that reference without releasing it, so is dropped.
+        // runMigrations() holds m_chunkMutex, so no store can come between this check and the write of dataBatch.
+        leveldb::Slice assetDataSlice(assetDataKey.data(), kAssetDataKeySize);
+        auto status = m_dataDatabase->Get(leveldb::ReadOptions(), assetDataSlice, &existing);
+        if (status.ok()) {
+            continue;
+        }
+        if (!status.IsNotFound()) {
+            LOG(ERROR) << "error reading AssetData to migrate, status: " << status.ToString();
+            return false;
+        }
+        BlobStore::Location location;
+        if (!m_blobStore->append(SizedPointer(iterator->value().data(), iterator->value().size()), location)) {
+            LOG(ERROR) << "error appending migrated AssetData to blob store.";
+            return false;
+        }
+        BlobStore::encodeLocation(location, encodedLocation.data());
+        dataBatch.Put(assetDataSlice, leveldb::Slice(encodedLocation.data(), encodedLocation.size()));
     }
+    return true;
+}
 
-    return status.ok();
+void AssetDatabase::finishAssetDataMigration() {
+    // Reclaim the space the chunks used in the metadata database.
+    char beginPrefix = kAssetData;
+    leveldb::Slice begin(&beginPrefix, 1);
+    char endPrefix = kLegacyAssetData + 1;
+    leveldb::Slice end(&endPrefix, 1);
+    m_database->CompactRange(&begin, &end);
 }
 
 bool AssetDatabase::storeList(uint64_t key, const SizedPointer& listEntry) {
@@ -325,28 +2976,23 @@ bool AssetDatabase::storeList(uint64_t key, const SizedPointer& listEntry) {
         name = kListNamePrefix + flatList->name()->str();
         LOG(INFO) << "adding name '" << flatList->name()->data() << "' lookup to list " << Asset::keyToString(key);
         batch.Put(name, leveldb::Slice(reinterpret_cast<const char*>(&key), sizeof(uint64_t)));
+        addNameSearchEntries(flatList->name()->str(), kList, key, batch);
     }
 
     // Make sentinel keys at beginning and end of the list, to allow seeking using an iterator to always valid entries.
     std::array<char, kListEntryKeySize> listBeginKey;
-    listBeginKey[0] = kListEntry;
-    std::memcpy(listBeginKey.data() + 1, &key, sizeof(uint64_t));
-    std::memcpy(listBeginKey.data() + 9, &kBeginList, sizeof(uint64_t));
-    std::memcpy(listBeginKey.data() + 17, &kBeginList, sizeof(uint64_t));
+    makeListEntryKey(key, kBeginList, kBeginList, listBeginKey.data());
     batch.Put(leveldb::Slice(listBeginKey.data(), kListEntryKeySize), leveldb::Slice());
 
     std::array<char, kListEntryKeySize> listEndKey;
-    listEndKey[0] = kListEntry;
-    std::memcpy(listEndKey.data() + 1, &key, sizeof(uint64_t));
-    std::memcpy(listEndKey.data() + 9, &kEndList, sizeof(uint64_t));
-    std::memcpy(listEndKey.data() + 17, &kEndList, sizeof(uint64_t));
+    makeListEntryKey(key, kEndList, kEndList, listEndKey.data());
     batch.Put(leveldb::Slice(listEndKey.data(), kListEntryKeySize), leveldb::Slice());
 
     std::array<char, kListKeySize> listKey;
     makeListKey(key, listKey.data());
     batch.Put(leveldb::Slice(listKey.data(), kListKeySize), leveldb::Slice(listEntry.dataChar(), listEntry.size()));
 
-    auto status = m_database->Write(leveldb::WriteOptions(), &batch);
+    auto status = writeLogged(batch, kReplicateList, key, 0, listEntry);
     if (status.ok()) {
         LOG(INFO) << "List store " << Asset::keyToString(key) << " success.";
     } else {
@@ -385,6 +3031,32 @@ RecordPtr AssetDatabase::findNamedList(const std::string& name) {
     return loadList(listKey);
 }
 
+bool AssetDatabase::addListItem(uint64_t listKey, uint64_t assetKey) {
+    uint64_t timeStamp = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+    return addListItemAt(listKey, assetKey, timeStamp);
+}
+
+bool AssetDatabase::addListItemAt(uint64_t listKey, uint64_t assetKey, uint64_t timeStamp) {
+    std::array<char, kListEntryKeySize> listEntryKey;
+    makeListEntryKey(listKey, timeStamp, assetKey, listEntryKey.data());
+    leveldb::WriteBatch batch;
+    batch.Put(leveldb::Slice(listEntryKey.data(), kListEntryKeySize), leveldb::Slice());
+    std::array<char, sizeof(uint64_t)> assetKeyBytes;
+    writeBigEndian64(assetKey, assetKeyBytes.data());
+    auto status = writeLogged(batch, kReplicateListItem, listKey, timeStamp,
+        SizedPointer(assetKeyBytes.data(), assetKeyBytes.size()));
+
+    if (status.ok()) {
+        LOG(INFO) << "added asset " << Asset::keyToString(assetKey) << " to list " << Asset::keyToString(listKey);
+    } else {
+        LOG(ERROR) << "Failed to add asset " << Asset::keyToString(assetKey) << " to list "
+            << Asset::keyToString(listKey) << ", status: " << status.ToString();
+    }
+
+    return status.ok();
+}
+
 size_t AssetDatabase::getListNext(uint64_t listKey, uint64_t fromToken, size_t maxPairs, uint64_t* listOut) {
     // Early-out for asking for the end of the list.
     if (fromToken == kEndList) {
@@ -397,10 +3069,7 @@ size_t AssetDatabase::getListNext(uint64_t listKey, uint64_t fromToken, size_t m
 
     // Point the iterator at the fromToken position in the list.
     std::array<char, kListEntryKeySize> listEntryKey;
-    listEntryKey[0] = kListEntry;
-    std::memcpy(listEntryKey.data() + 1, &listKey, sizeof(uint64_t));
-    std::memcpy(listEntryKey.data() + 9, &fromToken, sizeof(uint64_t));
-    std::memcpy(listEntryKey.data() + 17, &kBeginList, sizeof(uint64_t));
+    makeListEntryKey(listKey, fromToken, kBeginList, listEntryKey.data());
 
     std::shared_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
     iterator->Seek(leveldb::Slice(listEntryKey.data(), kListEntryKeySize));
@@ -424,12 +3093,636 @@ size_t AssetDatabase::getListNext(uint64_t listKey, uint64_t fromToken, size_t m
             break;
         }
 
-        std::memcpy(listOut + (pairs * 2), iterator->key().data() + 9, sizeof(uint64_t) * 2);
+        listEntryKeyPair(iterator->key().data(), listOut + (pairs * 2));
         ++pairs;
     }
 
     return pairs;
 }
 
-}  // namespace Confab
+size_t AssetDatabase::getListPrevious(uint64_t listKey, uint64_t fromToken, size_t maxPairs, uint64_t* listOut) {
+    // Early-out for asking for the beginning of the list.
+    if (fromToken == kBeginList) {
+        if (maxPairs >= 1) {
+            listOut[0] = kBeginList;
+            listOut[1] = kBeginList;
+        }
+        return 1;
+    }
+
+    // Seeking lands on the first entry at or after fromToken, so the entries before fromToken start one step back.
+    std::array<char, kListEntryKeySize> listEntryKey;
+    makeListEntryKey(listKey, fromToken, kBeginList, listEntryKey.data());
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
+    iterator->Seek(leveldb::Slice(listEntryKey.data(), kListEntryKeySize));
+    if (!iterator->Valid()) {
+        LOG(ERROR) << "error finding token: " << Asset::keyToString(fromToken) << " in list: "
+            << Asset::keyToString(listKey);
+        return 0;
+    }
+
+    size_t pairs = 0;
+    while (pairs < maxPairs) {
+        iterator->Prev();
+        if (!iterator->Valid() || iterator->key().size() != kListEntryKeySize ||
+            std::memcmp(iterator->key().data(), listEntryKey.data(), 9) != 0) {
+            LOG(INFO) << "walked off beginning of list " << Asset::keyToString(listKey) << " after " << pairs
+                << " pairs.";
+            break;
+        }
+
+        listEntryKeyPair(iterator->key().data(), listOut + (pairs * 2));
+        ++pairs;
+    }
+
+    return pairs;
+}
+
+size_t AssetDatabase::getListLatest(uint64_t listKey, size_t maxPairs, uint64_t* listOut) {
+    return getListPrevious(listKey, kEndList, maxPairs, listOut);
+}
+
+size_t AssetDatabase::getListRange(uint64_t listKey, uint64_t fromTime, uint64_t toTime, size_t maxPairs,
+    uint64_t* listOut) {
+    std::array<char, kListEntryKeySize> listEntryKey;
+    makeListEntryKey(listKey, fromTime, kBeginList, listEntryKey.data());
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
+
+    size_t pairs = 0;
+    for (iterator->Seek(leveldb::Slice(listEntryKey.data(), kListEntryKeySize)); iterator->Valid() && pairs < maxPairs;
+            iterator->Next()) {
+        if (iterator->key().size() != kListEntryKeySize ||
+            std::memcmp(iterator->key().data(), listEntryKey.data(), 9) != 0) {
+            break;
+        }
+        uint64_t* pair = listOut + (pairs * 2);
+        listEntryKeyPair(iterator->key().data(), pair);
+        if (pair[0] >= toTime || pair[0] == kEndList) {
+            break;
+        }
+        // Skip the beginning of list sentinel.
+        if (pair[0] != kBeginList) {
+            ++pairs;
+        }
+    }
+
+    return pairs;
+}
+
+size_t AssetDatabase::getTypeNext(uint32_t type, uint64_t fromToken, size_t maxPairs, uint64_t* pairsOut) {
+    return getIndexNext(makeTypeIndexPrefix(type), fromToken, maxPairs, pairsOut);
+}
+
+size_t AssetDatabase::getTypeRange(uint32_t type, uint64_t fromTime, uint64_t toTime, size_t maxPairs,
+    uint64_t* pairsOut) {
+    return getIndexRange(makeTypeIndexPrefix(type), fromTime, toTime, maxPairs, pairsOut);
+}
+
+size_t AssetDatabase::getAuthorNext(uint64_t author, uint32_t type, uint64_t fromToken, size_t maxPairs,
+    uint64_t* pairsOut) {
+    return getIndexNext(makeAuthorIndexPrefix(author, type), fromToken, maxPairs, pairsOut);
+}
+
+size_t AssetDatabase::getIndexNext(const std::string& prefix, uint64_t fromToken, size_t maxPairs,
+    uint64_t* pairsOut) {
+    if (maxPairs == 0) {
+        return 0;
+    }
+    if (fromToken == kEndList) {
+        pairsOut[0] = kEndList;
+        pairsOut[1] = kEndList;
+        return 1;
+    }
+    size_t pairs = getIndexRange(prefix, fromToken + 1, kEndList, maxPairs, pairsOut);
+    // Unlike Lists, indexes have no end sentinel entry, so one is added here if the page reached the end.
+    if (pairs < maxPairs) {
+        pairsOut[pairs * 2] = kEndList;
+        pairsOut[(pairs * 2) + 1] = kEndList;
+        ++pairs;
+    }
+    return pairs;
+}
 
+size_t AssetDatabase::getIndexRange(const std::string& prefix, uint64_t fromTime, uint64_t toTime, size_t maxPairs,
+    uint64_t* pairsOut) {
+    std::string fromKey = makeIndexEntryKey(prefix, fromTime, 0);
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
+    std::array<char, kChainHeadKeySize> chainHeadKey;
+    std::string chainHead;
+    size_t pairs = 0;
+    size_t skipped = 0;
+    for (iterator->Seek(fromKey); iterator->Valid() && pairs < maxPairs; iterator->Next()) {
+        if (iterator->key().size() != prefix.size() + kIndexEntrySuffixSize || !iterator->key().starts_with(prefix)) {
+            break;
+        }
+        uint64_t* pair = pairsOut + (pairs * 2);
+        pair[0] = readBigEndian64(iterator->key().data() + prefix.size());
+        if (pair[0] >= toTime) {
+            break;
+        }
+        std::memcpy(pair + 1, iterator->key().data() + prefix.size() + 8, sizeof(uint64_t));
+        // Deprecated Assets keep their index entries, but are found as the current version of their chain, which has
+        // its own entry, so are left out.
+        makeChainHeadKey(pair[1], chainHeadKey.data());
+        if (m_database->Get(leveldb::ReadOptions(), leveldb::Slice(chainHeadKey.data(), kChainHeadKeySize),
+                &chainHead).ok()) {
+            ++skipped;
+            continue;
+        }
+        ++pairs;
+    }
+
+    LOG(INFO) << "index scan found " << pairs << " pairs, skipping " << skipped << " deprecated Assets.";
+    return pairs;
+}
+
+uint64_t AssetDatabase::enqueueUpstream(uint64_t key, const SizedPointer& flatAsset) {
+    uint64_t token = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+    std::array<char, kUpstreamQueueKeySize> queueKey;
+    queueKey[0] = kUpstreamQueue;
+    writeBigEndian64(token, queueKey.data() + 1);
+    std::memcpy(queueKey.data() + 9, &key, sizeof(uint64_t));
+
+    // Callers report the Asset as added once this returns, so the entry must survive a crash.
+    leveldb::WriteOptions writeOptions;
+    writeOptions.sync = true;
+    auto status = m_database->Put(writeOptions, leveldb::Slice(queueKey.data(), kUpstreamQueueKeySize),
+        leveldb::Slice(flatAsset.dataChar(), flatAsset.size()));
+    if (!status.ok()) {
+        LOG(ERROR) << "Failed to queue Asset " << Asset::keyToString(key) << " for upload, status: "
+            << status.ToString();
+        return 0;
+    }
+    return token;
+}
+
+std::vector<AssetDatabase::UpstreamEntry> AssetDatabase::loadUpstreamQueue() {
+    std::vector<UpstreamEntry> entries;
+    char prefix = kUpstreamQueue;
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
+    for (iterator->Seek(leveldb::Slice(&prefix, 1)); iterator->Valid() && iterator->key()[0] == kUpstreamQueue;
+            iterator->Next()) {
+        if (iterator->key().size() != kUpstreamQueueKeySize) {
+            continue;
+        }
+        UpstreamEntry entry;
+        entry.token = readBigEndian64(iterator->key().data() + 1);
+        std::memcpy(&entry.key, iterator->key().data() + 9, sizeof(uint64_t));
+        auto buffer = std::make_shared<const std::string>(iterator->value().ToString());
+        entry.asset = RecordPtr(new BatchRecord(buffer, 0, 0, buffer->size()));
+        entries.push_back(entry);
+    }
+    return entries;
+}
+
+bool AssetDatabase::removeUpstream(uint64_t token, uint64_t key) {
+    std::array<char, kUpstreamQueueKeySize> queueKey;
+    queueKey[0] = kUpstreamQueue;
+    writeBigEndian64(token, queueKey.data() + 1);
+    std::memcpy(queueKey.data() + 9, &key, sizeof(uint64_t));
+    auto status = m_database->Delete(leveldb::WriteOptions(), leveldb::Slice(queueKey.data(), kUpstreamQueueKeySize));
+    if (!status.ok()) {
+        LOG(ERROR) << "Failed to remove Asset " << Asset::keyToString(key) << " from upload queue, status: "
+            << status.ToString();
+    }
+    return status.ok();
+}
+
+bool AssetDatabase::exportPack(const std::string& path) {
+    PackFile pack;
+    leveldb::ReadOptions metadataOptions;
+    metadataOptions.fill_cache = false;
+    leveldb::ReadOptions dataOptions;
+    dataOptions.fill_cache = false;
+    uint64_t sequence = 0;
+    {
+        // The metadata snapshot is taken first, so every chunk its log entries refer to is in the data snapshot.
+        std::lock_guard<std::mutex> lock(m_replicationMutex);
+        metadataOptions.snapshot = m_database->GetSnapshot();
+        sequence = m_replicationSequence;
+    }
+    dataOptions.snapshot = m_dataDatabase->GetSnapshot();
+
+    bool ok = pack.create(path, sequence);
+    uint64_t blobs = 0;
+    if (ok) {
+        LOG(INFO) << "exporting database to pack file " << path << " at replication sequence " << sequence;
+        // The data table sorts first. Values referring to the blob store carry the blob as it is stored, compressed
+        // or not, and the location is rewritten on import.
+        std::unique_ptr<leveldb::Iterator> iterator(m_dataDatabase->NewIterator(dataOptions));
+        for (iterator->SeekToFirst(); ok && iterator->Valid(); iterator->Next()) {
+            SizedPointer key(iterator->key().data(), iterator->key().size());
+            SizedPointer value(iterator->value().data(), iterator->value().size());
+            BlobStore::Location location;
+            if (blobLocation(iterator->key(), iterator->value(), location)) {
+                RecordPtr blob = m_blobStore->read(location);
+                if (blob->empty()) {
+                    LOG(ERROR) << "failed to read blob in segment " << location.segment << " at " << location.offset
+                        << " for pack export.";
+                    ok = false;
+                    break;
+                }
+                ok = pack.add(kPackDataTable, key, value, blob->data());
+                ++blobs;
+            } else {
+                ok = pack.add(kPackDataTable, key, value);
+            }
+            if (pack.entries() % kPackProgressInterval == 0) {
+                LOG(INFO) << "exported " << pack.entries() << " entries.";
+            }
+        }
+        ok = ok && iterator->status().ok();
+    }
+    m_dataDatabase->ReleaseSnapshot(dataOptions.snapshot);
+
+    if (ok) {
+        std::unique_ptr<leveldb::Iterator> iterator(m_database->NewIterator(metadataOptions));
+        for (iterator->SeekToFirst(); ok && iterator->Valid(); iterator->Next()) {
+            char prefix = iterator->key()[0];
+            if (prefix == kUpstreamQueue || prefix == kReplicationLog || iterator->key() == kReplicationAppliedKey ||
+                iterator->key() == kScrubPositionKey) {
+                continue;
+            }
+            ok = pack.add(kPackMetadataTable, SizedPointer(iterator->key().data(), iterator->key().size()),
+                SizedPointer(iterator->value().data(), iterator->value().size()));
+            if (pack.entries() % kPackProgressInterval == 0) {
+                LOG(INFO) << "exported " << pack.entries() << " entries.";
+            }
+        }
+        ok = ok && iterator->status().ok();
+    }
+    m_database->ReleaseSnapshot(metadataOptions.snapshot);
+
+    ok = ok && pack.finish();
+    if (ok) {
+        LOG(INFO) << "exported " << pack.entries() << " entries, with " << blobs << " blobs, to pack file " << path;
+    } else {
+        LOG(ERROR) << "failed to export database to pack file " << path;
+    }
+    return ok;
+}
+
+bool AssetDatabase::importPack(const std::string& path) {
+    // Chunk reference counts and blobs in the pack assume nothing else is stored.
+    {
+        std::unique_ptr<leveldb::Iterator> dataIterator(m_dataDatabase->NewIterator(leveldb::ReadOptions()));
+        dataIterator->SeekToFirst();
+        std::unique_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
+        char prefix = kAsset;
+        iterator->Seek(leveldb::Slice(&prefix, 1));
+        if (dataIterator->Valid() || (iterator->Valid() && iterator->key()[0] == kAsset)) {
+            LOG(ERROR) << "refusing to import pack file " << path << " in to a database already holding Assets.";
+            return false;
+        }
+    }
+
+    PackFile pack;
+    if (!pack.open(path)) {
+        return false;
+    }
+    LOG(INFO) << "importing " << pack.entries() << " entries in " << pack.blocks() << " blocks from pack file "
+        << path;
+
+    // LevelDB always writes its log, so the nearest to bulk loading is large batches written in key order, without
+    // syncing until the end.
+    leveldb::WriteOptions writeOptions;
+    writeOptions.sync = false;
+    leveldb::WriteBatch metadataBatch;
+    leveldb::WriteBatch dataBatch;
+    std::vector<PackFile::Entry> entries;
+    std::string value;
+    uint64_t imported = 0;
+    bool ok = true;
+    for (size_t block = 0; ok && block < pack.blocks(); ++block) {
+        if (!pack.readBlock(block, entries)) {
+            ok = false;
+            break;
+        }
+        for (const auto& entry : entries) {
+            leveldb::Slice key(entry.key.dataChar(), entry.key.size());
+            value.assign(entry.value.dataChar(), entry.value.size());
+            if (entry.table == kPackDataTable) {
+                BlobStore::Location location;
+                if (entry.blob.size() > 0) {
+                    if (value.size() < BlobStore::kEncodedLocationSize || !m_blobStore->append(entry.blob, location)) {
+                        LOG(ERROR) << "failed to store blob from pack file " << path;
+                        ok = false;
+                        break;
+                    }
+                    BlobStore::encodeLocation(location, &value[0]);
+                }
+                dataBatch.Put(key, value);
+            } else if (entry.table == kPackMetadataTable) {
+                metadataBatch.Put(key, value);
+            } else {
+                LOG(ERROR) << "unknown table '" << entry.table << "' in pack file " << path;
+                ok = false;
+                break;
+            }
+            ++imported;
+            if (imported % kPackProgressInterval == 0) {
+                LOG(INFO) << "imported " << imported << " entries.";
+            }
+        }
+
+        if (ok && dataBatch.ApproximateSize() >= kPackImportBatchSize) {
+            auto status = m_dataDatabase->Write(writeOptions, &dataBatch);
+            ok = status.ok();
+            dataBatch.Clear();
+        }
+        if (ok && metadataBatch.ApproximateSize() >= kPackImportBatchSize) {
+            auto status = m_database->Write(writeOptions, &metadataBatch);
+            ok = status.ok();
+            metadataBatch.Clear();
+        }
+    }
+
+    // Blobs are synced before the final, synced, writes of the entries that refer to them.
+    writeOptions.sync = true;
+    ok = ok && m_blobStore->sync();
+    ok = ok && m_dataDatabase->Write(writeOptions, &dataBatch).ok();
+    ok = ok && m_database->Write(writeOptions, &metadataBatch).ok();
+    if (!ok) {
+        LOG(ERROR) << "failed to import pack file " << path << " after " << imported << " entries.";
+        return false;
+    }
+
+    loadChunkDictionaries();
+    loadQuarantine();
+    if (pack.sequence() > 0 && !setReplicationApplied(pack.sequence())) {
+        return false;
+    }
+    LOG(INFO) << "imported " << imported << " entries from pack file " << path << ", replication can follow from "
+        << "sequence " << pack.sequence();
+    return true;
+}
+
+void AssetDatabase::setReplicationLogging(bool enabled) {
+    m_replicationLogging = enabled;
+}
+
+uint64_t AssetDatabase::replicationSequence() const {
+    return m_replicationSequence;
+}
+
+bool AssetDatabase::readReplicationLog(uint64_t afterSequence, size_t maxEntries,
+    std::vector<ReplicationEntry>& entriesOut) {
+    entriesOut.clear();
+    if (afterSequence >= m_replicationSequence) {
+        return true;
+    }
+    std::array<char, kReplicationLogKeySize> logKey;
+    makeReplicationLogKey(afterSequence + 1, logKey.data());
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
+    for (iterator->Seek(leveldb::Slice(logKey.data(), kReplicationLogKeySize));
+            iterator->Valid() && entriesOut.size() < maxEntries; iterator->Next()) {
+        ReplicationEntry entry;
+        if (!decodeReplicationEntry(iterator->key(), iterator->value(), entry)) {
+            break;
+        }
+        // The log has no gaps, so a missing entry means garbage collection has deleted it.
+        if (entry.sequence != afterSequence + entriesOut.size() + 1) {
+            LOG(ERROR) << "replication log entry " << (afterSequence + entriesOut.size() + 1) << " no longer kept.";
+            entriesOut.clear();
+            return false;
+        }
+        entriesOut.push_back(std::move(entry));
+    }
+    return true;
+}
+
+bool AssetDatabase::applyReplicationEntry(const ReplicationEntry& entry) {
+    auto verifier = flatbuffers::Verifier(reinterpret_cast<const uint8_t*>(entry.record.data()), entry.record.size());
+    SizedPointer record(entry.record.data(), entry.record.size());
+    switch (entry.op) {
+    case kReplicateAsset:
+        if (!Data::VerifyFlatAssetBuffer(verifier)) {
+            break;
+        }
+        return storeAssetAt(entry.key, record, entry.argument);
+
+    case kReplicateAssetData:
+        return storeAssetDataChunk(entry.key, entry.argument, record);
+
+    case kReplicateListItem:
+        return addListItemAt(entry.key, entry.assetKey, entry.argument);
+
+    case kReplicateList:
+        if (!Data::VerifyFlatListBuffer(verifier)) {
+            break;
+        }
+        return storeList(entry.key, record);
+    }
+
+    LOG(ERROR) << "failed to verify replication log entry " << entry.sequence << " for "
+        << Asset::keyToString(entry.key);
+    return false;
+}
+
+uint64_t AssetDatabase::replicationApplied() {
+    std::string applied;
+    if (!m_database->Get(leveldb::ReadOptions(), kReplicationAppliedKey, &applied).ok() ||
+        applied.size() != sizeof(uint64_t)) {
+        return 0;
+    }
+    return readBigEndian64(applied.data());
+}
+
+bool AssetDatabase::setReplicationApplied(uint64_t sequence) {
+    std::array<char, sizeof(uint64_t)> applied;
+    writeBigEndian64(sequence, applied.data());
+    leveldb::WriteOptions writeOptions;
+    writeOptions.sync = true;
+    auto status = m_database->Put(writeOptions, kReplicationAppliedKey, leveldb::Slice(applied.data(), applied.size()));
+    if (!status.ok()) {
+        LOG(ERROR) << "Failed to record replication log sequence " << sequence << " applied, status: "
+            << status.ToString();
+    }
+    return status.ok();
+}
+
+leveldb::Status AssetDatabase::writeLogged(leveldb::WriteBatch& batch, ReplicationOp op, uint64_t key,
+    uint64_t argument, const SizedPointer& record) {
+    if (!m_replicationLogging) {
+        return m_database->Write(leveldb::WriteOptions(), &batch);
+    }
+
+    std::lock_guard<std::mutex> lock(m_replicationMutex);
+    uint64_t sequence = m_replicationSequence + 1;
+    std::array<char, kReplicationLogKeySize> logKey;
+    makeReplicationLogKey(sequence, logKey.data());
+    std::string logValue = encodeReplicationEntry(op, key, argument, record);
+    batch.Put(leveldb::Slice(logKey.data(), kReplicationLogKeySize), logValue);
+    auto status = m_database->Write(leveldb::WriteOptions(), &batch);
+    // The sequence number is only used up by a successful write, so the log has no gaps.
+    if (status.ok()) {
+        m_replicationSequence = sequence;
+    }
+    return status;
+}
+
+std::vector<AssetDatabase::SearchResult> AssetDatabase::searchNames(const std::string& query, size_t limit) {
+    std::vector<SearchResult> results;
+    std::string normalized = NameSearch::normalize(query);
+    if (normalized.empty() || limit == 0) {
+        return results;
+    }
+
+    leveldb::ReadOptions readOptions;
+    readOptions.snapshot = m_database->GetSnapshot();
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->NewIterator(readOptions));
+    std::array<char, kChainHeadKeySize> chainHeadKey;
+    std::string chainHead;
+    // Deprecated Assets keep their names, but are left out of results in favor of the current version.
+    auto isDeprecated = [this, &readOptions, &chainHeadKey, &chainHead](char kind, uint64_t key) {
+        if (kind != kAsset) {
+            return false;
+        }
+        makeChainHeadKey(key, chainHeadKey.data());
+        return m_database->Get(readOptions, leveldb::Slice(chainHeadKey.data(), kChainHeadKeySize),
+            &chainHead).ok();
+    };
+    std::set<std::pair<char, uint64_t>> found;
+
+    // Names with a word starting with the query come first, in order of the matching words, so exact matches lead.
+    std::string prefix(1, kNamePrefix);
+    prefix.append(normalized.substr(0, NameSearch::kMaxIndexedLength));
+    size_t postings = 0;
+    size_t skipped = 0;
+    for (iterator->Seek(prefix); iterator->Valid() && iterator->key().starts_with(prefix) &&
+            results.size() < limit && postings < kMaxPrefixPostings; iterator->Next()) {
+        ++postings;
+        leveldb::Slice searchKey = iterator->key();
+        if (searchKey.size() < prefix.size() + kNameSearchSuffixSize) {
+            continue;
+        }
+        char kind = searchKey[searchKey.size() - kNameSearchSuffixSize];
+        uint64_t key = 0;
+        std::memcpy(&key, searchKey.data() + searchKey.size() - sizeof(uint64_t), sizeof(uint64_t));
+        if (found.count(std::make_pair(kind, key)) || isDeprecated(kind, key)) {
+            ++skipped;
+            continue;
+        }
+        found.insert(std::make_pair(kind, key));
+        results.push_back(SearchResult { key, kind == kList, iterator->value().ToString() });
+    }
+
+    // Then names sharing enough trigrams with the query, to find misspellings, best match first.
+    auto queryTrigrams = NameSearch::trigrams(normalized);
+    if (results.size() < limit && queryTrigrams.size() > 0) {
+        std::map<std::pair<char, uint64_t>, std::pair<size_t, std::string>> candidates;
+        for (const auto& trigram : queryTrigrams) {
+            std::string trigramPrefix(1, kNameTrigram);
+            trigramPrefix.append(trigram);
+            postings = 0;
+            for (iterator->Seek(trigramPrefix); iterator->Valid() && iterator->key().starts_with(trigramPrefix) &&
+                    postings < kMaxTrigramPostings; iterator->Next()) {
+                ++postings;
+                leveldb::Slice searchKey = iterator->key();
+                if (searchKey.size() != trigramPrefix.size() + kNameSearchSuffixSize) {
+                    continue;
+                }
+                uint64_t key = 0;
+                std::memcpy(&key, searchKey.data() + trigramPrefix.size() + 1, sizeof(uint64_t));
+                auto& candidate = candidates[std::make_pair(searchKey[trigramPrefix.size()], key)];
+                if (candidate.first++ == 0) {
+                    candidate.second = iterator->value().ToString();
+                }
+            }
+        }
+
+        std::vector<std::pair<float, std::pair<char, uint64_t>>> scored;
+        for (const auto& candidate : candidates) {
+            if (found.count(candidate.first)) {
+                continue;
+            }
+            float score = NameSearch::similarity(candidate.second.first, queryTrigrams.size(),
+                NameSearch::trigrams(NameSearch::normalize(candidate.second.second)).size());
+            if (score >= kMinNameSimilarity) {
+                scored.push_back(std::make_pair(score, candidate.first));
+            }
+        }
+        std::stable_sort(scored.begin(), scored.end(), [](const std::pair<float, std::pair<char, uint64_t>>& a,
+            const std::pair<float, std::pair<char, uint64_t>>& b) {
+            return a.first > b.first;
+        });
+        for (const auto& match : scored) {
+            if (results.size() >= limit) {
+                break;
+            }
+            if (isDeprecated(match.second.first, match.second.second)) {
+                ++skipped;
+                continue;
+            }
+            results.push_back(SearchResult { match.second.second, match.second.first == kList,
+                candidates[match.second].second });
+        }
+    }
+
+    iterator.reset();
+    m_database->ReleaseSnapshot(readOptions.snapshot);
+    LOG(INFO) << "name search for '" << query << "' found " << results.size() << " results, skipping " << skipped
+        << " deprecated or repeated matches.";
+    return results;
+}
+
+bool AssetDatabase::migrateListEntries(std::string& position, leveldb::WriteBatch& batch, leveldb::WriteBatch&,
+    size_t& examinedOut) {
+    if (position.empty()) {
+        position.assign(1, kLegacyListEntry);
+    }
+    std::array<char, kListEntryKeySize> listEntryKey;
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
+    for (iterator->Seek(position);
+            iterator->Valid() && iterator->key()[0] == kLegacyListEntry && examinedOut < kMigrationBatchSize;
+            iterator->Next()) {
+        ++examinedOut;
+        position.assign(iterator->key().data(), iterator->key().size());
+        position.push_back('\0');
+        if (iterator->key().size() != kListEntryKeySize) {
+            continue;
+        }
+        uint64_t listKey = 0;
+        uint64_t token = 0;
+        uint64_t assetKey = 0;
+        std::memcpy(&listKey, iterator->key().data() + 1, sizeof(uint64_t));
+        std::memcpy(&token, iterator->key().data() + 9, sizeof(uint64_t));
+        std::memcpy(&assetKey, iterator->key().data() + 17, sizeof(uint64_t));
+        makeListEntryKey(listKey, token, assetKey, listEntryKey.data());
+        batch.Put(leveldb::Slice(listEntryKey.data(), kListEntryKeySize), leveldb::Slice());
+        batch.Delete(iterator->key());
+    }
+    return true;
+}
+
+bool AssetDatabase::buildNameSearchIndex(std::string& position, leveldb::WriteBatch& batch, leveldb::WriteBatch&,
+    size_t& examinedOut) {
+    if (position.empty()) {
+        position = kAssetNamePrefix;
+    }
+    // Asset and List names sort next to each other, with nothing in between.
+    std::string namesEnd(kListNamePrefix);
+    namesEnd.back() += 1;
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
+    for (iterator->Seek(position); iterator->Valid() && iterator->key().compare(namesEnd) < 0 &&
+            examinedOut < kMigrationBatchSize; iterator->Next()) {
+        ++examinedOut;
+        position.assign(iterator->key().data(), iterator->key().size());
+        position.push_back('\0');
+        bool isAssetName = iterator->key().starts_with(kAssetNamePrefix);
+        if ((!isAssetName && !iterator->key().starts_with(kListNamePrefix)) ||
+            iterator->value().size() != sizeof(uint64_t)) {
+            continue;
+        }
+        const char* namePrefix = isAssetName ? kAssetNamePrefix : kListNamePrefix;
+        size_t prefixSize = std::strlen(namePrefix);
+        uint64_t key = 0;
+        std::memcpy(&key, iterator->value().data(), sizeof(uint64_t));
+        std::string name(iterator->key().data() + prefixSize, iterator->key().size() - prefixSize);
+        addNameSearchEntries(name, isAssetName ? kAsset : kList, key, batch);
+    }
+    return true;
+}
+
+}  // namespace Confab
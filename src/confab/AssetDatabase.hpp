@@ -4,16 +4,33 @@
 #include "Record.hpp"
 #include "SizedPointer.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace leveldb {
+    class Cache;
     class DB;
     class Iterator;
+    class Status;
     class WriteBatch;
 }
 
 namespace Confab {
 
+class AssetCache;
+class BlobStore;
+class ChunkCodec;
+
 class Database;
 
 /*! Class responsible for storage, retrieval, and verification of FlatAsset and FlatAssetData objects in the provided
@@ -21,6 +38,149 @@ class Database;
  */
 class AssetDatabase {
 public:
+    /*! Version of the key layout and value formats written by this confab. Databases with an older version are
+     * migrated when opened, and databases with a newer version are refused.
+     */
+    static constexpr uint64_t kSchemaVersion = 3;
+
+    /*! Settings for garbage collection of the database.
+     */
+    struct GarbageCollectionOptions {
+        /*! Number of deprecated versions kept in each chain of deprecations, not counting the current version. Older
+         *  versions are deleted, but are still found by key as the current version.
+         */
+        size_t retainDeprecated = 4;
+
+        /*! Number of keys examined between each write of deletions.
+         */
+        size_t batchSize = 256;
+
+        /*! Limit on the number of keys examined per second, or 0 for no limit.
+         */
+        size_t keysPerSecond = 2048;
+
+        /*! How long AssetData chunks with no Asset, or Assets missing their last chunk, are left alone before being
+         *  deleted as abandoned uploads. These are only noticed once per pass, so are deleted no sooner than the first
+         *  pass at least this long after the one that first found them.
+         */
+        std::chrono::seconds abandonedGracePeriod = std::chrono::hours(24);
+
+        /*! If true, Assets missing their last chunk past the grace period are deleted along with the chunks they have.
+         *  Only servers should enable this, as clients cache Asset data a chunk at a time.
+         */
+        bool deleteIncompleteAssets = false;
+
+        /*! Number of the most recent replication log entries kept, or 0 to keep them all. Followers further behind
+         *  than this can no longer catch up from the log.
+         */
+        size_t replicationLogRetain = 0;
+    };
+
+    /*! Totals of what a garbage collection pass deleted.
+     */
+    struct GarbageCollectionStats {
+        size_t deprecatedAssets = 0;
+        size_t incompleteAssets = 0;
+        size_t orphanedAssetData = 0;
+        size_t staleNames = 0;
+        size_t staleIndexEntries = 0;
+        size_t staleSearchEntries = 0;
+        size_t legacyKeys = 0;
+        size_t replicationLogEntries = 0;
+        size_t bytesReclaimed = 0;
+    };
+
+    /*! Settings for scrubbing, the check of stored AssetData against the hashes it was uploaded with.
+     */
+    struct ScrubOptions {
+        /*! Limit on the AssetData bytes read and hashed per second, or 0 for no limit. Both the disk reads and the
+         *  hashing of a pass are proportional to the bytes checked.
+         */
+        size_t bytesPerSecond = 8 * 1024 * 1024;
+
+        /*! Number of Assets checked between each checkpoint of the progress of a pass.
+         */
+        size_t batchSize = 64;
+    };
+
+    /*! Totals of what a scrub pass checked and found.
+     */
+    struct ScrubStats {
+        size_t assets = 0;
+        size_t chunks = 0;
+        size_t bytes = 0;
+        size_t incompleteAssets = 0;
+        size_t quarantinedAssets = 0;
+        size_t restoredAssets = 0;
+        size_t staleQuarantineEntries = 0;
+    };
+
+    /*! One Asset or List found by searchNames().
+     */
+    struct SearchResult {
+        uint64_t key;
+        bool isList;
+        std::string name;
+    };
+
+    /*! An Asset waiting to be uploaded to the server, added with enqueueUpstream().
+     */
+    struct UpstreamEntry {
+        uint64_t token;
+        uint64_t key;
+        RecordPtr asset;
+    };
+
+    /*! The kinds of write recorded in the replication log.
+     */
+    enum ReplicationOp : char {
+        /*! A storeAsset(), with the timestamp of its List and index entries.
+         */
+        kReplicateAsset = 'a',
+
+        /*! A storeAssetDataChunk(), with the chunk number. The FlatAssetData is not kept in the log.
+         */
+        kReplicateAssetData = 'c',
+
+        /*! An addListItem(), with the timestamp of the List entry.
+         */
+        kReplicateListItem = 'i',
+
+        /*! A storeList().
+         */
+        kReplicateList = 'l'
+    };
+
+    /*! One write recorded in the replication log.
+     */
+    struct ReplicationEntry {
+        /*! Position in the log, starting from 1 and with no gaps.
+         */
+        uint64_t sequence;
+
+        /*! The kind of write.
+         */
+        ReplicationOp op;
+
+        /*! The key of the Asset or List written.
+         */
+        uint64_t key;
+
+        /*! The timestamp for kReplicateAsset and kReplicateListItem, the chunk number for kReplicateAssetData, or
+         *  zero.
+         */
+        uint64_t argument;
+
+        /*! The key of the Asset added for kReplicateListItem, or zero.
+         */
+        uint64_t assetKey;
+
+        /*! The FlatAsset, FlatAssetData, or FlatList record written, or empty for kReplicateListItem. Never filled in
+         *  for kReplicateAssetData by readReplicationLog().
+         */
+        std::string record;
+    };
+
     /*! Constructs an AssetDatabase.
      */
     AssetDatabase();
@@ -35,11 +195,43 @@ public:
      * \param createNew If true, open() will attempt to create a new database, and will treat an existing or already
      *                  initialized database as an error condition. If false, open() will expect a valid database to
      *                  exist at \a path.
-     * \param cacheSize Size in bytes of the LRU memory cache to request from LevelDB. A size <= 0 will disable the
-     *                  cache.
+     * \param cacheSize Size in bytes of the LRU memory cache to request from LevelDB for Asset and List metadata. A
+     *                  size <= 0 will disable the cache.
+     * \param dataCacheSize Size in bytes of the separate LRU memory cache to request from LevelDB for AssetData
+     *                      chunks, which are stored in their own database alongside the metadata one at \a path. A
+     *                      size <= 0 will disable the cache.
+     * \param assetCacheSize Size in bytes of the cache of found Assets kept in front of the database. A size <= 0
+     *                       will disable the cache.
      * \return true on success, or false on error.
      */
-    bool open(const char* path, bool createNew, int cacheSize);
+    bool open(const char* path, bool createNew, int cacheSize, int dataCacheSize, int assetCacheSize);
+
+    /*! Sets the limit on the rate of migrations run in the background after open(), which take effect from the next
+     * batch of keys.
+     *
+     * \param keysPerSecond The most database keys examined per second, or 0 for no limit.
+     */
+    void setMigrationKeysPerSecond(size_t keysPerSecond);
+
+    /*! The schema version of the open database. Lower than kSchemaVersion while migrations are running in the
+     * background, during which reads also find entries in the layout of the older version.
+     *
+     * \return The version of the last migration completed.
+     */
+    uint64_t schemaVersion() const;
+
+    /*! Loads the Config record of the database.
+     *
+     * \return A FlatConfig record, or an empty Record if none has been stored.
+     */
+    RecordPtr loadConfig();
+
+    /*! Replaces the Config record of the database.
+     *
+     * \param config A serialized FlatConfig.
+     * \return true on success, false on error.
+     */
+    bool storeConfig(const SizedPointer& config);
 
     /*! Close the database, and delete any internal references to it.
      *
@@ -48,15 +240,53 @@ public:
 
     /*! Locates an asset associated with the provided key and returns it.
      *
-     * If the asset retrieved is marked as deprecated, this function will iteratively retrieve assets until it discovers
-     * a non-deprecated Asset, and then will return that one. So it is possible that the returned Asset will have a
-     * different key than the one requested.
+     * Recently found Assets are served from an in-memory cache, which storeAsset() invalidates.
+     *
+     * If the asset requested has been deprecated, this function will return the most recent Asset in its chain of
+     * deprecations instead, found with a single lookup in the chain head index maintained by storeAsset(). So it is
+     * possible that the returned Asset will have a different key than the one requested.
      *
      * \param key The asset key associated with this asset.
      * \return A non-owning pointer to a FlatAsset record, or an empty Record on error.
      */
     RecordPtr findAsset(uint64_t key);
 
+    /*! The number of findAsset() calls answered from the Asset cache.
+     *
+     * \return The cache hit count.
+     */
+    uint64_t assetCacheHits() const;
+
+    /*! The number of findAsset() calls that missed the Asset cache and read from the database.
+     *
+     * \return The cache miss count.
+     */
+    uint64_t assetCacheMisses() const;
+
+    /*! The total size of new AssetData chunk contents stored since open(), before any compression.
+     *
+     * \return The size in bytes.
+     */
+    uint64_t chunkBytesBeforeCompression() const;
+
+    /*! The total size of new AssetData chunk contents written to the blob store since open(), after compression. Sample
+     * and image chunks are written raw, so count the same on both sides.
+     *
+     * \return The size in bytes.
+     */
+    uint64_t chunkBytesAfterCompression() const;
+
+    /*! Locates a batch of Assets, following deprecations like findAsset(), with a single database snapshot and
+     * iterator.
+     *
+     * Keys are looked up in sorted order, which is much cheaper than a findAsset() call per key when resolving a page
+     * of List items.
+     *
+     * \param keys The Asset keys to look up, in any order.
+     * \return One Record per key, in the same order as keys, with empty Records for any Assets not found.
+     */
+    std::vector<RecordPtr> findAssets(const std::vector<uint64_t>& keys);
+
     /*! Locates an Asset associated with the provided name and returns it.
      *
      * Just like findAsset, will return the most recent version of the requested Asset, following deprecations.
@@ -67,6 +297,9 @@ public:
     RecordPtr findNamedAsset(const std::string& name);
 
     /*! Stores a FlatAsset record with an already computed hash into the database.
+     *
+     * If the Asset deprecates another, every Asset in the chain of deprecations it extends has its chain head index
+     * entry pointed at the new Asset, in the same atomic write as the Asset itself.
      *
      * \param key The key to store the serialized asset under.
      * \param assetData The serialized asset data.
@@ -78,11 +311,49 @@ public:
      *
      * \param key The key associated with this asset.
      * \param chunk Which chunk number to load.
-     * \return A non-owning pointer to the FlatAssetData record, or an empty Record on error.
+     * \return A non-owning pointer to the FlatAssetData record, or an empty Record on error or if the Asset is
+     *         quarantined.
      */
     RecordPtr loadAssetDataChunk(uint64_t key, uint64_t chunk);
 
+    /*! Reads consecutive FlatAssetData chunks of an Asset with a single sequential scan of the database.
+     *
+     * \param key The key associated with this asset.
+     * \param firstChunk The first chunk number to load.
+     * \param count The maximum number of chunks to load.
+     * \param visitor Called with the chunk number and a non-owning pointer to the FlatAssetData record of each chunk
+     *                in order, which is only valid for the duration of the call. Return false to stop reading.
+     * \return The number of chunks visited, which is less than count if a chunk was missing or visitor returned
+     *         false, and 0 if the Asset is quarantined.
+     */
+    size_t loadAssetDataRange(uint64_t key, uint64_t firstChunk, uint64_t count,
+        std::function<bool(uint64_t, const SizedPointer&)> visitor);
+
+    /*! Loads a batch of FlatAssetData records, possibly from different Assets, with a single database snapshot and
+     * iterator.
+     *
+     * \param keyChunks Pairs of Asset key and chunk number to load, in any order.
+     * \return One Record per pair, in the same order as keyChunks, with empty Records for any chunks not found or of
+     *         quarantined Assets.
+     */
+    std::vector<RecordPtr> loadAssetDataChunks(const std::vector<std::pair<uint64_t, uint64_t>>& keyChunks);
+
+    /*! Rewrites blob segments that are mostly unreferenced, then retires them, reclaiming their space.
+     *
+     * Blobs are only ever unreferenced when the last reference to their contents is released, so this should run after
+     * releaseAssetData() has been called for any Assets no longer needed.
+     *
+     * \param maxLiveFraction Segments with less than this fraction of their used space still referenced are compacted.
+     * \return The number of bytes reclaimed.
+     */
+    size_t compactBlobSegments(double maxLiveFraction = 0.5);
+
     /*! Stores a FlatAssetData record for an Asset into the database.
+     *
+     * Chunks are content-addressed. The first chunk stored with some contents is appended to a memory-mapped blob
+     * segment, so that it is never rewritten by database compaction and is read back without copying. Every chunk,
+     * from any Asset, with the same contents then only adds a reference to it, and a reference count is kept with the
+     * contents in the same atomic write.
      *
      * \param key The key to associate with this Asset data chunk.
      * \param chunk The chunk number to store this under.
@@ -91,6 +362,92 @@ public:
      */
     bool storeAssetDataChunk(uint64_t key, uint64_t chunk, const SizedPointer& flatAssetData);
 
+    /*! Deletes every FlatAssetData chunk of an Asset, releasing its references to shared chunk contents.
+     *
+     * Contents left with no references are deleted, and their space reclaimed by the next compactBlobSegments(). This
+     * does nothing while AssetData from an older version of confab is still being migrated.
+     *
+     * \param key The key of the Asset whose data to delete.
+     * \return The number of chunks deleted.
+     */
+    size_t releaseAssetData(uint64_t key);
+
+    /*! Runs one incremental garbage collection pass over the whole database.
+     *
+     * Keys are examined in batches, with each batch of deletions written atomically, and the pass sleeps between
+     * batches to stay within options.keysPerSecond, so it can run alongside normal use of the database. It deletes:
+     *  - Deprecated Assets older than the retained versions in their chain, and their AssetData.
+     *  - AssetData chunks for which there is no Asset, once past the grace period.
+     *  - Assets missing their last chunk, once past the grace period, if options.deleteIncompleteAssets is set.
+     *  - Asset name entries that no longer find an Asset, and index entries of deleted Assets.
+     *  - Leftover keys in formats from older versions of confab that migration skipped.
+     *  - Replication log entries older than the options.replicationLogRetain most recent.
+     *
+     * Each span of deleted keys is then compacted, and finally so are any mostly unreferenced blob segments.
+     *
+     * \param options The garbage collection settings.
+     * \return What the pass deleted, and the approximate number of bytes reclaimed.
+     */
+    GarbageCollectionStats collectGarbage(const GarbageCollectionOptions& options);
+
+    /*! Starts a thread that calls collectGarbage() periodically, until close().
+     *
+     * \param options The garbage collection settings.
+     * \param interval Time between the end of one pass and the start of the next.
+     */
+    void startGarbageCollection(const GarbageCollectionOptions& options, std::chrono::seconds interval);
+
+    /*! Runs one scrub pass, checking the AssetData of every Asset against its hashes.
+     *
+     * Every chunk is read back from the blob store, checked against the blob hash, and added to a running XXH64 hash
+     * of the Asset, which must match the hash stored with the chunk, and after the last chunk the Asset key. Assets
+     * that fail are quarantined, and their AssetData is no longer loaded, while quarantined Assets that check out
+     * again are released. Assets missing chunks are counted but left to garbage collection. The pass sleeps between
+     * chunks to stay within options.bytesPerSecond, and records its position every options.batchSize Assets, so a
+     * pass stopped by close() resumes where it left off, even after a restart. Does nothing while AssetData from an
+     * older version of confab is still being migrated.
+     *
+     * \param options The scrub settings.
+     * \return What the pass checked and found.
+     */
+    ScrubStats scrub(const ScrubOptions& options);
+
+    /*! Starts a thread that calls scrub() periodically, until close().
+     *
+     * \param options The scrub settings.
+     * \param interval Time between the end of one pass and the start of the next.
+     */
+    void startScrubbing(const ScrubOptions& options, std::chrono::seconds interval);
+
+    /*! Checks if an Asset was quarantined by scrub().
+     *
+     * \param key The key of the Asset.
+     * \return true if the AssetData of the Asset failed its hash check, and hasn't since passed it.
+     */
+    bool isQuarantined(uint64_t key);
+
+    /*! Lists the Assets quarantined by scrub().
+     *
+     * \return The keys of every quarantined Asset.
+     */
+    std::vector<uint64_t> quarantinedAssets();
+
+    /*! Loads the serialized waveform overview computed for a sample Asset.
+     *
+     * \param key The key of the sample Asset.
+     * \return A non-owning pointer to the serialized WaveformPeaks data, or an empty Record if none is stored.
+     */
+    RecordPtr loadWaveform(uint64_t key);
+
+    /*! Stores a serialized waveform overview for a sample Asset. Waveforms are derived locally from the Asset data, so
+     * are only kept in the local database.
+     *
+     * \param key The key of the sample Asset the overview was computed from.
+     * \param peaks The serialized WaveformPeaks data.
+     * \return true on success, false on error.
+     */
+    bool storeWaveform(uint64_t key, const SizedPointer& peaks);
+
     /*! Stores a new List entity into the database.
      *
      * \param key The list key to associate with this List.
@@ -113,6 +470,14 @@ public:
      */
     RecordPtr findNamedList(const std::string& name);
 
+    /*! Adds an existing Asset to the end of a List, for Assets that were stored without naming this List.
+     *
+     * \param listKey The key of the List to add to.
+     * \param assetKey The key of the Asset to add.
+     * \return true on success, false on error.
+     */
+    bool addListItem(uint64_t listKey, uint64_t assetKey);
+
     /*! Populates the provided buffer with <token, key> pairs from a list. If it reaches the end of the list it will
      * put a <kEndList, kEndList> pair at the end.
      *
@@ -126,13 +491,352 @@ public:
      */
     size_t getListNext(uint64_t listKey, uint64_t fromToken, size_t maxPairs, uint64_t* listOut);
 
+    /*! Populates the provided buffer with <token, key> pairs from a list, in reverse order. If it reaches the beginning
+     * of the list it will put a <kBeginList, kBeginList> pair at the end.
+     *
+     * \param listKey The key of the list to draw from.
+     * \param fromToken The token to start with, or kEndList if starting from the end. Returned list will not include
+     *                  this token.
+     * \param maxPairs The maximum number of <token, key> pairs to put into listOut.
+     * \param listOut A pointer to a buffer to hold the reverse-ordered list.
+     * \return The number of pairs written into listOut, or 0 on error.
+     */
+    size_t getListPrevious(uint64_t listKey, uint64_t fromToken, size_t maxPairs, uint64_t* listOut);
+
+    /*! Populates the provided buffer with the most recently added <token, key> pairs from a list, newest first.
+     *
+     * \param listKey The key of the list to draw from.
+     * \param maxPairs The maximum number of <token, key> pairs to put into listOut.
+     * \param listOut A pointer to a buffer to hold the reverse-ordered list.
+     * \return The number of pairs written into listOut, or 0 on error.
+     */
+    size_t getListLatest(uint64_t listKey, size_t maxPairs, uint64_t* listOut);
+
+    /*! Populates the provided buffer with the <token, key> pairs of the items added to a list within a span of time,
+     * oldest first. Tokens are the microsecond time of addition, so fromTime and toTime use the same units. No sentinel
+     * pairs are included.
+     *
+     * \param listKey The key of the list to draw from.
+     * \param fromTime The earliest token to include.
+     * \param toTime The token to stop before, not included in the returned list.
+     * \param maxPairs The maximum number of <token, key> pairs to put into listOut.
+     * \param listOut A pointer to a buffer to hold the ordered list.
+     * \return The number of pairs written into listOut.
+     */
+    size_t getListRange(uint64_t listKey, uint64_t fromTime, uint64_t toTime, size_t maxPairs, uint64_t* listOut);
+
+    /*! Populates the provided buffer with <token, key> pairs of the Assets of one type, oldest first. Tokens are the
+     * microsecond time each Asset was stored. Deprecated Assets are left out. If it reaches the end of the index it
+     * will put a <kEndList, kEndList> pair at the end.
+     *
+     * \param type The Asset type, from Asset::Type.
+     * \param fromToken The token to start after, or 0 if starting from the beginning.
+     * \param maxPairs The maximum number of <token, key> pairs to put into pairsOut.
+     * \param pairsOut A pointer to a buffer to hold the ordered pairs.
+     * \return The number of pairs written into pairsOut.
+     */
+    size_t getTypeNext(uint32_t type, uint64_t fromToken, size_t maxPairs, uint64_t* pairsOut);
+
+    /*! Populates the provided buffer with the <token, key> pairs of the Assets of one type stored within a span of
+     * time, oldest first. Deprecated Assets are left out, and no sentinel pairs are included.
+     *
+     * \param type The Asset type, from Asset::Type.
+     * \param fromTime The earliest token to include.
+     * \param toTime The token to stop before, not included in the returned pairs.
+     * \param maxPairs The maximum number of <token, key> pairs to put into pairsOut.
+     * \param pairsOut A pointer to a buffer to hold the ordered pairs.
+     * \return The number of pairs written into pairsOut.
+     */
+    size_t getTypeRange(uint32_t type, uint64_t fromTime, uint64_t toTime, size_t maxPairs, uint64_t* pairsOut);
+
+    /*! Populates the provided buffer with <token, key> pairs of the Assets by one author, oldest first, like
+     * getTypeNext().
+     *
+     * \param author The key of the author.
+     * \param type The Asset type, from Asset::Type, or 0 for Assets of every type.
+     * \param fromToken The token to start after, or 0 if starting from the beginning.
+     * \param maxPairs The maximum number of <token, key> pairs to put into pairsOut.
+     * \param pairsOut A pointer to a buffer to hold the ordered pairs.
+     * \return The number of pairs written into pairsOut.
+     */
+    size_t getAuthorNext(uint64_t author, uint32_t type, uint64_t fromToken, size_t maxPairs, uint64_t* pairsOut);
+
+    /*! Starts or stops recording writes in the replication log, so that follower servers can replay them in order.
+     *
+     * A log is only complete if kept from when the database is created, as followers start from an empty database.
+     * Garbage collection is not logged, followers collect their own garbage.
+     *
+     * \param enabled If true, every storeAsset(), storeAssetDataChunk(), storeList() and addListItem() is logged.
+     */
+    void setReplicationLogging(bool enabled);
+
+    /*! The sequence number of the most recent replication log entry.
+     *
+     * \return The last sequence number, or 0 if the log is empty.
+     */
+    uint64_t replicationSequence() const;
+
+    /*! Reads entries from the replication log, oldest first.
+     *
+     * \param afterSequence The sequence number to read after, which is 0 to read from the start of the log.
+     * \param maxEntries The maximum number of entries to read.
+     * \param entriesOut Replaced with the entries read, which is empty if there are no entries after afterSequence.
+     * \return false if the entries following afterSequence have been deleted by garbage collection, true otherwise.
+     */
+    bool readReplicationLog(uint64_t afterSequence, size_t maxEntries, std::vector<ReplicationEntry>& entriesOut);
+
+    /*! Replays a write read from the replication log of another database. Replaying an entry again has no further
+     * effect, and timestamps are kept, so List and index tokens match those of the other database.
+     *
+     * \param entry The entry to replay, which for kReplicateAssetData must have the FlatAssetData record filled in.
+     * \return true on success, false on error.
+     */
+    bool applyReplicationEntry(const ReplicationEntry& entry);
+
+    /*! The sequence number of the last replication log entry replayed from another database, as recorded with
+     * setReplicationApplied().
+     *
+     * \return The last sequence number applied, or 0 if none.
+     */
+    uint64_t replicationApplied();
+
+    /*! Durably records how far replay of the replication log of another database has reached.
+     *
+     * \param sequence The sequence number of the last entry applied.
+     * \return true on success, false on error.
+     */
+    bool setReplicationApplied(uint64_t sequence);
+
+    /*! Durably records that an Asset, already stored here along with any AssetData chunks, is waiting to be uploaded
+     * to the server. Entries stay until removed with removeUpstream(), including across restarts.
+     *
+     * \param key The key of the Asset.
+     * \param flatAsset The FlatAsset record to upload, kept with the entry so that it is uploaded as added even if
+     *                  a later Asset deprecates it.
+     * \return The token of the new entry, which orders entries by when they were added, or 0 on error.
+     */
+    uint64_t enqueueUpstream(uint64_t key, const SizedPointer& flatAsset);
+
+    /*! Loads every Asset waiting to be uploaded to the server, oldest first.
+     *
+     * \return The waiting entries.
+     */
+    std::vector<UpstreamEntry> loadUpstreamQueue();
+
+    /*! Removes an entry added with enqueueUpstream(), once the server has acknowledged the upload.
+     *
+     * \param token The token of the entry.
+     * \param key The key of the Asset.
+     * \return true on success, false on error.
+     */
+    bool removeUpstream(uint64_t token, uint64_t key);
+
+    /*! Writes a consistent copy of every entry in the database, and the contents of every stored chunk, to a new
+     * PackFile in sorted order. Upstream queue and replication log entries belong to this database alone and are left
+     * out, but the replication log sequence number is kept in the pack, so a follower imported from a pack of the
+     * leader can tail the leader log from where the pack left off.
+     *
+     * \param path The path of the pack file to create.
+     * \return true on success, false on error.
+     */
+    bool exportPack(const std::string& path);
+
+    /*! Loads a pack file written by exportPack() in to this database, which must not yet hold any Assets or chunks.
+     * Entries are written in large batches without syncing until the end, so this is limited by disk speed.
+     *
+     * \param path The path of the pack file to load.
+     * \return true on success, false on error or if the pack is corrupt, in which case the database should be deleted.
+     */
+    bool importPack(const std::string& path);
+
+    /*! Finds Assets and Lists by name, ignoring case and punctuation. Names with a word starting with the query come
+     * first, followed by names spelled similarly to the query, best match first. Deprecated Assets are left out.
+     *
+     * \param query The text to search for.
+     * \param limit The maximum number of results to return.
+     * \return Up to limit matching Assets and Lists.
+     */
+    std::vector<SearchResult> searchNames(const std::string& query, size_t limit);
+
     /// @cond UNDOCUMENTED
     AssetDatabase(const AssetDatabase&) = delete;
     AssetDatabase& operator=(const AssetDatabase&) = delete;
     /// @endcond UNDOCUMENTED
 
 private:
+    // A change to the key layout or value formats, applied a batch of keys at a time.
+    struct Migration {
+        // The schema version of the database once the migration is complete.
+        uint64_t version;
+        const char* description;
+        // If false the migration runs synchronously from open(), for changes reads can't follow across both layouts.
+        bool background;
+        // Adds the changes for the next batch of keys from position on to batch, and to dataBatch for the data
+        // database, advances position past them, and sets examinedOut to the number of keys examined, which is 0 once
+        // there are none left. Returns false on error.
+        bool (AssetDatabase::*step)(std::string& position, leveldb::WriteBatch& batch, leveldb::WriteBatch& dataBatch,
+            size_t& examinedOut);
+        // Called once the migration is complete, or nullptr.
+        void (AssetDatabase::*finish)();
+    };
+
+    // Every migration, in order of version.
+    static const std::vector<Migration>& migrations();
+    // Reads the schema version in to m_schemaVersion, recording it first for new databases and those from before
+    // versions were recorded, and moves any config left under its legacy key. Returns false on error or if the
+    // database is newer than this confab.
+    bool loadSchemaVersion(bool createNew);
+    // Runs the migrations after m_schemaVersion in order, resuming any interrupted one from its recorded progress.
+    // Stops before the first background migration unless background is true. Returns false on error or if stopped.
+    bool runMigrations(bool background);
+    // Sleeps as needed to keep to m_migrationKeysPerSecond after examining another batch of keys. Returns false if
+    // migration should stop.
+    bool throttleMigration(size_t examined, std::chrono::steady_clock::time_point start);
+    // True while AssetData entries may still be in m_database, so reads must look there as well.
+    bool legacyAssetData() const;
+    // Shared implementation of storeAsset() and applyReplicationEntry(), with the timestamp of List and index entries.
+    bool storeAssetAt(uint64_t key, const SizedPointer& assetData, uint64_t timeStamp);
+    // Shared implementation of addListItem() and applyReplicationEntry(), with the timestamp of the List entry.
+    bool addListItemAt(uint64_t listKey, uint64_t assetKey, uint64_t timeStamp);
+    // Writes batch to m_database, first adding a replication log entry for the write to it if logging is enabled.
+    leveldb::Status writeLogged(leveldb::WriteBatch& batch, ReplicationOp op, uint64_t key, uint64_t argument,
+        const SizedPointer& record);
+    // Deletes all but the most recent options.replicationLogRetain replication log entries, for collectGarbage().
+    void collectReplicationLog(const GarbageCollectionOptions& options, GarbageCollectionStats& stats);
+    // Returns the FlatAssetData record refers to, if it holds a chunk reference or blob location, or record itself if
+    // it holds a FlatAssetData.
+    RecordPtr resolveAssetData(RecordPtr record);
+    // Returns the FlatAssetData an AssetData value refers to, an empty Record if it can't be read, or nullptr if value
+    // is itself a FlatAssetData.
+    RecordPtr loadChunkBlob(const SizedPointer& value);
+    // Returns the type of a stored Asset, or kInvalid if it isn't found, for choosing how to compress its chunks.
+    uint32_t storedAssetType(uint64_t key);
+    // Keeps chunk as an example for training a compression dictionary for type, starting m_dictionaryThread to train
+    // and store the dictionary once enough examples have been kept.
+    void sampleChunkForDictionary(uint32_t type, const SizedPointer& chunk);
+    // Trains a dictionary for type from samples, then stores it and adds it to m_chunkCodec. Run on
+    // m_dictionaryThread.
+    void trainChunkDictionary(uint32_t type, std::vector<std::string> samples);
+    // Adds every stored compression dictionary to m_chunkCodec, run synchronously from open().
+    void loadChunkDictionaries();
+    // Adds a decrement of the reference count of a chunk content entry by count to batch, or its deletion if no
+    // references remain. Requires m_chunkMutex to be held until batch is written.
+    bool releaseChunkContent(const char* contentKey, uint64_t count, leveldb::WriteBatch& batch);
+    // Migration step moving AssetData entries written by older versions from m_database to m_dataDatabase, re-keying
+    // any with host byte order chunk numbers, and skipping any chunks stored again since. Requires m_chunkMutex to be
+    // held until dataBatch is written.
+    bool migrateAssetData(std::string& position, leveldb::WriteBatch& batch, leveldb::WriteBatch& dataBatch,
+        size_t& examinedOut);
+    // Reclaims the space AssetData entries used in m_database once migrateAssetData() is complete.
+    void finishAssetDataMigration();
+    // Adds chain head index entries to batch for every ancestor of key, following deprecates links back from
+    // deprecates, and appends each ancestor to ancestorsOut. Requires m_chainMutex to be held until batch is written.
+    void addChainHeads(uint64_t key, uint64_t deprecates, leveldb::WriteBatch& batch,
+        std::vector<uint64_t>& ancestorsOut);
+    // Shared implementation of getTypeNext() and getAuthorNext(), over the index entries starting with prefix.
+    size_t getIndexNext(const std::string& prefix, uint64_t fromToken, size_t maxPairs, uint64_t* pairsOut);
+    // Shared implementation of getTypeRange(), and of getIndexNext() without the end sentinel.
+    size_t getIndexRange(const std::string& prefix, uint64_t fromTime, uint64_t toTime, size_t maxPairs,
+        uint64_t* pairsOut);
+    // Migration step re-keying List entries written with host byte order timestamps.
+    bool migrateListEntries(std::string& position, leveldb::WriteBatch& batch, leveldb::WriteBatch& dataBatch,
+        size_t& examinedOut);
+    // Migration step adding name search entries for every name stored before they were indexed.
+    bool buildNameSearchIndex(std::string& position, leveldb::WriteBatch& batch, leveldb::WriteBatch& dataBatch,
+        size_t& examinedOut);
+    // Deletes deprecated Assets past the retained versions of each chain, and incomplete uploads, for collectGarbage().
+    void collectAssets(const GarbageCollectionOptions& options, GarbageCollectionStats& stats);
+    // Adds deletion of every Asset more than retainDeprecated versions back from head to batch, following deprecates
+    // links back from deprecates, and adds each deleted Asset key and its size in bytes to prunedOut.
+    void pruneChain(uint64_t head, uint64_t deprecates, size_t retainDeprecated, leveldb::WriteBatch& batch,
+        std::map<uint64_t, size_t>& prunedOut);
+    // Deletes AssetData chunks with no Asset, for collectGarbage().
+    void collectOrphanedAssetData(const GarbageCollectionOptions& options, GarbageCollectionStats& stats);
+    // Deletes name and search entries that don't find an Asset or List, and leftover legacy keys, for
+    // collectGarbage().
+    void collectStaleKeys(const GarbageCollectionOptions& options, GarbageCollectionStats& stats);
+    // Returns true if key was also a candidate for deletion in an earlier pass, at least the grace period ago, and
+    // remembers it as a candidate for the next pass otherwise.
+    bool abandonedPastGrace(uint64_t key, const GarbageCollectionOptions& options);
+    // Sleeps as needed to keep to options.keysPerSecond after examining another batch of keys. Returns false if
+    // garbage collection should stop.
+    bool throttleGarbageCollection(const GarbageCollectionOptions& options, size_t examined,
+        std::chrono::steady_clock::time_point start);
+    // Loop of m_garbageCollectionThread.
+    void runGarbageCollection(GarbageCollectionOptions options, std::chrono::seconds interval);
+    // Outcome of scrubAsset().
+    enum ScrubResult {
+        kScrubIntact,
+        kScrubIncomplete,
+        kScrubCorrupt,
+        kScrubStopped
+    };
+    // Checks the chunks of Asset key against their hashes for scrub(), setting badChunkOut to the chunk that failed.
+    ScrubResult scrubAsset(uint64_t key, uint64_t chunks, const ScrubOptions& options,
+        std::chrono::steady_clock::time_point start, ScrubStats& stats, uint64_t& badChunkOut);
+    // Sleeps as needed to keep to options.bytesPerSecond after checking another chunk. Returns false if scrubbing
+    // should stop.
+    bool throttleScrub(const ScrubOptions& options, size_t bytes, std::chrono::steady_clock::time_point start);
+    // Loop of m_scrubThread.
+    void runScrubbing(ScrubOptions options, std::chrono::seconds interval);
+    // Reads every quarantine entry in to m_quarantined, run synchronously from open().
+    void loadQuarantine();
+    // Records key as quarantined, returning false on error or if it already was.
+    bool quarantine(uint64_t key, uint64_t badChunk);
+    // Deletes the quarantine entry of key, returning false on error.
+    bool releaseQuarantine(uint64_t key);
+    // Deletes the quarantine entries of Assets that no longer exist, returning the number deleted.
+    size_t collectQuarantine();
+
+    std::unique_ptr<leveldb::Cache> m_metadataCache;
+    std::unique_ptr<leveldb::Cache> m_dataCache;
     std::unique_ptr<leveldb::DB> m_database;
+    std::unique_ptr<leveldb::DB> m_dataDatabase;
+    std::unique_ptr<BlobStore> m_blobStore;
+    std::unique_ptr<AssetCache> m_assetCache;
+    std::unique_ptr<ChunkCodec> m_chunkCodec;
+    std::atomic<uint64_t> m_chunkBytesBeforeCompression;
+    std::atomic<uint64_t> m_chunkBytesAfterCompression;
+    // Guards the dictionary training samples, and m_dictionaryTraining.
+    std::mutex m_dictionaryMutex;
+    std::map<uint32_t, std::vector<std::string>> m_dictionarySamples;
+    std::map<uint32_t, size_t> m_dictionarySampleBytes;
+    // True while m_dictionaryThread is training, which it does for one type at a time.
+    bool m_dictionaryTraining;
+    std::thread m_dictionaryThread;
+    std::atomic<uint64_t> m_schemaVersion;
+    std::atomic<size_t> m_migrationKeysPerSecond;
+    std::atomic<bool> m_quitMigration;
+    std::mutex m_migrationWaitMutex;
+    std::condition_variable m_migrationWait;
+    std::thread m_migrationThread;
+    // Serializes the read-modify-write of chain head index entries between stores of deprecating Assets.
+    std::mutex m_chainMutex;
+    // Serializes the read-modify-write of chunk content reference counts.
+    std::mutex m_chunkMutex;
+    // Held for the duration of a garbage collection pass, and guards the candidate maps.
+    std::mutex m_garbageCollectionMutex;
+    // Keys found abandoned by the last pass, with the time they were first found.
+    std::map<uint64_t, std::chrono::steady_clock::time_point> m_abandonedCandidates;
+    std::map<uint64_t, std::chrono::steady_clock::time_point> m_nextAbandonedCandidates;
+    std::atomic<bool> m_quitGarbageCollection;
+    std::mutex m_garbageCollectionWaitMutex;
+    std::condition_variable m_garbageCollectionWait;
+    std::thread m_garbageCollectionThread;
+    // Held for the duration of a scrub pass.
+    std::mutex m_scrubMutex;
+    std::atomic<bool> m_quitScrub;
+    std::mutex m_scrubWaitMutex;
+    std::condition_variable m_scrubWait;
+    std::thread m_scrubThread;
+    // Guards the set of quarantined Asset keys, which mirrors the quarantine entries in the database.
+    std::mutex m_quarantineMutex;
+    std::set<uint64_t> m_quarantined;
+    std::atomic<bool> m_replicationLogging;
+    // Held from choosing the next replication log sequence number until the entry is written, so entries are written
+    // in order with no gaps.
+    std::mutex m_replicationMutex;
+    std::atomic<uint64_t> m_replicationSequence;
 };
 
 }  // namespace Confab
@@ -0,0 +1,565 @@
+#include "AssetDatabase.hpp"
+
+#include "Asset.hpp"
+#include "Constants.hpp"
+#include "schemas/FlatAssetData_generated.h"
+
+#include "leveldb/db.h"
+#include "xxhash.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <experimental/filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace fs = std::experimental::filesystem;
+
+namespace {
+
+/*! The List every test Asset is added to, as storeAsset() expects each Asset to be in at least one List.
+ */
+static const uint64_t kTestList = 0x1157;
+
+// The data database and blob store are kept beside the metadata database, in directories named after it.
+void removeDatabase(const fs::path& path) {
+    fs::remove_all(path);
+    fs::remove_all(path.string() + "-data");
+    fs::remove_all(path.string() + "-blobs");
+}
+
+fs::path makeEmptyDatabase(const char* name) {
+    fs::path path = fs::temp_directory_path() / name;
+    removeDatabase(path);
+    return path;
+}
+
+Confab::SizedPointer pointer(const std::string& value) {
+    return Confab::SizedPointer(value.data(), value.size());
+}
+
+// The hash of the Asset data up to the end of each chunk, as clients upload them. The last is the Asset key.
+std::vector<uint64_t> runningHashes(const std::vector<std::string>& chunks) {
+    std::vector<uint64_t> hashes;
+    XXH64_state_t* hashState = XXH64_createState();
+    XXH64_reset(hashState, 0);
+    for (const auto& chunk : chunks) {
+        XXH64_update(hashState, chunk.data(), chunk.size());
+        hashes.push_back(XXH64_digest(hashState));
+    }
+    XXH64_freeState(hashState);
+    return hashes;
+}
+
+std::string flatAssetData(const std::string& contents, uint64_t hash) {
+    flatbuffers::FlatBufferBuilder builder;
+    auto data = builder.CreateVector(reinterpret_cast<const uint8_t*>(contents.data()), contents.size());
+    Confab::Data::FlatAssetDataBuilder assetDataBuilder(builder);
+    assetDataBuilder.add_data(data);
+    assetDataBuilder.add_hash(hash);
+    builder.Finish(assetDataBuilder.Finish());
+    return std::string(reinterpret_cast<const char*>(builder.GetBufferPointer()), builder.GetSize());
+}
+
+// Sample Assets are used throughout, as their chunks are stored uncompressed. The chunk count is set the way
+// HttpClient and UpstreamQueue set it for file Assets, which is one more than stored when the size is a multiple of
+// kDataChunkSize, so Assets of more than one chunk must have all but their last chunk kDataChunkSize long.
+std::string flatAsset(uint64_t key, const std::vector<std::string>& chunks, uint64_t deprecates = 0) {
+    Confab::Asset asset(Confab::Asset::kSample);
+    asset.setKey(key);
+    size_t size = 0;
+    for (const auto& chunk : chunks) {
+        size += chunk.size();
+    }
+    asset.setSize(size);
+    asset.setChunks((size / Confab::kDataChunkSize) + 1);
+    asset.setDeprecates(deprecates);
+    asset.addToList(kTestList);
+    flatbuffers::FlatBufferBuilder builder;
+    asset.flatten(builder);
+    return std::string(reinterpret_cast<const char*>(builder.GetBufferPointer()), builder.GetSize());
+}
+
+void storeChunks(Confab::AssetDatabase& database, uint64_t key, const std::vector<std::string>& chunks) {
+    std::vector<uint64_t> hashes = runningHashes(chunks);
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        EXPECT_TRUE(database.storeAssetDataChunk(key, i, pointer(flatAssetData(chunks[i], hashes[i]))));
+    }
+}
+
+// Stores an Asset and then its chunks, as clients upload them, and returns its key.
+uint64_t storeAsset(Confab::AssetDatabase& database, const std::vector<std::string>& chunks,
+        uint64_t deprecates = 0) {
+    uint64_t key = runningHashes(chunks).back();
+    EXPECT_TRUE(database.storeAsset(key, pointer(flatAsset(key, chunks, deprecates))));
+    storeChunks(database, key, chunks);
+    return key;
+}
+
+std::string chunkContents(const Confab::RecordPtr& record) {
+    if (record->empty()) {
+        return std::string();
+    }
+    auto data = Confab::Data::GetFlatAssetData(record->data().data())->data();
+    return data ? std::string(reinterpret_cast<const char*>(data->data()), data->size()) : std::string();
+}
+
+uint64_t chunkHash(const Confab::RecordPtr& record) {
+    return record->empty() ? 0 : Confab::Data::GetFlatAssetData(record->data().data())->hash();
+}
+
+// Counts the keys in the LevelDB database at path that start with prefix and are keySize long.
+size_t countKeys(const std::string& path, char prefix, size_t keySize) {
+    leveldb::DB* database = nullptr;
+    if (!leveldb::DB::Open(leveldb::Options(), path, &database).ok()) {
+        return 0;
+    }
+    std::unique_ptr<leveldb::DB> owner(database);
+    std::unique_ptr<leveldb::Iterator> iterator(database->NewIterator(leveldb::ReadOptions()));
+    size_t count = 0;
+    for (iterator->Seek(leveldb::Slice(&prefix, 1)); iterator->Valid() && iterator->key()[0] == prefix;
+            iterator->Next()) {
+        if (iterator->key().size() == keySize) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+// Flips a bit in the first byte of contents where it is stored in the first blob segment, without touching the blob
+// header, so the blob still reads but fails its hash check. Flipping it again restores the contents.
+void flipStoredContents(const fs::path& path, const std::string& contents) {
+    std::string segmentPath = path.string() + "-blobs/00000000.seg";
+    std::fstream segment(segmentPath, std::ios::in | std::ios::out | std::ios::binary);
+    ASSERT_TRUE(segment.good());
+    // The test blobs are all near the start of the segment, which is otherwise empty.
+    std::string stored(64 * 1024, '\0');
+    segment.read(&stored[0], stored.size());
+    size_t offset = stored.find(contents);
+    ASSERT_NE(std::string::npos, offset);
+    segment.clear();
+    segment.seekp(offset);
+    segment.put(contents[0] ^ 1);
+}
+
+// Garbage collection without throttling or a grace period, so that abandoned data goes on the second pass.
+Confab::AssetDatabase::GarbageCollectionOptions testCollectionOptions() {
+    Confab::AssetDatabase::GarbageCollectionOptions options;
+    options.keysPerSecond = 0;
+    options.abandonedGracePeriod = std::chrono::seconds(0);
+    return options;
+}
+
+std::string bigEndian64(uint64_t value) {
+    std::string encoded(sizeof(uint64_t), '\0');
+    for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+        encoded[i] = static_cast<char>(value >> (56 - (8 * i)));
+    }
+    return encoded;
+}
+
+}  // namespace
+
+TEST(AssetDatabaseTest, StoresAssetDataInDataDatabase) {
+    fs::path path = makeEmptyDatabase("AssetDatabase_test_data_database");
+    std::vector<std::string> chunks = { std::string(Confab::kDataChunkSize, 'f'), "last chunk of the Asset" };
+    std::vector<uint64_t> hashes = runningHashes(chunks);
+    uint64_t key = 0;
+    {
+        Confab::AssetDatabase database;
+        ASSERT_TRUE(database.open(path.c_str(), true, 0, 0, 0));
+        EXPECT_EQ(Confab::AssetDatabase::kSchemaVersion, database.schemaVersion());
+        key = storeAsset(database, chunks);
+        EXPECT_EQ(chunks[1], chunkContents(database.loadAssetDataChunk(key, 1)));
+        database.close();
+    }
+
+    // The AssetData entries are all in the data database, none in the metadata database.
+    EXPECT_EQ(0, countKeys(path.string(), 'c', 17));
+    EXPECT_EQ(2, countKeys(path.string() + "-data", 'c', 17));
+
+    Confab::AssetDatabase database;
+    ASSERT_TRUE(database.open(path.c_str(), false, 0, 0, 0));
+    ASSERT_FALSE(database.findAsset(key)->empty());
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        auto record = database.loadAssetDataChunk(key, i);
+        EXPECT_EQ(chunks[i], chunkContents(record));
+        EXPECT_EQ(hashes[i], chunkHash(record));
+    }
+
+    std::vector<uint64_t> visited;
+    EXPECT_EQ(2, database.loadAssetDataRange(key, 0, 3, [&visited](uint64_t chunk, const Confab::SizedPointer&) {
+        visited.push_back(chunk);
+        return true;
+    }));
+    EXPECT_EQ(std::vector<uint64_t>({ 0, 1 }), visited);
+
+    auto records = database.loadAssetDataChunks({ { key, 1 }, { key, 2 }, { key, 0 } });
+    ASSERT_EQ(3, records.size());
+    EXPECT_EQ(chunks[1], chunkContents(records[0]));
+    EXPECT_TRUE(records[1]->empty());
+    EXPECT_EQ(chunks[0], chunkContents(records[2]));
+
+    database.close();
+    removeDatabase(path);
+}
+
+TEST(AssetDatabaseTest, SharesIdenticalChunkContents) {
+    fs::path path = makeEmptyDatabase("AssetDatabase_test_shared_contents");
+    Confab::AssetDatabase database;
+    ASSERT_TRUE(database.open(path.c_str(), true, 0, 0, 0));
+
+    // The shared contents follow different chunks, so each Asset has a different hash for them.
+    std::string shared("chunk contents shared by both Assets");
+    std::vector<std::string> firstChunks = { std::string(Confab::kDataChunkSize, '1'), shared };
+    std::vector<std::string> secondChunks = { std::string(Confab::kDataChunkSize, '2'), shared };
+    std::vector<uint64_t> secondHashes = runningHashes(secondChunks);
+    uint64_t first = storeAsset(database, firstChunks);
+    uint64_t bytesBefore = database.chunkBytesBeforeCompression();
+    uint64_t second = storeAsset(database, secondChunks);
+    EXPECT_EQ(bytesBefore + flatAssetData(secondChunks[0], secondHashes[0]).size(),
+        database.chunkBytesBeforeCompression());
+
+    auto firstRecord = database.loadAssetDataChunk(first, 1);
+    auto secondRecord = database.loadAssetDataChunk(second, 1);
+    EXPECT_EQ(shared, chunkContents(firstRecord));
+    EXPECT_EQ(shared, chunkContents(secondRecord));
+    EXPECT_EQ(runningHashes(firstChunks)[1], chunkHash(firstRecord));
+    EXPECT_EQ(secondHashes[1], chunkHash(secondRecord));
+
+    // Uploading a chunk again stores nothing new, and adds no reference.
+    bytesBefore = database.chunkBytesBeforeCompression();
+    EXPECT_TRUE(database.storeAssetDataChunk(second, 1, pointer(flatAssetData(shared, secondHashes[1]))));
+    EXPECT_EQ(bytesBefore, database.chunkBytesBeforeCompression());
+
+    // The shared contents outlive the first Asset releasing them, but not the second.
+    EXPECT_EQ(2, database.releaseAssetData(first));
+    EXPECT_TRUE(database.loadAssetDataChunk(first, 1)->empty());
+    EXPECT_EQ(shared, chunkContents(database.loadAssetDataChunk(second, 1)));
+    EXPECT_EQ(2, database.releaseAssetData(second));
+    EXPECT_TRUE(database.loadAssetDataChunk(second, 1)->empty());
+
+    bytesBefore = database.chunkBytesBeforeCompression();
+    uint64_t third = storeAsset(database, { shared });
+    EXPECT_EQ(bytesBefore + flatAssetData(shared, third).size(), database.chunkBytesBeforeCompression());
+
+    database.close();
+    removeDatabase(path);
+}
+
+TEST(AssetDatabaseTest, ReplacedChunkReleasesContents) {
+    fs::path path = makeEmptyDatabase("AssetDatabase_test_replaced_chunk");
+    Confab::AssetDatabase database;
+    ASSERT_TRUE(database.open(path.c_str(), true, 0, 0, 0));
+
+    std::string oldContents("contents first stored for the chunk");
+    std::string newContents("contents that replace them");
+    EXPECT_TRUE(database.storeAssetDataChunk(0x1234, 0, pointer(flatAssetData(oldContents, 1))));
+    EXPECT_TRUE(database.storeAssetDataChunk(0x1234, 0, pointer(flatAssetData(newContents, 2))));
+    EXPECT_EQ(newContents, chunkContents(database.loadAssetDataChunk(0x1234, 0)));
+
+    // The old contents lost their only reference, so are stored again.
+    uint64_t bytesBefore = database.chunkBytesBeforeCompression();
+    EXPECT_TRUE(database.storeAssetDataChunk(0x5678, 0, pointer(flatAssetData(oldContents, 1))));
+    EXPECT_EQ(bytesBefore + flatAssetData(oldContents, 1).size(), database.chunkBytesBeforeCompression());
+
+    database.close();
+    removeDatabase(path);
+}
+
+TEST(AssetDatabaseTest, DifferentContentsUnderSameContentKeyAreNotShared) {
+    fs::path path = makeEmptyDatabase("AssetDatabase_test_content_collision");
+    std::string contents("contents found different under their content key");
+    uint64_t damaged = 0;
+    {
+        Confab::AssetDatabase database;
+        ASSERT_TRUE(database.open(path.c_str(), true, 0, 0, 0));
+        damaged = storeAsset(database, { contents });
+        database.close();
+    }
+
+    // Changing the stored contents leaves them under the content key of the original contents, which is as close to
+    // a hash collision as a test can get.
+    flipStoredContents(path, contents);
+    Confab::AssetDatabase database;
+    ASSERT_TRUE(database.open(path.c_str(), false, 0, 0, 0));
+    EXPECT_NE(contents, chunkContents(database.loadAssetDataChunk(damaged, 0)));
+
+    std::vector<std::string> chunks = { std::string(Confab::kDataChunkSize, 'c'), contents };
+    uint64_t bytesBefore = database.chunkBytesBeforeCompression();
+    uint64_t key = storeAsset(database, chunks);
+    uint64_t bytesAfter = database.chunkBytesBeforeCompression();
+    EXPECT_EQ(bytesBefore + flatAssetData(chunks[0], runningHashes(chunks)[0]).size() +
+        flatAssetData(contents, key).size(), bytesAfter);
+    EXPECT_EQ(contents, chunkContents(database.loadAssetDataChunk(key, 1)));
+    EXPECT_NE(contents, chunkContents(database.loadAssetDataChunk(damaged, 0)));
+
+    // Later chunks with the same contents find and share them past the different contents.
+    EXPECT_TRUE(database.storeAssetDataChunk(0x5678, 0, pointer(flatAssetData(contents, 1))));
+    EXPECT_EQ(bytesAfter, database.chunkBytesBeforeCompression());
+    EXPECT_EQ(contents, chunkContents(database.loadAssetDataChunk(0x5678, 0)));
+
+    database.close();
+    removeDatabase(path);
+}
+
+TEST(AssetDatabaseTest, CollectsOrphanedAssetData) {
+    fs::path path = makeEmptyDatabase("AssetDatabase_test_orphaned_data");
+    Confab::AssetDatabase database;
+    ASSERT_TRUE(database.open(path.c_str(), true, 0, 0, 0));
+
+    std::vector<std::string> orphanChunks = { "chunk uploaded for an Asset", "that was never stored" };
+    uint64_t orphan = runningHashes(orphanChunks).back();
+    storeChunks(database, orphan, orphanChunks);
+    uint64_t kept = storeAsset(database, { "chunk of a stored Asset" });
+
+    // Orphans are first noticed, then deleted by the next pass past the grace period.
+    auto options = testCollectionOptions();
+    EXPECT_EQ(0, database.collectGarbage(options).orphanedAssetData);
+    EXPECT_FALSE(database.loadAssetDataChunk(orphan, 0)->empty());
+    EXPECT_EQ(2, database.collectGarbage(options).orphanedAssetData);
+    EXPECT_TRUE(database.loadAssetDataChunk(orphan, 0)->empty());
+    EXPECT_TRUE(database.loadAssetDataChunk(orphan, 1)->empty());
+    EXPECT_FALSE(database.loadAssetDataChunk(kept, 0)->empty());
+    EXPECT_EQ(0, database.collectGarbage(options).orphanedAssetData);
+
+    database.close();
+    removeDatabase(path);
+}
+
+TEST(AssetDatabaseTest, CollectsIncompleteAssetsOnlyIfEnabled) {
+    fs::path path = makeEmptyDatabase("AssetDatabase_test_incomplete_assets");
+    Confab::AssetDatabase database;
+    ASSERT_TRUE(database.open(path.c_str(), true, 0, 0, 0));
+
+    std::vector<std::string> chunks = { std::string(Confab::kDataChunkSize, 'u'), "last chunk, never uploaded" };
+    uint64_t key = runningHashes(chunks).back();
+    ASSERT_TRUE(database.storeAsset(key, pointer(flatAsset(key, chunks))));
+    ASSERT_TRUE(database.storeAssetDataChunk(key, 0, pointer(flatAssetData(chunks[0], runningHashes(chunks)[0]))));
+
+    // Clients cache Assets a chunk at a time, so by default incomplete Assets are kept.
+    auto options = testCollectionOptions();
+    EXPECT_EQ(0, database.collectGarbage(options).incompleteAssets);
+    EXPECT_EQ(0, database.collectGarbage(options).incompleteAssets);
+    EXPECT_FALSE(database.findAsset(key)->empty());
+
+    options.deleteIncompleteAssets = true;
+    EXPECT_EQ(0, database.collectGarbage(options).incompleteAssets);
+    EXPECT_FALSE(database.findAsset(key)->empty());
+    EXPECT_EQ(1, database.collectGarbage(options).incompleteAssets);
+    EXPECT_TRUE(database.findAsset(key)->empty());
+    EXPECT_TRUE(database.loadAssetDataChunk(key, 0)->empty());
+
+    database.close();
+    removeDatabase(path);
+}
+
+TEST(AssetDatabaseTest, KeepsAssetsOfWholeChunksComplete) {
+    fs::path path = makeEmptyDatabase("AssetDatabase_test_whole_chunks");
+    Confab::AssetDatabase database;
+    ASSERT_TRUE(database.open(path.c_str(), true, 0, 0, 0));
+
+    // A file of exactly one chunk, and an empty file, both have a chunk count of one more than their stored chunks.
+    uint64_t wholeChunk = storeAsset(database, { std::string(Confab::kDataChunkSize, 'w') });
+    uint64_t empty = XXH64(nullptr, 0, 0);
+    ASSERT_TRUE(database.storeAsset(empty, pointer(flatAsset(empty, {}))));
+
+    auto options = testCollectionOptions();
+    options.deleteIncompleteAssets = true;
+    EXPECT_EQ(0, database.collectGarbage(options).incompleteAssets);
+    EXPECT_EQ(0, database.collectGarbage(options).incompleteAssets);
+    EXPECT_FALSE(database.findAsset(wholeChunk)->empty());
+    EXPECT_FALSE(database.loadAssetDataChunk(wholeChunk, 0)->empty());
+    EXPECT_FALSE(database.findAsset(empty)->empty());
+
+    database.close();
+    removeDatabase(path);
+}
+
+TEST(AssetDatabaseTest, PrunesDeprecatedAssets) {
+    fs::path path = makeEmptyDatabase("AssetDatabase_test_deprecated_assets");
+    Confab::AssetDatabase database;
+    ASSERT_TRUE(database.open(path.c_str(), true, 0, 0, 0));
+
+    uint64_t oldest = storeAsset(database, { "first version" });
+    uint64_t middle = storeAsset(database, { "second version" }, oldest);
+    uint64_t newest = storeAsset(database, { "third version" }, middle);
+
+    auto options = testCollectionOptions();
+    options.retainDeprecated = 1;
+    EXPECT_EQ(1, database.collectGarbage(options).deprecatedAssets);
+    EXPECT_EQ(0, database.collectGarbage(options).deprecatedAssets);
+
+    // The pruned Asset is still found as the current version, but its data is gone.
+    auto found = database.findAsset(oldest);
+    ASSERT_FALSE(found->empty());
+    EXPECT_EQ(newest, Confab::Data::GetFlatAsset(found->data().data())->key());
+    EXPECT_TRUE(database.loadAssetDataChunk(oldest, 0)->empty());
+    EXPECT_EQ("second version", chunkContents(database.loadAssetDataChunk(middle, 0)));
+    EXPECT_EQ("third version", chunkContents(database.loadAssetDataChunk(newest, 0)));
+
+    database.close();
+    removeDatabase(path);
+}
+
+TEST(AssetDatabaseTest, ScrubQuarantinesDamagedAssets) {
+    fs::path path = makeEmptyDatabase("AssetDatabase_test_scrub");
+    std::vector<std::string> chunks = { std::string(Confab::kDataChunkSize, 's'), "last chunk of the scrubbed Asset" };
+    std::vector<std::string> incompleteChunks = {
+        std::string(Confab::kDataChunkSize, 'i'), "last chunk, never uploaded" };
+    Confab::AssetDatabase::ScrubOptions options;
+    options.bytesPerSecond = 0;
+    uint64_t key = 0;
+    uint64_t intact = 0;
+    {
+        Confab::AssetDatabase database;
+        ASSERT_TRUE(database.open(path.c_str(), true, 0, 0, 0));
+        key = storeAsset(database, chunks);
+        intact = storeAsset(database, { "chunk of an Asset left intact" });
+        uint64_t incomplete = runningHashes(incompleteChunks).back();
+        ASSERT_TRUE(database.storeAsset(incomplete, pointer(flatAsset(incomplete, incompleteChunks))));
+        ASSERT_TRUE(database.storeAssetDataChunk(incomplete, 0,
+            pointer(flatAssetData(incompleteChunks[0], runningHashes(incompleteChunks)[0]))));
+
+        // Incomplete Assets are counted, but left to garbage collection.
+        auto stats = database.scrub(options);
+        EXPECT_EQ(3, stats.assets);
+        EXPECT_EQ(4, stats.chunks);
+        EXPECT_EQ(1, stats.incompleteAssets);
+        EXPECT_EQ(0, stats.quarantinedAssets);
+        EXPECT_TRUE(database.quarantinedAssets().empty());
+        database.close();
+    }
+
+    flipStoredContents(path, chunks[1]);
+    {
+        Confab::AssetDatabase database;
+        ASSERT_TRUE(database.open(path.c_str(), false, 0, 0, 0));
+        EXPECT_EQ(1, database.scrub(options).quarantinedAssets);
+        EXPECT_TRUE(database.isQuarantined(key));
+        EXPECT_FALSE(database.isQuarantined(intact));
+        EXPECT_EQ(std::vector<uint64_t>({ key }), database.quarantinedAssets());
+
+        // None of the data of a quarantined Asset is loaded, including its undamaged chunks.
+        EXPECT_TRUE(database.loadAssetDataChunk(key, 0)->empty());
+        EXPECT_EQ(0, database.loadAssetDataRange(key, 0, 2, [](uint64_t, const Confab::SizedPointer&) {
+            return true;
+        }));
+        EXPECT_TRUE(database.loadAssetDataChunks({ { key, 0 } })[0]->empty());
+        EXPECT_FALSE(database.loadAssetDataChunk(intact, 0)->empty());
+
+        // A second pass doesn't quarantine it again.
+        EXPECT_EQ(0, database.scrub(options).quarantinedAssets);
+        database.close();
+    }
+
+    // Quarantine is kept across restarts, until a pass finds the Asset intact again.
+    std::string damaged = chunks[1];
+    damaged[0] ^= 1;
+    flipStoredContents(path, damaged);
+    Confab::AssetDatabase database;
+    ASSERT_TRUE(database.open(path.c_str(), false, 0, 0, 0));
+    EXPECT_TRUE(database.isQuarantined(key));
+    EXPECT_EQ(1, database.scrub(options).restoredAssets);
+    EXPECT_FALSE(database.isQuarantined(key));
+    EXPECT_EQ(chunks[1], chunkContents(database.loadAssetDataChunk(key, 1)));
+
+    database.close();
+    removeDatabase(path);
+}
+
+TEST(AssetDatabaseTest, MigratesAssetDataAlongsideStores) {
+    fs::path path = makeEmptyDatabase("AssetDatabase_test_migration");
+    // Enough chunks for the throttled migration to take several batches, so that it runs alongside the stores below.
+    const size_t kLegacyAssets = 2048;
+    std::vector<std::string> contents;
+    std::vector<uint64_t> keys;
+    {
+        // A database from before AssetData moved to the data database, with its config under the oldest key.
+        leveldb::Options options;
+        options.create_if_missing = true;
+        leveldb::DB* legacy = nullptr;
+        ASSERT_TRUE(leveldb::DB::Open(options, path.string(), &legacy).ok());
+        std::unique_ptr<leveldb::DB> owner(legacy);
+        ASSERT_TRUE(legacy->Put(leveldb::WriteOptions(), "mSchemaVersion", bigEndian64(2)).ok());
+        ASSERT_TRUE(legacy->Put(leveldb::WriteOptions(), "confab-db-config", "legacy config").ok());
+        for (size_t i = 0; i < kLegacyAssets; ++i) {
+            contents.push_back("legacy chunk " + std::to_string(i));
+            keys.push_back(runningHashes({ contents.back() }).back());
+            // Legacy AssetData keys have the chunk number in host byte order.
+            uint64_t chunk = 0;
+            std::string legacyKey(1, 'd');
+            legacyKey.append(reinterpret_cast<const char*>(&keys.back()), sizeof(uint64_t));
+            legacyKey.append(reinterpret_cast<const char*>(&chunk), sizeof(uint64_t));
+            std::string legacyValue = flatAssetData(contents.back(), keys.back());
+            ASSERT_TRUE(legacy->Put(leveldb::WriteOptions(), legacyKey, legacyValue).ok());
+        }
+    }
+
+    Confab::AssetDatabase database;
+    database.setMigrationKeysPerSecond(4096);
+    ASSERT_TRUE(database.open(path.c_str(), false, 0, 0, 0));
+    auto config = database.loadConfig();
+    ASSERT_FALSE(config->empty());
+    EXPECT_EQ("legacy config", std::string(config->data().dataChar(), config->data().size()));
+
+    // Chunks load whether or not the migration has reached them yet, and can be stored again meanwhile.
+    for (size_t i = 0; i < kLegacyAssets; i += 2) {
+        EXPECT_EQ(contents[i], chunkContents(database.loadAssetDataChunk(keys[i], 0)));
+        storeChunks(database, keys[i], { contents[i] });
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    while (database.schemaVersion() < Confab::AssetDatabase::kSchemaVersion &&
+            std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(Confab::AssetDatabase::kSchemaVersion, database.schemaVersion());
+    for (size_t i = 0; i < kLegacyAssets; ++i) {
+        EXPECT_EQ(contents[i], chunkContents(database.loadAssetDataChunk(keys[i], 0)));
+    }
+
+    // Every chunk stored again kept its reference, whether stored before or after the migration reached it, so
+    // releasing them leaves their contents unreferenced, to be stored anew.
+    uint64_t expectedBytes = database.chunkBytesBeforeCompression();
+    for (size_t i = 0; i < kLegacyAssets; i += 2) {
+        EXPECT_EQ(1, database.releaseAssetData(keys[i]));
+        expectedBytes += flatAssetData(contents[i], keys[i]).size();
+    }
+    for (size_t i = 0; i < kLegacyAssets; i += 2) {
+        EXPECT_TRUE(database.storeAssetDataChunk(~keys[i], 0, pointer(flatAssetData(contents[i], keys[i]))));
+    }
+    EXPECT_EQ(expectedBytes, database.chunkBytesBeforeCompression());
+
+    database.close();
+    removeDatabase(path);
+}
+
+TEST(AssetDatabaseTest, ScrubFindsAssetsOfWholeChunksIntact) {
+    fs::path path = makeEmptyDatabase("AssetDatabase_test_scrub_whole_chunks");
+    Confab::AssetDatabase database;
+    ASSERT_TRUE(database.open(path.c_str(), true, 0, 0, 0));
+
+    // A file of exactly two chunks has a chunk count of three, and an empty file has no chunks to check.
+    uint64_t wholeChunks = storeAsset(database, {
+        std::string(Confab::kDataChunkSize, 'a'), std::string(Confab::kDataChunkSize, 'b') });
+    uint64_t empty = XXH64(nullptr, 0, 0);
+    ASSERT_TRUE(database.storeAsset(empty, pointer(flatAsset(empty, {}))));
+
+    Confab::AssetDatabase::ScrubOptions options;
+    options.bytesPerSecond = 0;
+    auto stats = database.scrub(options);
+    EXPECT_EQ(1, stats.assets);
+    EXPECT_EQ(2, stats.chunks);
+    EXPECT_EQ(0, stats.incompleteAssets);
+    EXPECT_EQ(0, stats.quarantinedAssets);
+    EXPECT_FALSE(database.isQuarantined(wholeChunks));
+
+    database.close();
+    removeDatabase(path);
+}
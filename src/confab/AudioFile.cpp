@@ -0,0 +1,345 @@
+#include "AudioFile.hpp"
+
+#include "glog/logging.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+/*! Number of frames to convert per read from the underlying file stream.
+ */
+static const size_t kReadFrames = 4096;
+
+/*! WAV format tags, from the fmt chunk or the first two bytes of the WAVE_FORMAT_EXTENSIBLE subformat GUID.
+ */
+static const uint16_t kWavFormatPcm = 0x0001;
+static const uint16_t kWavFormatFloat = 0x0003;
+static const uint16_t kWavFormatExtensible = 0xfffe;
+
+/*! Size in bytes of the header written by AudioFileWriter: the RIFF header, an 18-byte fmt chunk, a 4-byte fact chunk,
+ * and the data chunk header.
+ */
+static const size_t kFloatWavHeaderSize = 12 + (8 + 18) + (8 + 4) + 8;
+
+uint16_t readLittle16(const char* bytes) {
+    const uint8_t* b = reinterpret_cast<const uint8_t*>(bytes);
+    return b[0] | (b[1] << 8);
+}
+
+uint32_t readLittle32(const char* bytes) {
+    const uint8_t* b = reinterpret_cast<const uint8_t*>(bytes);
+    return b[0] | (b[1] << 8) | (b[2] << 16) | (static_cast<uint32_t>(b[3]) << 24);
+}
+
+uint16_t readBig16(const char* bytes) {
+    const uint8_t* b = reinterpret_cast<const uint8_t*>(bytes);
+    return (b[0] << 8) | b[1];
+}
+
+uint32_t readBig32(const char* bytes) {
+    const uint8_t* b = reinterpret_cast<const uint8_t*>(bytes);
+    return (static_cast<uint32_t>(b[0]) << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
+}
+
+void writeLittle16(uint16_t value, char* bytes) {
+    bytes[0] = value & 0xff;
+    bytes[1] = (value >> 8) & 0xff;
+}
+
+void writeLittle32(uint32_t value, char* bytes) {
+    bytes[0] = value & 0xff;
+    bytes[1] = (value >> 8) & 0xff;
+    bytes[2] = (value >> 16) & 0xff;
+    bytes[3] = (value >> 24) & 0xff;
+}
+
+// AIFF stores the sample rate as an 80-bit IEEE 754 extended precision float.
+double readExtended(const char* bytes) {
+    const uint8_t* b = reinterpret_cast<const uint8_t*>(bytes);
+    int exponent = ((b[0] & 0x7f) << 8) | b[1];
+    uint64_t mantissa = 0;
+    for (auto i = 0; i < 8; ++i) {
+        mantissa = (mantissa << 8) | b[2 + i];
+    }
+    if (exponent == 0 && mantissa == 0) {
+        return 0.0;
+    }
+    double value = std::ldexp(static_cast<double>(mantissa), exponent - 16383 - 63);
+    return (b[0] & 0x80) ? -value : value;
+}
+
+}  // namespace
+
+namespace Confab {
+
+AudioFileReader::AudioFileReader() :
+    m_channels(0),
+    m_sampleRate(0.0),
+    m_frames(0),
+    m_framesRead(0),
+    m_bytesPerSample(0),
+    m_encoding(kInteger),
+    m_bigEndian(false),
+    m_unsigned(false) {
+}
+
+bool AudioFileReader::open(const fs::path& path) {
+    m_file.open(path, std::ios::in | std::ios::binary);
+    if (!m_file) {
+        LOG(ERROR) << "error opening audio file " << path;
+        return false;
+    }
+
+    char header[12];
+    m_file.read(header, sizeof(header));
+    if (m_file.gcount() != sizeof(header)) {
+        LOG(ERROR) << "audio file " << path << " too short for header.";
+        return false;
+    }
+
+    bool ok = false;
+    if (std::memcmp(header, "RIFF", 4) == 0 && std::memcmp(header + 8, "WAVE", 4) == 0) {
+        ok = parseWav();
+    } else if (std::memcmp(header, "FORM", 4) == 0 &&
+        (std::memcmp(header + 8, "AIFF", 4) == 0 || std::memcmp(header + 8, "AIFC", 4) == 0)) {
+        ok = parseAiff();
+    } else {
+        LOG(ERROR) << "audio file " << path << " is not a WAV or AIFF file.";
+    }
+
+    if (!ok) {
+        LOG(ERROR) << "unable to parse audio file " << path;
+        return false;
+    }
+    if (m_channels <= 0 || m_sampleRate <= 0.0 || m_bytesPerSample <= 0 || m_bytesPerSample > 8 ||
+        (m_encoding == kFloat && m_bytesPerSample != 4 && m_bytesPerSample != 8)) {
+        LOG(ERROR) << "unsupported audio format in " << path << ", " << m_channels << " channels, " << m_sampleRate
+            << " Hz, " << m_bytesPerSample << " bytes per sample.";
+        return false;
+    }
+
+    m_framesRead = 0;
+    m_readBuffer.resize(kReadFrames * m_channels * m_bytesPerSample);
+    LOG(INFO) << "opened audio file " << path << ", " << m_channels << " channels, " << m_sampleRate << " Hz, "
+        << m_frames << " frames.";
+    return true;
+}
+
+size_t AudioFileReader::read(float* samplesOut, size_t frameCount) {
+    size_t totalFrames = 0;
+    while (totalFrames < frameCount && m_framesRead < m_frames && m_file) {
+        size_t frames = std::min(std::min(frameCount - totalFrames, kReadFrames),
+            static_cast<size_t>(m_frames - m_framesRead));
+        size_t frameBytes = m_channels * m_bytesPerSample;
+        m_file.read(m_readBuffer.data(), frames * frameBytes);
+        frames = m_file.gcount() / frameBytes;
+        if (frames == 0) {
+            break;
+        }
+
+        size_t samples = frames * m_channels;
+        const char* source = m_readBuffer.data();
+        float* target = samplesOut + (totalFrames * m_channels);
+        for (size_t i = 0; i < samples; ++i) {
+            // Assemble the sample as a big-endian integer in the top bytes of a 64-bit word, which sign-extends
+            // integer samples of every width with a single arithmetic shift.
+            uint64_t bits = 0;
+            for (auto j = 0; j < m_bytesPerSample; ++j) {
+                uint8_t byte = source[m_bigEndian ? j : m_bytesPerSample - 1 - j];
+                bits |= static_cast<uint64_t>(byte) << (56 - (8 * j));
+            }
+            source += m_bytesPerSample;
+
+            if (m_encoding == kFloat) {
+                if (m_bytesPerSample == 4) {
+                    uint32_t floatBits = static_cast<uint32_t>(bits >> 32);
+                    std::memcpy(target + i, &floatBits, sizeof(float));
+                } else {
+                    double value = 0.0;
+                    std::memcpy(&value, &bits, sizeof(double));
+                    target[i] = static_cast<float>(value);
+                }
+            } else {
+                if (m_unsigned) {
+                    bits ^= 0x8000000000000000ull;
+                }
+                target[i] = static_cast<float>(static_cast<int64_t>(bits) / 9223372036854775808.0);
+            }
+        }
+
+        totalFrames += frames;
+        m_framesRead += frames;
+    }
+    return totalFrames;
+}
+
+bool AudioFileReader::parseWav() {
+    bool foundFormat = false;
+    char chunkHeader[8];
+    while (m_file.read(chunkHeader, sizeof(chunkHeader))) {
+        uint32_t chunkSize = readLittle32(chunkHeader + 4);
+        if (std::memcmp(chunkHeader, "fmt ", 4) == 0) {
+            std::vector<char> format(chunkSize);
+            if (chunkSize < 16 || !m_file.read(format.data(), chunkSize)) {
+                return false;
+            }
+            uint16_t formatTag = readLittle16(format.data());
+            m_channels = readLittle16(format.data() + 2);
+            m_sampleRate = readLittle32(format.data() + 4);
+            m_bytesPerSample = readLittle16(format.data() + 14) / 8;
+            if (formatTag == kWavFormatExtensible && chunkSize >= 26) {
+                formatTag = readLittle16(format.data() + 24);
+            }
+            if (formatTag == kWavFormatPcm) {
+                m_encoding = kInteger;
+            } else if (formatTag == kWavFormatFloat) {
+                m_encoding = kFloat;
+            } else {
+                LOG(ERROR) << "unsupported WAV format tag " << formatTag;
+                return false;
+            }
+            m_bigEndian = false;
+            m_unsigned = m_bytesPerSample == 1;
+            foundFormat = true;
+            if (chunkSize & 1) {
+                m_file.seekg(1, std::ios::cur);
+            }
+        } else if (std::memcmp(chunkHeader, "data", 4) == 0) {
+            if (!foundFormat || m_channels <= 0 || m_bytesPerSample <= 0) {
+                LOG(ERROR) << "WAV data chunk found before valid fmt chunk.";
+                return false;
+            }
+            m_frames = chunkSize / (m_channels * m_bytesPerSample);
+            return true;
+        } else {
+            // Chunks are padded to an even number of bytes.
+            m_file.seekg(chunkSize + (chunkSize & 1), std::ios::cur);
+        }
+    }
+    return false;
+}
+
+bool AudioFileReader::parseAiff() {
+    bool foundCommon = false;
+    char chunkHeader[8];
+    while (m_file.read(chunkHeader, sizeof(chunkHeader))) {
+        uint32_t chunkSize = readBig32(chunkHeader + 4);
+        if (std::memcmp(chunkHeader, "COMM", 4) == 0) {
+            std::vector<char> common(chunkSize);
+            if (chunkSize < 18 || !m_file.read(common.data(), chunkSize)) {
+                return false;
+            }
+            m_channels = readBig16(common.data());
+            m_frames = readBig32(common.data() + 2);
+            m_bytesPerSample = (readBig16(common.data() + 6) + 7) / 8;
+            m_sampleRate = readExtended(common.data() + 8);
+            m_encoding = kInteger;
+            m_bigEndian = true;
+            m_unsigned = false;
+            // AIFF-C adds a compression type, of which only uncompressed and float are supported.
+            if (chunkSize >= 22) {
+                const char* compression = common.data() + 18;
+                if (std::memcmp(compression, "sowt", 4) == 0) {
+                    m_bigEndian = false;
+                } else if (std::memcmp(compression, "fl32", 4) == 0 || std::memcmp(compression, "FL32", 4) == 0) {
+                    m_encoding = kFloat;
+                    m_bytesPerSample = 4;
+                } else if (std::memcmp(compression, "NONE", 4) != 0) {
+                    LOG(ERROR) << "unsupported AIFF-C compression type " << std::string(compression, 4);
+                    return false;
+                }
+            }
+            foundCommon = true;
+            if (chunkSize & 1) {
+                m_file.seekg(1, std::ios::cur);
+            }
+        } else if (std::memcmp(chunkHeader, "SSND", 4) == 0) {
+            if (!foundCommon) {
+                LOG(ERROR) << "AIFF SSND chunk found before COMM chunk.";
+                return false;
+            }
+            char offsetBlock[8];
+            if (!m_file.read(offsetBlock, sizeof(offsetBlock))) {
+                return false;
+            }
+            m_file.seekg(readBig32(offsetBlock), std::ios::cur);
+            return true;
+        } else {
+            m_file.seekg(chunkSize + (chunkSize & 1), std::ios::cur);
+        }
+    }
+    return false;
+}
+
+AudioFileWriter::AudioFileWriter() :
+    m_channels(0),
+    m_sampleRate(0),
+    m_frames(0) {
+}
+
+AudioFileWriter::~AudioFileWriter() {
+    if (m_file.is_open()) {
+        close();
+    }
+}
+
+bool AudioFileWriter::open(const fs::path& path, int channels, int sampleRate) {
+    m_file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!m_file) {
+        LOG(ERROR) << "error opening audio file " << path << " for writing.";
+        return false;
+    }
+    m_channels = channels;
+    m_sampleRate = sampleRate;
+    m_frames = 0;
+    writeHeader();
+    return static_cast<bool>(m_file);
+}
+
+bool AudioFileWriter::write(const float* samples, size_t frameCount) {
+    // WAV is little-endian, as are all the hosts confab runs on, so the samples are written as-is.
+    m_file.write(reinterpret_cast<const char*>(samples), frameCount * m_channels * sizeof(float));
+    m_frames += frameCount;
+    return static_cast<bool>(m_file);
+}
+
+bool AudioFileWriter::close() {
+    bool ok = static_cast<bool>(m_file);
+    if (m_frames * m_channels * sizeof(float) > std::numeric_limits<uint32_t>::max() - kFloatWavHeaderSize) {
+        LOG(ERROR) << "audio file too large for WAV format, " << m_frames << " frames.";
+        ok = false;
+    } else {
+        m_file.seekp(0, std::ios::beg);
+        writeHeader();
+        ok = ok && m_file;
+    }
+    m_file.close();
+    return ok;
+}
+
+void AudioFileWriter::writeHeader() {
+    uint32_t dataSize = m_frames * m_channels * sizeof(float);
+    char header[kFloatWavHeaderSize];
+    std::memcpy(header, "RIFF", 4);
+    writeLittle32(kFloatWavHeaderSize - 8 + dataSize, header + 4);
+    std::memcpy(header + 8, "WAVEfmt ", 8);
+    writeLittle32(18, header + 16);
+    writeLittle16(kWavFormatFloat, header + 20);
+    writeLittle16(m_channels, header + 22);
+    writeLittle32(m_sampleRate, header + 24);
+    writeLittle32(m_sampleRate * m_channels * sizeof(float), header + 28);
+    writeLittle16(m_channels * sizeof(float), header + 32);
+    writeLittle16(32, header + 34);
+    writeLittle16(0, header + 36);
+    std::memcpy(header + 38, "fact", 4);
+    writeLittle32(4, header + 42);
+    writeLittle32(m_frames, header + 46);
+    std::memcpy(header + 50, "data", 4);
+    writeLittle32(dataSize, header + 54);
+    m_file.write(header, kFloatWavHeaderSize);
+}
+
+}  // namespace Confab
@@ -0,0 +1,128 @@
+#ifndef SRC_CONFAB_AUDIO_FILE_HPP_
+#define SRC_CONFAB_AUDIO_FILE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <experimental/filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::experimental::filesystem;
+
+namespace Confab {
+
+/*! Streaming reader of uncompressed audio files, converting samples to 32-bit float.
+ *
+ * Supports WAV and WAVE_FORMAT_EXTENSIBLE files with 8, 16, 24, or 32-bit integer or 32 or 64-bit float samples, and
+ * AIFF and AIFF-C files with 8, 16, 24, or 32-bit integer or 32-bit float samples. This covers the files that
+ * SuperCollider itself writes, and most of what turns up in sample libraries, without an external dependency.
+ */
+class AudioFileReader {
+public:
+    /*! Constructs an AudioFileReader with no open file.
+     */
+    AudioFileReader();
+
+    /*! Opens an audio file and parses its header, leaving the reader positioned at the first frame.
+     *
+     * \param path The path to the audio file.
+     * \return true on success, false on error or unsupported format.
+     */
+    bool open(const fs::path& path);
+
+    /*! Reads up to frameCount frames of interleaved samples, converted to float in the range [-1, 1].
+     *
+     * \param samplesOut A buffer with room for at least frameCount * channels() samples.
+     * \param frameCount The maximum number of frames to read.
+     * \return The number of frames read, zero at end of file or on error.
+     */
+    size_t read(float* samplesOut, size_t frameCount);
+
+    /*! The number of interleaved channels in the open file.
+     *
+     * \return The channel count.
+     */
+    int channels() const { return m_channels; }
+
+    /*! The sample rate of the open file.
+     *
+     * \return The sample rate in Hz.
+     */
+    double sampleRate() const { return m_sampleRate; }
+
+    /*! The total number of frames in the open file.
+     *
+     * \return The frame count.
+     */
+    uint64_t frames() const { return m_frames; }
+
+private:
+    enum Encoding {
+        kInteger,
+        kFloat
+    };
+
+    bool parseWav();
+    bool parseAiff();
+
+    std::ifstream m_file;
+    int m_channels;
+    double m_sampleRate;
+    uint64_t m_frames;
+    uint64_t m_framesRead;
+    int m_bytesPerSample;
+    Encoding m_encoding;
+    bool m_bigEndian;
+    // 8-bit WAV samples are unsigned, all other integer samples are signed.
+    bool m_unsigned;
+    std::vector<char> m_readBuffer;
+};
+
+/*! Streaming writer of 32-bit float WAV files, the native sample format of scsynth Buffers.
+ */
+class AudioFileWriter {
+public:
+    /*! Constructs an AudioFileWriter with no open file.
+     */
+    AudioFileWriter();
+
+    /*! Finishes the file, if open.
+     */
+    ~AudioFileWriter();
+
+    /*! Creates a new WAV file, replacing any existing file at path, and writes a placeholder header.
+     *
+     * \param path The path of the file to create.
+     * \param channels The number of interleaved channels to write.
+     * \param sampleRate The sample rate to record in the header, in Hz.
+     * \return true on success, false on error.
+     */
+    bool open(const fs::path& path, int channels, int sampleRate);
+
+    /*! Appends interleaved samples to the file.
+     *
+     * \param samples The samples to write.
+     * \param frameCount The number of frames in samples.
+     * \return true on success, false on error.
+     */
+    bool write(const float* samples, size_t frameCount);
+
+    /*! Fills in the header sizes and closes the file.
+     *
+     * \return true on success, false on error, including if the file is too large for the WAV format.
+     */
+    bool close();
+
+private:
+    void writeHeader();
+
+    std::ofstream m_file;
+    int m_channels;
+    int m_sampleRate;
+    uint64_t m_frames;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_AUDIO_FILE_HPP_
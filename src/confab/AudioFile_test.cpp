@@ -0,0 +1,32 @@
+#include "AudioFile.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+TEST(AudioFileTest, FloatWavRoundTrip) {
+    fs::path path = fs::temp_directory_path() / "AudioFile_test.wav";
+    std::vector<float> samples(3 * 10000);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        samples[i] = std::sin(i * 0.01f);
+    }
+
+    Confab::AudioFileWriter writer;
+    ASSERT_TRUE(writer.open(path, 3, 22050));
+    // Write in two parts to check that the header accounts for every write.
+    ASSERT_TRUE(writer.write(samples.data(), 4000));
+    ASSERT_TRUE(writer.write(samples.data() + (3 * 4000), 6000));
+    ASSERT_TRUE(writer.close());
+
+    Confab::AudioFileReader reader;
+    ASSERT_TRUE(reader.open(path));
+    EXPECT_EQ(3, reader.channels());
+    EXPECT_EQ(22050.0, reader.sampleRate());
+    EXPECT_EQ(10000u, reader.frames());
+    std::vector<float> readSamples(samples.size() + 3);
+    EXPECT_EQ(10000u, reader.read(readSamples.data(), 10001));
+    readSamples.resize(samples.size());
+    EXPECT_EQ(samples, readSamples);
+    fs::remove(path);
+}
@@ -0,0 +1,414 @@
+#include "BlobStore.hpp"
+
+#include "glog/logging.h"
+#include "xxhash.h"
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+/*! Marks the start of every blob header in a segment. Unwritten segment space is zero-filled, so the first header
+ * without this marker is the end of the segment.
+ */
+static const uint32_t kBlobMagic = 0x424f4c42;
+
+/*! The first four bytes of an encoded Location. See BlobStore::encodeLocation().
+ */
+static const char kLocationMagic[4] = { '\xff', '\xff', 'B', 'L' };
+
+/*! File name extensions of live and retired segments.
+ */
+static const char* kSegmentExtension = ".seg";
+static const char* kRetiredExtension = ".retired";
+
+/*! Header written before every blob in a segment.
+ */
+struct BlobHeader {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t length;
+    uint64_t hash;
+};
+
+static_assert(sizeof(BlobHeader) == 24, "BlobHeader must be packed");
+
+fs::path segmentPath(const fs::path& directory, uint32_t id, const char* extension) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%08" PRIu32 "%s", id, extension);
+    return directory / name;
+}
+
+}  // namespace
+
+namespace Confab {
+
+/*! A memory-mapped segment file, shared by the store and any Records pointing into it.
+ */
+class BlobStore::Segment {
+public:
+    Segment(int fileDescriptor, uint8_t* mapping, size_t capacity) :
+        fileDescriptor(fileDescriptor),
+        mapping(mapping),
+        capacity(capacity),
+        end(0) {
+    }
+
+    ~Segment() {
+        munmap(mapping, capacity);
+        ::close(fileDescriptor);
+        if (!retiredPath.empty()) {
+            std::error_code error;
+            fs::remove(retiredPath, error);
+        }
+    }
+
+    /*! Checks the header of the blob at location, returning a pointer to its contents or nullptr if invalid.
+     */
+    const uint8_t* blob(const Location& location) const {
+        if (location.offset > capacity || capacity - location.offset < sizeof(BlobHeader) ||
+            capacity - location.offset - sizeof(BlobHeader) < location.length) {
+            return nullptr;
+        }
+        BlobHeader header;
+        std::memcpy(&header, mapping + location.offset, sizeof(BlobHeader));
+        if (header.magic != kBlobMagic || header.length != location.length || header.hash != location.hash) {
+            return nullptr;
+        }
+        return mapping + location.offset + sizeof(BlobHeader);
+    }
+
+    const int fileDescriptor;
+    uint8_t* const mapping;
+    const size_t capacity;
+    size_t end;
+    // Set once retired, and deleted when the last reference to the segment is released.
+    fs::path retiredPath;
+};
+
+/*! Record pointing straight into a segment mapping, keeping the segment mapped for as long as it lives.
+ */
+class BlobRecord : public Record {
+public:
+    /*! Default constructor not supported, use makeEmptyRecord().
+     */
+    BlobRecord() = delete;
+
+    /*! Constructs a Record pointing at a blob.
+     *
+     * \param segment The segment holding the blob.
+     * \param data The contents of the blob within the segment mapping.
+     */
+    BlobRecord(std::shared_ptr<const void> segment, const SizedPointer& data) :
+        m_segment(segment),
+        m_data(data) {
+    }
+
+    ~BlobRecord() override { }
+
+    /*! Always reports a non-empty Record, as missing blobs get an EmptyRecord instead.
+     *
+     * \return Always false.
+     */
+    bool empty() const override { return false; }
+
+    /*! A pointer to the blob contents.
+     *
+     * \return A non-owning pointer into the segment mapping.
+     */
+    const SizedPointer data() const override { return m_data; }
+
+    /*! Blobs have no key of their own.
+     *
+     * \return Always empty.
+     */
+    const SizedPointer key() const override { return SizedPointer(); }
+
+private:
+    std::shared_ptr<const void> m_segment;
+    const SizedPointer m_data;
+};
+
+// static
+void BlobStore::encodeLocation(const Location& location, char* encodedOut) {
+    std::memcpy(encodedOut, kLocationMagic, sizeof(kLocationMagic));
+    std::memcpy(encodedOut + 4, &location.segment, sizeof(uint32_t));
+    std::memcpy(encodedOut + 8, &location.offset, sizeof(uint64_t));
+    std::memcpy(encodedOut + 16, &location.length, sizeof(uint64_t));
+    std::memcpy(encodedOut + 24, &location.hash, sizeof(uint64_t));
+}
+
+// static
+bool BlobStore::decodeLocation(const char* encoded, size_t size, Location& locationOut) {
+    if (size != kEncodedLocationSize || std::memcmp(encoded, kLocationMagic, sizeof(kLocationMagic)) != 0) {
+        return false;
+    }
+    std::memcpy(&locationOut.segment, encoded + 4, sizeof(uint32_t));
+    std::memcpy(&locationOut.offset, encoded + 8, sizeof(uint64_t));
+    std::memcpy(&locationOut.length, encoded + 16, sizeof(uint64_t));
+    std::memcpy(&locationOut.hash, encoded + 24, sizeof(uint64_t));
+    return true;
+}
+
+// static
+size_t BlobStore::storedSize(uint64_t length) {
+    // Headers stay 8-byte aligned.
+    return sizeof(BlobHeader) + ((length + 7) & ~static_cast<uint64_t>(7));
+}
+
+BlobStore::BlobStore(size_t segmentSize) :
+    m_segmentSize(segmentSize),
+    m_activeSegment(0) {
+}
+
+BlobStore::~BlobStore() {
+    close();
+}
+
+bool BlobStore::open(const fs::path& directory) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_directory = directory;
+    std::error_code error;
+    fs::create_directories(directory, error);
+    if (error) {
+        LOG(ERROR) << "error creating blob directory " << directory << ": " << error.message();
+        return false;
+    }
+
+    std::vector<uint32_t> ids;
+    for (const auto& entry : fs::directory_iterator(directory, error)) {
+        auto extension = entry.path().extension().string();
+        if (extension == kRetiredExtension) {
+            LOG(INFO) << "removing retired blob segment " << entry.path();
+            fs::remove(entry.path(), error);
+        } else if (extension == kSegmentExtension) {
+            ids.push_back(std::strtoul(entry.path().stem().c_str(), nullptr, 10));
+        }
+    }
+
+    for (auto id : ids) {
+        if (!openSegment(id, false)) {
+            return false;
+        }
+    }
+    if (m_segments.empty()) {
+        return openSegment(0, true);
+    }
+    m_activeSegment = m_segments.rbegin()->first;
+    LOG(INFO) << "opened " << m_segments.size() << " blob segments in " << directory;
+    return true;
+}
+
+void BlobStore::close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_segments.clear();
+    m_retired.clear();
+    m_released.clear();
+}
+
+bool BlobStore::append(const SizedPointer& data, Location& locationOut) {
+    size_t size = storedSize(data.size());
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_segments.empty()) {
+        LOG(ERROR) << "append to closed blob store.";
+        return false;
+    }
+    auto segment = m_segments[m_activeSegment];
+    if (segment->capacity - segment->end < size) {
+        if (size > m_segmentSize) {
+            LOG(ERROR) << "blob of " << data.size() << " bytes is larger than segment size " << m_segmentSize;
+            return false;
+        }
+        if (!openSegment(m_activeSegment + 1, true)) {
+            return false;
+        }
+        segment = m_segments[m_activeSegment];
+    }
+
+    BlobHeader header;
+    header.magic = kBlobMagic;
+    header.reserved = 0;
+    header.length = data.size();
+    header.hash = XXH64(data.data(), data.size(), 0);
+
+    // The header goes in last, so a blob torn by a crash mid-copy isn't mistaken for a complete one on open. Pages of
+    // a mapping can be written back in any order, so the contents are synced before the header is written.
+    uint8_t* contents = segment->mapping + segment->end + sizeof(BlobHeader);
+    std::memcpy(contents, data.data(), data.size());
+    static const uintptr_t pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t syncStart = reinterpret_cast<uintptr_t>(contents) & ~(pageSize - 1);
+    if (data.size() > 0 && msync(reinterpret_cast<void*>(syncStart),
+        reinterpret_cast<uintptr_t>(contents) + data.size() - syncStart, MS_SYNC) != 0) {
+        LOG(ERROR) << "error syncing blob contents: " << std::strerror(errno);
+        return false;
+    }
+    std::memcpy(segment->mapping + segment->end, &header, sizeof(BlobHeader));
+
+    locationOut.segment = m_activeSegment;
+    locationOut.offset = segment->end;
+    locationOut.length = header.length;
+    locationOut.hash = header.hash;
+    segment->end += size;
+    return true;
+}
+
+RecordPtr BlobStore::read(const Location& location) {
+    std::shared_ptr<Segment> segment;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_segments.find(location.segment);
+        if (found != m_segments.end()) {
+            segment = found->second;
+        } else {
+            found = m_retired.find(location.segment);
+            if (found != m_retired.end()) {
+                segment = found->second;
+            } else {
+                auto released = m_released.find(location.segment);
+                if (released != m_released.end()) {
+                    segment = released->second.lock();
+                }
+            }
+        }
+    }
+    if (!segment) {
+        LOG(ERROR) << "blob segment " << location.segment << " not found.";
+        return makeEmptyRecord();
+    }
+    const uint8_t* blob = segment->blob(location);
+    if (!blob) {
+        LOG(ERROR) << "invalid blob at segment " << location.segment << " offset " << location.offset;
+        return makeEmptyRecord();
+    }
+    return RecordPtr(new BlobRecord(segment, SizedPointer(blob, location.length)));
+}
+
+bool BlobStore::verify(const Location& location) {
+    RecordPtr record = read(location);
+    if (record->empty()) {
+        return false;
+    }
+    return XXH64(record->data().data(), record->data().size(), 0) == location.hash;
+}
+
+bool BlobStore::sync() {
+    std::shared_ptr<Segment> segment;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_segments.empty()) {
+            return false;
+        }
+        segment = m_segments[m_activeSegment];
+    }
+    if (msync(segment->mapping, segment->capacity, MS_SYNC) != 0) {
+        LOG(ERROR) << "error syncing blob segment: " << std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool BlobStore::retire(uint32_t segment) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_segments.find(segment);
+    if (found == m_segments.end() || segment == m_activeSegment) {
+        LOG(ERROR) << "can't retire blob segment " << segment;
+        return false;
+    }
+    std::error_code error;
+    fs::rename(segmentPath(m_directory, segment, kSegmentExtension),
+        segmentPath(m_directory, segment, kRetiredExtension), error);
+    if (error) {
+        LOG(ERROR) << "error retiring blob segment " << segment << ": " << error.message();
+        return false;
+    }
+    found->second->retiredPath = segmentPath(m_directory, segment, kRetiredExtension);
+    m_retired[segment] = found->second;
+    m_segments.erase(found);
+    LOG(INFO) << "retired blob segment " << segment;
+    return true;
+}
+
+void BlobStore::releaseRetired() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto released = m_released.begin(); released != m_released.end();) {
+        if (released->second.expired()) {
+            released = m_released.erase(released);
+        } else {
+            ++released;
+        }
+    }
+    for (const auto& retired : m_retired) {
+        m_released[retired.first] = retired.second;
+    }
+    m_retired.clear();
+}
+
+uint32_t BlobStore::usage(std::map<uint32_t, size_t>& usedOut) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    usedOut.clear();
+    for (const auto& segment : m_segments) {
+        usedOut[segment.first] = segment.second->end;
+    }
+    return m_activeSegment;
+}
+
+bool BlobStore::openSegment(uint32_t id, bool create) {
+    fs::path path = segmentPath(m_directory, id, kSegmentExtension);
+    int fileDescriptor = ::open(path.c_str(), O_RDWR | (create ? O_CREAT | O_EXCL : 0), 0644);
+    if (fileDescriptor < 0) {
+        LOG(ERROR) << "error opening blob segment " << path << ": " << std::strerror(errno);
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(fileDescriptor, &fileStat) != 0) {
+        LOG(ERROR) << "error reading size of blob segment " << path << ": " << std::strerror(errno);
+        ::close(fileDescriptor);
+        return false;
+    }
+    // Segments are created at full size, sparse until written, so the mapping never needs to grow.
+    size_t capacity = static_cast<size_t>(fileStat.st_size);
+    if (create || capacity == 0) {
+        capacity = m_segmentSize;
+        if (ftruncate(fileDescriptor, capacity) != 0) {
+            LOG(ERROR) << "error sizing blob segment " << path << ": " << std::strerror(errno);
+            ::close(fileDescriptor);
+            return false;
+        }
+    }
+
+    void* mapping = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+    if (mapping == MAP_FAILED) {
+        LOG(ERROR) << "error mapping blob segment " << path << ": " << std::strerror(errno);
+        ::close(fileDescriptor);
+        return false;
+    }
+
+    auto segment = std::make_shared<Segment>(fileDescriptor, static_cast<uint8_t*>(mapping), capacity);
+    // Walk the blob headers to find the end of the written part of the segment.
+    while (capacity - segment->end >= sizeof(BlobHeader)) {
+        BlobHeader header;
+        std::memcpy(&header, segment->mapping + segment->end, sizeof(BlobHeader));
+        if (header.magic != kBlobMagic || storedSize(header.length) > capacity - segment->end) {
+            break;
+        }
+        segment->end += storedSize(header.length);
+    }
+
+    m_segments[id] = segment;
+    if (id >= m_activeSegment || m_segments.size() == 1) {
+        m_activeSegment = id;
+    }
+    return true;
+}
+
+}  // namespace Confab
@@ -0,0 +1,161 @@
+#ifndef SRC_CONFAB_BLOB_STORE_HPP_
+#define SRC_CONFAB_BLOB_STORE_HPP_
+
+#include "Record.hpp"
+#include "SizedPointer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <experimental/filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace fs = std::experimental::filesystem;
+
+namespace Confab {
+
+/*! Append-only store of blobs in memory-mapped segment files.
+ *
+ * Blobs are appended to the newest segment until it is full, then a new segment is started. Each blob is written
+ * with a small header holding its length and hash, so the end of the newest segment can be found again on open by
+ * walking the headers. Blobs are never modified or deleted in place. Instead, a segment holding mostly unreferenced
+ * blobs can have its live blobs appended again elsewhere and then be retired as a whole. Where blobs are referenced
+ * is up to the caller, which keeps the Location returned from append().
+ *
+ * Reads return Records pointing straight into the mapping. Retired segments stay readable until releaseRetired(), so
+ * Locations read before a segment was retired stay valid until then. After that, each retired segment is unmapped and
+ * its file deleted as soon as no Record read from it is left.
+ */
+class BlobStore {
+public:
+    /*! Where a blob is stored.
+     */
+    struct Location {
+        uint32_t segment;
+        uint64_t offset;
+        uint64_t length;
+        uint64_t hash;
+    };
+
+    /*! Size in bytes of a Location serialized with encodeLocation().
+     */
+    static constexpr size_t kEncodedLocationSize = 32;
+
+    /*! Default size in bytes of each segment file.
+     */
+    static constexpr size_t kDefaultSegmentSize = 64 * 1024 * 1024;
+
+    /*! Serializes location in to a fixed-size buffer.
+     *
+     * The encoding begins with four bytes which, read as the root offset of a flatbuffer, would point far past the end
+     * of any buffer small enough to be stored in the database, so encoded Locations can be told apart from
+     * flatbuffers stored in the same place.
+     *
+     * \param location The Location to serialize.
+     * \param encodedOut A pointer to at least kEncodedLocationSize bytes.
+     */
+    static void encodeLocation(const Location& location, char* encodedOut);
+
+    /*! Deserializes a Location written by encodeLocation().
+     *
+     * \param encoded The bytes to read.
+     * \param size The number of bytes available.
+     * \param locationOut Where to store the decoded Location.
+     * \return true if the bytes were an encoded Location, false otherwise.
+     */
+    static bool decodeLocation(const char* encoded, size_t size, Location& locationOut);
+
+    /*! Constructs a closed BlobStore.
+     *
+     * \param segmentSize The size in bytes of each segment file, which is also the largest blob that can be stored.
+     */
+    explicit BlobStore(size_t segmentSize = kDefaultSegmentSize);
+
+    /*! Closes the store, if open.
+     */
+    ~BlobStore();
+
+    /*! Opens, or creates, a store in directory.
+     *
+     * \param directory The directory to keep segment files in, created if missing.
+     * \return true on success, false on error.
+     */
+    bool open(const fs::path& directory);
+
+    /*! Unmaps all segments. Records returned by read() must be released before calling.
+     */
+    void close();
+
+    /*! Appends a blob to the newest segment, starting a new segment if it doesn't fit.
+     *
+     * \param data The contents of the blob.
+     * \param locationOut Where the blob was stored.
+     * \return true on success, false on error.
+     */
+    bool append(const SizedPointer& data, Location& locationOut);
+
+    /*! Returns a Record pointing at a blob in its segment mapping, after checking the blob header.
+     *
+     * \param location The blob to read.
+     * \return A Record valid until close(), or an empty Record if location doesn't refer to a stored blob.
+     */
+    RecordPtr read(const Location& location);
+
+    /*! Checks that the contents of a blob still match their hash.
+     *
+     * \param location The blob to check.
+     * \return true if the blob is intact.
+     */
+    bool verify(const Location& location);
+
+    /*! Flushes appended blobs to disk.
+     *
+     * \return true on success, false on error.
+     */
+    bool sync();
+
+    /*! Marks a segment as no longer referenced. It stays readable until the next releaseRetired().
+     *
+     * \param segment The segment to retire, which must not be the newest segment.
+     * \return true on success, false on error.
+     */
+    bool retire(uint32_t segment);
+
+    /*! Stops reading from segments retired so far, so each is unmapped and its file deleted once the last Record
+     * read from it is released. Call once any Locations read before the segments were retired are no longer in use.
+     */
+    void releaseRetired();
+
+    /*! Describes the space used by every live segment.
+     *
+     * \param usedOut Replaced with the number of bytes used by blobs and their headers in each segment.
+     * \return The newest segment, which is appended to and can't be retired.
+     */
+    uint32_t usage(std::map<uint32_t, size_t>& usedOut);
+
+    /*! The number of bytes a blob takes up in its segment, including its header and padding.
+     *
+     * \param length The length of the blob.
+     * \return The space taken up in the segment.
+     */
+    static size_t storedSize(uint64_t length);
+
+private:
+    class Segment;
+
+    bool openSegment(uint32_t id, bool create);
+
+    size_t m_segmentSize;
+    fs::path m_directory;
+    std::mutex m_mutex;
+    std::map<uint32_t, std::shared_ptr<Segment>> m_segments;
+    // Retired segments still readable, and those released by releaseRetired() but still held by Records.
+    std::map<uint32_t, std::shared_ptr<Segment>> m_retired;
+    std::map<uint32_t, std::weak_ptr<Segment>> m_released;
+    uint32_t m_activeSegment;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_BLOB_STORE_HPP_
@@ -0,0 +1,130 @@
+#include "BlobStore.hpp"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <string>
+
+namespace {
+
+fs::path makeEmptyDirectory(const char* name) {
+    fs::path path = fs::temp_directory_path() / name;
+    fs::remove_all(path);
+    return path;
+}
+
+std::string recordString(const Confab::RecordPtr& record) {
+    return std::string(record->data().dataChar(), record->data().size());
+}
+
+}  // namespace
+
+TEST(BlobStoreTest, LocationRoundTrip) {
+    Confab::BlobStore::Location location = { 3, 4096, 2800, 0x0123456789abcdef };
+    char encoded[Confab::BlobStore::kEncodedLocationSize];
+    Confab::BlobStore::encodeLocation(location, encoded);
+    Confab::BlobStore::Location decoded;
+    ASSERT_TRUE(Confab::BlobStore::decodeLocation(encoded, sizeof(encoded), decoded));
+    EXPECT_EQ(location.segment, decoded.segment);
+    EXPECT_EQ(location.offset, decoded.offset);
+    EXPECT_EQ(location.length, decoded.length);
+    EXPECT_EQ(location.hash, decoded.hash);
+
+    // A flatbuffer starts with a small root offset, and so never decodes as a Location.
+    encoded[0] = 12;
+    encoded[1] = 0;
+    encoded[2] = 0;
+    encoded[3] = 0;
+    EXPECT_FALSE(Confab::BlobStore::decodeLocation(encoded, sizeof(encoded), decoded));
+}
+
+TEST(BlobStoreTest, AppendAndReopen) {
+    fs::path directory = makeEmptyDirectory("BlobStore_test_reopen");
+    std::string first("first blob");
+    std::string second("second, slightly longer, blob");
+    Confab::BlobStore::Location firstLocation;
+    Confab::BlobStore::Location secondLocation;
+    {
+        Confab::BlobStore store(4096);
+        ASSERT_TRUE(store.open(directory));
+        ASSERT_TRUE(store.append(Confab::SizedPointer(first.data(), first.size()), firstLocation));
+        ASSERT_TRUE(store.append(Confab::SizedPointer(second.data(), second.size()), secondLocation));
+        EXPECT_EQ(first, recordString(store.read(firstLocation)));
+        EXPECT_EQ(second, recordString(store.read(secondLocation)));
+    }
+
+    // Reopening finds the end of the segment, so new blobs don't overwrite old ones.
+    Confab::BlobStore store(4096);
+    ASSERT_TRUE(store.open(directory));
+    std::string third("third");
+    Confab::BlobStore::Location thirdLocation;
+    ASSERT_TRUE(store.append(Confab::SizedPointer(third.data(), third.size()), thirdLocation));
+    EXPECT_EQ(secondLocation.offset + Confab::BlobStore::storedSize(second.size()), thirdLocation.offset);
+    EXPECT_EQ(first, recordString(store.read(firstLocation)));
+    EXPECT_EQ(second, recordString(store.read(secondLocation)));
+    EXPECT_EQ(third, recordString(store.read(thirdLocation)));
+    EXPECT_TRUE(store.verify(thirdLocation));
+
+    // A Location that doesn't match the stored header reads as empty.
+    Confab::BlobStore::Location badLocation = thirdLocation;
+    badLocation.hash ^= 1;
+    EXPECT_TRUE(store.read(badLocation)->empty());
+    badLocation = thirdLocation;
+    badLocation.offset += 8;
+    EXPECT_TRUE(store.read(badLocation)->empty());
+    fs::remove_all(directory);
+}
+
+TEST(BlobStoreTest, RollsOverAndRetiresSegments) {
+    fs::path directory = makeEmptyDirectory("BlobStore_test_retire");
+    Confab::BlobStore store(1024);
+    ASSERT_TRUE(store.open(directory));
+    std::string blob(400, 'x');
+    Confab::BlobStore::Location locations[3];
+    for (auto& location : locations) {
+        ASSERT_TRUE(store.append(Confab::SizedPointer(blob.data(), blob.size()), location));
+    }
+    // Two blobs fit in a segment, the third starts a new one.
+    EXPECT_EQ(locations[0].segment, locations[1].segment);
+    EXPECT_NE(locations[1].segment, locations[2].segment);
+
+    std::map<uint32_t, size_t> used;
+    EXPECT_EQ(locations[2].segment, store.usage(used));
+    EXPECT_EQ(2u, used.size());
+    EXPECT_EQ(2 * Confab::BlobStore::storedSize(blob.size()), used[locations[0].segment]);
+
+    // The newest segment can't be retired, older ones can, and stay readable until released.
+    EXPECT_FALSE(store.retire(locations[2].segment));
+    auto record = store.read(locations[0]);
+    ASSERT_TRUE(store.retire(locations[0].segment));
+    fs::path retiredPath = directory / "00000000.retired";
+    EXPECT_TRUE(fs::exists(retiredPath));
+    EXPECT_EQ(blob, recordString(record));
+    EXPECT_EQ(blob, recordString(store.read(locations[1])));
+
+    // Once released, the segment is only kept for the Records still pointing into it, then deleted.
+    store.releaseRetired();
+    EXPECT_EQ(blob, recordString(record));
+    EXPECT_TRUE(fs::exists(retiredPath));
+    record.reset();
+    EXPECT_FALSE(fs::exists(retiredPath));
+    EXPECT_TRUE(store.read(locations[0])->empty());
+    store.close();
+
+    ASSERT_TRUE(store.open(directory));
+    EXPECT_TRUE(store.read(locations[0])->empty());
+    EXPECT_EQ(blob, recordString(store.read(locations[2])));
+    store.close();
+    fs::remove_all(directory);
+}
+
+TEST(BlobStoreTest, RejectsOversizeBlob) {
+    fs::path directory = makeEmptyDirectory("BlobStore_test_oversize");
+    Confab::BlobStore store(256);
+    ASSERT_TRUE(store.open(directory));
+    std::string blob(512, 'y');
+    Confab::BlobStore::Location location;
+    EXPECT_FALSE(store.append(Confab::SizedPointer(blob.data(), blob.size()), location));
+    store.close();
+    fs::remove_all(directory);
+}
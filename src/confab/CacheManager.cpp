@@ -1,22 +1,54 @@
 #include "CacheManager.hpp"
 
 #include "Asset.hpp"
+#include "AssetDatabase.hpp"
+#include "AudioFile.hpp"
 #include "Constants.hpp"
 #include "HttpClient.hpp"
+#include "Resampler.hpp"
 #include "schemas/FlatAsset_generated.h"
 #include "schemas/FlatAssetData_generated.h"
 
 #include "glog/logging.h"
 #include "xxhash.h"
 
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <fstream>
+#include <functional>
+#include <thread>
+
+namespace {
+
+/*! Inserted between the key and the extension in the names of derived cache files, which can't be validated by hash.
+ */
+static const char* kDerivedSuffix = ".derived";
+
+/*! Extension of temporary files written while deriving a cache file, which are removed on startup.
+ */
+static const char* kTemporaryExtension = ".tmp";
+
+/*! Number of frames converted at a time when deriving a sample variant.
+ */
+static const size_t kVariantFrames = 16384;
+
+/*! Hashed with the source Asset key to make the key of a float WAV sample variant.
+ */
+struct SampleVariantFormat {
+    char format[4];
+    int32_t sampleRate;
+};
+
+}  // namespace
 
 namespace Confab {
 
-CacheManager::CacheManager(const fs::path& cachePath, size_t maxSize, std::shared_ptr<HttpClient> httpClient) :
+CacheManager::CacheManager(const fs::path& cachePath, size_t maxSize, std::shared_ptr<AssetDatabase> assetDatabase,
+    std::shared_ptr<HttpClient> httpClient) :
     m_cachePath(cachePath),
     m_maxSize(maxSize),
+    m_assetDatabase(assetDatabase),
     m_httpClient(httpClient),
     m_currentSize(0) {
 }
@@ -34,11 +66,22 @@ void CacheManager::checkExistingEntries(bool validate) {
     for (auto& entry : fs::directory_iterator(m_cachePath)) {
         fs::path path = entry.path();
         if (fs::is_regular_file(path)) {
+            if (path.extension() == kTemporaryExtension) {
+                LOG(WARNING) << "removing incomplete cache file " << path;
+                fs::remove(path);
+                continue;
+            }
             size_t fileSize = fs::file_size(path);
             std::chrono::time_point writeTime = fs::last_write_time(path);
             uint64_t key = Asset::stringToKey(path.stem());
+            fs::path extension = path.extension();
+            bool derived = fs::path(path.stem()).extension() == kDerivedSuffix;
+            if (derived) {
+                extension = fs::path(kDerivedSuffix);
+                extension += path.extension();
+            }
             bool valid = true;
-            if (validate) {
+            if (validate && !derived) {
                 XXH64_state_t* hashState = XXH64_createState();
                 XXH64_reset(hashState, 0);
                 std::array<char, kDataChunkSize> fileChunk;
@@ -70,7 +113,6 @@ void CacheManager::checkExistingEntries(bool validate) {
                 LOG(INFO) << "adding " << path << " to cache record, " << fileSize << " bytes.";
                 m_currentSize += fileSize;
                 m_timeQueue.push(std::make_pair(writeTime, path));
-                fs::path extension = path.extension();
                 m_extensionMap.insert(std::make_pair(key, extension));
             } else {
                 LOG(WARNING) << "removing invalid cache file " << path;
@@ -122,40 +164,53 @@ fs::path CacheManager::download(uint64_t key, size_t fileSize, uint64_t chunks,
         return fs::path();
     }
 
+    // The chunk count of file Assets is one more than is stored when the size is a multiple of kDataChunkSize.
+    chunks = std::min<uint64_t>(chunks, (fileSize + kDataChunkSize - 1) / kDataChunkSize);
+
     size_t downloadedSize = 0;
-    uint64_t digest = 0;
     XXH64_state_t* hashState = XXH64_createState();
     XXH64_reset(hashState, 0);
     bool ok = true;
 
-    // Download AssetData chunk-by-chunk sequentially, validate each chunk, then write to file.
-    for (auto i = 0; i < chunks; ++i) {
-        m_httpClient->getAssetData(key, i, [&filePath, &outFile, &downloadedSize, &digest, &hashState, &ok](
-            uint64_t chunkKey, uint64_t chunkNumber, RecordPtr assetDataRecord) {
+    // Validate incremental hash of each chunk, then write to file.
+    auto writeChunk = [&filePath, &outFile, &downloadedSize, &hashState, &ok](uint64_t chunkNumber,
+        const SizedPointer& assetData) {
+        const Data::FlatAssetData* flatAssetData = Data::GetFlatAssetData(assetData.data());
+        const uint8_t* chunkData = flatAssetData->data()->data();
+        size_t chunkDataSize = flatAssetData->data()->size();
+        XXH64_update(hashState, chunkData, chunkDataSize);
+        uint64_t digest = XXH64_digest(hashState);
+        if (digest != flatAssetData->hash()) {
+            LOG(ERROR) << "incremental hash validation for asset download " << filePath << " chunk number "
+                << chunkNumber << " failed, computed " << Asset::keyToString(digest) << ", expected "
+                << Asset::keyToString(flatAssetData->hash());
+            ok = false;
+        } else {
+            downloadedSize += chunkDataSize;
+            outFile.write(reinterpret_cast<const char*>(chunkData), chunkDataSize);
+        }
+        return ok;
+    };
+
+    // Read each run of chunks stored locally with one scan of the database, downloading only the chunk that ended the
+    // run, sequentially, until complete.
+    uint64_t chunk = 0;
+    while (ok && chunk < chunks) {
+        chunk += m_assetDatabase->loadAssetDataRange(key, chunk, chunks - chunk, writeChunk);
+        if (!ok || chunk == chunks) break;
+        m_httpClient->getAssetData(key, chunk, [&filePath, &writeChunk, &ok](uint64_t chunkKey, uint64_t chunkNumber,
+            RecordPtr assetDataRecord) {
             if (assetDataRecord->empty()) {
                 LOG(ERROR) << "error downloading chunk " << chunkNumber << " for file " << filePath;
                 ok = false;
             } else {
-                // Validate incremental hash of incoming data.
-                const Data::FlatAssetData* flatAssetData = Data::GetFlatAssetData(assetDataRecord->data().data());
-                const uint8_t* chunkData = flatAssetData->data()->data();
-                size_t chunkDataSize = flatAssetData->data()->size();
-                XXH64_update(hashState, chunkData, chunkDataSize);
-                digest = XXH64_digest(hashState);
-                if (digest != flatAssetData->hash()) {
-                    LOG(ERROR) << "incremental hash validation for asset download " << filePath << " chunk number "
-                        << chunkNumber << " failed, computed " << Asset::keyToString(digest) << ", expected "
-                        << Asset::keyToString(flatAssetData->hash());
-                    ok = false;
-                } else {
-                    downloadedSize += chunkDataSize;
-                    outFile.write(reinterpret_cast<const char*>(chunkData), chunkDataSize);
-                }
+                writeChunk(chunkNumber, assetDataRecord->data());
             }
         });
-        if (!ok) break;
+        ++chunk;
     }
 
+    uint64_t digest = XXH64_digest(hashState);
     XXH64_freeState(hashState);
     outFile.close();
 
@@ -186,6 +241,99 @@ fs::path CacheManager::download(uint64_t key, size_t fileSize, uint64_t chunks,
     return filePath;
 }
 
+fs::path CacheManager::sampleVariant(uint64_t key, int sampleRate) {
+    fs::path sourcePath = checkCache(key);
+    if (sourcePath.empty()) {
+        LOG(ERROR) << "Asset " << Asset::keyToString(key) << " must be cached before deriving a sample variant.";
+        return fs::path();
+    }
+
+    AudioFileReader reader;
+    if (!reader.open(sourcePath)) {
+        LOG(ERROR) << "unable to read cached Asset " << Asset::keyToString(key) << " as audio.";
+        return fs::path();
+    }
+    int sourceRate = static_cast<int>(std::lround(reader.sampleRate()));
+    if (sampleRate <= 0) {
+        sampleRate = sourceRate;
+    }
+
+    uint64_t derivedKey = variantKey(key, sampleRate);
+    fs::path variantPath = checkCache(derivedKey);
+    if (!variantPath.empty()) {
+        return variantPath;
+    }
+
+    std::string extension = std::string(kDerivedSuffix) + ".wav";
+    variantPath = m_cachePath;
+    variantPath += fs::path("/" + Asset::keyToString(derivedKey) + extension);
+    // Requests for the same variant may be converting at the same time, so each writes its own temporary file.
+    fs::path temporaryPath = variantPath;
+    temporaryPath += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) +
+        kTemporaryExtension;
+    LOG(INFO) << "deriving " << sampleRate << " Hz float variant of Asset " << Asset::keyToString(key) << " in to "
+        << variantPath;
+
+    AudioFileWriter writer;
+    if (!writer.open(temporaryPath, reader.channels(), sampleRate)) {
+        return fs::path();
+    }
+
+    std::unique_ptr<Resampler> resampler;
+    if (sampleRate != sourceRate) {
+        resampler.reset(new Resampler(reader.channels(), reader.sampleRate(), sampleRate));
+    }
+    std::vector<float> samples(kVariantFrames * reader.channels());
+    std::vector<float> resampled;
+    bool ok = true;
+    uint64_t framesRead = 0;
+    size_t frames = 0;
+    while (ok && (frames = reader.read(samples.data(), kVariantFrames)) > 0) {
+        framesRead += frames;
+        if (resampler) {
+            resampled.clear();
+            resampler->process(samples.data(), frames, resampled);
+            ok = writer.write(resampled.data(), resampled.size() / reader.channels());
+        } else {
+            ok = writer.write(samples.data(), frames);
+        }
+    }
+    if (ok && resampler) {
+        resampled.clear();
+        resampler->flush(resampled);
+        ok = writer.write(resampled.data(), resampled.size() / reader.channels());
+    }
+    ok = writer.close() && ok;
+
+    if (!ok || framesRead != reader.frames()) {
+        LOG(ERROR) << "failed to derive sample variant of Asset " << Asset::keyToString(key) << ", read "
+            << framesRead << " of " << reader.frames() << " frames.";
+        fs::remove(temporaryPath);
+        return fs::path();
+    }
+
+    fs::rename(temporaryPath, variantPath);
+    size_t fileSize = fs::file_size(variantPath);
+    std::chrono::time_point writeTime = fs::last_write_time(variantPath);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_extensionMap.insert(std::make_pair(derivedKey, extension)).second) {
+            m_currentSize += fileSize;
+            m_timeQueue.push(std::make_pair(writeTime, variantPath));
+            LOG(INFO) << "adding " << variantPath << " to cache record, " << fileSize << " bytes, cache now "
+                << m_currentSize << " bytes.";
+        }
+    }
+
+    return variantPath;
+}
+
+// static
+uint64_t CacheManager::variantKey(uint64_t key, int sampleRate) {
+    SampleVariantFormat format = { { 'f', '3', '2', 'w' }, sampleRate };
+    return XXH64(&format, sizeof(format), key);
+}
+
 void CacheManager::makeRoomFor(size_t addedBytes) {
     while (m_currentSize + addedBytes > m_maxSize) {
         fs::path fileToRemove;
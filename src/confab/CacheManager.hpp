@@ -14,10 +14,12 @@ namespace fs = std::experimental::filesystem;
 
 namespace Confab {
 
+class AssetDatabase;
 class HttpClient;
 
 /*! Manages a file cache of file-based Assets, using an LRU eviction strategy to maintain a fixed maximum size.
- *  Uses HttpClient to download AssetData chunks not in the cache.
+ *  Builds cache files from the AssetData chunks in the local AssetDatabase, using HttpClient to download any chunks
+ *  not stored locally.
  */
 class CacheManager {
 public:
@@ -25,9 +27,11 @@ public:
      *
      * \param cachePath A path to the cache directory.
      * \param maxSize The size in bytes at which to start evicting least recently used cache entries.
-     * \param httpClient A pointer to the HttpClient object, for downloaded resources not in cache.
+     * \param assetDatabase A pointer to the local AssetDatabase, read first for AssetData chunks.
+     * \param httpClient A pointer to the HttpClient object, for AssetData chunks not in the local AssetDatabase.
      */
-    CacheManager(const fs::path& cachePath, size_t maxSize, std::shared_ptr<HttpClient> httpClient);
+    CacheManager(const fs::path& cachePath, size_t maxSize, std::shared_ptr<AssetDatabase> assetDatabase,
+        std::shared_ptr<HttpClient> httpClient);
 
     /*! Enumerates any existing files, and computes the total size of the cache so far. Can take significant time
      *  depending on the number of files in the cache and their size, particularly with validation enabled.
@@ -45,18 +49,40 @@ public:
      */
     fs::path checkCache(uint64_t key);
 
-    /*! If needed, makes room by evicting old entries first, then downloads AssetData chunks of the provided Asset
-     * until complete, then returns a path to the newly created cache entry, or an empty path on error. Note that it
-     * does not checkCache first, meaning it will clobber any existing file and re-download.
+    /*! If needed, makes room by evicting old entries first, then writes AssetData chunks of the provided Asset until
+     * complete, then returns a path to the newly created cache entry, or an empty path on error. Chunks are read from
+     * the local AssetDatabase where stored, such as for Assets added locally and not yet uploaded, and downloaded
+     * otherwise. Note that it does not checkCache first, meaning it will clobber any existing file and re-download.
      *
      * \param key The Asset key to download AssetData chunks for.
      * \param fileSize The size of the Asset in bytes.
-     * \param chunks The number of chunks to download.
+     * \param chunks The number of chunks in the Asset, which is clamped to the number its size calls for.
      * \param fileExtension The extension to append to the filename when complete, including the dot.
      * \return The path to the file, or an empty path on error.
      */
     fs::path download(uint64_t key, size_t fileSize, uint64_t chunks, const std::string& fileExtension);
 
+    /*! Returns a path to a playback-ready variant of a cached sample Asset, as a 32-bit float WAV file at the requested
+     * sample rate, converting the cached Asset file and adding the variant to the cache first if needed.
+     *
+     * Variants are cached under their own key, computed by variantKey(), and evicted just like downloaded Assets.
+     * Because the variant key is not a hash of the variant file contents, variant files are named with a ".derived"
+     * suffix before their extension, and are not validated by checkExistingEntries().
+     *
+     * \param key The key of the sample Asset, which must already be in the cache.
+     * \param sampleRate The desired sample rate in Hz, or zero to keep the sample rate of the Asset.
+     * \return The path to the variant file, or an empty path on error.
+     */
+    fs::path sampleVariant(uint64_t key, int sampleRate);
+
+    /*! Computes the cache key of a float WAV variant of a sample Asset.
+     *
+     * \param key The key of the sample Asset.
+     * \param sampleRate The sample rate of the variant in Hz.
+     * \return The variant key.
+     */
+    static uint64_t variantKey(uint64_t key, int sampleRate);
+
 private:
     /*! Evict items from the cache until the size of the cache is smaller than the maximum size plus the addedBytes.
      *
@@ -67,6 +93,7 @@ private:
 
     const fs::path m_cachePath;
     size_t m_maxSize;
+    std::shared_ptr<AssetDatabase> m_assetDatabase;
     std::shared_ptr<HttpClient> m_httpClient;
 
     size_t m_currentSize;
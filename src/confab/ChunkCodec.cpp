@@ -0,0 +1,204 @@
+#include "ChunkCodec.hpp"
+
+#include "glog/logging.h"
+#include "zdict.h"
+#include "zstd.h"
+
+#include <cstring>
+#include <numeric>
+
+namespace {
+
+/*! The first four bytes of a compressed chunk. As with encoded BlobStore Locations, these read as a flatbuffer root
+ * offset far past the end of any chunk, so compressed chunks can't be mistaken for FlatAssetData.
+ */
+static const char kCompressedMagic[Confab::ChunkCodec::kHeaderSize] = { '\xff', '\xff', 'Z', 'S' };
+
+}  // namespace
+
+namespace Confab {
+
+/*! A zstd dictionary, digested once for compression and once for decompression.
+ */
+class ChunkCodec::Dictionary {
+public:
+    Dictionary(ZSTD_CDict* compressDictionary, ZSTD_DDict* decompressDictionary, uint32_t id) :
+        compressDictionary(compressDictionary),
+        decompressDictionary(decompressDictionary),
+        id(id) {
+    }
+
+    ~Dictionary() {
+        ZSTD_freeCDict(compressDictionary);
+        ZSTD_freeDDict(decompressDictionary);
+    }
+
+    ZSTD_CDict* const compressDictionary;
+    ZSTD_DDict* const decompressDictionary;
+    const uint32_t id;
+};
+
+// static
+ChunkCodec::Codec ChunkCodec::policy(Asset::Type type) {
+    switch (type) {
+    case Asset::kSnippet:
+    case Asset::kYAML:
+        return kZstd;
+
+    // Sample and image files are already compressed, or are noise-like audio, so compressing them again costs CPU on
+    // every read for little or no saving.
+    case Asset::kImage:
+    case Asset::kSample:
+    case Asset::kInvalid:
+        return kRaw;
+    }
+    return kRaw;
+}
+
+// static
+std::string ChunkCodec::trainDictionary(const std::vector<std::string>& samples, size_t maxSize) {
+    std::string sampleBuffer;
+    std::vector<size_t> sampleSizes;
+    sampleBuffer.reserve(std::accumulate(samples.begin(), samples.end(), size_t(0),
+        [](size_t total, const std::string& sample) { return total + sample.size(); }));
+    for (const auto& sample : samples) {
+        sampleBuffer.append(sample);
+        sampleSizes.push_back(sample.size());
+    }
+
+    std::string dictionary(maxSize, '\0');
+    size_t size = ZDICT_trainFromBuffer(&dictionary[0], dictionary.size(), sampleBuffer.data(), sampleSizes.data(),
+        static_cast<unsigned>(sampleSizes.size()));
+    if (ZDICT_isError(size)) {
+        LOG(WARNING) << "unable to train chunk dictionary from " << samples.size() << " samples: "
+            << ZDICT_getErrorName(size);
+        return std::string();
+    }
+    dictionary.resize(size);
+    return dictionary;
+}
+
+// static
+uint32_t ChunkCodec::dictionaryId(const std::string& dictionary) {
+    return ZDICT_getDictID(dictionary.data(), dictionary.size());
+}
+
+// static
+bool ChunkCodec::isCompressed(const SizedPointer& stored) {
+    return stored.size() > kHeaderSize && std::memcmp(stored.data(), kCompressedMagic, kHeaderSize) == 0;
+}
+
+ChunkCodec::ChunkCodec(int level) : m_level(level) {
+}
+
+ChunkCodec::~ChunkCodec() {
+}
+
+bool ChunkCodec::addDictionary(Asset::Type type, const std::string& dictionary) {
+    uint32_t id = dictionaryId(dictionary);
+    if (id == 0) {
+        LOG(ERROR) << "not adding invalid chunk dictionary for type " << Asset::enumToTypeString(type);
+        return false;
+    }
+    ZSTD_CDict* compressDictionary = ZSTD_createCDict(dictionary.data(), dictionary.size(), m_level);
+    ZSTD_DDict* decompressDictionary = ZSTD_createDDict(dictionary.data(), dictionary.size());
+    if (!compressDictionary || !decompressDictionary) {
+        ZSTD_freeCDict(compressDictionary);
+        ZSTD_freeDDict(decompressDictionary);
+        LOG(ERROR) << "failed to load chunk dictionary for type " << Asset::enumToTypeString(type);
+        return false;
+    }
+
+    auto loaded = std::make_shared<Dictionary>(compressDictionary, decompressDictionary, id);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_typeDictionaries[type] = loaded;
+    m_idDictionaries[id] = loaded;
+    LOG(INFO) << "added chunk dictionary " << id << " of " << dictionary.size() << " bytes for type "
+        << Asset::enumToTypeString(type);
+    return true;
+}
+
+bool ChunkCodec::hasDictionary(Asset::Type type) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_typeDictionaries.count(type) > 0;
+}
+
+bool ChunkCodec::compress(Asset::Type type, const SizedPointer& chunk, std::string& compressedOut) const {
+    if (policy(type) == kRaw) {
+        return false;
+    }
+
+    std::shared_ptr<Dictionary> dictionary;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_typeDictionaries.find(type);
+        if (found != m_typeDictionaries.end()) {
+            dictionary = found->second;
+        }
+    }
+
+    compressedOut.assign(kHeaderSize + ZSTD_compressBound(chunk.size()), '\0');
+    std::memcpy(&compressedOut[0], kCompressedMagic, kHeaderSize);
+    std::unique_ptr<ZSTD_CCtx, size_t(*)(ZSTD_CCtx*)> context(ZSTD_createCCtx(), ZSTD_freeCCtx);
+    size_t size = 0;
+    if (dictionary) {
+        size = ZSTD_compress_usingCDict(context.get(), &compressedOut[kHeaderSize], compressedOut.size() - kHeaderSize,
+            chunk.data(), chunk.size(), dictionary->compressDictionary);
+    } else {
+        size = ZSTD_compressCCtx(context.get(), &compressedOut[kHeaderSize], compressedOut.size() - kHeaderSize,
+            chunk.data(), chunk.size(), m_level);
+    }
+    if (ZSTD_isError(size)) {
+        LOG(ERROR) << "failed to compress chunk: " << ZSTD_getErrorName(size);
+        return false;
+    }
+
+    // Chunks that don't get smaller are stored raw, which is also cheaper to read.
+    if (kHeaderSize + size >= chunk.size()) {
+        return false;
+    }
+    compressedOut.resize(kHeaderSize + size);
+    return true;
+}
+
+bool ChunkCodec::decompress(const SizedPointer& stored, std::string& chunkOut) const {
+    if (!isCompressed(stored)) {
+        return false;
+    }
+    const char* frame = stored.dataChar() + kHeaderSize;
+    size_t frameSize = stored.size() - kHeaderSize;
+    unsigned long long chunkSize = ZSTD_getFrameContentSize(frame, frameSize);
+    if (chunkSize == ZSTD_CONTENTSIZE_UNKNOWN || chunkSize == ZSTD_CONTENTSIZE_ERROR || chunkSize > kMaxChunkSize) {
+        LOG(ERROR) << "compressed chunk has bad frame header.";
+        return false;
+    }
+
+    std::shared_ptr<Dictionary> dictionary;
+    uint32_t id = ZSTD_getDictID_fromFrame(frame, frameSize);
+    if (id != 0) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_idDictionaries.find(id);
+        if (found == m_idDictionaries.end()) {
+            LOG(ERROR) << "compressed chunk needs missing dictionary " << id;
+            return false;
+        }
+        dictionary = found->second;
+    }
+
+    chunkOut.assign(chunkSize, '\0');
+    std::unique_ptr<ZSTD_DCtx, size_t(*)(ZSTD_DCtx*)> context(ZSTD_createDCtx(), ZSTD_freeDCtx);
+    size_t size = 0;
+    if (dictionary) {
+        size = ZSTD_decompress_usingDDict(context.get(), &chunkOut[0], chunkOut.size(), frame, frameSize,
+            dictionary->decompressDictionary);
+    } else {
+        size = ZSTD_decompressDCtx(context.get(), &chunkOut[0], chunkOut.size(), frame, frameSize);
+    }
+    if (ZSTD_isError(size) || size != chunkSize) {
+        LOG(ERROR) << "failed to decompress chunk: " << (ZSTD_isError(size) ? ZSTD_getErrorName(size) : "short frame");
+        return false;
+    }
+    return true;
+}
+
+}  // namespace Confab
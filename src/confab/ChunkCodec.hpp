@@ -0,0 +1,137 @@
+#ifndef SRC_CONFAB_CHUNK_CODEC_HPP_
+#define SRC_CONFAB_CHUNK_CODEC_HPP_
+
+#include "Asset.hpp"
+#include "SizedPointer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Confab {
+
+/*! Compresses and decompresses stored AssetData chunks, following a policy keyed on the type of their Asset.
+ *
+ * Samples and images are already compressed by their file formats, so their chunks are stored raw. Text Assets such
+ * as snippets and YAML are compressed with zstd, using a dictionary trained on earlier chunks of the same type once
+ * one has been added. Chunks are small, so a dictionary makes most of the difference in how well they compress.
+ *
+ * Compressed chunks start with a short header that can't begin a FlatAssetData, followed by a zstd frame, which records
+ * the ID of the dictionary it was compressed with, if any. Raw chunks are stored as they are, so every stored chunk
+ * records its own codec, and chunks stored before compression was added still read as raw.
+ */
+class ChunkCodec {
+public:
+    /*! How a chunk is stored.
+     */
+    enum Codec : uint8_t {
+        kRaw = 0,
+        kZstd = 1
+    };
+
+    /*! Size in bytes of the header starting every compressed chunk.
+     */
+    static constexpr size_t kHeaderSize = 4;
+
+    /*! Default zstd compression level. Chunks are compressed once on upload and decompressed on every read, and zstd
+     * decompression speed doesn't depend on the level, so a fairly high level is affordable.
+     */
+    static constexpr int kDefaultLevel = 9;
+
+    /*! Largest decompressed chunk accepted, to guard against corrupt frame headers.
+     */
+    static constexpr size_t kMaxChunkSize = 1024 * 1024;
+
+    /*! The codec chunks of an Asset type are stored with.
+     *
+     * \param type The type of the Asset.
+     * \return kRaw for types whose files are already compressed, kZstd for the rest.
+     */
+    static Codec policy(Asset::Type type);
+
+    /*! Trains a compression dictionary from example chunks.
+     *
+     * \param samples Chunks of Assets of the type the dictionary is for.
+     * \param maxSize The largest dictionary to train, in bytes.
+     * \return The dictionary, or an empty string if there were too few samples to train one.
+     */
+    static std::string trainDictionary(const std::vector<std::string>& samples, size_t maxSize);
+
+    /*! Reads the ID of a dictionary returned by trainDictionary().
+     *
+     * \param dictionary The dictionary.
+     * \return The ID recorded in chunks compressed with dictionary, or 0 if dictionary isn't valid.
+     */
+    static uint32_t dictionaryId(const std::string& dictionary);
+
+    /*! Checks if a stored chunk was compressed.
+     *
+     * \param stored The chunk as stored.
+     * \return true if stored starts with the compressed chunk header.
+     */
+    static bool isCompressed(const SizedPointer& stored);
+
+    /*! Constructs a ChunkCodec with no dictionaries.
+     *
+     * \param level The zstd compression level.
+     */
+    explicit ChunkCodec(int level = kDefaultLevel);
+
+    /*! Frees all dictionaries.
+     */
+    ~ChunkCodec();
+
+    /*! Adds a dictionary, used to compress chunks of type from now on, and to decompress any chunks compressed with it.
+     *
+     * \param type The Asset type the dictionary was trained for.
+     * \param dictionary A dictionary returned by trainDictionary().
+     * \return true on success, false if dictionary isn't a valid zstd dictionary.
+     */
+    bool addDictionary(Asset::Type type, const std::string& dictionary);
+
+    /*! Checks if a dictionary has been added for an Asset type.
+     *
+     * \param type The Asset type.
+     * \return true if chunks of type are compressed with a dictionary.
+     */
+    bool hasDictionary(Asset::Type type) const;
+
+    /*! Compresses a chunk, if the policy for its type calls for it and it gets smaller.
+     *
+     * \param type The type of the Asset the chunk belongs to.
+     * \param chunk The FlatAssetData chunk to compress.
+     * \param compressedOut Replaced with the compressed chunk, including header, if compressed.
+     * \return true if chunk was compressed in to compressedOut, false if it should be stored raw.
+     */
+    bool compress(Asset::Type type, const SizedPointer& chunk, std::string& compressedOut) const;
+
+    /*! Decompresses a chunk compressed by compress().
+     *
+     * \param stored The chunk as stored, which must satisfy isCompressed().
+     * \param chunkOut Replaced with the decompressed FlatAssetData chunk.
+     * \return true on success, false if stored is corrupt or needs a dictionary that hasn't been added.
+     */
+    bool decompress(const SizedPointer& stored, std::string& chunkOut) const;
+
+    /// @cond UNDOCUMENTED
+    ChunkCodec(const ChunkCodec&) = delete;
+    ChunkCodec& operator=(const ChunkCodec&) = delete;
+    /// @endcond UNDOCUMENTED
+
+private:
+    class Dictionary;
+
+    int m_level;
+    // Guards both dictionary maps. Dictionaries themselves are immutable once added, and shared while in use.
+    mutable std::mutex m_mutex;
+    std::map<uint32_t, std::shared_ptr<Dictionary>> m_typeDictionaries;
+    std::map<uint32_t, std::shared_ptr<Dictionary>> m_idDictionaries;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_CHUNK_CODEC_HPP_
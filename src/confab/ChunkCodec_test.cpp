@@ -0,0 +1,104 @@
+#include "ChunkCodec.hpp"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Makes a snippet-like chunk of SuperCollider code, varying in its numbers and names.
+std::string makeSnippet(std::mt19937& generator) {
+    std::uniform_int_distribution<int> number(0, 9999);
+    std::string snippet;
+    for (auto i = 0; i < 8; ++i) {
+        snippet += "Pbindef(\\pattern" + std::to_string(number(generator)) + ", \\instrument, \\default, \\freq, "
+            "Pseq([" + std::to_string(number(generator)) + ", " + std::to_string(number(generator)) + "], inf), "
+            "\\dur, " + std::to_string(number(generator) % 8) + ").play;\n";
+    }
+    return snippet;
+}
+
+Confab::SizedPointer pointerTo(const std::string& data) {
+    return Confab::SizedPointer(data.data(), data.size());
+}
+
+}  // namespace
+
+TEST(ChunkCodecTest, Policy) {
+    EXPECT_EQ(Confab::ChunkCodec::kRaw, Confab::ChunkCodec::policy(Confab::Asset::kSample));
+    EXPECT_EQ(Confab::ChunkCodec::kRaw, Confab::ChunkCodec::policy(Confab::Asset::kImage));
+    EXPECT_EQ(Confab::ChunkCodec::kZstd, Confab::ChunkCodec::policy(Confab::Asset::kSnippet));
+    EXPECT_EQ(Confab::ChunkCodec::kZstd, Confab::ChunkCodec::policy(Confab::Asset::kYAML));
+}
+
+TEST(ChunkCodecTest, RoundTripWithoutDictionary) {
+    std::mt19937 generator(1);
+    std::string chunk = makeSnippet(generator);
+    Confab::ChunkCodec codec;
+    std::string compressed;
+    ASSERT_TRUE(codec.compress(Confab::Asset::kSnippet, pointerTo(chunk), compressed));
+    EXPECT_LT(compressed.size(), chunk.size());
+    EXPECT_TRUE(Confab::ChunkCodec::isCompressed(pointerTo(compressed)));
+    EXPECT_FALSE(Confab::ChunkCodec::isCompressed(pointerTo(chunk)));
+
+    std::string decompressed;
+    ASSERT_TRUE(codec.decompress(pointerTo(compressed), decompressed));
+    EXPECT_EQ(chunk, decompressed);
+
+    // Samples are stored raw, whatever their contents.
+    EXPECT_FALSE(codec.compress(Confab::Asset::kSample, pointerTo(chunk), compressed));
+}
+
+TEST(ChunkCodecTest, StoresIncompressibleChunksRaw) {
+    std::mt19937 generator(2);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::string chunk(512, '\0');
+    for (auto& c : chunk) {
+        c = static_cast<char>(byte(generator));
+    }
+    Confab::ChunkCodec codec;
+    std::string compressed;
+    EXPECT_FALSE(codec.compress(Confab::Asset::kYAML, pointerTo(chunk), compressed));
+}
+
+TEST(ChunkCodecTest, RoundTripWithDictionary) {
+    std::mt19937 generator(3);
+    std::vector<std::string> samples;
+    for (auto i = 0; i < 1000; ++i) {
+        samples.push_back(makeSnippet(generator));
+    }
+    std::string dictionary = Confab::ChunkCodec::trainDictionary(samples, 8192);
+    ASSERT_FALSE(dictionary.empty());
+    EXPECT_NE(0u, Confab::ChunkCodec::dictionaryId(dictionary));
+
+    std::string chunk = makeSnippet(generator);
+    Confab::ChunkCodec plainCodec;
+    std::string plain;
+    ASSERT_TRUE(plainCodec.compress(Confab::Asset::kSnippet, pointerTo(chunk), plain));
+
+    Confab::ChunkCodec codec;
+    EXPECT_FALSE(codec.hasDictionary(Confab::Asset::kSnippet));
+    ASSERT_TRUE(codec.addDictionary(Confab::Asset::kSnippet, dictionary));
+    EXPECT_TRUE(codec.hasDictionary(Confab::Asset::kSnippet));
+    EXPECT_FALSE(codec.hasDictionary(Confab::Asset::kYAML));
+    std::string compressed;
+    ASSERT_TRUE(codec.compress(Confab::Asset::kSnippet, pointerTo(chunk), compressed));
+    EXPECT_LT(compressed.size(), plain.size());
+
+    std::string decompressed;
+    ASSERT_TRUE(codec.decompress(pointerTo(compressed), decompressed));
+    EXPECT_EQ(chunk, decompressed);
+
+    // Chunks compressed with a dictionary can't be read without it, but those compressed without still can.
+    EXPECT_FALSE(plainCodec.decompress(pointerTo(compressed), decompressed));
+    ASSERT_TRUE(codec.decompress(pointerTo(plain), decompressed));
+    EXPECT_EQ(chunk, decompressed);
+}
+
+TEST(ChunkCodecTest, RejectsInvalidDictionary) {
+    Confab::ChunkCodec codec;
+    EXPECT_FALSE(codec.addDictionary(Confab::Asset::kSnippet, std::string(1024, 'x')));
+    EXPECT_FALSE(codec.hasDictionary(Confab::Asset::kSnippet));
+}
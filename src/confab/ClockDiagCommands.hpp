@@ -0,0 +1,19 @@
+#ifndef SRC_CONFAB_CLOCK_DIAG_COMMANDS_HPP_
+#define SRC_CONFAB_CLOCK_DIAG_COMMANDS_HPP_
+
+#include <string>
+
+namespace Confab {
+
+enum ClockDiagCommands : int {
+    kDiagReport,
+    kDiagGetSummary,
+    kDiagDump,
+    kDiagNotFound
+};
+
+ClockDiagCommands getClockDiagCommandNamed(const std::string& name);
+
+} // namespace Confab
+
+#endif // SRC_CONFAB_CLOCK_DIAG_COMMANDS_HPP_
@@ -0,0 +1,116 @@
+#ifndef SRC_CONFAB_CLOCK_DIAGNOSTIC_RING_HPP_
+#define SRC_CONFAB_CLOCK_DIAGNOSTIC_RING_HPP_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Confab {
+
+/*! One clock diagnostic report as recorded by the server. All values are in seconds, except beatError in beats.
+ */
+struct ClockDiagnosticSample {
+    /*! Server-local time the report was received.
+     */
+    double receiveTime;
+
+    /*! The reporting client's timeDiff, the offset from server time to its local time.
+     */
+    double offset;
+
+    /*! The client's current clock sync round trip time estimate.
+     */
+    double roundTripTime;
+
+    /*! The difference between the client TempoClock beats and the beats computed from the shared clock state.
+     */
+    double beatError;
+};
+
+/*! Header-only fixed-size ring of the most recent ClockDiagnosticSample reports from a single client.
+ *
+ * Supports one writer and any number of concurrent readers without locks. The writer never waits, and readers take
+ * a snapshot by copying the ring and then discarding any entries the writer may have overwritten during the copy.
+ */
+class ClockDiagnosticRing {
+public:
+    /*! The number of samples retained, must be a power of two.
+     */
+    static constexpr size_t kCapacity = 4096;
+
+    /*! Constructs an empty ring.
+     */
+    ClockDiagnosticRing() : m_head(0) { }
+
+    /*! Appends a sample, overwriting the oldest sample if the ring is full. Only call from a single writer thread.
+     *
+     * \param sample The sample to append.
+     */
+    void push(const ClockDiagnosticSample& sample) {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        Slot& slot = m_slots[head & (kCapacity - 1)];
+        slot.receiveTime.store(sample.receiveTime, std::memory_order_relaxed);
+        slot.offset.store(sample.offset, std::memory_order_relaxed);
+        slot.roundTripTime.store(sample.roundTripTime, std::memory_order_relaxed);
+        slot.beatError.store(sample.beatError, std::memory_order_relaxed);
+        m_head.store(head + 1, std::memory_order_release);
+    }
+
+    /*! The total number of samples ever pushed, including those since overwritten.
+     *
+     * \return The count of pushed samples.
+     */
+    uint64_t total() const { return m_head.load(std::memory_order_acquire); }
+
+    /*! Copies the retained samples, oldest first, into samplesOut. Safe to call concurrently with push().
+     *
+     * \param samplesOut A vector to replace the contents of with the retained samples.
+     */
+    void snapshot(std::vector<ClockDiagnosticSample>& samplesOut) const {
+        samplesOut.clear();
+        uint64_t head = m_head.load(std::memory_order_acquire);
+        uint64_t begin = head > kCapacity ? head - kCapacity : 0;
+        samplesOut.reserve(head - begin);
+        for (uint64_t i = begin; i < head; ++i) {
+            const Slot& slot = m_slots[i & (kCapacity - 1)];
+            samplesOut.push_back({
+                slot.receiveTime.load(std::memory_order_relaxed),
+                slot.offset.load(std::memory_order_relaxed),
+                slot.roundTripTime.load(std::memory_order_relaxed),
+                slot.beatError.load(std::memory_order_relaxed) });
+        }
+
+        // Any entry the writer could have reached while we were copying may be torn, including the one it may be
+        // writing right now, so drop those from the front.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t newHead = m_head.load(std::memory_order_relaxed);
+        uint64_t safeBegin = newHead + 1 > kCapacity ? newHead + 1 - kCapacity : 0;
+        if (safeBegin > begin) {
+            size_t torn = std::min(static_cast<size_t>(safeBegin - begin), samplesOut.size());
+            samplesOut.erase(samplesOut.begin(), samplesOut.begin() + torn);
+        }
+    }
+
+    /// @cond UNDOCUMENTED
+    ClockDiagnosticRing(const ClockDiagnosticRing&) = delete;
+    ClockDiagnosticRing& operator=(const ClockDiagnosticRing&) = delete;
+    /// @endcond UNDOCUMENTED
+
+private:
+    struct Slot {
+        std::atomic<double> receiveTime;
+        std::atomic<double> offset;
+        std::atomic<double> roundTripTime;
+        std::atomic<double> beatError;
+    };
+
+    std::array<Slot, kCapacity> m_slots;
+    std::atomic<uint64_t> m_head;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_CLOCK_DIAGNOSTIC_RING_HPP_
@@ -0,0 +1,45 @@
+#include "ClockDiagnosticRing.hpp"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+TEST(ClockDiagnosticRingTest, EmptySnapshot) {
+    std::unique_ptr<Confab::ClockDiagnosticRing> ring(new Confab::ClockDiagnosticRing);
+    std::vector<Confab::ClockDiagnosticSample> samples = { { 1.0, 2.0, 3.0, 4.0 } };
+    ring->snapshot(samples);
+    EXPECT_TRUE(samples.empty());
+    EXPECT_EQ(0u, ring->total());
+}
+
+TEST(ClockDiagnosticRingTest, SnapshotInOrder) {
+    std::unique_ptr<Confab::ClockDiagnosticRing> ring(new Confab::ClockDiagnosticRing);
+    for (auto i = 0; i < 10; ++i) {
+        ring->push({ static_cast<double>(i), 0.5, 0.001, -0.25 });
+    }
+    std::vector<Confab::ClockDiagnosticSample> samples;
+    ring->snapshot(samples);
+    ASSERT_EQ(10u, samples.size());
+    for (auto i = 0; i < 10; ++i) {
+        EXPECT_EQ(static_cast<double>(i), samples[i].receiveTime);
+        EXPECT_EQ(0.5, samples[i].offset);
+        EXPECT_EQ(0.001, samples[i].roundTripTime);
+        EXPECT_EQ(-0.25, samples[i].beatError);
+    }
+}
+
+TEST(ClockDiagnosticRingTest, OverwritesOldest) {
+    std::unique_ptr<Confab::ClockDiagnosticRing> ring(new Confab::ClockDiagnosticRing);
+    size_t count = Confab::ClockDiagnosticRing::kCapacity + 100;
+    for (size_t i = 0; i < count; ++i) {
+        ring->push({ static_cast<double>(i), 0.0, 0.0, 0.0 });
+    }
+    EXPECT_EQ(count, ring->total());
+    std::vector<Confab::ClockDiagnosticSample> samples;
+    ring->snapshot(samples);
+    // The oldest remaining entry may be overwritten by the next push, so is dropped from the snapshot.
+    ASSERT_EQ(Confab::ClockDiagnosticRing::kCapacity - 1, samples.size());
+    EXPECT_EQ(101.0, samples.front().receiveTime);
+    EXPECT_EQ(static_cast<double>(count - 1), samples.back().receiveTime);
+}
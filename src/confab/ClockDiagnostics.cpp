@@ -0,0 +1,358 @@
+#include "ClockDiagnostics.hpp"
+
+#include "ClockDiagCommands.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <vector>
+
+namespace {
+
+/*! Argument count of a /sclorkClockDiag report from an SCLOrkClock that does not send round trip time or beat error.
+ */
+static const int kLegacyReportArgs = 17;
+
+/*! Argument count of a full /sclorkClockDiag report.
+ */
+static const int kReportArgs = 21;
+
+double doubleFromHalves(lo_arg** argv, int index) {
+    uint64_t bits = (static_cast<uint64_t>(static_cast<uint32_t>(argv[index]->i)) << 32) |
+        static_cast<uint32_t>(argv[index + 1]->i);
+    double value = 0.0;
+    std::memcpy(&value, &bits, sizeof(double));
+    return value;
+}
+
+// Expects values to be sorted.
+double percentile(const std::vector<double>& values, double fraction) {
+    if (values.empty()) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    size_t index = std::min(static_cast<size_t>(fraction * values.size()), values.size() - 1);
+    return values[index];
+}
+
+// Least squares slope of y against x, or zero if x has no variance.
+double slope(const std::vector<double>& x, const std::vector<double>& y) {
+    if (x.size() < 2) {
+        return 0.0;
+    }
+    double meanX = 0.0;
+    double meanY = 0.0;
+    for (size_t i = 0; i < x.size(); ++i) {
+        meanX += x[i];
+        meanY += y[i];
+    }
+    meanX /= x.size();
+    meanY /= y.size();
+    double covariance = 0.0;
+    double variance = 0.0;
+    for (size_t i = 0; i < x.size(); ++i) {
+        covariance += (x[i] - meanX) * (y[i] - meanY);
+        variance += (x[i] - meanX) * (x[i] - meanX);
+    }
+    return variance > 0.0 ? covariance / variance : 0.0;
+}
+
+}  // namespace
+
+namespace Confab {
+
+ClockDiagnostics::ClockDiagnostics() :
+    m_udpThread(nullptr),
+    m_udpServer(nullptr),
+    m_startTime(std::chrono::steady_clock::now()),
+    m_clientCount(0),
+    m_dumpRunning(false) {
+}
+
+ClockDiagnostics::~ClockDiagnostics() {
+}
+
+bool ClockDiagnostics::create(const std::string& bindPort, const std::string& dumpPath) {
+    m_dumpPath = dumpPath;
+    m_udpThread = lo_server_thread_new(bindPort.data(), loError);
+    if (!m_udpThread) {
+        spdlog::error("Unable to create OSC listener on UDP port {}", bindPort);
+        return false;
+    }
+    m_udpServer = lo_server_thread_get_server(m_udpThread);
+
+    lo_server_thread_add_method(m_udpThread, nullptr, nullptr, loHandle, this);
+
+    spdlog::info("ClockDiagnostics listening on UDP port {}", bindPort);
+    return true;
+}
+
+bool ClockDiagnostics::run() {
+    if (lo_server_thread_start(m_udpThread) < 0) {
+        spdlog::error("Failed to start ClockDiagnostics OSC dispatcher thread.");
+        return false;
+    }
+    return true;
+}
+
+void ClockDiagnostics::stop() {
+    if (lo_server_thread_stop(m_udpThread) < 0) {
+        spdlog::error("Failed to stop ClockDiagnostics OSC dispatcher UDP thread.");
+    }
+    if (m_dumpThread.joinable()) {
+        m_dumpThread.join();
+    }
+}
+
+void ClockDiagnostics::destroy() {
+    if (m_udpThread) {
+        lo_server_thread_free(m_udpThread);
+        m_udpThread = nullptr;
+    }
+}
+
+int ClockDiagnostics::dumpCsv(const std::string& path) const {
+    std::ofstream outFile(path, std::ios::out | std::ios::trunc);
+    if (!outFile) {
+        spdlog::error("error opening clock diagnostics file {} for writing.", path);
+        return -1;
+    }
+
+    int written = 0;
+    outFile << "host,cohort,receiveTime,offset,roundTripTime,beatError\n";
+    std::vector<ClockDiagnosticSample> samples;
+    int clientCount = m_clientCount.load(std::memory_order_acquire);
+    for (auto i = 0; i < clientCount; ++i) {
+        const Client* client = m_clients[i].get();
+        client->ring.snapshot(samples);
+        for (const auto& sample : samples) {
+            outFile << fmt::format("{},{},{:.6f},{:.9f},{:.9f},{:.9f}\n", client->host, client->cohortName,
+                    sample.receiveTime, sample.offset, sample.roundTripTime, sample.beatError);
+            ++written;
+        }
+    }
+
+    if (!outFile) {
+        spdlog::error("error writing clock diagnostics file {}.", path);
+        return -1;
+    }
+    spdlog::info("wrote {} clock diagnostic reports from {} clients to {}", written, clientCount, path);
+    return written;
+}
+
+// static
+void ClockDiagnostics::loError(int number, const char* message, const char* path) {
+    spdlog::error("lo error number: {}, message: {}, path: {}", number, message, path);
+}
+
+// static
+int ClockDiagnostics::loHandle(const char* path, const char* types, lo_arg** argv, int argc, lo_message message,
+        void* userData) {
+    ClockDiagnostics* diagnostics = static_cast<ClockDiagnostics*>(userData);
+    lo_address address = lo_message_get_source(message);
+    diagnostics->handleMessage(path, argc, argv, types, address);
+    return 0;
+}
+
+void ClockDiagnostics::handleMessage(const char* path, int argc, lo_arg** argv, const char* types,
+        lo_address address) {
+    ClockDiagCommands command = getClockDiagCommandNamed(std::string(path));
+    switch (command) {
+    // Input: [ /sclorkClockDiag cohortName (pairs of high, low 32-bit halves of 64-bit doubles) ], as sent by
+    // SCLOrkClock.sendDiagnostic. No response.
+    case kDiagReport: {
+        recordReport(argc, argv, types, address);
+    } break;
+
+    // Input: [ /clockDiagGetSummary ], response [ /clockDiagSetSummary numClients beatErrorSpread maxRoundTripP95
+    // (host cohortName samples offsetJitter offsetDrift roundTripP50 roundTripP95 beatErrorP50 beatErrorP95) ... ]
+    case kDiagGetSummary: {
+        sendSummary(address);
+    } break;
+
+    // Input: [ /clockDiagDump ], writes the CSV file configured on the server, response [ /clockDiagDumped path
+    // reportsWritten ]. The path is never taken from the message, as any host on the network can send one.
+    case kDiagDump: {
+        if (m_dumpPath.empty()) {
+            spdlog::error("/clockDiagDump received from {}:{} but no dump path is configured.",
+                    lo_address_get_hostname(address), lo_address_get_port(address));
+            return;
+        }
+        // Joining a dump still writing would block the dispatcher thread until it finished, so a request arriving
+        // during a dump is dropped instead.
+        if (m_dumpRunning.exchange(true)) {
+            spdlog::warn("/clockDiagDump received from {}:{} while a dump is still being written, ignoring.",
+                    lo_address_get_hostname(address), lo_address_get_port(address));
+            return;
+        }
+        std::string path = m_dumpPath;
+        // The source address is owned by the incoming message, so copy it for the reply from the dump thread.
+        lo_address replyAddress = lo_address_new(lo_address_get_hostname(address), lo_address_get_port(address));
+        // Writing the file can take a while, so do it off the dispatcher thread. Reports keep arriving in the
+        // meantime, which the lock-free rings allow for.
+        if (m_dumpThread.joinable()) {
+            m_dumpThread.join();
+        }
+        m_dumpThread = std::thread([this, path, replyAddress] {
+            int written = dumpCsv(path);
+            if (lo_send_from(replyAddress, m_udpServer, LO_TT_IMMEDIATE, "/clockDiagDumped", "si", path.data(),
+                    written) < 0) {
+                spdlog::error("failed to send /clockDiagDumped to {}:{}", lo_address_get_hostname(replyAddress),
+                        lo_address_get_port(replyAddress));
+            }
+            lo_address_free(replyAddress);
+            m_dumpRunning.store(false);
+        });
+    } break;
+
+    case kDiagNotFound: {
+        spdlog::error("received unsupported OSC command {} from {}:{}", path, lo_address_get_hostname(address),
+                lo_address_get_port(address));
+    } break;
+    }
+}
+
+void ClockDiagnostics::recordReport(int argc, lo_arg** argv, const char* types, lo_address address) {
+    if ((argc != kLegacyReportArgs && argc != kReportArgs) || types[0] != LO_STRING) {
+        spdlog::error("/sclorkClockDiag arguments absent or wrong type.");
+        return;
+    }
+    for (auto i = 1; i < argc; ++i) {
+        if (types[i] != LO_INT32) {
+            spdlog::error("/sclorkClockDiag argument {} wrong type.", i);
+            return;
+        }
+    }
+
+    std::string host(lo_address_get_hostname(address));
+    std::string cohortName(reinterpret_cast<const char*>(argv[0]));
+    std::string clientKey = host + "/" + cohortName;
+    int index = 0;
+    auto indexEntry = m_clientIndex.find(clientKey);
+    if (indexEntry == m_clientIndex.end()) {
+        index = m_clientCount.load(std::memory_order_relaxed);
+        if (index >= kMaxClients) {
+            spdlog::error("dropping clock diagnostic from {}, already tracking maximum of {} clients.", clientKey,
+                    kMaxClients);
+            return;
+        }
+        m_clients[index].reset(new Client);
+        m_clients[index]->host = host;
+        m_clients[index]->cohortName = cohortName;
+        m_clientIndex[clientKey] = index;
+        m_clientCount.store(index + 1, std::memory_order_release);
+        spdlog::info("tracking clock diagnostics for new client {}", clientKey);
+    } else {
+        index = indexEntry->second;
+    }
+
+    ClockDiagnosticSample sample;
+    sample.receiveTime = now();
+    sample.offset = doubleFromHalves(argv, 7);
+    if (argc == kReportArgs) {
+        sample.roundTripTime = doubleFromHalves(argv, 17);
+        sample.beatError = doubleFromHalves(argv, 19);
+    } else {
+        sample.roundTripTime = std::numeric_limits<double>::quiet_NaN();
+        sample.beatError = std::numeric_limits<double>::quiet_NaN();
+    }
+    m_clients[index]->ring.push(sample);
+}
+
+void ClockDiagnostics::sendSummary(lo_address address) {
+    struct ClientSummary {
+        const Client* client;
+        int32_t samples;
+        double offsetJitter;
+        double offsetDrift;
+        double roundTripP50;
+        double roundTripP95;
+        double beatErrorP50;
+        double beatErrorP95;
+    };
+
+    std::vector<ClockDiagnosticSample> samples;
+    std::vector<double> times;
+    std::vector<double> offsets;
+    std::vector<double> roundTrips;
+    std::vector<double> beatErrors;
+    double minBeatError = std::numeric_limits<double>::max();
+    double maxBeatError = std::numeric_limits<double>::lowest();
+    double maxRoundTripP95 = 0.0;
+
+    int clientCount = m_clientCount.load(std::memory_order_acquire);
+    std::vector<ClientSummary> summaries;
+    summaries.reserve(clientCount);
+    for (auto i = 0; i < clientCount; ++i) {
+        const Client* client = m_clients[i].get();
+        client->ring.snapshot(samples);
+        times.clear();
+        offsets.clear();
+        roundTrips.clear();
+        beatErrors.clear();
+        for (const auto& sample : samples) {
+            times.push_back(sample.receiveTime);
+            offsets.push_back(sample.offset);
+            if (!std::isnan(sample.roundTripTime)) {
+                roundTrips.push_back(sample.roundTripTime);
+            }
+            if (!std::isnan(sample.beatError)) {
+                beatErrors.push_back(std::abs(sample.beatError));
+            }
+        }
+
+        ClientSummary summary;
+        summary.client = client;
+        summary.samples = static_cast<int32_t>(samples.size());
+        // Compute drift before sorting offsets, as it needs them paired with their receive times.
+        summary.offsetDrift = slope(times, offsets);
+        std::sort(offsets.begin(), offsets.end());
+        std::sort(roundTrips.begin(), roundTrips.end());
+        std::sort(beatErrors.begin(), beatErrors.end());
+        summary.offsetJitter = percentile(offsets, 0.95) - percentile(offsets, 0.05);
+        summary.roundTripP50 = percentile(roundTrips, 0.5);
+        summary.roundTripP95 = percentile(roundTrips, 0.95);
+        summary.beatErrorP50 = percentile(beatErrors, 0.5);
+        summary.beatErrorP95 = percentile(beatErrors, 0.95);
+
+        if (!beatErrors.empty()) {
+            minBeatError = std::min(minBeatError, summary.beatErrorP50);
+            maxBeatError = std::max(maxBeatError, summary.beatErrorP50);
+        }
+        if (!roundTrips.empty()) {
+            maxRoundTripP95 = std::max(maxRoundTripP95, summary.roundTripP95);
+        }
+        summaries.push_back(summary);
+    }
+
+    lo_message message = lo_message_new();
+    lo_message_add_int32(message, clientCount);
+    lo_message_add_float(message, maxBeatError >= minBeatError ? maxBeatError - minBeatError : 0.0);
+    lo_message_add_float(message, maxRoundTripP95);
+    for (const auto& summary : summaries) {
+        lo_message_add_string(message, summary.client->host.data());
+        lo_message_add_string(message, summary.client->cohortName.data());
+        lo_message_add_int32(message, summary.samples);
+        lo_message_add_float(message, summary.offsetJitter);
+        lo_message_add_float(message, summary.offsetDrift);
+        lo_message_add_float(message, summary.roundTripP50);
+        lo_message_add_float(message, summary.roundTripP95);
+        lo_message_add_float(message, summary.beatErrorP50);
+        lo_message_add_float(message, summary.beatErrorP95);
+    }
+
+    if (lo_send_message_from(address, m_udpServer, "/clockDiagSetSummary", message) < 0) {
+        spdlog::error("failed to send /clockDiagSetSummary to {}:{}", lo_address_get_hostname(address),
+                lo_address_get_port(address));
+    }
+    lo_message_free(message);
+}
+
+double ClockDiagnostics::now() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_startTime).count();
+}
+
+} // namespace Confab
@@ -0,0 +1,91 @@
+#ifndef SRC_CONFAB_CLOCK_DIAGNOSTICS_HPP_
+#define SRC_CONFAB_CLOCK_DIAGNOSTICS_HPP_
+
+#include "ClockDiagnosticRing.hpp"
+
+#include "lo/lo.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace Confab {
+
+/*! Collects /sclorkClockDiag reports from every SCLOrkClock in the ensemble over UDP, and keeps the most recent
+ * reports per client in lock-free rings for summary and later analysis.
+ *
+ * Clients are identified by reporting host and clock cohort name. Summaries of the ensemble spread are returned on
+ * request with [ /clockDiagGetSummary ], and all retained reports can be written to the CSV file configured on the
+ * server with [ /clockDiagDump ].
+ */
+class ClockDiagnostics {
+public:
+    ClockDiagnostics();
+    ~ClockDiagnostics();
+
+    /*! Creates the OSC listener.
+     *
+     * \param bindPort The UDP port to listen on.
+     * \param dumpPath The file [ /clockDiagDump ] writes to, or empty to ignore that command.
+     * \return true on success, false on error.
+     */
+    bool create(const std::string& bindPort, const std::string& dumpPath = std::string());
+
+    bool run();
+
+    void stop();
+    void destroy();
+
+    /*! Writes every retained report from every client to a CSV file. Safe to call from any thread while running.
+     *
+     * \param path The path of the file to write.
+     * \return The number of reports written, or -1 on error.
+     */
+    int dumpCsv(const std::string& path) const;
+
+private:
+    static void loError(int number, const char* message, const char* path);
+    static int loHandle(const char* path, const char* types, lo_arg** argv, int argc, lo_message message,
+                        void* userData);
+
+    void handleMessage(const char* path, int argc, lo_arg** argv, const char* types, lo_address address);
+
+    void recordReport(int argc, lo_arg** argv, const char* types, lo_address address);
+    void sendSummary(lo_address address);
+
+    // Seconds since this object was constructed.
+    double now() const;
+
+    lo_server_thread m_udpThread;
+    lo_server m_udpServer;
+    std::chrono::steady_clock::time_point m_startTime;
+
+    struct Client {
+        std::string host;
+        std::string cohortName;
+        ClockDiagnosticRing ring;
+    };
+
+    // Client slots are only ever appended, by the OSC dispatcher thread, and published to readers by incrementing
+    // m_clientCount, so readers can iterate [0, m_clientCount) without locking.
+    static const int kMaxClients = 256;
+    std::array<std::unique_ptr<Client>, kMaxClients> m_clients;
+    std::atomic<int> m_clientCount;
+
+    // Only accessed on the OSC dispatcher thread.
+    std::unordered_map<std::string, int> m_clientIndex;
+
+    std::string m_dumpPath;
+    std::thread m_dumpThread;
+    // Set by the OSC dispatcher thread when starting m_dumpThread, and cleared by m_dumpThread as its last action, so
+    // the dispatcher only ever joins a dump that has already finished.
+    std::atomic<bool> m_dumpRunning;
+};
+
+} // namespace Confab
+
+#endif // SRC_CONFAB_CLOCK_DIAGNOSTICS_HPP_
@@ -0,0 +1,162 @@
+#include "ClockEstimator.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+/*! Burst minima with round trip times more than this multiple of the window minimum are excluded from regression.
+ */
+static const double kRoundTripRejectFactor = 2.0;
+
+/*! Samples are never rejected for round trip times within this many seconds of the window minimum, which keeps the
+ * filter from discarding almost everything on a quiet loopback or LAN link where round trip times are tiny.
+ */
+static const double kRoundTripRejectFloor = 0.0005;
+
+double median(std::vector<double>& values) {
+    size_t middle = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + middle, values.end());
+    double upper = values[middle];
+    if (values.size() % 2 == 1) {
+        return upper;
+    }
+    double lower = *std::max_element(values.begin(), values.begin() + middle);
+    return 0.5 * (lower + upper);
+}
+
+}  // namespace
+
+namespace Confab {
+
+ClockEstimator::ClockEstimator(size_t windowSize, double smoothing) :
+    m_windowSize(std::max(windowSize, static_cast<size_t>(1))),
+    m_smoothing(std::min(std::max(smoothing, 0.0), 1.0)),
+    m_valid(false),
+    m_reference(0.0),
+    m_offset(0.0),
+    m_drift(0.0) {
+}
+
+void ClockEstimator::beginBurst() {
+    m_burst.clear();
+}
+
+void ClockEstimator::addSample(const ClockSample& sample) {
+    if (sample.roundTripTime() >= 0.0) {
+        m_burst.push_back(sample);
+    }
+}
+
+bool ClockEstimator::endBurst(double now) {
+    if (m_burst.empty()) {
+        return false;
+    }
+
+    auto best = std::min_element(m_burst.begin(), m_burst.end(), [](const ClockSample& a, const ClockSample& b) {
+        return a.roundTripTime() < b.roundTripTime();
+    });
+    m_window.push_back(*best);
+    while (m_window.size() > m_windowSize) {
+        m_window.pop_front();
+    }
+    m_burst.clear();
+
+    double fitOffset = 0.0;
+    double fitDrift = 0.0;
+    if (!fit(fitOffset, fitDrift)) {
+        return false;
+    }
+
+    // The fit describes offset as a function of time relative to the most recent sample. Re-reference it to now.
+    double fitReference = m_window.back().localMidpoint();
+    double fitOffsetNow = fitOffset + (fitDrift * (now - fitReference));
+
+    if (!m_valid || m_smoothing >= 1.0) {
+        m_offset = fitOffsetNow;
+        m_drift = fitDrift;
+        m_valid = true;
+    } else {
+        double publishedOffsetNow = m_offset + (m_drift * (now - m_reference));
+        m_offset = publishedOffsetNow + (m_smoothing * (fitOffsetNow - publishedOffsetNow));
+        m_drift = m_drift + (m_smoothing * (fitDrift - m_drift));
+    }
+    m_reference = now;
+    return true;
+}
+
+double ClockEstimator::localToServer(double localTime) const {
+    return localTime + m_offset + (m_drift * (localTime - m_reference));
+}
+
+double ClockEstimator::serverToLocal(double serverTime) const {
+    // Invert serverTime = localTime * (1 + drift) + offset - (drift * reference).
+    return (serverTime - m_offset + (m_drift * m_reference)) / (1.0 + m_drift);
+}
+
+double ClockEstimator::minRoundTripTime() const {
+    if (m_window.empty()) {
+        return 0.0;
+    }
+    double minimum = std::numeric_limits<double>::max();
+    for (const auto& sample : m_window) {
+        minimum = std::min(minimum, sample.roundTripTime());
+    }
+    return minimum;
+}
+
+// static
+void ClockEstimator::theilSen(const std::vector<double>& x, const std::vector<double>& y, double& slopeOut,
+        double& interceptOut) {
+    slopeOut = 0.0;
+    interceptOut = 0.0;
+    if (x.empty() || x.size() != y.size()) {
+        return;
+    }
+
+    std::vector<double> slopes;
+    slopes.reserve((x.size() * (x.size() - 1)) / 2);
+    for (size_t i = 0; i < x.size(); ++i) {
+        for (size_t j = i + 1; j < x.size(); ++j) {
+            double dx = x[j] - x[i];
+            if (dx != 0.0) {
+                slopes.push_back((y[j] - y[i]) / dx);
+            }
+        }
+    }
+    if (slopes.size() > 0) {
+        slopeOut = median(slopes);
+    }
+
+    std::vector<double> intercepts(x.size());
+    for (size_t i = 0; i < x.size(); ++i) {
+        intercepts[i] = y[i] - (slopeOut * x[i]);
+    }
+    interceptOut = median(intercepts);
+}
+
+bool ClockEstimator::fit(double& offsetOut, double& driftOut) const {
+    if (m_window.empty()) {
+        return false;
+    }
+
+    double minRtt = minRoundTripTime();
+    double maxRtt = std::max(minRtt * kRoundTripRejectFactor, minRtt + kRoundTripRejectFloor);
+    double reference = m_window.back().localMidpoint();
+
+    std::vector<double> x;
+    std::vector<double> y;
+    x.reserve(m_window.size());
+    y.reserve(m_window.size());
+    for (const auto& sample : m_window) {
+        if (sample.roundTripTime() <= maxRtt) {
+            x.push_back(sample.localMidpoint() - reference);
+            y.push_back(sample.offset());
+        }
+    }
+
+    theilSen(x, y, driftOut, offsetOut);
+    return true;
+}
+
+}  // namespace Confab
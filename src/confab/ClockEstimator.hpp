@@ -0,0 +1,151 @@
+#ifndef SRC_CONFAB_CLOCK_ESTIMATOR_HPP_
+#define SRC_CONFAB_CLOCK_ESTIMATOR_HPP_
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+namespace Confab {
+
+/*! A single round trip of the /clockSyncGet protocol. All times are in seconds.
+ */
+struct ClockSample {
+    /*! Local time at which the /clockSyncGet request was sent.
+     */
+    double localSend;
+
+    /*! Server time as reported in the /clockSyncSet response.
+     */
+    double serverTime;
+
+    /*! Local time at which the /clockSyncSet response was received.
+     */
+    double localReceive;
+
+    /*! The round trip time of this exchange.
+     *
+     * \return The elapsed local time between request and response.
+     */
+    double roundTripTime() const { return localReceive - localSend; }
+
+    /*! The local time assumed to correspond to serverTime, halfway between request and response.
+     *
+     * \return The midpoint in local time of this exchange.
+     */
+    double localMidpoint() const { return 0.5 * (localSend + localReceive); }
+
+    /*! The implied offset from local to server time, such that serverTime = localTime + offset.
+     *
+     * \return The offset in seconds implied by this sample.
+     */
+    double offset() const { return serverTime - localMidpoint(); }
+};
+
+/*! Estimates the offset and drift between the local clock and the clock server from NTP-style bursts of samples.
+ *
+ * Each burst of samples contributes only the sample with the smallest round trip time, as that is the sample with
+ * the least queueing delay and so the tightest bound on the true offset. The burst minima are kept in a sliding
+ * window, any with round trip times well above the window minimum are discarded, and a Theil-Sen regression of offset
+ * against local time fits the offset and drift. The fit is robust to the occasional outlier that survives filtering.
+ *
+ * The published mapping is then slewed towards each new fit by an exponential smoothing factor, so that consumers of
+ * the mapping never see a step change in server time.
+ *
+ * Not thread-safe, callers are expected to provide their own synchronization.
+ */
+class ClockEstimator {
+public:
+    /*! Constructs an empty ClockEstimator.
+     *
+     * \param windowSize The number of burst minimum samples to retain for regression.
+     * \param smoothing A value in (0, 1] describing how far to move the published mapping towards each new fit. A
+     *                  value of 1 means no smoothing.
+     */
+    ClockEstimator(size_t windowSize, double smoothing);
+
+    /*! Discards any samples collected for the current burst and starts a new one.
+     */
+    void beginBurst();
+
+    /*! Adds a sample to the current burst.
+     *
+     * \param sample The completed round trip sample. Samples with negative round trip times are ignored.
+     */
+    void addSample(const ClockSample& sample);
+
+    /*! Completes the current burst, committing its minimum round trip time sample to the window and re-fitting.
+     *
+     * \param now The current local time, used as the reference point for slewing the published mapping.
+     * \return true if the mapping was updated, false if the burst had no valid samples.
+     */
+    bool endBurst(double now);
+
+    /*! True once at least one burst has produced a mapping.
+     *
+     * \return true if the mapping is valid.
+     */
+    bool valid() const { return m_valid; }
+
+    /*! Maps a local time to the estimated server time.
+     *
+     * \param localTime A local time in seconds.
+     * \return The estimated server time in seconds.
+     */
+    double localToServer(double localTime) const;
+
+    /*! Maps a server time to the estimated local time.
+     *
+     * \param serverTime A server time in seconds.
+     * \return The estimated local time in seconds.
+     */
+    double serverToLocal(double serverTime) const;
+
+    /*! The estimated drift of the server clock relative to the local clock, in seconds per second.
+     *
+     * \return The smoothed drift estimate.
+     */
+    double drift() const { return m_drift; }
+
+    /*! The smallest round trip time of the samples currently in the window.
+     *
+     * \return The minimum round trip time in seconds, or zero if no samples.
+     */
+    double minRoundTripTime() const;
+
+    /*! The number of burst minimum samples currently in the window.
+     *
+     * \return Count of samples available for regression.
+     */
+    size_t windowSamples() const { return m_window.size(); }
+
+    /*! Computes a Theil-Sen fit of y = intercept + slope * x, exposed for testing.
+     *
+     * \param x The independent values.
+     * \param y The dependent values, must be the same size as x.
+     * \param slopeOut Output for the median pairwise slope, zero if fewer than two distinct x values.
+     * \param interceptOut Output for the median residual intercept.
+     */
+    static void theilSen(const std::vector<double>& x, const std::vector<double>& y, double& slopeOut,
+        double& interceptOut);
+
+private:
+    // Fits the window, providing offset at the local midpoint of the newest sample plus drift. Returns false on empty
+    // window.
+    bool fit(double& offsetOut, double& driftOut) const;
+
+    const size_t m_windowSize;
+    const double m_smoothing;
+
+    std::vector<ClockSample> m_burst;
+    std::deque<ClockSample> m_window;
+
+    bool m_valid;
+    // The published mapping is serverTime = localTime + m_offset + m_drift * (localTime - m_reference).
+    double m_reference;
+    double m_offset;
+    double m_drift;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_CLOCK_ESTIMATOR_HPP_
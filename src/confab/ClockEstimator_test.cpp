@@ -0,0 +1,76 @@
+#include "ClockEstimator.hpp"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+TEST(ClockEstimatorTest, TheilSenExactLine) {
+    std::vector<double> x = { 0.0, 1.0, 2.0, 3.0, 4.0 };
+    std::vector<double> y = { 1.0, 1.5, 2.0, 2.5, 3.0 };
+    double slope = 0.0;
+    double intercept = 0.0;
+    Confab::ClockEstimator::theilSen(x, y, slope, intercept);
+    EXPECT_DOUBLE_EQ(0.5, slope);
+    EXPECT_DOUBLE_EQ(1.0, intercept);
+}
+
+TEST(ClockEstimatorTest, TheilSenIgnoresOutlier) {
+    std::vector<double> x = { 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0 };
+    std::vector<double> y = { 2.0, 2.0, 2.0, 100.0, 2.0, 2.0, 2.0 };
+    double slope = 1.0;
+    double intercept = 0.0;
+    Confab::ClockEstimator::theilSen(x, y, slope, intercept);
+    EXPECT_DOUBLE_EQ(0.0, slope);
+    EXPECT_DOUBLE_EQ(2.0, intercept);
+}
+
+TEST(ClockEstimatorTest, InvalidUntilFirstBurst) {
+    Confab::ClockEstimator estimator(16, 1.0);
+    EXPECT_FALSE(estimator.valid());
+    estimator.beginBurst();
+    EXPECT_FALSE(estimator.endBurst(0.0));
+    EXPECT_FALSE(estimator.valid());
+}
+
+TEST(ClockEstimatorTest, KeepsMinimumRoundTripSample) {
+    Confab::ClockEstimator estimator(16, 1.0);
+    // True offset is 100 seconds. The slow samples have asymmetric delays that bias their implied offsets.
+    estimator.beginBurst();
+    estimator.addSample({ 10.0, 110.09, 10.1 });
+    estimator.addSample({ 11.0, 111.001, 11.002 });
+    estimator.addSample({ 12.0, 112.2, 12.3 });
+    ASSERT_TRUE(estimator.endBurst(12.3));
+    EXPECT_TRUE(estimator.valid());
+    EXPECT_EQ(1, estimator.windowSamples());
+    EXPECT_NEAR(0.002, estimator.minRoundTripTime(), 1e-12);
+    EXPECT_NEAR(120.0, estimator.localToServer(20.0), 1e-9);
+    EXPECT_NEAR(20.0, estimator.serverToLocal(120.0), 1e-9);
+}
+
+TEST(ClockEstimatorTest, FitsDrift) {
+    Confab::ClockEstimator estimator(32, 1.0);
+    // Server clock runs 100 ppm fast and 5 seconds ahead of the local clock.
+    const double drift = 1e-4;
+    for (auto i = 0; i < 20; ++i) {
+        double local = i * 10.0;
+        estimator.beginBurst();
+        estimator.addSample({ local, (local + 0.001) * (1.0 + drift) + 5.0, local + 0.002 });
+        ASSERT_TRUE(estimator.endBurst(local + 0.002));
+    }
+    EXPECT_NEAR(drift, estimator.drift(), 1e-9);
+    EXPECT_NEAR((300.0 * (1.0 + drift)) + 5.0, estimator.localToServer(300.0), 1e-6);
+}
+
+TEST(ClockEstimatorTest, SmoothingSlewsMapping) {
+    Confab::ClockEstimator estimator(1, 0.5);
+    estimator.beginBurst();
+    estimator.addSample({ 0.0, 10.0, 0.0 });
+    ASSERT_TRUE(estimator.endBurst(0.0));
+    EXPECT_DOUBLE_EQ(11.0, estimator.localToServer(1.0));
+
+    // A one second step in offset only moves the published mapping halfway.
+    estimator.beginBurst();
+    estimator.addSample({ 1.0, 12.0, 1.0 });
+    ASSERT_TRUE(estimator.endBurst(1.0));
+    EXPECT_DOUBLE_EQ(11.5, estimator.localToServer(1.0));
+}
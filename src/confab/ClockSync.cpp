@@ -0,0 +1,267 @@
+#include "ClockSync.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+/*! How long to wait for a /clockSyncSet response before giving up on that round trip.
+ */
+static const std::chrono::milliseconds kResponseTimeout(250);
+
+/*! Pause between round trips within a burst, so that the burst itself doesn't cause queueing on the responder.
+ */
+static const std::chrono::milliseconds kBurstSpacing(5);
+
+/*! Number of burst minimum samples the estimator keeps for regression.
+ */
+static const size_t kEstimatorWindow = 64;
+
+/*! Fraction of the distance to move the published mapping towards each new fit.
+ */
+static const double kEstimatorSmoothing = 0.25;
+
+// sclang has no 64-bit integer or double OSC argument support, so doubles are sent as two 32-bit halves of the IEEE
+// bit pattern, reassembled on the sclang side with Float.from64Bits(high, low).
+void addDouble(lo_message message, double value) {
+    uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(double));
+    lo_message_add_int32(message, static_cast<int32_t>(bits >> 32));
+    lo_message_add_int32(message, static_cast<int32_t>(bits & 0xffffffff));
+}
+
+double doubleFromHalves(int32_t high, int32_t low) {
+    uint64_t bits = (static_cast<uint64_t>(static_cast<uint32_t>(high)) << 32) | static_cast<uint32_t>(low);
+    double value = 0.0;
+    std::memcpy(&value, &bits, sizeof(double));
+    return value;
+}
+
+}  // namespace
+
+namespace Confab {
+
+ClockSync::ClockSync(const std::string& syncHost, int syncPort, int publishPort, int burstSize, int burstPeriodMs,
+        int publishRateHz) :
+    m_syncHost(syncHost),
+    m_syncPort(syncPort),
+    m_publishPort(publishPort),
+    m_burstSize(std::max(burstSize, 1)),
+    m_burstPeriod(std::chrono::milliseconds(burstPeriodMs)),
+    m_publishPeriod(std::chrono::microseconds(1000000 / std::max(publishRateHz, 1))),
+    m_udpThread(nullptr),
+    m_udpServer(nullptr),
+    m_syncAddress(nullptr),
+    m_publishAddress(nullptr),
+    m_quit(false),
+    m_awaitingResponse(false),
+    m_responseReady(false),
+    m_response{0.0, 0.0, 0.0},
+    m_estimator(kEstimatorWindow, kEstimatorSmoothing) {
+}
+
+ClockSync::~ClockSync() {
+}
+
+bool ClockSync::create() {
+    // Bind to any available port, it is supplied to the responder with each request.
+    m_udpThread = lo_server_thread_new(nullptr, loError);
+    if (!m_udpThread) {
+        spdlog::error("Unable to create OSC listener for clock sync responses.");
+        return false;
+    }
+    m_udpServer = lo_server_thread_get_server(m_udpThread);
+    lo_server_thread_add_method(m_udpThread, "/clockSyncSet", "ii", loHandleSyncSet, this);
+
+    m_syncAddress = lo_address_new(m_syncHost.data(), std::to_string(m_syncPort).data());
+    m_publishAddress = lo_address_new("127.0.0.1", std::to_string(m_publishPort).data());
+    if (!m_syncAddress || !m_publishAddress) {
+        spdlog::error("Unable to create OSC addresses for clock sync.");
+        return false;
+    }
+
+    spdlog::info("ClockSync receiving on UDP port {}, syncing against {}:{}, publishing to localhost:{}",
+            lo_server_thread_get_port(m_udpThread), m_syncHost, m_syncPort, m_publishPort);
+    return true;
+}
+
+bool ClockSync::run() {
+    if (lo_server_thread_start(m_udpThread) < 0) {
+        spdlog::error("Failed to start ClockSync OSC dispatcher thread.");
+        return false;
+    }
+
+    m_quit = false;
+    m_burstThread = std::thread(&ClockSync::burstLoop, this);
+    m_publishThread = std::thread(&ClockSync::publishLoop, this);
+    return true;
+}
+
+void ClockSync::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_quitMutex);
+        m_quit = true;
+    }
+    m_quitCondition.notify_all();
+    m_responseCondition.notify_all();
+
+    if (m_burstThread.joinable()) {
+        m_burstThread.join();
+    }
+    if (m_publishThread.joinable()) {
+        m_publishThread.join();
+    }
+
+    if (lo_server_thread_stop(m_udpThread) < 0) {
+        spdlog::error("Failed to stop ClockSync OSC dispatcher thread.");
+    }
+}
+
+void ClockSync::destroy() {
+    if (m_udpThread) {
+        lo_server_thread_free(m_udpThread);
+        m_udpThread = nullptr;
+    }
+    if (m_syncAddress) {
+        lo_address_free(m_syncAddress);
+        m_syncAddress = nullptr;
+    }
+    if (m_publishAddress) {
+        lo_address_free(m_publishAddress);
+        m_publishAddress = nullptr;
+    }
+}
+
+// static
+void ClockSync::loError(int number, const char* message, const char* path) {
+    spdlog::error("lo error number: {}, message: {}, path: {}", number, message, path);
+}
+
+// static
+int ClockSync::loHandleSyncSet(const char* path, const char* types, lo_arg** argv, int argc, lo_message message,
+        void* userData) {
+    double receiveTime = now();
+    ClockSync* clockSync = static_cast<ClockSync*>(userData);
+    double serverTime = doubleFromHalves(argv[0]->i, argv[1]->i);
+
+    {
+        std::lock_guard<std::mutex> lock(clockSync->m_responseMutex);
+        // Responses carry no request identifier, so any response arriving after its request timed out is dropped.
+        if (!clockSync->m_awaitingResponse) {
+            spdlog::warn("dropping unexpected /clockSyncSet response.");
+            return 0;
+        }
+        clockSync->m_response.serverTime = serverTime;
+        clockSync->m_response.localReceive = receiveTime;
+        clockSync->m_awaitingResponse = false;
+        clockSync->m_responseReady = true;
+    }
+    clockSync->m_responseCondition.notify_one();
+    return 0;
+}
+
+// static
+double ClockSync::now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void ClockSync::burstLoop() {
+    while (!m_quit) {
+        auto burstStart = std::chrono::steady_clock::now();
+
+        {
+            std::lock_guard<std::mutex> lock(m_estimatorMutex);
+            m_estimator.beginBurst();
+        }
+
+        int responses = 0;
+        for (auto i = 0; i < m_burstSize && !m_quit; ++i) {
+            ClockSample sample;
+            if (roundTrip(sample)) {
+                std::lock_guard<std::mutex> lock(m_estimatorMutex);
+                m_estimator.addSample(sample);
+                ++responses;
+            } else {
+                // A late response to this request could otherwise be mistaken for the response to the next one, so
+                // wait out another timeout period before sending again.
+                std::unique_lock<std::mutex> lock(m_quitMutex);
+                m_quitCondition.wait_for(lock, kResponseTimeout, [this] { return m_quit.load(); });
+            }
+            std::unique_lock<std::mutex> lock(m_quitMutex);
+            m_quitCondition.wait_for(lock, kBurstSpacing, [this] { return m_quit.load(); });
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_estimatorMutex);
+            double burstEnd = now();
+            if (m_estimator.endBurst(burstEnd)) {
+                spdlog::info("clock sync burst {} of {} responses, offset {:.6f}s, drift {:.3e}, min rtt {:.6f}s",
+                        responses, m_burstSize, m_estimator.localToServer(burstEnd) - burstEnd, m_estimator.drift(),
+                        m_estimator.minRoundTripTime());
+            } else {
+                spdlog::warn("clock sync burst got no responses from {}:{}", m_syncHost, m_syncPort);
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(m_quitMutex);
+        m_quitCondition.wait_until(lock, burstStart + m_burstPeriod, [this] { return m_quit.load(); });
+    }
+}
+
+void ClockSync::publishLoop() {
+    auto nextPublish = std::chrono::steady_clock::now();
+    while (!m_quit) {
+        bool valid = false;
+        double serverTime = 0.0;
+        double drift = 0.0;
+        double minRoundTripTime = 0.0;
+        {
+            std::lock_guard<std::mutex> lock(m_estimatorMutex);
+            valid = m_estimator.valid();
+            serverTime = m_estimator.localToServer(now());
+            drift = m_estimator.drift();
+            minRoundTripTime = m_estimator.minRoundTripTime();
+        }
+
+        if (valid) {
+            lo_message update = lo_message_new();
+            addDouble(update, serverTime);
+            addDouble(update, drift);
+            addDouble(update, minRoundTripTime);
+            if (lo_send_message_from(m_publishAddress, m_udpServer, "/clockSyncUpdate", update) < 0) {
+                spdlog::error("failed to publish /clockSyncUpdate to localhost:{}", m_publishPort);
+            }
+            lo_message_free(update);
+        }
+
+        nextPublish += m_publishPeriod;
+        std::unique_lock<std::mutex> lock(m_quitMutex);
+        m_quitCondition.wait_until(lock, nextPublish, [this] { return m_quit.load(); });
+    }
+}
+
+bool ClockSync::roundTrip(ClockSample& sampleOut) {
+    std::unique_lock<std::mutex> lock(m_responseMutex);
+    m_responseReady = false;
+    m_awaitingResponse = true;
+    m_response.localSend = now();
+    if (lo_send_from(m_syncAddress, m_udpServer, LO_TT_IMMEDIATE, "/clockSyncGet", "i",
+            lo_server_thread_get_port(m_udpThread)) < 0) {
+        spdlog::error("failed to send /clockSyncGet to {}:{}", m_syncHost, m_syncPort);
+        m_awaitingResponse = false;
+        return false;
+    }
+
+    if (!m_responseCondition.wait_for(lock, kResponseTimeout, [this] { return m_responseReady || m_quit.load(); })
+        || !m_responseReady) {
+        m_awaitingResponse = false;
+        return false;
+    }
+
+    sampleOut = m_response;
+    return true;
+}
+
+} // namespace Confab
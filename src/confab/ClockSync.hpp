@@ -0,0 +1,108 @@
+#ifndef SRC_CONFAB_CLOCK_SYNC_HPP_
+#define SRC_CONFAB_CLOCK_SYNC_HPP_
+
+#include "ClockEstimator.hpp"
+
+#include "lo/lo.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace Confab {
+
+/*! Runs NTP-style /clockSyncGet bursts against an SCLOrkClockServer sync responder, and publishes the resulting
+ * smoothed local to server time mapping to sclang over OSC at a fixed rate.
+ *
+ * The mapping is published as [ /clockSyncUpdate serverTime drift minRoundTripTime ], with each value a 64-bit double
+ * split into high and low 32-bit integers, the same way /clockSyncSet does. The serverTime is the estimated server
+ * time at the moment of sending, so the receiver can compute its own offset by subtracting it from the time of
+ * receipt, as the localhost delivery latency is negligible compared to the network round trip.
+ */
+class ClockSync {
+public:
+    /*! Constructs a ClockSync service.
+     *
+     * \param syncHost The hostname or address of the sync responder.
+     * \param syncPort The UDP port of the sync responder.
+     * \param publishPort The localhost UDP port to publish /clockSyncUpdate messages to.
+     * \param burstSize The number of round trips in each burst.
+     * \param burstPeriodMs The time in milliseconds between the start of each burst.
+     * \param publishRateHz The number of /clockSyncUpdate messages to publish per second.
+     */
+    ClockSync(const std::string& syncHost, int syncPort, int publishPort, int burstSize, int burstPeriodMs,
+            int publishRateHz);
+    ~ClockSync();
+
+    /*! Opens the UDP socket used to receive responses from the sync responder.
+     *
+     * \return true on success, false on error.
+     */
+    bool create();
+
+    /*! Starts the OSC dispatcher, burst, and publishing threads.
+     *
+     * \return true on success, false on error.
+     */
+    bool run();
+
+    /*! Stops all threads. Blocks until they have exited.
+     */
+    void stop();
+
+    /*! Frees the UDP socket and associated resources.
+     */
+    void destroy();
+
+private:
+    static void loError(int number, const char* message, const char* path);
+    static int loHandleSyncSet(const char* path, const char* types, lo_arg** argv, int argc, lo_message message,
+                               void* userData);
+
+    // Local monotonic time in seconds.
+    static double now();
+
+    void burstLoop();
+    void publishLoop();
+
+    // Sends one /clockSyncGet and waits for the response. Returns false on timeout.
+    bool roundTrip(ClockSample& sampleOut);
+
+    std::string m_syncHost;
+    int m_syncPort;
+    int m_publishPort;
+    int m_burstSize;
+    std::chrono::milliseconds m_burstPeriod;
+    std::chrono::microseconds m_publishPeriod;
+
+    lo_server_thread m_udpThread;
+    lo_server m_udpServer;
+    lo_address m_syncAddress;
+    lo_address m_publishAddress;
+
+    std::atomic<bool> m_quit;
+    std::thread m_burstThread;
+    std::thread m_publishThread;
+
+    // Protects the in-flight request state, used with m_responseCondition to hand responses to the burst thread.
+    std::mutex m_responseMutex;
+    std::condition_variable m_responseCondition;
+    bool m_awaitingResponse;
+    bool m_responseReady;
+    ClockSample m_response;
+
+    // Protects m_estimator, which is updated by the burst thread and read by the publish thread.
+    std::mutex m_estimatorMutex;
+    ClockEstimator m_estimator;
+
+    // Used only to wake sleeping threads on stop().
+    std::mutex m_quitMutex;
+    std::condition_variable m_quitCondition;
+};
+
+} // namespace Confab
+
+#endif // SRC_CONFAB_CLOCK_SYNC_HPP_
@@ -7,6 +7,8 @@
 
 #include "glog/logging.h"
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <memory>
 #include <pthread.h>
@@ -22,8 +24,40 @@ DEFINE_string(data_directory, "../data/confab", "Path where confab will store th
 DEFINE_bool(create_new_database, false, "If true confab will make a new database, if false confab will expect the "
     "database to already exist.");
 DEFINE_int32(database_cache_size_mb, 4, "Size in megabytes of the memory cache the database should use.");
-
-const char* kConfigKey = "confab-db-config";
+DEFINE_int32(data_cache_size_mb, 8, "Size in megabytes of the memory cache the database should use for Asset data "
+    "chunks, separate from the cache for metadata.");
+DEFINE_int32(asset_cache_size_mb, 8, "Size in megabytes of the cache of recently found Assets, in front of the "
+    "database.");
+DEFINE_int32(migration_keys_per_second, 4096, "Limit on the number of database keys schema migrations running in the "
+    "background examine per second, or 0 for no limit.");
+
+// Command line flags for database garbage collection.
+DEFINE_int32(gc_interval_minutes, 0, "Minutes between garbage collection passes over the database, or 0 to disable "
+    "garbage collection. Only for servers, confab clients keep their database as a local cache and leave this off.");
+DEFINE_int32(gc_retain_deprecated, 4, "Number of deprecated versions of each Asset kept by garbage collection.");
+DEFINE_int32(gc_keys_per_second, 2048, "Limit on the number of database keys garbage collection examines per second, "
+    "or 0 for no limit.");
+DEFINE_int32(gc_grace_hours, 24, "Hours garbage collection leaves Asset data from abandoned uploads alone before "
+    "deleting it.");
+DEFINE_bool(gc_incomplete_assets, false, "If true garbage collection also deletes Assets that are missing chunks past "
+    "the grace period. Only for servers, as clients download Asset data a chunk at a time.");
+DEFINE_int32(gc_replication_log_retain, 0, "Number of the most recent replication log entries kept by garbage "
+    "collection, or 0 to keep them all. Followers further behind than this must be copied from the leader again.");
+
+// Command line flags for scrubbing, the check of stored Asset data against its hashes.
+DEFINE_int32(scrub_interval_minutes, 0, "Minutes between scrub passes over the stored Asset data, or 0 to disable "
+    "scrubbing. Only for servers, confab clients leave this off.");
+DEFINE_int32(scrub_mb_per_second, 8, "Limit on the megabytes of Asset data scrubbing reads and hashes per second, or 0 "
+    "for no limit.");
+
+// Command line flags for replication.
+DEFINE_bool(replication_log, false, "If true every Asset, AssetData chunk, and List written to the database is also "
+    "added to the replication log, for follower servers to copy.");
+
+// Command line flags for copying whole databases.
+DEFINE_string(export_pack, "", "If set, write every entry in the database to a pack file at this path, then exit.");
+DEFINE_string(import_pack, "", "If set, load the pack file at this path in to the database, then exit. The database "
+    "must not already hold any Assets, so is best made with --create_new_database.");
 
 namespace Confab {
 
@@ -56,6 +90,20 @@ void ConfabCommon::waitForTerminationSignal() {
     }
 }
 
+bool ConfabCommon::packMode() const {
+    return FLAGS_export_pack.size() > 0 || FLAGS_import_pack.size() > 0;
+}
+
+int ConfabCommon::runPackMode() {
+    if (FLAGS_export_pack.size() > 0 && FLAGS_import_pack.size() > 0) {
+        LOG(ERROR) << "--export_pack and --import_pack can't be used together.";
+        return -1;
+    }
+    bool ok = FLAGS_export_pack.size() > 0 ? m_assetDatabase->exportPack(FLAGS_export_pack) :
+        m_assetDatabase->importPack(FLAGS_import_pack);
+    return ok ? 0 : -1;
+}
+
 void ConfabCommon::shutdown() {
     m_assetDatabase->close();
     // Delete pid sentinel file.
@@ -106,39 +154,30 @@ bool ConfabCommon::setThreadMask() {
 
 bool ConfabCommon::openDatabase() {
     m_assetDatabase.reset(new Confab::AssetDatabase);
+    m_assetDatabase->setMigrationKeysPerSecond(std::max(FLAGS_migration_keys_per_second, 0));
 
     if (!m_assetDatabase->open((FLAGS_data_directory + "/db").c_str(), FLAGS_create_new_database,
-        FLAGS_database_cache_size_mb * 1024 * 1024)) {
+        FLAGS_database_cache_size_mb * 1024 * 1024, FLAGS_data_cache_size_mb * 1024 * 1024,
+        FLAGS_asset_cache_size_mb * 1024 * 1024)) {
         return false;
     }
-
-    /*
-    // If a new database we write the configuration information for the first time. If an existing database we validate
-    // that the version written is equal to or older than our current version.
-    if (FLAGS_create_new_database) {
-        // Verify that no existing configuration information is present.
-        auto configRecord = m_assetDatabase->load(Confab::Config::getConfigKey());
-        if (!configRecord->empty()) {
-            LOG(ERROR) << "Create new database specified by database has an existing config key.";
-            return false;
+    m_assetDatabase->setReplicationLogging(FLAGS_replication_log);
+
+    // A new database records the version of confab that made it. Otherwise the recorded version must be no newer than
+    // this one, and is updated to it. Layout changes between versions are migrated by the database itself, on open.
+    auto configRecord = m_assetDatabase->loadConfig();
+    if (configRecord->empty() || !Confab::Config::Verify(configRecord)) {
+        if (!FLAGS_create_new_database) {
+            LOG(WARNING) << "No valid config record in database, writing one for confab version "
+                << Confab::confabVersion.toString();
         }
-
         Confab::Config config(Confab::confabVersion);
-
-        if (!m_assetDatabase->store(Confab::Config::getConfigKey(), config.flatten())) {
+        if (!m_assetDatabase->storeConfig(config.flatten())) {
             LOG(ERROR) << "Error writing config information to database.";
             return false;
-        } else {
-            LOG(INFO) << "Wrote new config record to database.";
         }
     } else {
-        auto configRecord = m_assetDatabase->load(Confab::Config::getConfigKey());
-        if (configRecord->empty()) {
-            LOG(ERROR) << "Error reaading configuration information from database.";
-            return false;
-        }
         auto config = Confab::Config::LoadConfig(configRecord);
-
         if (config.version() > Confab::confabVersion) {
             LOG(ERROR) << "Database records confab version " << config.version().toString() << " which is newer than "
                 << "confab version " << Confab::confabVersion.toString();
@@ -149,13 +188,30 @@ bool ConfabCommon::openDatabase() {
             LOG(INFO) << "Updating confab version in database " << config.version().toString()
                 << " to confab version " << Confab::confabVersion.toString();
             Confab::Config currentConfig(Confab::confabVersion);
-            if (!m_assetDatabase->store(Confab::Config::getConfigKey(), currentConfig.flatten())) {
+            if (!m_assetDatabase->storeConfig(currentConfig.flatten())) {
                 LOG(ERROR) << "Error writing updated Config record to database.";
                 return false;
             }
         }
     }
-    */
+
+    // Garbage collection runs only when a server asks for it with --gc_interval_minutes, never by default.
+    if (FLAGS_gc_interval_minutes > 0 && !packMode()) {
+        Confab::AssetDatabase::GarbageCollectionOptions options;
+        options.retainDeprecated = std::max(FLAGS_gc_retain_deprecated, 0);
+        options.keysPerSecond = std::max(FLAGS_gc_keys_per_second, 0);
+        options.abandonedGracePeriod = std::chrono::hours(std::max(FLAGS_gc_grace_hours, 0));
+        options.deleteIncompleteAssets = FLAGS_gc_incomplete_assets;
+        options.replicationLogRetain = std::max(FLAGS_gc_replication_log_retain, 0);
+        m_assetDatabase->startGarbageCollection(options, std::chrono::minutes(FLAGS_gc_interval_minutes));
+    }
+
+    // As with garbage collection, scrubbing runs only when a server asks for it.
+    if (FLAGS_scrub_interval_minutes > 0 && !packMode()) {
+        Confab::AssetDatabase::ScrubOptions options;
+        options.bytesPerSecond = static_cast<size_t>(std::max(FLAGS_scrub_mb_per_second, 0)) * 1024 * 1024;
+        m_assetDatabase->startScrubbing(options, std::chrono::minutes(FLAGS_scrub_interval_minutes));
+    }
 
     return true;
 }
@@ -32,6 +32,20 @@ public:
      */
     void shutdown();
 
+    /*! True if the command line asked for the database to be exported to, or imported from, a pack file instead of
+     * running normally. Garbage collection is not started in this case.
+     *
+     * \return true if --export_pack or --import_pack was given.
+     */
+    bool packMode() const;
+
+    /*! Exports or imports the database as asked for on the command line. Import is best done in to a database created
+     * with --create_new_database.
+     *
+     * \return The process exit code, 0 on success or -1 on error.
+     */
+    int runPackMode();
+
     /*! Returns the shared AssetDatabase object.
      *
      * \return The AssetDatabase object.
@@ -23,12 +23,13 @@ namespace Data {
  */
 class Config {
 public:
-    /*! Supplies the unique identifier used to store the singleton config object in the database.
+    /*! Supplies the unique identifier used to store the singleton config object in the database, under the prefix of
+     * database bookkeeping keys.
      *
      * \return The key associated with the Config object.
      */
     static constexpr SizedPointer getConfigKey() {
-        const char* kConfigKey = "confab-db-config";
+        const char* kConfigKey = "mConfig";
         return SizedPointer(kConfigKey, std::strlen(kConfigKey));
     }
 
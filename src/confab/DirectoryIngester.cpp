@@ -0,0 +1,219 @@
+#include "DirectoryIngester.hpp"
+
+#include "Constants.hpp"
+#include "HttpClient.hpp"
+#include "schemas/FlatList_generated.h"
+
+#include "glog/logging.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+/*! File extensions, in lower case, of the audio files SuperCollider can load in to a Buffer.
+ */
+static const char* kSampleExtensions[] = { ".aif", ".aifc", ".aiff", ".flac", ".ogg", ".wav", ".wave" };
+
+/*! File extensions, in lower case, of the image files SuperCollider can load in to an Image.
+ */
+static const char* kImageExtensions[] = { ".bmp", ".gif", ".jpeg", ".jpg", ".png", ".tif", ".tiff" };
+
+bool hasExtension(const fs::path& path, const char* const* extensions, size_t count) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+        [](unsigned char c) { return std::tolower(c); });
+    return std::find_if(extensions, extensions + count, [&extension](const char* candidate) {
+        return extension == candidate;
+    }) != extensions + count;
+}
+
+}  // namespace
+
+namespace Confab {
+
+DirectoryIngester::DirectoryIngester(std::shared_ptr<HttpClient> httpClient, int numThreads) :
+    m_httpClient(httpClient),
+    m_numThreads(numThreads > 0 ? numThreads : std::max(1u, std::thread::hardware_concurrency())) {
+}
+
+bool DirectoryIngester::ingest(const fs::path& root, Asset::Type type, const std::string& listName, uint64_t author,
+    Summary& summaryOut) {
+    summaryOut = Summary{ 0, 0, 0, 0, 0 };
+
+    std::vector<fs::path> files = findFiles(root, type);
+    summaryOut.files = files.size();
+    if (files.size() == 0) {
+        LOG(ERROR) << "no files to ingest found under " << root;
+        return false;
+    }
+
+    // Re-publishing a directory appends to the existing List, so it keeps the key others may already have. Assets
+    // already in the List are not added again.
+    uint64_t listKey = 0;
+    m_httpClient->getNamedList(listName, [&listKey](RecordPtr record) {
+        if (!record->empty()) {
+            listKey = Data::GetFlatList(record->data().data())->key();
+        }
+    });
+    std::unordered_set<uint64_t> listAssets;
+    if (listKey != 0) {
+        loadListAssets(listKey, listAssets);
+    } else {
+        listKey = m_httpClient->postList(listName);
+        if (listKey == 0) {
+            LOG(ERROR) << "unable to create list " << listName << " for ingest of " << root;
+            return false;
+        }
+    }
+    summaryOut.listKey = listKey;
+    std::string listIds = Asset::keyToString(listKey);
+
+    LOG(INFO) << "ingesting " << files.size() << " files from " << root << " in to list " << listName << " ("
+        << listIds << ") with " << m_numThreads << " threads.";
+
+    std::atomic<size_t> nextFile(0);
+    std::atomic<size_t> uploaded(0);
+    std::atomic<size_t> existing(0);
+    std::atomic<size_t> failed(0);
+    // Guards listAssets and claimedKeys.
+    std::mutex listMutex;
+    std::unordered_set<uint64_t> claimedKeys;
+    std::vector<std::thread> workers;
+    int numWorkers = std::min(m_numThreads, static_cast<int>(files.size()));
+    for (auto i = 0; i < numWorkers; ++i) {
+        workers.emplace_back([this, &files, &nextFile, &uploaded, &existing, &failed, &root, &listName, &listIds,
+            &listAssets, &listMutex, &claimedKeys, listKey, type, author] {
+            HttpClient::FileHash fileHash;
+            for (size_t index = nextFile++; index < files.size(); index = nextFile++) {
+                const fs::path& path = files[index];
+                if (!HttpClient::hashFile(path, fileHash)) {
+                    ++failed;
+                    continue;
+                }
+
+                // Identical files within the directory share a key, so only the worker that hashes the first of them
+                // to finish goes on to check, upload and add it, and the rest are counted with the files the server
+                // already has.
+                bool claimed = false;
+                {
+                    std::lock_guard<std::mutex> lock(listMutex);
+                    claimed = claimedKeys.insert(fileHash.key).second;
+                }
+                if (!claimed) {
+                    LOG(INFO) << "skipping " << path << ", identical to another file in " << root << " as "
+                        << Asset::keyToString(fileHash.key);
+                    ++existing;
+                    continue;
+                }
+
+                if (m_httpClient->hasAsset(fileHash.key)) {
+                    LOG(INFO) << "server already has " << path << " as " << Asset::keyToString(fileHash.key);
+                    bool inList = false;
+                    {
+                        std::lock_guard<std::mutex> lock(listMutex);
+                        inList = !listAssets.insert(fileHash.key).second;
+                    }
+                    if (inList || m_httpClient->postListItem(listKey, fileHash.key)) {
+                        ++existing;
+                    } else {
+                        ++failed;
+                    }
+                    continue;
+                }
+
+                std::string relative = path.string().substr(root.string().size());
+                while (relative.size() && relative[0] == fs::path::preferred_separator) {
+                    relative = relative.substr(1);
+                }
+                std::string name = listName + "/" + fs::path(relative).generic_string();
+                uint64_t key = m_httpClient->postFileAsset(type, name, author, 0, listIds, path, fileHash);
+                if (key == fileHash.key) {
+                    ++uploaded;
+                } else {
+                    ++failed;
+                }
+            }
+        });
+    }
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    summaryOut.uploaded = uploaded;
+    summaryOut.existing = existing;
+    summaryOut.failed = failed;
+    LOG(INFO) << "ingest of " << root << " complete, " << summaryOut.uploaded << " uploaded, " << summaryOut.existing
+        << " already on server, " << summaryOut.failed << " failed.";
+    return summaryOut.failed == 0;
+}
+
+void DirectoryIngester::loadListAssets(uint64_t listKey, std::unordered_set<uint64_t>& assetsOut) {
+    uint64_t token = kBeginList;
+    while (token != kEndList) {
+        size_t pairs = 0;
+        m_httpClient->getListItems(listKey, token, [&token, &pairs, &assetsOut](const std::string& items) {
+            std::istringstream itemStream(items);
+            std::string tokenString, assetString;
+            while (itemStream >> tokenString >> assetString) {
+                token = Asset::stringToKey(tokenString);
+                if (token != kEndList) {
+                    assetsOut.insert(Asset::stringToKey(assetString));
+                }
+                ++pairs;
+            }
+        });
+        // An empty or failed page ends the walk, as there is no token to continue from.
+        if (pairs == 0) {
+            break;
+        }
+    }
+    LOG(INFO) << "list " << Asset::keyToString(listKey) << " already has " << assetsOut.size() << " assets.";
+}
+
+// static
+std::vector<fs::path> DirectoryIngester::findFiles(const fs::path& root, Asset::Type type) {
+    std::vector<fs::path> files;
+    std::error_code error;
+    fs::recursive_directory_iterator entry(root, error);
+    if (error) {
+        LOG(ERROR) << "unable to open directory " << root << " for ingest: " << error.message();
+        return files;
+    }
+
+    for (; entry != fs::recursive_directory_iterator(); entry.increment(error)) {
+        if (error) {
+            LOG(ERROR) << "error walking directory " << root << ": " << error.message();
+            break;
+        }
+        const fs::path& path = entry->path();
+        if (path.filename().string()[0] == '.') {
+            if (fs::is_directory(entry->status())) {
+                entry.disable_recursion_pending();
+            }
+            continue;
+        }
+        if (!fs::is_regular_file(entry->status())) {
+            continue;
+        }
+        if (type == Asset::kSample && !hasExtension(path, kSampleExtensions,
+                sizeof(kSampleExtensions) / sizeof(const char*))) {
+            continue;
+        }
+        if (type == Asset::kImage && !hasExtension(path, kImageExtensions,
+                sizeof(kImageExtensions) / sizeof(const char*))) {
+            continue;
+        }
+        files.push_back(path);
+    }
+
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+}  // namespace Confab
@@ -0,0 +1,98 @@
+#ifndef SRC_CONFAB_DIRECTORY_INGESTER_HPP_
+#define SRC_CONFAB_DIRECTORY_INGESTER_HPP_
+
+#include "Asset.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <experimental/filesystem>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace fs = std::experimental::filesystem;
+
+namespace Confab {
+
+class HttpClient;
+
+/*! Publishes every file in a directory tree as an Asset, all added to one named List.
+ *
+ * Each file is handled start to finish by one of a pool of worker threads, which hashes it, asks the server if it
+ * already has an Asset with that key, and only uploads the file if not. Files already on the server are still added to
+ * the List, unless the List already holds them. Of several identical files, only the first hashed is checked and
+ * uploaded. Having several files in flight at once keeps both the disk and the
+ * HTTP connections busy, and keeps the memory used to hold files between hashing and upload bounded by the number of
+ * workers.
+ */
+class DirectoryIngester {
+public:
+    /*! Counts of what happened to the files in one call to ingest().
+     */
+    struct Summary {
+        /*! The key of the List the Assets were added to, or zero if the List could not be found or created.
+         */
+        uint64_t listKey;
+
+        /*! The number of files found to ingest.
+         */
+        size_t files;
+
+        /*! The number of files uploaded as new Assets.
+         */
+        size_t uploaded;
+
+        /*! The number of files the server already had, which were only added to the List, and of files identical to
+         * another file in the directory.
+         */
+        size_t existing;
+
+        /*! The number of files that failed to hash or upload.
+         */
+        size_t failed;
+    };
+
+    /*! Constructs a DirectoryIngester.
+     *
+     * \param httpClient The shared HttpClient to upload with.
+     * \param numThreads The number of files to process at once. A value <= 0 will use one thread per core.
+     */
+    DirectoryIngester(std::shared_ptr<HttpClient> httpClient, int numThreads);
+
+    /*! Ingests every file in a directory tree. Blocks until all files are processed.
+     *
+     * Files are named on the server by the List name, followed by a slash, followed by their path relative to root,
+     * so they can be found individually by name as well. If a List with the provided name already exists, the files are
+     * added to the end of it, skipping any Assets already in it, otherwise a new List is created.
+     *
+     * \param root The directory to search.
+     * \param type The Asset type to ingest files as. Only files with extensions appropriate to kSample or kImage types
+     *             are ingested for those types.
+     * \param listName The name of the List to add every file to.
+     * \param author An optional Asset key of the author of the files, can be zero.
+     * \param summaryOut Filled with the results of the ingest.
+     * \return true if every file found was successfully ingested, false on any error.
+     */
+    bool ingest(const fs::path& root, Asset::Type type, const std::string& listName, uint64_t author,
+        Summary& summaryOut);
+
+    /*! Finds the files in a directory tree that ingest() would process. Hidden files and directories are skipped.
+     *
+     * \param root The directory to search.
+     * \param type The Asset type, used to filter files by extension.
+     * \return The paths of the files found, in sorted order.
+     */
+    static std::vector<fs::path> findFiles(const fs::path& root, Asset::Type type);
+
+private:
+    // Pages through an existing List on the server, collecting the keys of every Asset in it.
+    void loadListAssets(uint64_t listKey, std::unordered_set<uint64_t>& assetsOut);
+
+    std::shared_ptr<HttpClient> m_httpClient;
+    int m_numThreads;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_DIRECTORY_INGESTER_HPP_
@@ -0,0 +1,101 @@
+#include "EmojiIndex.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+namespace {
+
+// Splits query in to words, keeping only lowercased ASCII alphanumeric characters, to match emoji-trie-gen.
+std::vector<std::string> normalizeQuery(const std::string& query) {
+    std::vector<std::string> words;
+    std::string word;
+    for (char c : query + " ") {
+        if (c == ' ') {
+            if (word.size()) {
+                words.push_back(word);
+            }
+            word.clear();
+        } else if (c > 0 && std::isalnum(static_cast<unsigned char>(c))) {
+            word += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+    }
+    return words;
+}
+
+}  // namespace
+
+namespace Confab {
+
+// static
+size_t EmojiIndex::lookup(const std::string& query, size_t limit, std::vector<Match>& matchesOut) {
+    matchesOut.clear();
+    std::vector<std::string> words = normalizeQuery(query);
+    if (words.empty()) {
+        return 0;
+    }
+
+    std::vector<const Node*> nodes;
+    for (const auto& word : words) {
+        const Node* node = findNode(word);
+        if (!node) {
+            return 0;
+        }
+        nodes.push_back(node);
+    }
+
+    // A subtree's postings can list the same emoji more than once, for instance for "man" and "medium" under "m".
+    // Collecting them in a bitset by record index removes the duplicates, intersects multiple query words cheaply,
+    // and as records are sorted by description also puts the results in description order.
+    std::vector<uint64_t> matched((kRecordCount + 63) / 64, 0);
+    for (auto i = nodes[0]->postingsBegin; i < nodes[0]->postingsEnd; ++i) {
+        matched[kPostings[i] / 64] |= 1ull << (kPostings[i] % 64);
+    }
+    std::vector<uint64_t> wordMatched(matched.size());
+    for (size_t i = 1; i < nodes.size(); ++i) {
+        std::fill(wordMatched.begin(), wordMatched.end(), 0);
+        for (auto j = nodes[i]->postingsBegin; j < nodes[i]->postingsEnd; ++j) {
+            wordMatched[kPostings[j] / 64] |= 1ull << (kPostings[j] % 64);
+        }
+        for (size_t j = 0; j < matched.size(); ++j) {
+            matched[j] &= wordMatched[j];
+        }
+    }
+
+    size_t total = 0;
+    for (size_t i = 0; i < matched.size(); ++i) {
+        uint64_t bits = matched[i];
+        total += __builtin_popcountll(bits);
+        while (bits && matchesOut.size() < limit) {
+            size_t index = (i * 64) + __builtin_ctzll(bits);
+            matchesOut.push_back({ kStrings + kRecords[index].emoji, kStrings + kRecords[index].description });
+            bits &= bits - 1;
+        }
+    }
+    return total;
+}
+
+// static
+const EmojiIndex::Node* EmojiIndex::findNode(const std::string& word) {
+    const Node* node = kNodes;
+    for (char c : word) {
+        const Node* child = nullptr;
+        // Children are sorted by label, and there are at most 36 of them, so a linear scan over adjacent entries is
+        // fast.
+        for (auto i = node->firstChild; i < node->firstChild + node->childCount; ++i) {
+            if (kNodes[i].label == c) {
+                child = kNodes + i;
+                break;
+            }
+            if (kNodes[i].label > c) {
+                break;
+            }
+        }
+        if (!child) {
+            return nullptr;
+        }
+        node = child;
+    }
+    return node;
+}
+
+}  // namespace Confab
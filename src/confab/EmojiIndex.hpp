@@ -0,0 +1,74 @@
+#ifndef SRC_CONFAB_EMOJI_INDEX_HPP_
+#define SRC_CONFAB_EMOJI_INDEX_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Confab {
+
+/*! Read-only search index of emoji by the words in their descriptions, compiled in at build time.
+ *
+ * The emoji-trie-gen tool builds the index from scripts/emoji-test.txt, using the same word normalization as the
+ * SCLOrkEmoji class, into a few flat constant arrays. Each trie node has one lowercase alphanumeric character label,
+ * and the children of a node are contiguous in the node array. The emoji matching every word in a node's subtree are
+ * stored contiguously in a postings array, so a prefix query costs one step per query character to find its node,
+ * then a single pass over that node's postings.
+ */
+class EmojiIndex {
+public:
+    /*! A single search result. Both strings are NUL-terminated UTF-8 and point in to static storage.
+     */
+    struct Match {
+        const char* emoji;
+        const char* description;
+    };
+
+    /*! Finds emoji with descriptions containing words starting with every word in query.
+     *
+     * Query words are normalized in the same manner as the descriptions, so lookup is case-insensitive and ignores
+     * punctuation. Results are in order of description.
+     *
+     * \param query One or more space-separated word prefixes to search for.
+     * \param limit The maximum number of matches to return in matchesOut.
+     * \param matchesOut A vector to replace the contents of with up to limit matches.
+     * \return The total number of emoji matching the query, which may be larger than limit.
+     */
+    static size_t lookup(const std::string& query, size_t limit, std::vector<Match>& matchesOut);
+
+    /*! The number of emoji in the index.
+     *
+     * \return The count of indexed emoji.
+     */
+    static size_t size() { return kRecordCount; }
+
+private:
+    struct Record {
+        uint32_t emoji;
+        uint32_t description;
+    };
+
+    struct Node {
+        uint32_t firstChild;
+        uint32_t postingsBegin;
+        uint32_t postingsEnd;
+        uint8_t childCount;
+        char label;
+    };
+
+    // Returns the node reached by following word from the root, or nullptr if there is none.
+    static const Node* findNode(const std::string& word);
+
+    // Defined in the EmojiIndexData.cpp file generated by emoji-trie-gen.
+    static const char kStrings[];
+    static const Record kRecords[];
+    static const size_t kRecordCount;
+    static const Node kNodes[];
+    static const size_t kNodeCount;
+    static const uint16_t kPostings[];
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_EMOJI_INDEX_HPP_
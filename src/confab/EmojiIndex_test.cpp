@@ -0,0 +1,59 @@
+#include "EmojiIndex.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+TEST(EmojiIndexTest, EmptyQuery) {
+    std::vector<Confab::EmojiIndex::Match> matches;
+    EXPECT_EQ(0u, Confab::EmojiIndex::lookup("", 10, matches));
+    EXPECT_TRUE(matches.empty());
+    EXPECT_EQ(0u, Confab::EmojiIndex::lookup("  !? ", 10, matches));
+    EXPECT_TRUE(matches.empty());
+}
+
+TEST(EmojiIndexTest, NoMatch) {
+    std::vector<Confab::EmojiIndex::Match> matches;
+    EXPECT_EQ(0u, Confab::EmojiIndex::lookup("qqqq", 10, matches));
+    EXPECT_TRUE(matches.empty());
+}
+
+TEST(EmojiIndexTest, UniquePrefix) {
+    std::vector<Confab::EmojiIndex::Match> matches;
+    EXPECT_EQ(1u, Confab::EmojiIndex::lookup("orangu", 10, matches));
+    ASSERT_EQ(1u, matches.size());
+    EXPECT_EQ(std::string("\xf0\x9f\xa6\xa7"), matches[0].emoji);
+    EXPECT_EQ(std::string("orangutan"), matches[0].description);
+}
+
+TEST(EmojiIndexTest, SortedAndDeduplicated) {
+    std::vector<Confab::EmojiIndex::Match> matches;
+    size_t total = Confab::EmojiIndex::lookup("Orange", 100, matches);
+    EXPECT_EQ(6u, total);
+    ASSERT_EQ(6u, matches.size());
+    for (size_t i = 1; i < matches.size(); ++i) {
+        EXPECT_LT(std::string(matches[i - 1].description), std::string(matches[i].description));
+    }
+}
+
+TEST(EmojiIndexTest, LimitDoesNotChangeTotal) {
+    std::vector<Confab::EmojiIndex::Match> matches;
+    size_t total = Confab::EmojiIndex::lookup("hand", 3, matches);
+    EXPECT_GT(total, 3u);
+    EXPECT_EQ(3u, matches.size());
+}
+
+TEST(EmojiIndexTest, MultipleWordsIntersect) {
+    std::vector<Confab::EmojiIndex::Match> matches;
+    size_t handTotal = Confab::EmojiIndex::lookup("wav", 1000, matches);
+    size_t total = Confab::EmojiIndex::lookup("wav hand dark", 1000, matches);
+    EXPECT_LT(total, handTotal);
+    ASSERT_EQ(total, matches.size());
+    for (const auto& match : matches) {
+        std::string description(match.description);
+        EXPECT_NE(std::string::npos, description.find("wav"));
+        EXPECT_NE(std::string::npos, description.find("hand"));
+        EXPECT_NE(std::string::npos, description.find("dark"));
+    }
+}
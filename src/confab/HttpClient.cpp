@@ -14,14 +14,31 @@
 #include "pistache/client.h"
 #include "xxhash.h"
 
+#include <algorithm>
+#include <array>
 #include <cstring>
 #include <experimental/filesystem>
 #include <inttypes.h>
 #include <fstream>
 #include <limits>
+#include <map>
+#include <sstream>
 
 namespace fs = std::experimental::filesystem;
 
+namespace {
+
+/*! Files up to this size are kept in memory between hashing and upload, avoiding a second read from disk.
+ */
+static const size_t kMaxBufferedFileSize = 16 * 1024 * 1024;
+
+/*! Maximum number of Asset keys, or AssetData chunks, to send in a single batch request, matching the limit on the
+ * server.
+ */
+static const size_t kMaxBatchKeys = 64;
+
+}  // namespace
+
 namespace Confab {
 
 /*! Record class to hold the string values returned by Pistache and allow us to deserialize records from them
@@ -72,22 +89,52 @@ private:
     const SizedPointer m_data;
 };
 
-HttpClient::HttpClient(const std::string& serverAddress) :
+HttpClient::HttpClient(const std::string& serverAddress, const std::vector<std::string>& replicaAddresses,
+        const std::vector<std::string>& shardAddresses) :
     m_serverAddress(serverAddress),
     m_client(new Pistache::Http::Client),
-    m_distribution(0, std::numeric_limits<uint64_t>::max()) {
+    m_distribution(0, std::numeric_limits<uint64_t>::max()),
+    m_nextRead(0),
+    m_shardMap(shardAddresses) {
     auto opts = Pistache::Http::Client::options()
         .keepAlive(true)
         .maxConnectionsPerHost(4)
         .threads(4);
     m_client->init(opts);
+
+    m_readAddresses.push_back(m_serverAddress);
+    m_readAddresses.insert(m_readAddresses.end(), replicaAddresses.begin(), replicaAddresses.end());
 }
 
 HttpClient::~HttpClient() {
 }
 
 void HttpClient::getAsset(uint64_t key, std::function<void(uint64_t, RecordPtr)> callback) {
-    std::string request = m_serverAddress + "/asset/id/" + Asset::keyToString(key);
+    const std::string& shard = shardAddress(key);
+    if (shard != m_serverAddress) {
+        getAssetFrom(shard, key, callback);
+        return;
+    }
+    std::string address = readAddress();
+    if (address != m_serverAddress) {
+        bool found = false;
+        getAssetFrom(address, key, [&found, &callback](uint64_t loadedKey, RecordPtr record) {
+            if (!record->empty()) {
+                found = true;
+                callback(loadedKey, record);
+            }
+        });
+        if (found) {
+            return;
+        }
+    }
+    // Replicas can lag behind the leader, so anything not found on one is asked of the leader too.
+    getAssetFrom(m_serverAddress, key, callback);
+}
+
+void HttpClient::getAssetFrom(const std::string& address, uint64_t key,
+    std::function<void(uint64_t, RecordPtr)> callback) {
+    std::string request = address + "/asset/id/" + Asset::keyToString(key);
     LOG(INFO) << "issuing Asset request to " << request;
 
     auto promise = m_client->get(request).send();
@@ -118,7 +165,25 @@ void HttpClient::getAsset(uint64_t key, std::function<void(uint64_t, RecordPtr)>
 }
 
 void HttpClient::getNamedAsset(const std::string& name, std::function<void(RecordPtr)> callback) {
-    std::string request = m_serverAddress + "/asset/name";
+    std::string address = readAddress();
+    if (address != m_serverAddress) {
+        bool found = false;
+        getNamedAssetFrom(address, name, [&found, &callback](RecordPtr record) {
+            if (!record->empty()) {
+                found = true;
+                callback(record);
+            }
+        });
+        if (found) {
+            return;
+        }
+    }
+    getNamedAssetFrom(m_serverAddress, name, callback);
+}
+
+void HttpClient::getNamedAssetFrom(const std::string& address, const std::string& name,
+    std::function<void(RecordPtr)> callback) {
+    std::string request = address + "/asset/name";
     LOG(INFO) << "issuing named Asset for '" << name << "' request to " << request;
 
     // We supply the Asset name in the body of the request to avoid URL encoding issues with names.
@@ -149,10 +214,34 @@ void HttpClient::getNamedAsset(const std::string& name, std::function<void(Recor
 }
 
 void HttpClient::getAssetData(uint64_t key, uint64_t chunk,
+    std::function<void(uint64_t, uint64_t, RecordPtr)> callback) {
+    const std::string& shard = shardAddress(key);
+    if (shard != m_serverAddress) {
+        getAssetDataFrom(shard, key, chunk, callback);
+        return;
+    }
+    std::string address = readAddress();
+    if (address != m_serverAddress) {
+        bool found = false;
+        getAssetDataFrom(address, key, chunk, [&found, &callback](uint64_t loadedKey, uint64_t loadedChunk,
+            RecordPtr record) {
+            if (!record->empty()) {
+                found = true;
+                callback(loadedKey, loadedChunk, record);
+            }
+        });
+        if (found) {
+            return;
+        }
+    }
+    getAssetDataFrom(m_serverAddress, key, chunk, callback);
+}
+
+void HttpClient::getAssetDataFrom(const std::string& address, uint64_t key, uint64_t chunk,
     std::function<void(uint64_t, uint64_t, RecordPtr)> callback) {
     char numBuf[32];
     snprintf(numBuf, 32, "%" PRIu64, chunk);
-    std::string request = m_serverAddress + "/asset/data/" + Asset::keyToString(key) + "/" + std::string(numBuf);
+    std::string request = address + "/asset/data/" + Asset::keyToString(key) + "/" + std::string(numBuf);
     LOG(INFO) << "issuing AssetData request to " << request;
 
     auto promise = m_client->get(request).send();
@@ -182,6 +271,107 @@ void HttpClient::getAssetData(uint64_t key, uint64_t chunk,
     barrier.wait();
 }
 
+void HttpClient::getAssetDataBatch(const std::vector<std::pair<uint64_t, uint64_t>>& keyChunks,
+    std::function<void(uint64_t, uint64_t, RecordPtr)> callback) {
+    std::map<std::string, std::vector<std::pair<uint64_t, uint64_t>>> shardChunks;
+    for (const auto& keyChunk : keyChunks) {
+        shardChunks[shardAddress(keyChunk.first)].push_back(keyChunk);
+    }
+    for (const auto& shard : shardChunks) {
+        if (shard.first != m_serverAddress) {
+            getAssetDataBatchFrom(shard.first, shard.second, callback);
+            continue;
+        }
+        std::string address = readAddress();
+        if (address == m_serverAddress) {
+            getAssetDataBatchFrom(address, shard.second, callback);
+            continue;
+        }
+        std::vector<std::pair<uint64_t, uint64_t>> missing;
+        getAssetDataBatchFrom(address, shard.second, [&missing, &callback](uint64_t key, uint64_t chunk,
+            RecordPtr record) {
+            if (record->empty()) {
+                missing.emplace_back(key, chunk);
+            } else {
+                callback(key, chunk, record);
+            }
+        });
+        if (missing.size() > 0) {
+            getAssetDataBatchFrom(m_serverAddress, missing, callback);
+        }
+    }
+}
+
+void HttpClient::getAssetDataBatchFrom(const std::string& address,
+    const std::vector<std::pair<uint64_t, uint64_t>>& keyChunks,
+    std::function<void(uint64_t, uint64_t, RecordPtr)> callback) {
+    std::string request = address + "/asset/data/batch";
+    size_t next = 0;
+    while (next < keyChunks.size()) {
+        std::string body;
+        size_t batchEnd = std::min(keyChunks.size(), next + kMaxBatchKeys);
+        for (size_t i = next; i < batchEnd; ++i) {
+            body += Asset::keyToString(keyChunks[i].first) + " " + std::to_string(keyChunks[i].second) + "\n";
+        }
+        LOG(INFO) << "issuing batch request for " << (batchEnd - next) << " AssetData chunks to " << request;
+
+        // As with Asset batches, count how many pairs the server answered to know where to resume.
+        size_t answered = 0;
+        auto promise = m_client->post(request)
+            .header<Pistache::Http::Header::ContentType>(MIME(Text, Plain))
+            .body(body)
+            .send();
+        promise.then([&keyChunks, &callback, &request, next, batchEnd, &answered](Pistache::Http::Response response) {
+            if (response.code() != Pistache::Http::Code::Ok) {
+                LOG(ERROR) << "error code " << response.code() << " on AssetData batch request " << request;
+                return;
+            }
+            std::istringstream lines(response.body());
+            std::string line;
+            uint8_t decoded[kPageSize];
+            while (next + answered < batchEnd && std::getline(lines, line)) {
+                uint64_t key = keyChunks[next + answered].first;
+                uint64_t chunk = keyChunks[next + answered].second;
+                std::istringstream fields(line);
+                std::string keyString;
+                uint64_t lineChunk = 0;
+                std::string encoded;
+                if (!(fields >> keyString >> lineChunk) || Asset::stringToKey(keyString) != key || lineChunk != chunk) {
+                    LOG(ERROR) << "out of order response to AssetData batch request " << request;
+                    break;
+                }
+                ++answered;
+                if (!(fields >> encoded)) {
+                    callback(key, chunk, makeEmptyRecord());
+                    continue;
+                }
+                size_t decodedSize = 0;
+                base64_decode(encoded.data(), encoded.size(), reinterpret_cast<char*>(decoded), &decodedSize, 0);
+                auto verifier = flatbuffers::Verifier(decoded, decodedSize);
+                if (Data::VerifyFlatAssetDataBuffer(verifier)) {
+                    callback(key, chunk, RecordPtr(new ClientRecord(decoded, decodedSize)));
+                } else {
+                    LOG(ERROR) << "failed to verify server-provided data for Asset " << Asset::keyToString(key)
+                        << " chunk " << chunk << " in batch request " << request;
+                    callback(key, chunk, makeEmptyRecord());
+                }
+            }
+        }, Pistache::Async::NoExcept);
+
+        Pistache::Async::Barrier barrier(promise);
+        barrier.wait();
+
+        if (answered == 0) {
+            // Error or no progress, fail the remaining pairs.
+            for (size_t i = next; i < keyChunks.size(); ++i) {
+                callback(keyChunks[i].first, keyChunks[i].second, makeEmptyRecord());
+            }
+            return;
+        }
+        next += answered;
+    }
+}
+
 uint64_t HttpClient::postInlineAsset(Asset::Type type, const std::string& name, uint64_t author, uint64_t deprecates,
         const std::string& listIds, uint64_t size, const uint8_t* inlineData) {
     if (size > kSingleChunkDataSize) {
@@ -203,7 +393,7 @@ uint64_t HttpClient::postInlineAsset(Asset::Type type, const std::string& name,
     flatbuffers::FlatBufferBuilder builder(kPageSize);
     asset.flatten(builder, inlineData);
 
-    std::string request = m_serverAddress + "/asset/id/" + Asset::keyToString(key);
+    std::string request = shardAddress(key) + "/asset/id/" + Asset::keyToString(key);
     LOG(INFO) << "sending POST for new inline asset " << request << ", " << builder.GetSize() << " bytes";
 
     char base64[kPageSize];
@@ -230,60 +420,200 @@ uint64_t HttpClient::postInlineAsset(Asset::Type type, const std::string& name,
     Pistache::Async::Barrier barrier(promise);
     barrier.wait();
 
+    if (ok) {
+        ok = postDirectoryAsset(key, SizedPointer(builder.GetBufferPointer(), builder.GetSize()));
+    }
     return ok ? key : 0;
 }
 
-uint64_t HttpClient::postFileAsset(Asset::Type type, const std::string& name, uint64_t author, uint64_t deprecates,
-        const std::string& listIds, const fs::path& assetFile) {
-    // Some Assets like images make sense to serialize to a file, regardless of size, because SuperCollider has no
-    // concept of loading an image from a binary blob of memory.
-    size_t fileSize = fs::file_size(assetFile);
-    if (fileSize == 0) {
-        LOG(ERROR) << "rejecting addition of zero-size file at " << assetFile;
-        return 0;
+// static
+bool HttpClient::hashFile(const fs::path& assetFile, FileHash& hashOut) {
+    std::error_code error;
+    hashOut.key = 0;
+    hashOut.size = fs::file_size(assetFile, error);
+    hashOut.chunkHashes.clear();
+    hashOut.contents.clear();
+    if (error) {
+        LOG(ERROR) << "error reading size of file at " << assetFile << ": " << error.message();
+        return false;
+    }
+    if (hashOut.size == 0) {
+        LOG(ERROR) << "rejecting hash of zero-size file at " << assetFile;
+        return false;
     }
 
-    // First we must hash the file. This means we will be traversing this file twice, first for a hash and then second
-    // for the upload. This could be avoided at the cost of loading the file entirely in to memory, or possibly by
-    // designing some incremental upload that specifies the Asset key *last*, but in the interest of simplicity the
-    // current design is to just traverse the file twice. We even recompute the hash twice because storage of the
-    // intermediate hashes for large files is on the order of megabytes.
-    std::array<char, kDataChunkSize> fileChunk;
     std::ifstream inFile(assetFile, std::ios::in | std::ios::binary);
     if (!inFile) {
         LOG(ERROR) << "error opening file: " << assetFile << " for hash computation";
-        return 0;
+        return false;
+    }
+
+    // Small files are kept in memory so the upload doesn't have to read them a second time. Each AssetData chunk
+    // carries the digest of the file up to the end of that chunk, so those are kept too, which costs 8 bytes for every
+    // kDataChunkSize bytes of file.
+    bool buffered = hashOut.size <= kMaxBufferedFileSize;
+    std::array<char, kDataChunkSize> fileChunk;
+    if (buffered) {
+        hashOut.contents.resize(hashOut.size);
     }
+    hashOut.chunkHashes.reserve((hashOut.size / kDataChunkSize) + 1);
+
     XXH64_state_t* hashState = XXH64_createState();
     XXH64_reset(hashState, 0);
-    inFile.read(fileChunk.data(), kDataChunkSize);
-    size_t bytesRead = inFile.gcount();
-    size_t bytesRemaining = fileSize - bytesRead;
-
+    size_t bytesRemaining = hashOut.size;
     while (inFile && bytesRemaining > 0) {
-        XXH64_update(hashState, fileChunk.data(), bytesRead);
-        inFile.read(fileChunk.data(), kDataChunkSize);
-        bytesRead = inFile.gcount();
+        char* chunkData = buffered ? hashOut.contents.data() + (hashOut.size - bytesRemaining) : fileChunk.data();
+        inFile.read(chunkData, std::min(kDataChunkSize, bytesRemaining));
+        size_t bytesRead = inFile.gcount();
+        if (bytesRead == 0) {
+            break;
+        }
+        XXH64_update(hashState, chunkData, bytesRead);
+        hashOut.chunkHashes.push_back(XXH64_digest(hashState));
         bytesRemaining -= bytesRead;
     }
-
-    // Compute any remaining hash bytes.
-    if (bytesRead > 0) {
-        XXH64_update(hashState, fileChunk.data(), bytesRead);
-    }
-
-    uint64_t key = XXH64_digest(hashState);
-    // Free this now, we can re-allocate later, just to avoid potentially leaking it on the various exit paths from this
-    // function.
     XXH64_freeState(hashState);
 
     if (bytesRemaining > 0) {
         LOG(ERROR) << "file read error for " << assetFile << ", " << bytesRemaining << " bytes left unread.";
+        hashOut.contents.clear();
+        return false;
+    }
+
+    hashOut.key = hashOut.chunkHashes.back();
+    LOG(INFO) << "computed key " << Asset::keyToString(hashOut.key) << " for asset file " << assetFile;
+    return true;
+}
+
+bool HttpClient::hasAsset(uint64_t key) {
+    bool found = false;
+    getAsset(key, [&found](uint64_t, RecordPtr record) {
+        found = !record->empty();
+    });
+    return found;
+}
+
+void HttpClient::getAssets(const std::vector<uint64_t>& keys, std::function<void(uint64_t, RecordPtr)> callback) {
+    if (m_shardMap.empty()) {
+        getServerAssets(keys, callback);
+        return;
+    }
+    std::map<std::string, std::vector<uint64_t>> shardKeys;
+    for (auto key : keys) {
+        shardKeys[m_shardMap.shardFor(key)].push_back(key);
+    }
+    for (const auto& shard : shardKeys) {
+        if (shard.first == m_serverAddress) {
+            getServerAssets(shard.second, callback);
+        } else {
+            getAssetsFrom(shard.first, shard.second, callback);
+        }
+    }
+}
+
+void HttpClient::getServerAssets(const std::vector<uint64_t>& keys,
+    std::function<void(uint64_t, RecordPtr)> callback) {
+    std::string address = readAddress();
+    if (address == m_serverAddress) {
+        getAssetsFrom(address, keys, callback);
+        return;
+    }
+    std::vector<uint64_t> missing;
+    getAssetsFrom(address, keys, [&missing, &callback](uint64_t key, RecordPtr record) {
+        if (record->empty()) {
+            missing.push_back(key);
+        } else {
+            callback(key, record);
+        }
+    });
+    if (missing.size() > 0) {
+        getAssetsFrom(m_serverAddress, missing, callback);
+    }
+}
+
+void HttpClient::getAssetsFrom(const std::string& address, const std::vector<uint64_t>& keys,
+    std::function<void(uint64_t, RecordPtr)> callback) {
+    std::string request = address + "/asset/batch";
+    size_t next = 0;
+    while (next < keys.size()) {
+        std::string body;
+        size_t batchEnd = std::min(keys.size(), next + kMaxBatchKeys);
+        for (size_t i = next; i < batchEnd; ++i) {
+            body += Asset::keyToString(keys[i]) + "\n";
+        }
+        LOG(INFO) << "issuing batch request for " << (batchEnd - next) << " Assets to " << request;
+
+        // The server answers as many keys as fit in a page, so count how many it answered to know where to resume.
+        size_t answered = 0;
+        auto promise = m_client->post(request)
+            .header<Pistache::Http::Header::ContentType>(MIME(Text, Plain))
+            .body(body)
+            .send();
+        promise.then([&keys, &callback, &request, next, batchEnd, &answered](Pistache::Http::Response response) {
+            if (response.code() != Pistache::Http::Code::Ok) {
+                LOG(ERROR) << "error code " << response.code() << " on Asset batch request " << request;
+                return;
+            }
+            std::istringstream lines(response.body());
+            std::string line;
+            uint8_t decoded[kPageSize];
+            while (next + answered < batchEnd && std::getline(lines, line)) {
+                uint64_t key = keys[next + answered];
+                size_t separator = line.find(' ');
+                if (Asset::stringToKey(line.substr(0, separator)) != key) {
+                    LOG(ERROR) << "out of order response to Asset batch request " << request;
+                    break;
+                }
+                ++answered;
+                if (separator == std::string::npos) {
+                    callback(key, makeEmptyRecord());
+                    continue;
+                }
+                size_t decodedSize = 0;
+                base64_decode(line.data() + separator + 1, line.size() - separator - 1,
+                    reinterpret_cast<char*>(decoded), &decodedSize, 0);
+                // Verify the Asset record as returned by the server.
+                auto verifier = flatbuffers::Verifier(decoded, decodedSize);
+                if (Data::VerifyFlatAssetBuffer(verifier)) {
+                    callback(key, RecordPtr(new ClientRecord(decoded, decodedSize)));
+                } else {
+                    LOG(ERROR) << "failed to verify server-provided data for Asset " << Asset::keyToString(key)
+                        << " in batch request " << request;
+                    callback(key, makeEmptyRecord());
+                }
+            }
+        }, Pistache::Async::NoExcept);
+
+        Pistache::Async::Barrier barrier(promise);
+        barrier.wait();
+
+        if (answered == 0) {
+            // Error or no progress, fail the remaining keys.
+            for (size_t i = next; i < keys.size(); ++i) {
+                callback(keys[i], makeEmptyRecord());
+            }
+            return;
+        }
+        next += answered;
+    }
+}
+
+uint64_t HttpClient::postFileAsset(Asset::Type type, const std::string& name, uint64_t author, uint64_t deprecates,
+        const std::string& listIds, const fs::path& assetFile) {
+    FileHash fileHash;
+    if (!hashFile(assetFile, fileHash)) {
         return 0;
     }
+    return postFileAsset(type, name, author, deprecates, listIds, assetFile, fileHash);
+}
 
+uint64_t HttpClient::postFileAsset(Asset::Type type, const std::string& name, uint64_t author, uint64_t deprecates,
+        const std::string& listIds, const fs::path& assetFile, const FileHash& fileHash) {
+    // Some Assets like images make sense to serialize to a file, regardless of size, because SuperCollider has no
+    // concept of loading an image from a binary blob of memory.
+    uint64_t key = fileHash.key;
+    size_t fileSize = fileHash.size;
     std::string keyString = Asset::keyToString(key);
-    LOG(INFO) << "computed key " << keyString << " for asset file " << assetFile;
 
     Asset asset(type);
     asset.setKey(key);
@@ -303,7 +633,7 @@ uint64_t HttpClient::postFileAsset(Asset::Type type, const std::string& name, ui
     CHECK_LT(encodedSize, kPageSize) << "encoded file asset record larger than page.";
     LOG(INFO) << "sending POST of file asset " << keyString << ", " << encodedSize << " bytes.";
 
-    std::string request = m_serverAddress + "/asset/id/" + keyString;
+    std::string request = shardAddress(key) + "/asset/id/" + keyString;
     bool ok = true;
     auto promise = m_client->post(request)
         .body(std::string(base64, encodedSize))
@@ -320,84 +650,121 @@ uint64_t HttpClient::postFileAsset(Asset::Type type, const std::string& name, ui
     Pistache::Async::Barrier barrier(promise);
     barrier.wait();
 
-    if (!ok) {
+    if (!ok || !postDirectoryAsset(key, SizedPointer(builder.GetBufferPointer(), builder.GetSize()))) {
         LOG(INFO) << "error posting new file asset " << assetFile << " with key " << keyString;
         return 0;
     }
 
-    // Now we upload the individual data chunks of the file. We will be reading the bytes directly into the
-    // FlatBufferBuilder object, to skip a copy.
-    hashState = XXH64_createState();
-    XXH64_reset(hashState, 0);
-    inFile.clear();
-    inFile.seekg(0, std::ios::beg);
-    bytesRemaining = fileSize;
-    size_t chunk = 0;
-    uint64_t chunkHash = 0;
+    bool posted = buildFileChunks(assetFile, fileHash, [this, key](uint64_t chunk, const SizedPointer& flatAssetData) {
+        return postAssetData(key, chunk, flatAssetData);
+    });
+    if (!posted) {
+        LOG(ERROR) << "error uploading file " << assetFile << " to server.";
+        return 0;
+    }
 
-    while (ok && inFile && bytesRemaining > 0) {
+    LOG(INFO) << "completed successful upload of file Asset " << keyString << " from " << assetFile;
+    return key;
+}
+
+// static
+bool HttpClient::buildFileChunks(const fs::path& assetFile, const FileHash& fileHash,
+        std::function<bool(uint64_t, const SizedPointer&)> sink) {
+    size_t fileSize = fileHash.size;
+    bool buffered = fileHash.contents.size() == fileSize;
+    std::ifstream inFile;
+    XXH64_state_t* hashState = nullptr;
+    if (!buffered) {
+        inFile.open(assetFile, std::ios::in | std::ios::binary);
+        if (!inFile) {
+            LOG(ERROR) << "error re-opening file: " << assetFile << " to read chunks.";
+            return false;
+        }
+        hashState = XXH64_createState();
+        XXH64_reset(hashState, 0);
+    }
+
+    // The bytes of each chunk are read or copied directly into the FlatBufferBuilder object.
+    bool ok = true;
+    flatbuffers::FlatBufferBuilder builder(kPageSize);
+    size_t bytesRemaining = fileSize;
+    size_t chunk = 0;
+    while (bytesRemaining > 0 && chunk < fileHash.chunkHashes.size()) {
         builder.Clear();
         uint8_t* flatData = nullptr;
         size_t flatDataSize = std::min(kDataChunkSize, bytesRemaining);
         auto flatAssetData = builder.CreateUninitializedVector(flatDataSize, &flatData);
-        inFile.read(reinterpret_cast<char*>(flatData), flatDataSize);
-        bytesRead = inFile.gcount();
-        bytesRemaining -= bytesRead;
-        if (bytesRead != flatDataSize) {
-            LOG(ERROR) << "error re-reading asset file " << assetFile << " expected " << flatDataSize << " bytes, got "
-                << bytesRead << " bytes instead.";
-            ok = false;
+        if (buffered) {
+            std::memcpy(flatData, fileHash.contents.data() + (fileSize - bytesRemaining), flatDataSize);
         } else {
-            Data::FlatAssetDataBuilder assetDataBuilder(builder);
-            assetDataBuilder.add_data(flatAssetData);
+            inFile.read(reinterpret_cast<char*>(flatData), flatDataSize);
+            size_t bytesRead = inFile.gcount();
+            if (bytesRead != flatDataSize) {
+                LOG(ERROR) << "error re-reading asset file " << assetFile << " expected " << flatDataSize
+                    << " bytes, got " << bytesRead << " bytes instead.";
+                ok = false;
+                break;
+            }
             XXH64_update(hashState, flatData, bytesRead);
-            chunkHash = XXH64_digest(hashState);
-            assetDataBuilder.add_hash(chunkHash);
-            auto assetData = assetDataBuilder.Finish();
-            builder.Finish(assetData);
-
-            base64_encode(reinterpret_cast<char*>(builder.GetBufferPointer()), builder.GetSize(), base64, &encodedSize,
-                0);
-            CHECK_LT(encodedSize, kPageSize) << "stack overrun on encode!";
-
-            LOG(INFO) << "sending POST of asset data for " << keyString << " chunk " << chunk << ", " << encodedSize
-                << " bytes.";
-            char numBuf[32];
-            snprintf(numBuf, 32, "%" PRIu64, chunk);
-            request = m_serverAddress + "/asset/data/" + keyString + "/" + std::string(numBuf);
-            promise = m_client->post(request)
-                .body(std::string(base64, encodedSize))
-                .send();
-            promise.then([&request, &ok](Pistache::Http::Response response) {
-                if (response.code() == Pistache::Http::Code::Ok) {
-                    LOG(INFO) << "recived ok response on file asset chunk post " << request;
-                } else {
-                    LOG(ERROR) << "error code " << response.code() << " on file asset chunk post " << request;
-                    ok = false;
-                }
-            }, Pistache::Async::NoExcept);
+            if (XXH64_digest(hashState) != fileHash.chunkHashes[chunk]) {
+                LOG(ERROR) << "asset file " << assetFile << " changed since hashing at chunk " << chunk;
+                ok = false;
+                break;
+            }
+        }
+        bytesRemaining -= flatDataSize;
+
+        Data::FlatAssetDataBuilder assetDataBuilder(builder);
+        assetDataBuilder.add_data(flatAssetData);
+        assetDataBuilder.add_hash(fileHash.chunkHashes[chunk]);
+        auto assetData = assetDataBuilder.Finish();
+        builder.Finish(assetData);
 
-            Pistache::Async::Barrier chunkBarrier(promise);
-            chunkBarrier.wait();
-            ++chunk;
+        if (!sink(chunk, SizedPointer(builder.GetBufferPointer(), builder.GetSize()))) {
+            ok = false;
+            break;
         }
+        ++chunk;
     }
 
-    XXH64_freeState(hashState);
-
-    // Digest hash of final chunk should match the overall hash of the file.
-    if (!ok || bytesRemaining > 0 || chunkHash != key) {
-        LOG(ERROR) << "error uploading file " << assetFile << " to server.";
-        return 0;
+    if (hashState) {
+        XXH64_freeState(hashState);
     }
+    return ok && bytesRemaining == 0;
+}
 
-    LOG(INFO) << "completed successful upload of file Asset " << keyString << " from " << assetFile;
-    return key;
+bool HttpClient::postAsset(uint64_t key, const SizedPointer& flatAsset) {
+    return postRecord(shardAddress(key) + "/asset/id/" + Asset::keyToString(key), flatAsset)
+        && postDirectoryAsset(key, flatAsset);
+}
+
+bool HttpClient::postAssetData(uint64_t key, uint64_t chunk, const SizedPointer& flatAssetData) {
+    char numBuf[32];
+    snprintf(numBuf, 32, "%" PRIu64, chunk);
+    return postRecord(shardAddress(key) + "/asset/data/" + Asset::keyToString(key) + "/" + std::string(numBuf),
+        flatAssetData);
 }
 
-// TODO: could probably flatten this, assetData, and asset requests into a single generic call.
 void HttpClient::getList(uint64_t key, std::function<void(RecordPtr)> callback) {
-    std::string request = m_serverAddress + "/list/id/" + Asset::keyToString(key);
+    std::string address = readAddress();
+    if (address != m_serverAddress) {
+        bool found = false;
+        getListFrom(address, key, [&found, &callback](RecordPtr record) {
+            if (!record->empty()) {
+                found = true;
+                callback(record);
+            }
+        });
+        if (found) {
+            return;
+        }
+    }
+    getListFrom(m_serverAddress, key, callback);
+}
+
+// TODO: could probably flatten this, assetData, and asset requests into a single generic call.
+void HttpClient::getListFrom(const std::string& address, uint64_t key, std::function<void(RecordPtr)> callback) {
+    std::string request = address + "/list/id/" + Asset::keyToString(key);
     LOG(INFO) << "issuing list request to " << request;
 
     auto promise = m_client->get(request).send();
@@ -428,7 +795,25 @@ void HttpClient::getList(uint64_t key, std::function<void(RecordPtr)> callback)
 }
 
 void HttpClient::getNamedList(const std::string& name, std::function<void(RecordPtr)> callback) {
-    std::string request = m_serverAddress + "/list/name";
+    std::string address = readAddress();
+    if (address != m_serverAddress) {
+        bool found = false;
+        getNamedListFrom(address, name, [&found, &callback](RecordPtr record) {
+            if (!record->empty()) {
+                found = true;
+                callback(record);
+            }
+        });
+        if (found) {
+            return;
+        }
+    }
+    getNamedListFrom(m_serverAddress, name, callback);
+}
+
+void HttpClient::getNamedListFrom(const std::string& address, const std::string& name,
+    std::function<void(RecordPtr)> callback) {
+    std::string request = address + "/list/name";
     LOG(INFO) << "issuing named list for '" << name << "' request to " << request;
 
     auto promise = m_client->get(request).body(name).send();
@@ -458,7 +843,64 @@ void HttpClient::getNamedList(const std::string& name, std::function<void(Record
 }
 
 void HttpClient::getListItems(uint64_t key, uint64_t token, std::function<void(const std::string&)> callback) {
-    std::string request = m_serverAddress + "/list/items/" + Asset::keyToString(key) + "/" + Asset::keyToString(token);
+    getListPairs(readAddress() + "/list/items/" + Asset::keyToString(key) + "/" + Asset::keyToString(token),
+        callback);
+}
+
+void HttpClient::getListPreviousItems(uint64_t key, uint64_t token,
+    std::function<void(const std::string&)> callback) {
+    getListPairs(readAddress() + "/list/previous/" + Asset::keyToString(key) + "/" + Asset::keyToString(token),
+        callback);
+}
+
+void HttpClient::getListRangeItems(uint64_t key, uint64_t fromTime, uint64_t toTime,
+    std::function<void(const std::string&)> callback) {
+    getListPairs(readAddress() + "/list/range/" + Asset::keyToString(key) + "/" + Asset::keyToString(fromTime) + "/"
+        + Asset::keyToString(toTime), callback);
+}
+
+void HttpClient::getTypeItems(Asset::Type type, uint64_t token, std::function<void(const std::string&)> callback) {
+    getListPairs(readAddress() + "/asset/type/" + Asset::enumToTypeString(type) + "/" + Asset::keyToString(token),
+        callback);
+}
+
+void HttpClient::getTypeRangeItems(Asset::Type type, uint64_t fromTime, uint64_t toTime,
+    std::function<void(const std::string&)> callback) {
+    getListPairs(readAddress() + "/asset/type/" + Asset::enumToTypeString(type) + "/range/"
+        + Asset::keyToString(fromTime) + "/" + Asset::keyToString(toTime), callback);
+}
+
+void HttpClient::getAuthorItems(uint64_t author, Asset::Type type, uint64_t token,
+    std::function<void(const std::string&)> callback) {
+    std::string request = readAddress() + "/asset/author/" + Asset::keyToString(author) + "/";
+    if (type != Asset::kInvalid) {
+        request += "type/" + Asset::enumToTypeString(type) + "/";
+    }
+    getListPairs(request + Asset::keyToString(token), callback);
+}
+
+void HttpClient::searchNames(const std::string& query, size_t limit,
+    std::function<void(const std::string&)> callback) {
+    std::string request = readAddress() + "/search/" + std::to_string(limit);
+    LOG(INFO) << "issuing name search for '" << query << "' request to " << request;
+
+    // Like named lookups, the query goes in the body of the request to avoid URL encoding issues.
+    auto promise = m_client->get(request).body(query).send();
+    promise.then([&query, &callback, &request](Pistache::Http::Response response) {
+        if (response.code() == Pistache::Http::Code::Ok) {
+            LOG(INFO) << "received Ok response for name search for '" << query << "'.";
+            callback(response.body());
+        } else {
+            LOG(ERROR) << "error code " << response.code() << " on name search request " << request;
+            callback("");
+        }
+    }, Pistache::Async::NoExcept);
+
+    Pistache::Async::Barrier barrier(promise);
+    barrier.wait();
+}
+
+void HttpClient::getListPairs(const std::string& request, std::function<void(const std::string&)> callback) {
     LOG(INFO) << "issuing list items request to " << request;
 
     auto promise = m_client->get(request).send();
@@ -514,12 +956,106 @@ uint64_t HttpClient::postList(const std::string& name) {
     Pistache::Async::Barrier barrier(promise);
     barrier.wait();
 
+    if (ok) {
+        ok = postDirectoryAsset(key, SizedPointer(builder.GetBufferPointer(), builder.GetSize()));
+    }
     return ok ? key : 0;
 }
 
+bool HttpClient::postListItem(uint64_t listKey, uint64_t assetKey) {
+    std::string request = m_serverAddress + "/list/items/" + Asset::keyToString(listKey) + "/"
+        + Asset::keyToString(assetKey);
+    LOG(INFO) << "sending POST for list item " << request;
+
+    bool ok = true;
+    auto promise = m_client->post(request).send();
+    promise.then([&request, &ok](Pistache::Http::Response response) {
+        if (response.code() == Pistache::Http::Code::Ok) {
+            LOG(INFO) << "received ok response for list item post " << request;
+        } else {
+            LOG(ERROR) << "error code " << response.code() << " on list item post " << request;
+            ok = false;
+        }
+    }, Pistache::Async::NoExcept);
+
+    Pistache::Async::Barrier barrier(promise);
+    barrier.wait();
+
+    return ok;
+}
+
 void HttpClient::shutdown() {
     m_client->shutdown();
 }
 
+void HttpClient::getReplicationLog(uint64_t afterSequence, std::function<void(int, const std::string&)> callback) {
+    std::string request = m_serverAddress + "/replication/log/" + Asset::keyToString(afterSequence);
+    LOG(INFO) << "issuing replication log request to " << request;
+
+    // The log is only read from the leader, and the caller decides what to do about each response code.
+    int code = 0;
+    std::string body;
+    auto promise = m_client->get(request).send();
+    promise.then([&code, &body](Pistache::Http::Response response) {
+        code = static_cast<int>(response.code());
+        body = response.body();
+    }, Pistache::Async::NoExcept);
+
+    Pistache::Async::Barrier barrier(promise);
+    barrier.wait();
+
+    if (code != static_cast<int>(Pistache::Http::Code::Ok)) {
+        LOG(ERROR) << "error code " << code << " on replication log request " << request;
+    }
+    callback(code, body);
+}
+
+std::string HttpClient::readAddress() {
+    return m_readAddresses[m_nextRead++ % m_readAddresses.size()];
+}
+
+const std::string& HttpClient::shardAddress(uint64_t key) const {
+    return m_shardMap.empty() ? m_serverAddress : m_shardMap.shardFor(key);
+}
+
+bool HttpClient::postDirectoryAsset(uint64_t key, const SizedPointer& flatAsset) {
+    if (shardAddress(key) == m_serverAddress) {
+        return true;
+    }
+    // The shard has the Asset first, as it compresses the chunks that follow according to the type of their Asset.
+    return postRecord(m_serverAddress + "/asset/id/" + Asset::keyToString(key), flatAsset);
+}
+
+bool HttpClient::postRecord(const std::string& request, const SizedPointer& record) {
+    if (4 * ((record.size() + 2) / 3) >= kPageSize) {
+        LOG(ERROR) << "record of " << record.size() << " bytes too large to post to " << request;
+        return false;
+    }
+    char base64[kPageSize];
+    size_t encodedSize = 0;
+    base64_encode(record.dataChar(), record.size(), base64, &encodedSize, 0);
+    LOG(INFO) << "sending POST to " << request << ", " << encodedSize << " bytes.";
+
+    // Only an Ok response counts as acknowledgement, a request that never reaches the server fails too.
+    bool ok = false;
+    auto promise = m_client->post(request)
+        .header<Pistache::Http::Header::ContentType>(MIME(Text, Plain))
+        .header<Pistache::Http::Header::ContentLength>(encodedSize)
+        .body(std::string(base64, encodedSize))
+        .send();
+    promise.then([&request, &ok](Pistache::Http::Response response) {
+        if (response.code() == Pistache::Http::Code::Ok) {
+            LOG(INFO) << "received ok response on post " << request;
+            ok = true;
+        } else {
+            LOG(ERROR) << "error code " << response.code() << " on post " << request;
+        }
+    }, Pistache::Async::NoExcept);
+
+    Pistache::Async::Barrier barrier(promise);
+    barrier.wait();
+    return ok;
+}
+
 }  // namespace Confab
 
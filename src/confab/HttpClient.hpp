@@ -3,12 +3,16 @@
 
 #include "Asset.hpp"
 #include "Record.hpp"
+#include "ShardMap.hpp"
 
+#include <atomic>
 #include <experimental/filesystem>
 #include <functional>
 #include <memory>
 #include <random>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace fs = std::experimental::filesystem;
 
@@ -24,12 +28,44 @@ namespace Confab {
  */
 class HttpClient {
 public:
+    /*! The result of hashing a file for upload as an Asset, computed by hashFile().
+     */
+    struct FileHash {
+        /*! The Asset key, which is the hash of the whole file.
+         */
+        uint64_t key;
+
+        /*! The file size in bytes.
+         */
+        size_t size;
+
+        /*! The hash of the file up to the end of each AssetData chunk, as stored in that chunk.
+         */
+        std::vector<uint64_t> chunkHashes;
+
+        /*! The file contents, if the file was small enough to keep in memory for upload, otherwise empty.
+         */
+        std::vector<char> contents;
+    };
+
     /*! Construct a new HttpClient for use in upstream communication.
+     *
+     * Uploads always go to the server. Downloads are spread in turn across the server and its replicas, and anything
+     * not found on a replica, which may not yet have replicated a recent upload, is requested again from the server.
+     *
+     * If shards are provided, Asset and AssetData requests by key go to the shard that owns the key, according to a
+     * ShardMap of the shard addresses, which must match the one the shards are configured with. The server then acts
+     * as the directory: it is also sent every Asset record, and answers all requests by name, by List, by type and by
+     * author, and searches. The server may be one of the shards too, and only its share of keys is read from replicas.
      *
      * \param serverAddress The address part of the URLs that the client will construct, such as
      *                      "http://sclork-s01.local:9080".
+     * \param replicaAddresses The addresses of any follower servers replicating serverAddress.
+     * \param shardAddresses The addresses of the servers Asset keys are sharded across, or empty for none.
      */
-    HttpClient(const std::string& serverAddress);
+    HttpClient(const std::string& serverAddress,
+        const std::vector<std::string>& replicaAddresses = std::vector<std::string>(),
+        const std::vector<std::string>& shardAddresses = std::vector<std::string>());
 
     /*! Destructs an HttpClient.
      */
@@ -48,6 +84,15 @@ public:
      */
     void getAsset(uint64_t key, std::function<void(uint64_t, RecordPtr)> callback);
 
+    /*! Requests a batch of Assets from the server, with as few requests as will fit the responses. Blocking.
+     *
+     * \param keys The keys of the Assets to request.
+     * \param callback The function to call once for each key, in order except for any keys requested again from the
+     *                 server after a replica didn't have them, and grouped by shard if sharded, with the requested key
+     *                 and a non-owning pointer to the FlatAsset or an empty Record if not found or on error.
+     */
+    void getAssets(const std::vector<uint64_t>& keys, std::function<void(uint64_t, RecordPtr)> callback);
+
     /*! Requests an asset by name from the server. Blocks until return.
      *
      * \param name The name of the Asset to look up.
@@ -65,6 +110,17 @@ public:
      */
     void getAssetData(uint64_t key, uint64_t chunk, std::function<void(uint64_t, uint64_t, RecordPtr)> callback);
 
+    /*! Requests a batch of AssetData chunks from the server, with as few requests as will fit the responses. Blocking.
+     *
+     * \param keyChunks Pairs of Asset key and chunk number to request, possibly from different Assets.
+     * \param callback The function to call once for each pair, in order except for any pairs requested again from the
+     *                 server after a replica didn't have them, and grouped by shard if sharded, with the Asset key, the
+     *                 chunk number, and a non-owning pointer to the FlatAssetData or an empty Record if not found or on
+     *                 error.
+     */
+    void getAssetDataBatch(const std::vector<std::pair<uint64_t, uint64_t>>& keyChunks,
+        std::function<void(uint64_t, uint64_t, RecordPtr)> callback);
+
     /*! Uploads a new Asset with inline data to the server. Blocking.
      *
      * \param type The Asset type.
@@ -79,6 +135,34 @@ public:
     uint64_t postInlineAsset(Asset::Type type, const std::string& name, uint64_t author, uint64_t deprecates,
             const std::string& listIds, uint64_t size, const uint8_t* inlineData);
 
+    /*! Reads a file and computes everything needed to upload it as an Asset. Safe to call from multiple threads.
+     *
+     * \param assetFile The path of the file to hash.
+     * \param hashOut The structure to fill with the hash results.
+     * \return true on success, false on error.
+     */
+    static bool hashFile(const fs::path& assetFile, FileHash& hashOut);
+
+    /*! Builds the FlatAssetData chunks of a file hashed by hashFile(), passing each in turn to sink. Files too large to
+     * have been kept in memory are read again, and re-hashed to make sure they didn't change since hashing. Safe to
+     * call from multiple threads.
+     *
+     * \param assetFile The path of the hashed file.
+     * \param fileHash The results of hashFile() on assetFile.
+     * \param sink Called with the chunk number and a non-owning pointer to each FlatAssetData chunk in order, which is
+     *             only valid for the duration of the call. Return false to stop building.
+     * \return true if every chunk was built and accepted by sink, false on error.
+     */
+    static bool buildFileChunks(const fs::path& assetFile, const FileHash& fileHash,
+            std::function<bool(uint64_t, const SizedPointer&)> sink);
+
+    /*! Checks if the server already has an Asset with the provided key. Blocking.
+     *
+     * \param key The asset key to check for.
+     * \return true if the server returned the Asset, false if not found or on error.
+     */
+    bool hasAsset(uint64_t key);
+
     /*! Uploads a new Asset along with all AssetData chunks in the file to the server. Blocking.
      *
      * \param type The Asset type.
@@ -92,6 +176,38 @@ public:
     uint64_t postFileAsset(Asset::Type type, const std::string& name, uint64_t author, uint64_t deprecates,
             const std::string& listIds, const fs::path& assetFile);
 
+    /*! Uploads a new Asset along with all AssetData chunks in the file to the server, using an already computed
+     * FileHash of the file. Blocking.
+     *
+     * \param type The Asset type.
+     * \param name The Asset name, can be "".
+     * \param author An optional Asset key.
+     * \param deprecates An optional Asset key.
+     * \param listIds A comma-separated concatenated string of list ids to add this asset to.
+     * \param assetFile The path of the file to ingest.
+     * \param fileHash The results of hashFile() on assetFile.
+     * \return The computed key for this Asset, or zero on error.
+     */
+    uint64_t postFileAsset(Asset::Type type, const std::string& name, uint64_t author, uint64_t deprecates,
+            const std::string& listIds, const fs::path& assetFile, const FileHash& fileHash);
+
+    /*! Uploads an already serialized Asset to the server. Blocking.
+     *
+     * \param key The key of the Asset.
+     * \param flatAsset The FlatAsset record to upload.
+     * \return true if the server acknowledged the upload, false on error.
+     */
+    bool postAsset(uint64_t key, const SizedPointer& flatAsset);
+
+    /*! Uploads an already serialized AssetData chunk to the server. Blocking.
+     *
+     * \param key The key of the Asset the chunk belongs to.
+     * \param chunk The chunk number.
+     * \param flatAssetData The FlatAssetData record to upload.
+     * \return true if the server acknowledged the upload, false on error.
+     */
+    bool postAssetData(uint64_t key, uint64_t chunk, const SizedPointer& flatAssetData);
+
     /*! Requests a list metadata entry from the server. Blocking.
      *
      * \param key The key of the list to retrieve.
@@ -114,6 +230,63 @@ public:
      */
     void getListItems(uint64_t key, uint64_t token, std::function<void(const std::string&)> callback);
 
+    /*! Requests list items from the server in reverse order, newest first. Blocking.
+     *
+     * \param key The key of the list to retrieve.
+     * \param token The list token marker to start iterating back from (can be kEndList to start at the end).
+     * \param callback The function to callback with list items as a string of "<token> <asset key>\n" pairs.
+     */
+    void getListPreviousItems(uint64_t key, uint64_t token, std::function<void(const std::string&)> callback);
+
+    /*! Requests the list items added within a span of time from the server, oldest first. Blocking.
+     *
+     * \param key The key of the list to retrieve.
+     * \param fromTime The earliest token to include.
+     * \param toTime The token to stop before.
+     * \param callback The function to callback with list items as a string of "<token> <asset key>\n" pairs.
+     */
+    void getListRangeItems(uint64_t key, uint64_t fromTime, uint64_t toTime,
+        std::function<void(const std::string&)> callback);
+
+    /*! Requests the Assets of one type from the server, oldest first, leaving out deprecated Assets. Blocking.
+     *
+     * \param type The type of Asset to list.
+     * \param token The token to start after (can be 0 to start at beginning).
+     * \param callback The function to callback with items as a string of "<token> <asset key>\n" pairs, ending with a
+     *                 kEndList pair at the end of the index.
+     */
+    void getTypeItems(Asset::Type type, uint64_t token, std::function<void(const std::string&)> callback);
+
+    /*! Requests the Assets of one type stored within a span of time from the server, oldest first. Blocking.
+     *
+     * \param type The type of Asset to list.
+     * \param fromTime The earliest token to include.
+     * \param toTime The token to stop before.
+     * \param callback The function to callback with items as a string of "<token> <asset key>\n" pairs.
+     */
+    void getTypeRangeItems(Asset::Type type, uint64_t fromTime, uint64_t toTime,
+        std::function<void(const std::string&)> callback);
+
+    /*! Requests the Assets by one author from the server, oldest first, leaving out deprecated Assets. Blocking.
+     *
+     * \param author The key of the author.
+     * \param type The type of Asset to list, or kInvalid for Assets of every type.
+     * \param token The token to start after (can be 0 to start at beginning).
+     * \param callback The function to callback with items as a string of "<token> <asset key>\n" pairs, ending with a
+     *                 kEndList pair at the end of the index.
+     */
+    void getAuthorItems(uint64_t author, Asset::Type type, uint64_t token,
+        std::function<void(const std::string&)> callback);
+
+    /*! Searches the server for Assets and Lists by name, best match first. Blocking.
+     *
+     * \param query The text to search for.
+     * \param limit The maximum number of results to return.
+     * \param callback The function to callback with results as a string of "<a|l> <key> <name>\n" lines, with a for
+     *                 Assets and l for Lists, or an empty string if nothing was found or on error.
+     */
+    void searchNames(const std::string& query, size_t limit, std::function<void(const std::string&)> callback);
+
     /*! Uploads a new List to the server. Blocking.
      *
      * \param name The name of the list. If non-unique, will clobber old list name (but not old list).
@@ -121,15 +294,59 @@ public:
      */
     uint64_t postList(const std::string& name);
 
+    /*! Adds an Asset already on the server to the end of a List. Blocking.
+     *
+     * \param listKey The key of the List to add to.
+     * \param assetKey The key of the Asset to add.
+     * \return true on success, false on error.
+     */
+    bool postListItem(uint64_t listKey, uint64_t assetKey);
+
+    /*! Requests entries from the replication log of the server, never from a replica. Blocking.
+     *
+     * \param afterSequence The sequence number of the last entry already applied, or 0 for the start of the log.
+     * \param callback The function to callback with the HTTP status code of the response, or 0 if there was none, and
+     *                 the response body, as documented with the /replication/log route of HttpEndpoint.
+     */
+    void getReplicationLog(uint64_t afterSequence, std::function<void(int, const std::string&)> callback);
+
     /*! Closes any pending requests and shuts down.
      */
     void shutdown();
 
 private:
+    // Requests made to one server or replica, called by the public methods of the same name.
+    void getAssetFrom(const std::string& address, uint64_t key, std::function<void(uint64_t, RecordPtr)> callback);
+    void getAssetsFrom(const std::string& address, const std::vector<uint64_t>& keys,
+        std::function<void(uint64_t, RecordPtr)> callback);
+    void getNamedAssetFrom(const std::string& address, const std::string& name,
+        std::function<void(RecordPtr)> callback);
+    void getAssetDataFrom(const std::string& address, uint64_t key, uint64_t chunk,
+        std::function<void(uint64_t, uint64_t, RecordPtr)> callback);
+    void getAssetDataBatchFrom(const std::string& address, const std::vector<std::pair<uint64_t, uint64_t>>& keyChunks,
+        std::function<void(uint64_t, uint64_t, RecordPtr)> callback);
+    void getListFrom(const std::string& address, uint64_t key, std::function<void(RecordPtr)> callback);
+    void getNamedListFrom(const std::string& address, const std::string& name,
+        std::function<void(RecordPtr)> callback);
+    // Calls getAssetsFrom() on replicas as for getAssets(), for keys owned by the server.
+    void getServerAssets(const std::vector<uint64_t>& keys, std::function<void(uint64_t, RecordPtr)> callback);
+    // Returns the next address to send a download to, taking the server and each replica in turn.
+    std::string readAddress();
+    // Returns the address of the shard that owns key, or the server if unsharded.
+    const std::string& shardAddress(uint64_t key) const;
+    // Sends an Asset record already posted to its shard on to the server too, so the server can answer directory
+    // requests about it. Returns true if posted, or if the server is the shard.
+    bool postDirectoryAsset(uint64_t key, const SizedPointer& flatAsset);
+    void getListPairs(const std::string& request, std::function<void(const std::string&)> callback);
+    bool postRecord(const std::string& request, const SizedPointer& record);
+
     const std::string m_serverAddress;
     std::unique_ptr<Pistache::Http::Client> m_client;
     std::random_device m_randomDevice;
     std::uniform_int_distribution<uint64_t> m_distribution;
+    std::vector<std::string> m_readAddresses;
+    std::atomic<size_t> m_nextRead;
+    const ShardMap m_shardMap;
 };
 
 }  // namespace Confab
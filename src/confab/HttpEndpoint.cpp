@@ -12,6 +12,26 @@
 #include "pistache/endpoint.h"
 #include "pistache/router.h"
 
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+/*! Maximum number of Asset keys, or Asset Data chunks, accepted in a single batch request.
+ */
+static const size_t kMaxBatchKeys = 64;
+
+/*! Maximum number of results returned by a single name search request.
+ */
+static const size_t kMaxSearchResults = 64;
+
+/*! Maximum number of replication log entries returned by a single request.
+ */
+static const size_t kMaxReplicationEntries = 64;
+
+}  // namespace
+
 namespace Confab {
 
 /*! Handler class for processing incoming HTTP requests. Uses the Pistache Router to connect specific REST-style API
@@ -24,11 +44,18 @@ public:
      * \param listenPort The TCP port to listen on for HTTP requests.
      * \param numThreads The number of threads to use to listen on the port.
      * \param assetDatabase A pointer to the shared AssetDatabase instance.
+     * \param acceptWrites If false, requests to store Assets and Lists are refused.
+     * \param shardMap The shards Asset keys are split across, or empty if unsharded.
+     * \param shardAddress The address of this server in shardMap.
      */
-    HttpHandler(int listenPort, int numThreads, std::shared_ptr<AssetDatabase> assetDatabase) :
+    HttpHandler(int listenPort, int numThreads, std::shared_ptr<AssetDatabase> assetDatabase, bool acceptWrites,
+        const ShardMap& shardMap, const std::string& shardAddress) :
         m_listenPort(listenPort),
         m_numThreads(numThreads),
-        m_assetDatabase(assetDatabase) { }
+        m_assetDatabase(assetDatabase),
+        m_acceptWrites(acceptWrites),
+        m_shardMap(shardMap),
+        m_shardAddress(shardAddress) { }
 
     /*! Setup HTTP URL routes and initialize server.
      */
@@ -40,27 +67,56 @@ public:
 
         Pistache::Rest::Routes::Get(m_router, "/asset/id/:key", Pistache::Rest::Routes::bind(
             &HttpEndpoint::HttpHandler::getAsset, this));
-        Pistache::Rest::Routes::Post(m_router, "/asset/id/:key", Pistache::Rest::Routes::bind(
-            &HttpEndpoint::HttpHandler::postAsset, this));
+        // Followers serve every read route, but refuse writes, which only reach them by replication.
+        auto rejectWrite = Pistache::Rest::Routes::bind(&HttpEndpoint::HttpHandler::rejectWrite, this);
+
+        Pistache::Rest::Routes::Post(m_router, "/asset/id/:key", m_acceptWrites ? Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::postAsset, this) : rejectWrite);
+
+        Pistache::Rest::Routes::Post(m_router, "/asset/batch", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getAssetBatch, this));
 
         Pistache::Rest::Routes::Get(m_router, "/asset/name", Pistache::Rest::Routes::bind(
             &HttpEndpoint::HttpHandler::getNamedAsset, this));
 
+        Pistache::Rest::Routes::Get(m_router, "/asset/type/:type/:from", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getTypeItems, this));
+        Pistache::Rest::Routes::Get(m_router, "/asset/type/:type/range/:from/:to", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getTypeRangeItems, this));
+        Pistache::Rest::Routes::Get(m_router, "/asset/author/:author/:from", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getAuthorItems, this));
+        Pistache::Rest::Routes::Get(m_router, "/asset/author/:author/type/:type/:from", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getAuthorTypeItems, this));
+
+        Pistache::Rest::Routes::Get(m_router, "/search/:limit", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getSearch, this));
+
         Pistache::Rest::Routes::Get(m_router, "/asset/data/:key/:chunk", Pistache::Rest::Routes::bind(
             &HttpEndpoint::HttpHandler::getAssetData, this));
-        Pistache::Rest::Routes::Post(m_router, "/asset/data/:key/:chunk", Pistache::Rest::Routes::bind(
-            &HttpEndpoint::HttpHandler::postAssetData, this));
+        Pistache::Rest::Routes::Post(m_router, "/asset/data/batch", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getAssetDataBatch, this));
+        Pistache::Rest::Routes::Post(m_router, "/asset/data/:key/:chunk", m_acceptWrites ?
+            Pistache::Rest::Routes::bind(&HttpEndpoint::HttpHandler::postAssetData, this) : rejectWrite);
 
         Pistache::Rest::Routes::Get(m_router, "/list/id/:key", Pistache::Rest::Routes::bind(
             &HttpEndpoint::HttpHandler::getList, this));
-        Pistache::Rest::Routes::Post(m_router, "/list/id/:key", Pistache::Rest::Routes::bind(
-            &HttpEndpoint::HttpHandler::postList, this));
+        Pistache::Rest::Routes::Post(m_router, "/list/id/:key", m_acceptWrites ? Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::postList, this) : rejectWrite);
 
         Pistache::Rest::Routes::Get(m_router, "/list/name", Pistache::Rest::Routes::bind(
             &HttpEndpoint::HttpHandler::getNamedList, this));
 
         Pistache::Rest::Routes::Get(m_router, "/list/items/:key/:from", Pistache::Rest::Routes::bind(
             &HttpEndpoint::HttpHandler::getListItems, this));
+        Pistache::Rest::Routes::Post(m_router, "/list/items/:key/:asset", m_acceptWrites ?
+            Pistache::Rest::Routes::bind(&HttpEndpoint::HttpHandler::postListItem, this) : rejectWrite);
+        Pistache::Rest::Routes::Get(m_router, "/list/previous/:key/:from", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getListPreviousItems, this));
+        Pistache::Rest::Routes::Get(m_router, "/list/range/:key/:from/:to", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getListRangeItems, this));
+
+        Pistache::Rest::Routes::Get(m_router, "/replication/log/:from", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getReplicationLog, this));
     }
 
     /*! Starts a thread that will listen on the provided TCP port and process incoming requests for storage and
@@ -108,6 +164,48 @@ private:
         }
     }
 
+    // Responds with one line of "<key> <base64 FlatAsset>" per requested key, or "<key>" alone if not found, in
+    // request order. Responses are kept under a page, so clients must re-request any keys without a line.
+    void getAssetBatch(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        std::vector<uint64_t> keys;
+        std::istringstream keyStream(request.body());
+        std::string keyString;
+        while (keys.size() < kMaxBatchKeys && keyStream >> keyString) {
+            keys.push_back(Asset::stringToKey(keyString));
+        }
+        LOG(INFO) << "processing HTTP POST request for /asset/batch of " << keys.size() << " keys.";
+
+        response.headers().add<Pistache::Http::Header::Server>("confab");
+        if (keys.empty()) {
+            response.send(Pistache::Http::Code::Bad_Request);
+            return;
+        }
+
+        std::vector<RecordPtr> records = m_assetDatabase->findAssets(keys);
+        std::string batch;
+        char base64[kPageSize];
+        for (size_t i = 0; i < keys.size(); ++i) {
+            std::string line = Asset::keyToString(keys[i]);
+            if (!records[i]->empty()) {
+                size_t encodedSize = 0;
+                base64_encode(reinterpret_cast<const char*>(records[i]->data().data()), records[i]->data().size(),
+                    base64, &encodedSize, 0);
+                if (encodedSize >= kPageSize) {
+                    LOG(ERROR) << "encoded size: " << encodedSize << " exceeds buffer size " << kPageSize;
+                }
+                line += " " + std::string(base64, encodedSize);
+            }
+            line += "\n";
+            // Always send at least one line, so clients make progress through their keys.
+            if (i > 0 && batch.size() + line.size() > kDataChunkSize) {
+                break;
+            }
+            batch += line;
+        }
+
+        response.send(Pistache::Http::Code::Ok, batch, MIME(Text, Plain));
+    }
+
     void postAsset(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
         auto keyString = request.param(":key").as<std::string>();
         uint64_t key = Asset::stringToKey(keyString);
@@ -159,6 +257,30 @@ private:
         }
     }
 
+    // Responds with one line of "<a|l> <key> <name>" per Asset or List found with a name matching the query in the
+    // request body, best match first. Responses are kept under a page, so may hold fewer results than requested.
+    void getSearch(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        auto query = request.body();
+        auto limit = std::min(request.param(":limit").as<size_t>(), kMaxSearchResults);
+        LOG(INFO) << "processing HTTP GET request for /search/" << limit << " '" << query << "'.";
+
+        std::string results;
+        for (const auto& result : m_assetDatabase->searchNames(query, limit)) {
+            std::string name = result.name;
+            std::replace(name.begin(), name.end(), '\n', ' ');
+            std::string line = std::string(result.isList ? "l " : "a ") + Asset::keyToString(result.key) + " " + name +
+                "\n";
+            if (results.size() + line.size() > kDataChunkSize) {
+                break;
+            }
+            results += line;
+        }
+
+        // Finding nothing is not an error, so respond with an empty list.
+        response.headers().add<Pistache::Http::Header::Server>("confab");
+        response.send(Pistache::Http::Code::Ok, results, MIME(Text, Plain));
+    }
+
     void getAssetData(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
         auto keyString = request.param(":key").as<std::string>();
         auto chunk = request.param(":chunk").as<uint64_t>();
@@ -186,11 +308,64 @@ private:
         }
     }
 
+    // Responds with one line of "<key> <chunk> <base64 FlatAssetData>" per requested "<key> <chunk>" pair, or
+    // "<key> <chunk>" alone if not found, in request order. As with /asset/batch, responses are kept under a page, so
+    // clients must re-request any pairs without a line.
+    void getAssetDataBatch(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        std::vector<std::pair<uint64_t, uint64_t>> keyChunks;
+        std::istringstream keyStream(request.body());
+        std::string keyString;
+        uint64_t chunk = 0;
+        while (keyChunks.size() < kMaxBatchKeys && keyStream >> keyString >> chunk) {
+            keyChunks.emplace_back(Asset::stringToKey(keyString), chunk);
+        }
+        LOG(INFO) << "processing HTTP POST request for /asset/data/batch of " << keyChunks.size() << " chunks.";
+
+        response.headers().add<Pistache::Http::Header::Server>("confab");
+        if (keyChunks.empty()) {
+            response.send(Pistache::Http::Code::Bad_Request);
+            return;
+        }
+
+        std::vector<RecordPtr> records = m_assetDatabase->loadAssetDataChunks(keyChunks);
+        std::string batch;
+        char base64[kPageSize];
+        for (size_t i = 0; i < keyChunks.size(); ++i) {
+            std::string line = Asset::keyToString(keyChunks[i].first) + " " + std::to_string(keyChunks[i].second);
+            if (!records[i]->empty()) {
+                size_t encodedSize = 0;
+                base64_encode(reinterpret_cast<const char*>(records[i]->data().data()), records[i]->data().size(),
+                    base64, &encodedSize, 0);
+                if (encodedSize >= kPageSize) {
+                    LOG(ERROR) << "encoded size: " << encodedSize << " exceeds buffer size " << kPageSize;
+                }
+                line += " " + std::string(base64, encodedSize);
+            }
+            line += "\n";
+            // Always send at least one line, so clients make progress through their chunks.
+            if (i > 0 && batch.size() + line.size() > kDataChunkSize) {
+                break;
+            }
+            batch += line;
+        }
+
+        response.send(Pistache::Http::Code::Ok, batch, MIME(Text, Plain));
+    }
+
     void postAssetData(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
         auto keyString = request.param(":key").as<std::string>();
         auto chunk = request.param(":chunk").as<uint64_t>();
         LOG(INFO) << "processing HTTP POST request for /asset/data/" << keyString << "/" << chunk;
         uint64_t key = Asset::stringToKey(keyString);
+        // Asset records are accepted for any key, as the directory server keeps them all, but chunks are only stored
+        // on the shard that owns them.
+        if (!m_shardMap.empty() && m_shardMap.shardFor(key) != m_shardAddress) {
+            LOG(ERROR) << "refusing asset data " << keyString << " chunk " << chunk << " owned by shard "
+                << m_shardMap.shardFor(key);
+            response.headers().add<Pistache::Http::Header::Server>("confab");
+            response.send(Pistache::Http::Code::Bad_Request);
+            return;
+        }
         uint8_t decoded[kPageSize];
         size_t decodedSize;
         base64_decode(request.body().data(), request.body().size(), reinterpret_cast<char*>(decoded), &decodedSize, 0);
@@ -286,6 +461,78 @@ private:
         }
     }
 
+    void getTypeItems(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        auto typeString = request.param(":type").as<std::string>();
+        auto fromString = request.param(":from").as<std::string>();
+        LOG(INFO) << "processing get /asset/type/" << typeString << "/" << fromString;
+
+        Asset::Type type = Asset::typeStringToEnum(typeString);
+        if (type == Asset::kInvalid) {
+            LOG(ERROR) << "unknown Asset type " << typeString << " in type index request.";
+            response.headers().add<Pistache::Http::Header::Server>("confab");
+            response.send(Pistache::Http::Code::Bad_Request);
+            return;
+        }
+        uint64_t token = Asset::stringToKey(fromString);
+        std::array<uint64_t, kPageSize / 17> pairs;
+        size_t numPairs = m_assetDatabase->getTypeNext(type, token, pairs.size() / 2, pairs.data());
+        sendListPairs(typeString, pairs.data(), numPairs, response);
+    }
+
+    void getTypeRangeItems(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        auto typeString = request.param(":type").as<std::string>();
+        auto fromString = request.param(":from").as<std::string>();
+        auto toString = request.param(":to").as<std::string>();
+        LOG(INFO) << "processing get /asset/type/" << typeString << "/range/" << fromString << "/" << toString;
+
+        response.headers().add<Pistache::Http::Header::Server>("confab");
+        Asset::Type type = Asset::typeStringToEnum(typeString);
+        if (type == Asset::kInvalid) {
+            LOG(ERROR) << "unknown Asset type " << typeString << " in type index request.";
+            response.send(Pistache::Http::Code::Bad_Request);
+            return;
+        }
+        uint64_t fromTime = Asset::stringToKey(fromString);
+        uint64_t toTime = Asset::stringToKey(toString);
+        std::array<uint64_t, kPageSize / 17> pairs;
+        size_t numPairs = m_assetDatabase->getTypeRange(type, fromTime, toTime, pairs.size() / 2, pairs.data());
+        // An empty span of time is not an error, so respond with an empty list.
+        LOG(INFO) << "sending " << numPairs << " tokens back to client on type " << typeString;
+        response.send(Pistache::Http::Code::Ok, formatListPairs(pairs.data(), numPairs), MIME(Text, Plain));
+    }
+
+    void getAuthorItems(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        auto authorString = request.param(":author").as<std::string>();
+        auto fromString = request.param(":from").as<std::string>();
+        LOG(INFO) << "processing get /asset/author/" << authorString << "/" << fromString;
+
+        uint64_t author = Asset::stringToKey(authorString);
+        uint64_t token = Asset::stringToKey(fromString);
+        std::array<uint64_t, kPageSize / 17> pairs;
+        size_t numPairs = m_assetDatabase->getAuthorNext(author, 0, token, pairs.size() / 2, pairs.data());
+        sendListPairs(authorString, pairs.data(), numPairs, response);
+    }
+
+    void getAuthorTypeItems(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        auto authorString = request.param(":author").as<std::string>();
+        auto typeString = request.param(":type").as<std::string>();
+        auto fromString = request.param(":from").as<std::string>();
+        LOG(INFO) << "processing get /asset/author/" << authorString << "/type/" << typeString << "/" << fromString;
+
+        Asset::Type type = Asset::typeStringToEnum(typeString);
+        if (type == Asset::kInvalid) {
+            LOG(ERROR) << "unknown Asset type " << typeString << " in author index request.";
+            response.headers().add<Pistache::Http::Header::Server>("confab");
+            response.send(Pistache::Http::Code::Bad_Request);
+            return;
+        }
+        uint64_t author = Asset::stringToKey(authorString);
+        uint64_t token = Asset::stringToKey(fromString);
+        std::array<uint64_t, kPageSize / 17> pairs;
+        size_t numPairs = m_assetDatabase->getAuthorNext(author, type, token, pairs.size() / 2, pairs.data());
+        sendListPairs(authorString, pairs.data(), numPairs, response);
+    }
+
     void getListItems(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
         auto keyString = request.param(":key").as<std::string>();
         auto fromString = request.param(":from").as<std::string>();
@@ -295,29 +542,139 @@ private:
         uint64_t token = Asset::stringToKey(fromString);
         std::array<uint64_t, kPageSize / 17> pairs;
         size_t numPairs = m_assetDatabase->getListNext(key, token, pairs.size() / 2, pairs.data());
+        sendListPairs(keyString, pairs.data(), numPairs, response);
+    }
+
+    void getListPreviousItems(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        auto keyString = request.param(":key").as<std::string>();
+        auto fromString = request.param(":from").as<std::string>();
+        LOG(INFO) << "processing get /list/previous/" << keyString << "/" << fromString;
+
+        uint64_t key = Asset::stringToKey(keyString);
+        uint64_t token = Asset::stringToKey(fromString);
+        std::array<uint64_t, kPageSize / 17> pairs;
+        size_t numPairs = m_assetDatabase->getListPrevious(key, token, pairs.size() / 2, pairs.data());
+        sendListPairs(keyString, pairs.data(), numPairs, response);
+    }
+
+    void getListRangeItems(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        auto keyString = request.param(":key").as<std::string>();
+        auto fromString = request.param(":from").as<std::string>();
+        auto toString = request.param(":to").as<std::string>();
+        LOG(INFO) << "processing get /list/range/" << keyString << "/" << fromString << "/" << toString;
+
+        uint64_t key = Asset::stringToKey(keyString);
+        uint64_t fromTime = Asset::stringToKey(fromString);
+        uint64_t toTime = Asset::stringToKey(toString);
+        std::array<uint64_t, kPageSize / 17> pairs;
+        size_t numPairs = m_assetDatabase->getListRange(key, fromTime, toTime, pairs.size() / 2, pairs.data());
+        // An empty span of time is not an error, so respond with an empty list.
+        LOG(INFO) << "sending " << numPairs << " tokens back to client on list " << keyString;
+        response.headers().add<Pistache::Http::Header::Server>("confab");
+        response.send(Pistache::Http::Code::Ok, formatListPairs(pairs.data(), numPairs), MIME(Text, Plain));
+    }
+
+    std::string formatListPairs(const uint64_t* pairs, size_t numPairs) {
+        std::string pairList;
+        for (auto i = 0; i < numPairs; ++i) {
+            pairList += Asset::keyToString(pairs[i * 2]) + " " + Asset::keyToString(pairs[(i * 2) + 1]) + "\n";
+        }
+        return pairList;
+    }
+
+    void sendListPairs(const std::string& keyString, const uint64_t* pairs, size_t numPairs,
+        Pistache::Http::ResponseWriter& response) {
         response.headers().add<Pistache::Http::Header::Server>("confab");
         if (numPairs == 0) {
             LOG(ERROR) << "error retrieving iterator pair list for " << keyString;
             response.send(Pistache::Http::Code::Internal_Server_Error);
         } else {
             LOG(INFO) << "sending " << numPairs << " tokens back to client on list " << keyString;
-            std::string pairList;
-            for (auto i = 0; i < numPairs; ++i) {
-                pairList += Asset::keyToString(pairs[i * 2]) + " " + Asset::keyToString(pairs[(i * 2) + 1]) + "\n";
+            response.send(Pistache::Http::Code::Ok, formatListPairs(pairs, numPairs), MIME(Text, Plain));
+        }
+    }
+
+    void postListItem(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        auto keyString = request.param(":key").as<std::string>();
+        auto assetString = request.param(":asset").as<std::string>();
+        LOG(INFO) << "processing POST request for /list/items/" << keyString << "/" << assetString;
+
+        uint64_t key = Asset::stringToKey(keyString);
+        uint64_t assetKey = Asset::stringToKey(assetString);
+        bool status = key != 0 && assetKey != 0 && !m_assetDatabase->findAsset(assetKey)->empty();
+        if (status) {
+            status = m_assetDatabase->addListItem(key, assetKey);
+        } else {
+            LOG(ERROR) << "asset " << assetString << " not found for add to list " << keyString;
+        }
+        response.headers().add<Pistache::Http::Header::Server>("confab");
+        if (status) {
+            response.send(Pistache::Http::Code::Ok);
+        } else {
+            response.send(Pistache::Http::Code::Not_Found);
+        }
+    }
+
+    void rejectWrite(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        LOG(ERROR) << "refusing HTTP POST request for " << request.resource() << " as a follower.";
+        response.headers().add<Pistache::Http::Header::Server>("confab");
+        response.send(Pistache::Http::Code::Forbidden);
+    }
+
+    // Responds with one line per replication log entry after the :from sequence number, oldest first, of
+    // "<sequence> <op> <key> <argument>" followed by " <base64 record>" for Assets and Lists, or " <asset key>" for
+    // List items. Followers fetch AssetData chunks separately. An empty response means there are no newer entries,
+    // and Gone means the entries following :from are no longer kept. Responses are kept under a page.
+    void getReplicationLog(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        auto fromString = request.param(":from").as<std::string>();
+        LOG(INFO) << "processing HTTP GET request for /replication/log/" << fromString;
+        uint64_t from = Asset::stringToKey(fromString);
+        std::vector<AssetDatabase::ReplicationEntry> entries;
+        response.headers().add<Pistache::Http::Header::Server>("confab");
+        if (!m_assetDatabase->readReplicationLog(from, kMaxReplicationEntries, entries)) {
+            response.send(Pistache::Http::Code::Gone);
+            return;
+        }
+
+        std::string log;
+        char base64[kPageSize];
+        for (const auto& entry : entries) {
+            std::string line = Asset::keyToString(entry.sequence) + " " + static_cast<char>(entry.op) + " " +
+                Asset::keyToString(entry.key) + " " + Asset::keyToString(entry.argument);
+            if (entry.op == AssetDatabase::kReplicateListItem) {
+                line += " " + Asset::keyToString(entry.assetKey);
+            } else if (entry.record.size() > 0) {
+                size_t encodedSize = 0;
+                base64_encode(entry.record.data(), entry.record.size(), base64, &encodedSize, 0);
+                if (encodedSize >= kPageSize) {
+                    LOG(ERROR) << "encoded size: " << encodedSize << " exceeds buffer size " << kPageSize;
+                }
+                line += " " + std::string(base64, encodedSize);
+            }
+            line += "\n";
+            // Always send at least one line, so followers make progress through the log.
+            if (log.size() > 0 && log.size() + line.size() > kDataChunkSize) {
+                break;
             }
-            response.send(Pistache::Http::Code::Ok, pairList, MIME(Text, Plain));
+            log += line;
         }
+
+        response.send(Pistache::Http::Code::Ok, log, MIME(Text, Plain));
     }
 
     int m_listenPort;
     int m_numThreads;
     std::shared_ptr<AssetDatabase> m_assetDatabase;
+    bool m_acceptWrites;
+    const ShardMap m_shardMap;
+    const std::string m_shardAddress;
     std::shared_ptr<Pistache::Http::Endpoint> m_server;
     Pistache::Rest::Router m_router;
 };
 
-HttpEndpoint::HttpEndpoint(int listenPort, int numThreads, std::shared_ptr<AssetDatabase> assetDatabase) :
-    m_handler(new HttpHandler(listenPort, numThreads, assetDatabase)) {
+HttpEndpoint::HttpEndpoint(int listenPort, int numThreads, std::shared_ptr<AssetDatabase> assetDatabase,
+    bool acceptWrites, const ShardMap& shardMap, const std::string& shardAddress) :
+    m_handler(new HttpHandler(listenPort, numThreads, assetDatabase, acceptWrites, shardMap, shardAddress)) {
 }
 
 HttpEndpoint::~HttpEndpoint() {
@@ -1,7 +1,10 @@
 #ifndef SRC_CONFAB_HTTP_ENDPOINT_HPP_
 #define SRC_CONFAB_HTTP_ENDPOINT_HPP_
 
+#include "ShardMap.hpp"
+
 #include <memory>
+#include <string>
 
 namespace Confab {
 
@@ -17,8 +20,15 @@ public:
      * \param listenPort The TCP port to listen on for HTTP requests.
      * \param numThreads The number of threads to use to listen on the port.
      * \param assetDatabase A pointer to the shared AssetDatabase instance.
+     * \param acceptWrites If false, requests to store Assets and Lists are refused, as on a follower server whose
+     *                     database is only written by replication from the leader.
+     * \param shardMap The shards Asset keys are split across, as configured on clients, or empty if unsharded.
+     * \param shardAddress The address of this server in shardMap. AssetData chunks for keys owned by other shards are
+     *                     refused, so a client with a different shard map can't strand chunks where no one will look.
      */
-    HttpEndpoint(int listenPort, int numThreads, std::shared_ptr<AssetDatabase> assetDatabase);
+    HttpEndpoint(int listenPort, int numThreads, std::shared_ptr<AssetDatabase> assetDatabase,
+        bool acceptWrites = true, const ShardMap& shardMap = ShardMap(),
+        const std::string& shardAddress = std::string());
 
     /*! Destructs an HttpHandler. Declared here to let us use std::unique_ptr with forward-declared classes.
      */
@@ -0,0 +1,64 @@
+#include "NameSearch.hpp"
+
+#include <algorithm>
+
+namespace Confab {
+
+// static
+std::string NameSearch::normalize(const std::string& name) {
+    std::string normalized;
+    normalized.reserve(name.size());
+    bool pendingSpace = false;
+    for (char c : name) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        if (byte >= 'A' && byte <= 'Z') {
+            byte = byte - 'A' + 'a';
+        } else if (byte < 0x80 && !(byte >= 'a' && byte <= 'z') && !(byte >= '0' && byte <= '9')) {
+            pendingSpace = true;
+            continue;
+        }
+        if (pendingSpace && normalized.size() > 0) {
+            normalized.push_back(' ');
+        }
+        pendingSpace = false;
+        normalized.push_back(static_cast<char>(byte));
+    }
+    return normalized;
+}
+
+// static
+std::vector<std::string> NameSearch::wordSuffixes(const std::string& normalized) {
+    std::vector<std::string> suffixes;
+    size_t start = 0;
+    while (start < normalized.size()) {
+        suffixes.push_back(normalized.substr(start, kMaxIndexedLength));
+        size_t space = normalized.find(' ', start);
+        if (space == std::string::npos) {
+            break;
+        }
+        start = space + 1;
+    }
+    return suffixes;
+}
+
+// static
+std::vector<std::string> NameSearch::trigrams(const std::string& normalized) {
+    std::vector<std::string> grams;
+    size_t length = std::min(normalized.size(), kMaxIndexedLength);
+    for (size_t i = 0; i + 3 <= length; ++i) {
+        grams.push_back(normalized.substr(i, 3));
+    }
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+    return grams;
+}
+
+// static
+float NameSearch::similarity(size_t shared, size_t queryTrigrams, size_t nameTrigrams) {
+    if (queryTrigrams + nameTrigrams == 0) {
+        return 0.0f;
+    }
+    return static_cast<float>(2 * shared) / static_cast<float>(queryTrigrams + nameTrigrams);
+}
+
+}  // namespace Confab
@@ -0,0 +1,57 @@
+#ifndef SRC_CONFAB_NAME_SEARCH_HPP_
+#define SRC_CONFAB_NAME_SEARCH_HPP_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace Confab {
+
+/*! Text processing shared by the writing and the querying of the Asset and List name search index.
+ *
+ * Names are normalized before indexing, so search is case-insensitive and ignores punctuation. Each normalized name is
+ * indexed under every suffix starting at a word, for type-ahead matching of any word in the name, and under each of
+ * its trigrams, for fuzzy matching of misspelled queries. Bytes outside of ASCII are kept as they are, so UTF-8 names
+ * are indexed too, if without case folding.
+ */
+class NameSearch {
+public:
+    /*! Longest normalized name indexed, in bytes. Longer names are truncated, and only found by their beginning.
+     */
+    static constexpr size_t kMaxIndexedLength = 64;
+
+    /*! Normalizes a name or query for indexing or search.
+     *
+     * \param name The name to normalize.
+     * \return The name in lower case, with each run of ASCII characters other than letters and digits replaced by a
+     *         single space, and no leading or trailing space.
+     */
+    static std::string normalize(const std::string& name);
+
+    /*! Lists the prefix index keys of a normalized name.
+     *
+     * \param normalized A name returned by normalize().
+     * \return Each suffix of normalized starting at a word, longest first, truncated to kMaxIndexedLength.
+     */
+    static std::vector<std::string> wordSuffixes(const std::string& normalized);
+
+    /*! Lists the trigrams of a normalized name.
+     *
+     * \param normalized A name returned by normalize().
+     * \return Each distinct three byte substring of the first kMaxIndexedLength bytes of normalized, in sorted order.
+     */
+    static std::vector<std::string> trigrams(const std::string& normalized);
+
+    /*! Scores how closely a name matches a query, by the trigrams they share.
+     *
+     * \param shared The number of trigrams in both the query and the name.
+     * \param queryTrigrams The number of trigrams in the query.
+     * \param nameTrigrams The number of trigrams in the name.
+     * \return The Dice coefficient of the two sets of trigrams, from 0 for nothing shared to 1 for identical sets.
+     */
+    static float similarity(size_t shared, size_t queryTrigrams, size_t nameTrigrams);
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_NAME_SEARCH_HPP_
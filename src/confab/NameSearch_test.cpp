@@ -0,0 +1,41 @@
+#include "NameSearch.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+TEST(NameSearchTest, Normalize) {
+    EXPECT_EQ("big drum loop 2", Confab::NameSearch::normalize("  Big_Drum--LOOP (2)! "));
+    EXPECT_EQ("", Confab::NameSearch::normalize(" ?! "));
+    // Bytes outside of ASCII are kept as they are.
+    EXPECT_EQ("caf\xc3\xa9 noise", Confab::NameSearch::normalize("Caf\xc3\xa9-Noise"));
+}
+
+TEST(NameSearchTest, WordSuffixes) {
+    std::vector<std::string> expected = { "big drum loop", "drum loop", "loop" };
+    EXPECT_EQ(expected, Confab::NameSearch::wordSuffixes("big drum loop"));
+    EXPECT_TRUE(Confab::NameSearch::wordSuffixes("").empty());
+
+    std::string longName(Confab::NameSearch::kMaxIndexedLength + 10, 'x');
+    auto suffixes = Confab::NameSearch::wordSuffixes(longName);
+    ASSERT_EQ(1u, suffixes.size());
+    EXPECT_EQ(Confab::NameSearch::kMaxIndexedLength, suffixes[0].size());
+}
+
+TEST(NameSearchTest, Trigrams) {
+    std::vector<std::string> expected = { " lo", "g l", "ig ", "loo", "oop", "big" };
+    std::sort(expected.begin(), expected.end());
+    EXPECT_EQ(expected, Confab::NameSearch::trigrams("big loop"));
+    // Repeated trigrams are only listed once.
+    EXPECT_EQ(std::vector<std::string>({ "aaa" }), Confab::NameSearch::trigrams("aaaaa"));
+    EXPECT_TRUE(Confab::NameSearch::trigrams("ab").empty());
+}
+
+TEST(NameSearchTest, Similarity) {
+    EXPECT_FLOAT_EQ(1.0f, Confab::NameSearch::similarity(4, 4, 4));
+    EXPECT_FLOAT_EQ(0.5f, Confab::NameSearch::similarity(2, 4, 4));
+    EXPECT_FLOAT_EQ(0.0f, Confab::NameSearch::similarity(0, 3, 5));
+    EXPECT_FLOAT_EQ(0.0f, Confab::NameSearch::similarity(0, 0, 0));
+}
@@ -4,7 +4,11 @@
 #include "AssetDatabase.hpp"
 #include "CacheManager.hpp"
 #include "Constants.hpp"
+#include "DirectoryIngester.hpp"
+#include "EmojiIndex.hpp"
 #include "HttpClient.hpp"
+#include "UpstreamQueue.hpp"
+#include "WaveformPeaks.hpp"
 #include "schemas/FlatAsset_generated.h"
 #include "schemas/FlatAssetData_generated.h"
 #include "schemas/FlatList_generated.h"
@@ -15,8 +19,61 @@
 #include "osc/OscPacketListener.h"
 #include "osc/OscReceivedElements.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <cstring>
 #include <future>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+/*! Maximum number of matches returned for one /emojiLookup, so that every response fits in kEmojiBufferSize.
+ */
+static const int kMaxEmojiMatches = 64;
+
+/*! Longest emoji sequence plus longest description in emoji-test.txt is under 128 bytes, with room for OSC padding.
+ */
+static const size_t kEmojiBufferSize = (kMaxEmojiMatches + 2) * 160;
+
+/*! Search results are at most kDataChunkSize bytes of text from the server, which grows by less than double once
+ * split in to OSC strings with their type tags and padding.
+ */
+static const size_t kSearchBufferSize = 2 * kPageSize;
+
+/*! Maximum number of Peak entries, across all columns and channels, returned for one /assetWaveform.
+ */
+static const size_t kMaxWaveformPeaks = 8192;
+
+/*! Each Peak entry is three int16 values, plus a page for the rest of the /assetWaveformFound message.
+ */
+static const size_t kWaveformBufferSize = (kMaxWaveformPeaks * 6) + kPageSize;
+
+/*! Parses the optional target format argument to /assetLoad, which is "float" for a 32-bit float WAV variant of a
+ * sample at its original rate, or "float:<rate>" for a variant at a sample rate of rate Hz.
+ *
+ * \param format The format string to parse.
+ * \param sampleRateOut Set to the requested sample rate, or zero for the original rate.
+ * \return true if format is valid.
+ */
+bool parseSampleFormat(const std::string& format, int& sampleRateOut) {
+    sampleRateOut = 0;
+    if (format == "float") {
+        return true;
+    }
+    if (format.compare(0, 6, "float:") != 0) {
+        return false;
+    }
+    char* endPtr = nullptr;
+    long sampleRate = std::strtol(format.c_str() + 6, &endPtr, 10);
+    if (*endPtr != '\0' || sampleRate <= 0 || sampleRate > 768000) {
+        return false;
+    }
+    sampleRateOut = static_cast<int>(sampleRate);
+    return true;
+}
+
+}  // namespace
 
 namespace Confab {
 
@@ -57,6 +114,25 @@ public:
                         m_handler->findAsset(assetKey);
                     });
                 }
+            } else if (std::strcmp("/assetFindBatch", message.AddressPattern()) == 0) {
+                std::vector<uint64_t> assetKeys;
+                for (auto arguments = message.ArgumentsBegin(); arguments != message.ArgumentsEnd(); ++arguments) {
+                    std::string assetIdString(arguments->AsString());
+                    uint64_t assetKey = Asset::stringToKey(assetIdString);
+                    if (assetKey == 0) {
+                        LOG(ERROR) << "/assetFindBatch got invalid key value: " << assetIdString;
+                    } else {
+                        assetKeys.push_back(assetKey);
+                    }
+                }
+
+                LOG(INFO) << "processing [/assetFindBatch] of " << assetKeys.size() << " keys";
+
+                if (assetKeys.size()) {
+                    std::async(std::launch::async, [this, assetKeys] {
+                        m_handler->findAssets(assetKeys);
+                    });
+                }
             } else if (std::strcmp("/assetFindName", message.AddressPattern()) == 0) {
                 osc::ReceivedMessage::const_iterator arguments = message.ArgumentsBegin();
                 std::string name((arguments++)->AsString());
@@ -71,20 +147,46 @@ public:
             } else if (std::strcmp("/assetLoad", message.AddressPattern()) == 0) {
                 osc::ReceivedMessage::const_iterator arguments = message.ArgumentsBegin();
                 std::string keyString((arguments++)->AsString());
+                std::string format;
+                if (arguments != message.ArgumentsEnd()) {
+                    format = (arguments++)->AsString();
+                }
                 if (arguments != message.ArgumentsEnd()) {
                     throw osc::ExcessArgumentException();
                 }
 
-                LOG(INFO) << "processing [/assetLoad " << keyString << "]";
+                LOG(INFO) << "processing [/assetLoad " << keyString << ", " << format << "]";
 
                 uint64_t key = Asset::stringToKey(keyString);
+                int sampleRate = 0;
                 if (key == 0) {
                     LOG(ERROR) << "/assetLoad got invalid key value: " << keyString;
+                } else if (format.size() > 0 && !parseSampleFormat(format, sampleRate)) {
+                    LOG(ERROR) << "/assetLoad got invalid format: " << format;
                 } else {
-                    std::async(std::launch::async, [this, key] {
-                        m_handler->loadAsset(key);
+                    bool variant = format.size() > 0;
+                    std::async(std::launch::async, [this, key, variant, sampleRate] {
+                        m_handler->loadAsset(key, variant, sampleRate);
                     });
                 };
+            } else if (std::strcmp("/assetWaveform", message.AddressPattern()) == 0) {
+                osc::ReceivedMessage::const_iterator arguments = message.ArgumentsBegin();
+                std::string keyString((arguments++)->AsString());
+                int width = (arguments++)->AsInt32();
+                if (arguments != message.ArgumentsEnd()) {
+                    throw osc::ExcessArgumentException();
+                }
+
+                LOG(INFO) << "processing [/assetWaveform " << keyString << ", " << width << "]";
+
+                uint64_t key = Asset::stringToKey(keyString);
+                if (key == 0 || width <= 0) {
+                    LOG(ERROR) << "/assetWaveform got invalid key or width: " << keyString << ", " << width;
+                } else {
+                    std::async(std::launch::async, [this, key, width] {
+                        m_handler->findWaveform(key, width);
+                    });
+                }
             } else if (std::strcmp("/assetAddFile", message.AddressPattern()) == 0) {
                 osc::ReceivedMessage::const_iterator arguments = message.ArgumentsBegin();
                 int serialNumber = (arguments++)->AsInt32();
@@ -118,6 +220,32 @@ public:
                         m_handler->addAssetFile(type, serialNumber, name, author, deprecates, listIds, filePath);
                     });
                 }
+            } else if (std::strcmp("/assetAddDirectory", message.AddressPattern()) == 0) {
+                osc::ReceivedMessage::const_iterator arguments = message.ArgumentsBegin();
+                int serialNumber = (arguments++)->AsInt32();
+                std::string typeString((arguments++)->AsString());
+                std::string listName((arguments++)->AsString());
+                std::string authorString((arguments++)->AsString());
+                uint64_t author = 0;
+                if (authorString.size() > 0) {
+                    author = Asset::stringToKey(authorString);
+                }
+                std::string directoryPath((arguments++)->AsString());
+                if (arguments != message.ArgumentsEnd()) {
+                    throw osc::ExcessArgumentException();
+                }
+
+                LOG(INFO) << "processing [/assetAddDirectory " << serialNumber << ", " << typeString << ", "
+                    << listName << ", " << authorString << ", " << directoryPath << "]";
+
+                Asset::Type type = Asset::typeStringToEnum(typeString);
+                if (type == Asset::kInvalid || listName.size() == 0) {
+                    LOG(ERROR) << "/assetAddDirectory got bad type string: " << typeString << " or empty list name.";
+                } else {
+                    std::async(std::launch::async, [this, serialNumber, type, listName, author, directoryPath] {
+                        m_handler->addAssetDirectory(serialNumber, type, listName, author, directoryPath);
+                    });
+                }
             } else if (std::strcmp("/assetAddString", message.AddressPattern()) == 0) {
                 osc::ReceivedMessage::const_iterator arguments = message.ArgumentsBegin();
                 int serialNumber = (arguments++)->AsInt32();
@@ -187,6 +315,55 @@ public:
                 std::async(std::launch::async, [this, key, token] {
                     m_handler->nextList(key, token);
                 });
+            } else if (std::strcmp("/listPrevious", message.AddressPattern()) == 0) {
+                osc::ReceivedMessage::const_iterator arguments = message.ArgumentsBegin();
+                std::string keyString((arguments++)->AsString());
+                uint64_t key = Asset::stringToKey(keyString);
+                std::string tokenString((arguments++)->AsString());
+                uint64_t token = Asset::stringToKey(tokenString);
+
+                LOG(INFO) << "processing [/listPrevious, " << keyString << ", " << tokenString << "]";
+
+                std::async(std::launch::async, [this, key, token] {
+                    m_handler->previousList(key, token);
+                });
+            } else if (std::strcmp("/listRange", message.AddressPattern()) == 0) {
+                osc::ReceivedMessage::const_iterator arguments = message.ArgumentsBegin();
+                std::string keyString((arguments++)->AsString());
+                uint64_t key = Asset::stringToKey(keyString);
+                std::string fromString((arguments++)->AsString());
+                uint64_t fromTime = Asset::stringToKey(fromString);
+                std::string toString((arguments++)->AsString());
+                uint64_t toTime = Asset::stringToKey(toString);
+
+                LOG(INFO) << "processing [/listRange, " << keyString << ", " << fromString << ", " << toString << "]";
+
+                std::async(std::launch::async, [this, key, fromTime, toTime] {
+                    m_handler->rangeList(key, fromTime, toTime);
+                });
+            } else if (std::strcmp("/assetSearch", message.AddressPattern()) == 0) {
+                osc::ReceivedMessage::const_iterator arguments = message.ArgumentsBegin();
+                std::string query((arguments++)->AsString());
+                int limit = (arguments++)->AsInt32();
+                if (arguments != message.ArgumentsEnd()) {
+                    throw osc::ExcessArgumentException();
+                }
+
+                LOG(INFO) << "processing [/assetSearch, " << query << ", " << limit << "]";
+
+                std::async(std::launch::async, [this, query, limit] {
+                    m_handler->searchAssets(query, limit);
+                });
+            } else if (std::strcmp("/emojiLookup", message.AddressPattern()) == 0) {
+                osc::ReceivedMessage::const_iterator arguments = message.ArgumentsBegin();
+                std::string prefix((arguments++)->AsString());
+                int limit = (arguments++)->AsInt32();
+                if (arguments != message.ArgumentsEnd()) {
+                    throw osc::ExcessArgumentException();
+                }
+
+                // Lookups take microseconds, so answer directly instead of launching a task.
+                m_handler->lookupEmoji(prefix, limit);
             } else {
                 LOG(ERROR) << "OSC unknown message: " << message.AddressPattern();
             }
@@ -200,12 +377,14 @@ private:
 };
 
 OscHandler::OscHandler(int listenPort, int sendPort, std::shared_ptr<AssetDatabase> assetDatabase,
-    std::shared_ptr<HttpClient> httpClient, std::shared_ptr<CacheManager> cacheManager) :
+    std::shared_ptr<HttpClient> httpClient, std::shared_ptr<CacheManager> cacheManager,
+    std::shared_ptr<UpstreamQueue> upstreamQueue) :
     m_listenPort(listenPort),
     m_sendPort(sendPort),
     m_assetDatabase(assetDatabase),
     m_httpClient(httpClient),
-    m_cacheManager(cacheManager) {
+    m_cacheManager(cacheManager),
+    m_upstreamQueue(upstreamQueue) {
 }
 
 OscHandler::~OscHandler() {
@@ -254,6 +433,37 @@ void OscHandler::findAsset(uint64_t assetId) {
     });
 }
 
+void OscHandler::findAssets(const std::vector<uint64_t>& assetIds) {
+    // Resolve everything the database cache has in one pass, and collect the rest for a single upstream batch.
+    std::vector<RecordPtr> databaseAssets = m_assetDatabase->findAssets(assetIds);
+    std::vector<uint64_t> missingIds;
+    for (size_t i = 0; i < assetIds.size(); ++i) {
+        if (databaseAssets[i]->empty()) {
+            missingIds.push_back(assetIds[i]);
+        } else {
+            sendAsset(Asset::keyToString(assetIds[i]), databaseAssets[i]);
+        }
+    }
+    if (missingIds.empty()) {
+        LOG(INFO) << "database cache hit for all " << assetIds.size() << " Assets in batch, sent to SC.";
+        return;
+    }
+
+    m_httpClient->getAssets(missingIds, [this](uint64_t assetId, RecordPtr record) {
+        if (record->empty()) {
+            char buffer[kDataChunkSize];
+            osc::OutboundPacketStream p(buffer, kDataChunkSize);
+            LOG(ERROR) << "failed to retrieve Asset " << Asset::keyToString(assetId) << ".";
+            p << osc::BeginMessage("/assetError") << Asset::keyToString(assetId).c_str()
+                << "Failed to find asset associated with key." << osc::EndMessage;
+            m_transmitSocket->Send(p.Data(), p.Size());
+        } else {
+            m_assetDatabase->storeAsset(assetId, record->data());
+            sendAsset(Asset::keyToString(assetId), record);
+        }
+    });
+}
+
 void OscHandler::findNamedAsset(std::string name) {
     // To ensure freshness of named Assets we don't refer to cache for them.
     m_httpClient->getNamedAsset(name, [this, &name](RecordPtr record) {
@@ -276,7 +486,7 @@ void OscHandler::findNamedAsset(std::string name) {
     });
 }
 
-void OscHandler::loadAsset(uint64_t key) {
+void OscHandler::loadAsset(uint64_t key, bool variant, int sampleRate) {
     uint64_t downloadKey = 0;
     fs::path assetPath = m_cacheManager->checkCache(key);
 
@@ -285,12 +495,13 @@ void OscHandler::loadAsset(uint64_t key) {
         size_t size = 0;
         uint64_t chunks = 0;
         std::string fileExtension;
+        Asset::Type type = Asset::kInvalid;
         // First check cache for this Asset.
         RecordPtr asset = m_assetDatabase->findAsset(key);
         if (asset->empty()) {
             LOG(INFO) << "cache miss for asset " << Asset::keyToString(key);
-            m_httpClient->getAsset(key, [this, &downloadKey, &size, &chunks, &fileExtension](uint64_t loadedKey,
-                RecordPtr record) {
+            m_httpClient->getAsset(key, [this, &downloadKey, &size, &chunks, &fileExtension, &type](
+                uint64_t loadedKey, RecordPtr record) {
                 if (record->empty()) {
                     LOG(ERROR) << "asset not found " << Asset::keyToString(loadedKey);
                 } else {
@@ -300,6 +511,7 @@ void OscHandler::loadAsset(uint64_t key) {
                     size = flatAsset->size();
                     chunks = flatAsset->chunks();
                     fileExtension = flatAsset->fileExtension()->str();
+                    type = static_cast<Asset::Type>(flatAsset->type());
                 }
             });
         } else {
@@ -310,6 +522,7 @@ void OscHandler::loadAsset(uint64_t key) {
             size = flatAsset->size();
             chunks = flatAsset->chunks();
             fileExtension = flatAsset->fileExtension()->str();
+            type = static_cast<Asset::Type>(flatAsset->type());
         }
 
         // We should have extracted what we need from the asset to download now.
@@ -317,11 +530,28 @@ void OscHandler::loadAsset(uint64_t key) {
             LOG(INFO) << "starting download for asset " << Asset::keyToString(downloadKey) << " for requested asset "
                 << Asset::keyToString(key) << ", " << size << " bytes, " << chunks << " chunks, " << fileExtension;
             assetPath = m_cacheManager->download(downloadKey, size, chunks, fileExtension);
+            // Downloading is the only time the whole sample passes through here, so compute the overview now, ahead
+            // of any request to draw it.
+            if (type == Asset::kSample && !assetPath.empty() && m_assetDatabase->loadWaveform(downloadKey)->empty()) {
+                storeWaveform(downloadKey, assetPath);
+            }
         } else {
             LOG(ERROR) << "unable to find Asset " << Asset::keyToString(key);
         }
     }
 
+    if (variant && !assetPath.empty()) {
+        // The file in the cache is under the key of the Asset actually downloaded, which may differ from the
+        // requested key due to deprecation.
+        fs::path variantPath = m_cacheManager->sampleVariant(downloadKey ? downloadKey : key, sampleRate);
+        if (variantPath.empty()) {
+            LOG(ERROR) << "unable to derive sample variant of Asset " << Asset::keyToString(key)
+                << ", returning original file.";
+        } else {
+            assetPath = variantPath;
+        }
+    }
+
     char buffer[kPageSize];
     osc::OutboundPacketStream p(buffer, kPageSize);
     p << osc::BeginMessage("/assetLoaded")
@@ -334,7 +564,10 @@ void OscHandler::loadAsset(uint64_t key) {
 
 void OscHandler::addAssetFile(Asset::Type type, int serialNumber, std::string name, uint64_t author,
     uint64_t deprecates, std::string listIds, std::string filePath) {
-    uint64_t key = m_httpClient->postFileAsset(type, name, author, deprecates, listIds, filePath);
+    uint64_t key = m_upstreamQueue->addFileAsset(type, name, author, deprecates, listIds, filePath);
+    if (type == Asset::kSample && key != 0) {
+        storeWaveform(key, filePath);
+    }
     char buffer[kPageSize];
     osc::OutboundPacketStream p(buffer, kPageSize);
     p << osc::BeginMessage("/assetAdded") << serialNumber << Asset::keyToString(key).c_str()
@@ -342,9 +575,80 @@ void OscHandler::addAssetFile(Asset::Type type, int serialNumber, std::string na
     m_transmitSocket->Send(p.Data(), p.Size());
 }
 
+void OscHandler::addAssetDirectory(int serialNumber, Asset::Type type, std::string listName, uint64_t author,
+    std::string directoryPath) {
+    DirectoryIngester ingester(m_httpClient, 0);
+    DirectoryIngester::Summary summary;
+    ingester.ingest(directoryPath, type, listName, author, summary);
+
+    char buffer[kPageSize];
+    osc::OutboundPacketStream p(buffer, kPageSize);
+    p << osc::BeginMessage("/assetDirectoryAdded") << serialNumber << Asset::keyToString(summary.listKey).c_str()
+        << static_cast<int>(summary.files) << static_cast<int>(summary.uploaded)
+        << static_cast<int>(summary.existing) << static_cast<int>(summary.failed) << osc::EndMessage;
+    m_transmitSocket->Send(p.Data(), p.Size());
+}
+
+bool OscHandler::storeWaveform(uint64_t key, const fs::path& audioFile) {
+    std::vector<uint8_t> peaks;
+    if (!WaveformPeaks::compute(audioFile, peaks)) {
+        LOG(ERROR) << "unable to compute waveform for Asset " << Asset::keyToString(key) << " from " << audioFile;
+        return false;
+    }
+    return m_assetDatabase->storeWaveform(key, SizedPointer(peaks.data(), peaks.size()));
+}
+
+void OscHandler::findWaveform(uint64_t key, int width) {
+    RecordPtr record = m_assetDatabase->loadWaveform(key);
+    if (record->empty()) {
+        // Overviews of samples added or downloaded before waveforms were supported can still be computed from the
+        // cached file, if there is one.
+        fs::path assetPath = m_cacheManager->checkCache(key);
+        if (!assetPath.empty() && storeWaveform(key, assetPath)) {
+            record = m_assetDatabase->loadWaveform(key);
+        }
+    }
+
+    if (record->empty()) {
+        char buffer[kPageSize];
+        osc::OutboundPacketStream p(buffer, kPageSize);
+        p << osc::BeginMessage("/assetError") << Asset::keyToString(key).c_str()
+            << "No waveform for asset, load it first." << osc::EndMessage;
+        m_transmitSocket->Send(p.Data(), p.Size());
+        return;
+    }
+
+    WaveformPeaks waveform(record->data());
+    if (!waveform.valid()) {
+        LOG(ERROR) << "corrupt waveform stored for Asset " << Asset::keyToString(key);
+        char buffer[kPageSize];
+        osc::OutboundPacketStream p(buffer, kPageSize);
+        p << osc::BeginMessage("/assetError") << Asset::keyToString(key).c_str() << "Corrupt waveform for asset."
+            << osc::EndMessage;
+        m_transmitSocket->Send(p.Data(), p.Size());
+        return;
+    }
+
+    size_t columns = std::min(static_cast<size_t>(width), kMaxWaveformPeaks / waveform.channels());
+    std::vector<WaveformPeaks::Peak> peaks;
+    waveform.render(columns, peaks);
+
+    std::vector<char> buffer(kWaveformBufferSize);
+    osc::OutboundPacketStream p(buffer.data(), buffer.size());
+    p << osc::BeginMessage("/assetWaveformFound")
+        << Asset::keyToString(key).c_str()
+        << waveform.channels()
+        << static_cast<float>(waveform.sampleRate())
+        << static_cast<float>(waveform.frames() / waveform.sampleRate())
+        << static_cast<int>(columns)
+        << osc::Blob(peaks.data(), peaks.size() * sizeof(WaveformPeaks::Peak))
+        << osc::EndMessage;
+    m_transmitSocket->Send(p.Data(), p.Size());
+}
+
 void OscHandler::addAssetString(Asset::Type type, int serialNumber, std::string name, uint64_t author,
     uint64_t deprecates, std::string listIds, std::string assetString) {
-    uint64_t key = m_httpClient->postInlineAsset(type, name, author, deprecates, listIds, assetString.size(),
+    uint64_t key = m_upstreamQueue->addInlineAsset(type, name, author, deprecates, listIds, assetString.size(),
         reinterpret_cast<const uint8_t*>(assetString.c_str()));
 
     // Regardless of success or failure of Asset add we return the key and serial number.
@@ -409,12 +713,66 @@ void OscHandler::findList(std::string name) {
 
 void OscHandler::nextList(uint64_t key, uint64_t token) {
     m_httpClient->getListItems(key, token, [this, &key](const std::string& tokens) {
-        char buffer[kPageSize];
-        osc::OutboundPacketStream p(buffer, kPageSize);
-        p << osc::BeginMessage("/listItems") << Asset::keyToString(key).c_str() << tokens.c_str() << osc::EndMessage;
+        sendListItems(key, tokens);
+    });
+}
+
+void OscHandler::previousList(uint64_t key, uint64_t token) {
+    m_httpClient->getListPreviousItems(key, token, [this, &key](const std::string& tokens) {
+        sendListItems(key, tokens);
+    });
+}
+
+void OscHandler::rangeList(uint64_t key, uint64_t fromTime, uint64_t toTime) {
+    m_httpClient->getListRangeItems(key, fromTime, toTime, [this, &key](const std::string& tokens) {
+        sendListItems(key, tokens);
+    });
+}
+
+void OscHandler::sendListItems(uint64_t key, const std::string& tokens) {
+    char buffer[kPageSize];
+    osc::OutboundPacketStream p(buffer, kPageSize);
+    p << osc::BeginMessage("/listItems") << Asset::keyToString(key).c_str() << tokens.c_str() << osc::EndMessage;
+    m_transmitSocket->Send(p.Data(), p.Size());
+}
+
+void OscHandler::lookupEmoji(const std::string& prefix, int limit) {
+    std::vector<EmojiIndex::Match> matches;
+    size_t total = EmojiIndex::lookup(prefix, std::min(std::max(limit, 0), kMaxEmojiMatches), matches);
+    char buffer[kEmojiBufferSize];
+    osc::OutboundPacketStream p(buffer, kEmojiBufferSize);
+    p << osc::BeginMessage("/emojiFound") << prefix.c_str() << static_cast<int>(total);
+    for (const auto& match : matches) {
+        p << match.emoji << match.description;
+    }
+    p << osc::EndMessage;
+    m_transmitSocket->Send(p.Data(), p.Size());
+}
+
+void OscHandler::searchAssets(const std::string& query, int limit) {
+    // Like lists, search results are never cached, as any new name stored on the server could change them.
+    m_httpClient->searchNames(query, std::max(limit, 0), [this, &query](const std::string& results) {
+        std::vector<std::string> lines;
+        std::istringstream resultStream(results);
+        std::string line;
+        while (std::getline(resultStream, line)) {
+            // Each line is "<a|l> <key> <name>", and names may themselves contain spaces.
+            if (line.size() > 2 && line.find(' ', 2) != std::string::npos) {
+                lines.push_back(line);
+            }
+        }
+
+        char buffer[kSearchBufferSize];
+        osc::OutboundPacketStream p(buffer, kSearchBufferSize);
+        p << osc::BeginMessage("/assetSearchResults") << query.c_str() << static_cast<int>(lines.size());
+        for (const auto& result : lines) {
+            size_t nameStart = result.find(' ', 2);
+            p << (result[0] == 'l' ? "list" : "asset") << result.substr(2, nameStart - 2).c_str()
+                << result.substr(nameStart + 1).c_str();
+        }
+        p << osc::EndMessage;
         m_transmitSocket->Send(p.Data(), p.Size());
     });
 }
 
 }  // namespace Confab
-
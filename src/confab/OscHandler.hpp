@@ -4,9 +4,13 @@
 #include "Asset.hpp"
 #include "Record.hpp"
 
+#include <experimental/filesystem>
 #include <memory>
 #include <string>
 #include <thread>
+#include <vector>
+
+namespace fs = std::experimental::filesystem;
 
 // Forward declarations from OscPack library.
 class UdpListeningReceiveSocket;
@@ -17,6 +21,7 @@ namespace Confab {
 class AssetDatabase;
 class CacheManager;
 class HttpClient;
+class UpstreamQueue;
 
 /*! Class for listening and responding to OSC messages from a single SuperCollider client.
  */
@@ -29,9 +34,11 @@ public:
      * \param assetDatabase The shared reference to the AssetDatabase instance, for caching smaller Assets locally.
      * \param httpClient A shared reference to the HttpClient instance this OscHandler should use for Asset queries.
      * \param cacheManager A shared reference to the CacheManager instnace this OscHandler should use for Cache queries.
+     * \param upstreamQueue A shared reference to the UpstreamQueue this OscHandler should add new Assets with.
      */
     OscHandler(int listenPort, int sendPort, std::shared_ptr<AssetDatabase> assetDatabase,
-        std::shared_ptr<HttpClient> httpClient, std::shared_ptr<CacheManager> cacheManager);
+        std::shared_ptr<HttpClient> httpClient, std::shared_ptr<CacheManager> cacheManager,
+        std::shared_ptr<UpstreamQueue> upstreamQueue);
 
     /*! Destructs an OSCHandler. Declared here to let us use std::unique_ptr with forward-declared classes.
      */
@@ -52,24 +59,46 @@ private:
      */
     void findAsset(uint64_t assetId);
 
+    /*! Searches for a batch of assets, first all together in the database cache and then all together upstream,
+     * sending each back to SC as with findAsset(). Should run as a task.
+     */
+    void findAssets(const std::vector<uint64_t>& assetIds);
+
     /*! Searches for an asset with provided name. Should run as a task.
      */
     void findNamedAsset(std::string name);
 
-    /*! Downloads an asset file to cache, provides path back to caller. Should run as a task.
+    /*! Downloads an asset file to cache, provides path back to caller. If variant is true, provides the path to a float
+     * WAV variant of the sample at sampleRate instead, or at its original rate if sampleRate is zero. Should run as a
+     * task.
      */
-    void loadAsset(uint64_t key);
+    void loadAsset(uint64_t key, bool variant, int sampleRate);
 
-    /*! Processes an asset addition request for a given file path. Should run as a task.
+    /*! Processes an asset addition request for a given file path, storing it locally and queueing it for upload.
+     * Should run as a task.
      */
     void addAssetFile(Asset::Type type, int serialNumber, std::string name, uint64_t author, uint64_t deprecates,
         std::string listIds, std::string filePath);
 
-    /*! Processes an asset addition request for a short string. Should run as a task.
+    /*! Ingests every file in a directory tree as an Asset on the named list, returns counts to SC. Should run as a task.
+     */
+    void addAssetDirectory(int serialNumber, Asset::Type type, std::string listName, uint64_t author,
+        std::string directoryPath);
+
+    /*! Processes an asset addition request for a short string, storing it locally and queueing it for upload. Should
+     * run as a task.
      */
     void addAssetString(Asset::Type type, int serialNumber, std::string name, uint64_t author, uint64_t deprecates,
         std::string listIds, std::string assetString);
 
+    /*! Computes the waveform overview of a sample Asset from its audio file and saves it in the database.
+     */
+    bool storeWaveform(uint64_t key, const fs::path& audioFile);
+
+    /*! Renders the waveform overview of a sample Asset at the requested width, returns it to SC. Should run as a task.
+     */
+    void findWaveform(uint64_t key, int width);
+
     /*! Utility method, sends an Asset back to SuperCollider via OSC. The requested string can either be a key or a
      * name.
      */
@@ -87,11 +116,32 @@ private:
      */
     void nextList(uint64_t key, uint64_t token);
 
+    /*! Iterates through previous elements in list, newest first, returns to SC.
+     */
+    void previousList(uint64_t key, uint64_t token);
+
+    /*! Finds the elements added to a list in a span of time, returns to SC.
+     */
+    void rangeList(uint64_t key, uint64_t fromTime, uint64_t toTime);
+
+    /*! Utility method, sends a string of list item pairs back to SC.
+     */
+    void sendListItems(uint64_t key, const std::string& tokens);
+
+    /*! Finds emoji with descriptions matching prefix, returns up to limit of them to SC.
+     */
+    void lookupEmoji(const std::string& prefix, int limit);
+
+    /*! Searches the server for Assets and Lists with names matching query, returns up to limit of them to SC.
+     */
+    void searchAssets(const std::string& query, int limit);
+
     int m_listenPort;
     int m_sendPort;
     std::shared_ptr<AssetDatabase> m_assetDatabase;
     std::shared_ptr<HttpClient> m_httpClient;
     std::shared_ptr<CacheManager> m_cacheManager;
+    std::shared_ptr<UpstreamQueue> m_upstreamQueue;
 
     std::unique_ptr<UdpTransmitSocket> m_transmitSocket;
     std::unique_ptr<OscListener> m_listener;
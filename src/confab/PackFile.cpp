@@ -0,0 +1,331 @@
+#include "PackFile.hpp"
+
+#include "glog/logging.h"
+#include "xxhash.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+/*! Written at the start of the header and at the end of the footer.
+ */
+static const char kPackMagic[8] = { 'c', 'o', 'n', 'f', 'a', 'b', 'p', 'k' };
+
+/*! Version of the pack file layout, stored in the header.
+ */
+static const uint64_t kPackVersion = 1;
+
+/*! Header size, the magic, then the 8-byte big-endian version and sequence.
+ */
+static const size_t kHeaderSize = 24;
+
+/*! Block header size, the 8-byte big-endian payload size, entry count, and XXH64 hash of the payload.
+ */
+static const size_t kBlockHeaderSize = 24;
+
+/*! Entry header size, the table character, then the 4-byte big-endian sizes of the key, value, and blob.
+ */
+static const size_t kEntryHeaderSize = 13;
+
+/*! Footer size, the 8-byte big-endian index offset, block count, and XXH64 hash of the index, then the magic.
+ */
+static const size_t kFooterSize = 32;
+
+inline void writeBigEndian64(uint64_t value, char* out) noexcept {
+    for (int i = 7; i >= 0; --i) {
+        out[i] = static_cast<char>(value & 0xff);
+        value >>= 8;
+    }
+}
+
+inline uint64_t readBigEndian64(const char* in) noexcept {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value = (value << 8) | static_cast<uint8_t>(in[i]);
+    }
+    return value;
+}
+
+inline void writeBigEndian32(uint32_t value, char* out) noexcept {
+    for (int i = 3; i >= 0; --i) {
+        out[i] = static_cast<char>(value & 0xff);
+        value >>= 8;
+    }
+}
+
+inline uint32_t readBigEndian32(const char* in) noexcept {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value = (value << 8) | static_cast<uint8_t>(in[i]);
+    }
+    return value;
+}
+
+}  // namespace
+
+namespace Confab {
+
+PackFile::PackFile(size_t blockSize) :
+    m_blockSize(blockSize),
+    m_writing(false),
+    m_sequence(0),
+    m_entries(0),
+    m_offset(0),
+    m_blockEntries(0) {
+}
+
+PackFile::~PackFile() {
+    close();
+}
+
+bool PackFile::create(const fs::path& path, uint64_t sequence) {
+    close();
+    m_file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!m_file) {
+        LOG(ERROR) << "failed to create pack file " << path;
+        return false;
+    }
+    char header[kHeaderSize];
+    std::memcpy(header, kPackMagic, sizeof(kPackMagic));
+    writeBigEndian64(kPackVersion, header + 8);
+    writeBigEndian64(sequence, header + 16);
+    m_file.write(header, kHeaderSize);
+    m_writing = true;
+    m_sequence = sequence;
+    m_offset = kHeaderSize;
+    return static_cast<bool>(m_file);
+}
+
+bool PackFile::add(char table, const SizedPointer& key, const SizedPointer& value, const SizedPointer& blob) {
+    if (!m_writing) {
+        return false;
+    }
+    std::string sortKey(1, table);
+    sortKey.append(key.dataChar(), key.size());
+    if (m_entries > 0 && sortKey <= m_lastKey) {
+        LOG(ERROR) << "pack file entry out of order in table " << table;
+        return false;
+    }
+    if (key.size() > UINT32_MAX || value.size() > UINT32_MAX || blob.size() > UINT32_MAX) {
+        LOG(ERROR) << "pack file entry too large in table " << table;
+        return false;
+    }
+
+    if (m_blockEntries == 0) {
+        m_index.push_back(IndexEntry{ m_offset, 0, sortKey });
+    }
+    char header[kEntryHeaderSize];
+    header[0] = table;
+    writeBigEndian32(key.size(), header + 1);
+    writeBigEndian32(value.size(), header + 5);
+    writeBigEndian32(blob.size(), header + 9);
+    m_block.append(header, kEntryHeaderSize);
+    m_block.append(key.dataChar(), key.size());
+    m_block.append(value.dataChar(), value.size());
+    m_block.append(blob.dataChar(), blob.size());
+    ++m_blockEntries;
+    ++m_entries;
+    m_lastKey.swap(sortKey);
+
+    if (m_block.size() >= m_blockSize) {
+        return writeBlock();
+    }
+    return true;
+}
+
+bool PackFile::finish() {
+    if (!m_writing) {
+        return false;
+    }
+    if (m_blockEntries > 0 && !writeBlock()) {
+        return false;
+    }
+
+    std::string index;
+    char field[8];
+    for (const auto& block : m_index) {
+        writeBigEndian64(block.offset, field);
+        index.append(field, 8);
+        writeBigEndian64(block.entries, field);
+        index.append(field, 8);
+        writeBigEndian32(block.firstKey.size(), field);
+        index.append(field, 4);
+        index.append(block.firstKey);
+    }
+    m_file.write(index.data(), index.size());
+
+    char footer[kFooterSize];
+    writeBigEndian64(m_offset, footer);
+    writeBigEndian64(m_index.size(), footer + 8);
+    writeBigEndian64(XXH64(index.data(), index.size(), 0), footer + 16);
+    std::memcpy(footer + 24, kPackMagic, sizeof(kPackMagic));
+    m_file.write(footer, kFooterSize);
+    m_file.flush();
+    bool ok = static_cast<bool>(m_file);
+    if (!ok) {
+        LOG(ERROR) << "failed to write pack file index.";
+    }
+    m_file.close();
+    m_writing = false;
+    return ok;
+}
+
+bool PackFile::open(const fs::path& path) {
+    close();
+    m_file.open(path, std::ios::in | std::ios::binary);
+    if (!m_file) {
+        LOG(ERROR) << "failed to open pack file " << path;
+        return false;
+    }
+
+    char header[kHeaderSize];
+    char footer[kFooterSize];
+    m_file.read(header, kHeaderSize);
+    m_file.seekg(0, std::ios::end);
+    uint64_t fileSize = m_file.tellg();
+    if (fileSize >= kHeaderSize + kFooterSize) {
+        m_file.seekg(fileSize - kFooterSize);
+        m_file.read(footer, kFooterSize);
+    }
+    if (!m_file || fileSize < kHeaderSize + kFooterSize || std::memcmp(header, kPackMagic, sizeof(kPackMagic)) != 0 ||
+        std::memcmp(footer + 24, kPackMagic, sizeof(kPackMagic)) != 0) {
+        LOG(ERROR) << "pack file " << path << " is incomplete or not a pack file.";
+        close();
+        return false;
+    }
+    if (readBigEndian64(header + 8) != kPackVersion) {
+        LOG(ERROR) << "pack file " << path << " has unsupported version " << readBigEndian64(header + 8);
+        close();
+        return false;
+    }
+    m_sequence = readBigEndian64(header + 16);
+
+    uint64_t indexOffset = readBigEndian64(footer);
+    uint64_t blockCount = readBigEndian64(footer + 8);
+    if (indexOffset < kHeaderSize || indexOffset > fileSize - kFooterSize) {
+        LOG(ERROR) << "pack file " << path << " has a corrupt footer.";
+        close();
+        return false;
+    }
+    std::string index(fileSize - kFooterSize - indexOffset, '\0');
+    m_file.seekg(indexOffset);
+    m_file.read(&index[0], index.size());
+    if (!m_file || XXH64(index.data(), index.size(), 0) != readBigEndian64(footer + 16)) {
+        LOG(ERROR) << "pack file " << path << " has a corrupt index.";
+        close();
+        return false;
+    }
+
+    size_t position = 0;
+    while (m_index.size() < blockCount && position + 20 <= index.size()) {
+        IndexEntry block;
+        block.offset = readBigEndian64(index.data() + position);
+        block.entries = readBigEndian64(index.data() + position + 8);
+        size_t keySize = readBigEndian32(index.data() + position + 16);
+        position += 20;
+        if (position + keySize > index.size() || block.offset >= indexOffset) {
+            break;
+        }
+        block.firstKey.assign(index.data() + position, keySize);
+        position += keySize;
+        m_entries += block.entries;
+        m_index.push_back(std::move(block));
+    }
+    if (m_index.size() != blockCount || position != index.size()) {
+        LOG(ERROR) << "pack file " << path << " has a corrupt index.";
+        close();
+        return false;
+    }
+    return true;
+}
+
+size_t PackFile::findBlock(char table, const SizedPointer& key) const {
+    std::string sortKey(1, table);
+    sortKey.append(key.dataChar(), key.size());
+    auto block = std::upper_bound(m_index.begin(), m_index.end(), sortKey,
+        [](const std::string& target, const IndexEntry& entry) {
+            return target < entry.firstKey;
+        });
+    return block == m_index.begin() ? 0 : (block - m_index.begin()) - 1;
+}
+
+bool PackFile::readBlock(size_t block, std::vector<Entry>& entriesOut) {
+    entriesOut.clear();
+    if (m_writing || block >= m_index.size()) {
+        return false;
+    }
+    char header[kBlockHeaderSize];
+    m_file.seekg(m_index[block].offset);
+    m_file.read(header, kBlockHeaderSize);
+    uint64_t payloadSize = readBigEndian64(header);
+    uint64_t entries = readBigEndian64(header + 8);
+    uint64_t end = block + 1 < m_index.size() ? m_index[block + 1].offset : UINT64_MAX;
+    if (!m_file || entries != m_index[block].entries || m_index[block].offset + kBlockHeaderSize + payloadSize > end) {
+        LOG(ERROR) << "pack file block " << block << " has a corrupt header.";
+        return false;
+    }
+    m_block.resize(payloadSize);
+    m_file.read(&m_block[0], payloadSize);
+    if (!m_file || XXH64(m_block.data(), m_block.size(), 0) != readBigEndian64(header + 16)) {
+        LOG(ERROR) << "pack file block " << block << " failed hash check.";
+        return false;
+    }
+
+    size_t position = 0;
+    while (entriesOut.size() < entries && position + kEntryHeaderSize <= m_block.size()) {
+        const char* entryHeader = m_block.data() + position;
+        size_t keySize = readBigEndian32(entryHeader + 1);
+        size_t valueSize = readBigEndian32(entryHeader + 5);
+        size_t blobSize = readBigEndian32(entryHeader + 9);
+        position += kEntryHeaderSize;
+        if (position + keySize + valueSize + blobSize > m_block.size()) {
+            break;
+        }
+        const char* data = m_block.data() + position;
+        entriesOut.push_back(Entry{ entryHeader[0], SizedPointer(data, keySize),
+            SizedPointer(data + keySize, valueSize), SizedPointer(data + keySize + valueSize, blobSize) });
+        position += keySize + valueSize + blobSize;
+    }
+    if (entriesOut.size() != entries || position != m_block.size()) {
+        LOG(ERROR) << "pack file block " << block << " has corrupt entries.";
+        entriesOut.clear();
+        return false;
+    }
+    return true;
+}
+
+void PackFile::close() {
+    if (m_file.is_open()) {
+        m_file.close();
+    }
+    m_file.clear();
+    m_writing = false;
+    m_sequence = 0;
+    m_entries = 0;
+    m_offset = 0;
+    m_index.clear();
+    m_block.clear();
+    m_blockEntries = 0;
+    m_lastKey.clear();
+}
+
+bool PackFile::writeBlock() {
+    char header[kBlockHeaderSize];
+    writeBigEndian64(m_block.size(), header);
+    writeBigEndian64(m_blockEntries, header + 8);
+    writeBigEndian64(XXH64(m_block.data(), m_block.size(), 0), header + 16);
+    m_file.write(header, kBlockHeaderSize);
+    m_file.write(m_block.data(), m_block.size());
+    if (!m_file) {
+        LOG(ERROR) << "failed to write pack file block " << m_index.size() - 1;
+        return false;
+    }
+    m_index.back().entries = m_blockEntries;
+    m_offset += kBlockHeaderSize + m_block.size();
+    m_block.clear();
+    m_blockEntries = 0;
+    return true;
+}
+
+}  // namespace Confab
@@ -0,0 +1,155 @@
+#ifndef SRC_CONFAB_PACK_FILE_HPP_
+#define SRC_CONFAB_PACK_FILE_HPP_
+
+#include "SizedPointer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <experimental/filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::experimental::filesystem;
+
+namespace Confab {
+
+/*! A single file holding a sorted copy of every entry in a database, for moving whole databases between machines.
+ *
+ * Entries are written in sorted order in to blocks of about the same size, each with its own hash, so corruption is
+ * found before anything read from a damaged block is used. An index of the first key of every block follows the
+ * blocks, then a fixed-size footer locating the index, so a reader can check the whole file is present and seek to the
+ * block holding any key without reading those before it.
+ *
+ * Each entry belongs to a table, identified by a single character, and is sorted first by table and then by key. Along
+ * with its key and value an entry may carry a blob, for values that refer to data stored outside of the database.
+ */
+class PackFile {
+public:
+    /*! Default payload size in bytes after which a block is ended.
+     */
+    static constexpr size_t kDefaultBlockSize = 1024 * 1024;
+
+    /*! An entry read from a pack file. Pointers are in to the block buffer of the PackFile, and are valid until the
+     * next call to readBlock() or close().
+     */
+    struct Entry {
+        char table;
+        SizedPointer key;
+        SizedPointer value;
+        SizedPointer blob;
+    };
+
+    /*! Constructs a closed PackFile.
+     *
+     * \param blockSize The payload size in bytes after which a block is ended, when writing.
+     */
+    explicit PackFile(size_t blockSize = kDefaultBlockSize);
+
+    /*! Closes the file, if open, without finishing a file being written.
+     */
+    ~PackFile();
+
+    /*! Creates a new pack file for writing, replacing any existing file.
+     *
+     * \param path The path of the file to create.
+     * \param sequence A value stored in the file header, returned by sequence() when read.
+     * \return true on success, false on error.
+     */
+    bool create(const fs::path& path, uint64_t sequence);
+
+    /*! Adds an entry to a file opened with create().
+     *
+     * \param table The table of the entry.
+     * \param key The key of the entry, which must sort after the previous key added to the same table.
+     * \param value The value of the entry.
+     * \param blob Data stored outside of the database along with the value, or empty for none.
+     * \return true on success, false on error or if the entry is out of order.
+     */
+    bool add(char table, const SizedPointer& key, const SizedPointer& value,
+        const SizedPointer& blob = SizedPointer());
+
+    /*! Writes the last block, the index, and the footer, and closes a file opened with create().
+     *
+     * \return true on success, false on error.
+     */
+    bool finish();
+
+    /*! Opens an existing pack file for reading, checking its header, footer, and index.
+     *
+     * \param path The path of the file to open.
+     * \return true on success, false on error or if the file is incomplete or corrupt.
+     */
+    bool open(const fs::path& path);
+
+    /*! The number of blocks in a file opened with open().
+     *
+     * \return The number of blocks.
+     */
+    size_t blocks() const { return m_index.size(); }
+
+    /*! The number of entries in the file.
+     *
+     * \return The number of entries added so far to a file being written, or the total in a file being read.
+     */
+    uint64_t entries() const { return m_entries; }
+
+    /*! The value passed to create() when the file was written.
+     *
+     * \return The header sequence value.
+     */
+    uint64_t sequence() const { return m_sequence; }
+
+    /*! Finds the block that would hold an entry.
+     *
+     * \param table The table of the entry.
+     * \param key The key of the entry.
+     * \return The index of the last block starting at or before the entry, or 0 if the entry sorts before every block.
+     */
+    size_t findBlock(char table, const SizedPointer& key) const;
+
+    /*! Reads and checks a block of a file opened with open().
+     *
+     * \param block The index of the block to read, less than blocks().
+     * \param entriesOut Replaced with the entries of the block, in order.
+     * \return true on success, false on error or if the block is corrupt.
+     */
+    bool readBlock(size_t block, std::vector<Entry>& entriesOut);
+
+    /*! Closes the file.
+     */
+    void close();
+
+    /// @cond UNDOCUMENTED
+    PackFile(const PackFile&) = delete;
+    PackFile& operator=(const PackFile&) = delete;
+    /// @endcond UNDOCUMENTED
+
+private:
+    struct IndexEntry {
+        uint64_t offset;
+        uint64_t entries;
+        // The table character followed by the key of the first entry in the block.
+        std::string firstKey;
+    };
+
+    // Writes the block being built to the file and adds it to the index.
+    bool writeBlock();
+
+    size_t m_blockSize;
+    std::fstream m_file;
+    bool m_writing;
+    uint64_t m_sequence;
+    uint64_t m_entries;
+    uint64_t m_offset;
+    std::vector<IndexEntry> m_index;
+    // The block being written, or the last block read.
+    std::string m_block;
+    uint64_t m_blockEntries;
+    // The table character followed by the key of the last entry added, to check entries arrive in order.
+    std::string m_lastKey;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_PACK_FILE_HPP_
@@ -0,0 +1,124 @@
+#include "PackFile.hpp"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+fs::path makeEmptyFile(const char* name) {
+    fs::path path = fs::temp_directory_path() / name;
+    fs::remove(path);
+    return path;
+}
+
+Confab::SizedPointer pointer(const std::string& value) {
+    return Confab::SizedPointer(value.data(), value.size());
+}
+
+std::string entryString(const Confab::SizedPointer& pointer) {
+    return std::string(pointer.dataChar(), pointer.size());
+}
+
+}  // namespace
+
+TEST(PackFileTest, WriteAndRead) {
+    fs::path path = makeEmptyFile("PackFile_test_write_and_read");
+    {
+        // Small blocks, to get several.
+        Confab::PackFile pack(64);
+        ASSERT_TRUE(pack.create(path, 47));
+        ASSERT_TRUE(pack.add('d', pointer("c1"), pointer("chunk reference"), pointer("chunk blob")));
+        for (int i = 0; i < 20; ++i) {
+            std::string key = "a" + std::to_string(100 + i);
+            ASSERT_TRUE(pack.add('m', pointer(key), pointer("asset " + key)));
+        }
+        EXPECT_EQ(21u, pack.entries());
+        ASSERT_TRUE(pack.finish());
+    }
+
+    Confab::PackFile pack;
+    ASSERT_TRUE(pack.open(path));
+    EXPECT_EQ(47u, pack.sequence());
+    EXPECT_EQ(21u, pack.entries());
+    ASSERT_GT(pack.blocks(), 2u);
+
+    std::vector<Confab::PackFile::Entry> entries;
+    ASSERT_TRUE(pack.readBlock(0, entries));
+    ASSERT_FALSE(entries.empty());
+    EXPECT_EQ('d', entries[0].table);
+    EXPECT_EQ("c1", entryString(entries[0].key));
+    EXPECT_EQ("chunk reference", entryString(entries[0].value));
+    EXPECT_EQ("chunk blob", entryString(entries[0].blob));
+
+    size_t total = 0;
+    std::string lastKey;
+    for (size_t block = 0; block < pack.blocks(); ++block) {
+        ASSERT_TRUE(pack.readBlock(block, entries));
+        for (const auto& entry : entries) {
+            std::string key = std::string(1, entry.table) + entryString(entry.key);
+            EXPECT_LT(lastKey, key);
+            lastKey = key;
+            ++total;
+        }
+    }
+    EXPECT_EQ(21u, total);
+
+    // The block found for a key holds it.
+    size_t block = pack.findBlock('m', pointer("a113"));
+    ASSERT_TRUE(pack.readBlock(block, entries));
+    bool found = false;
+    for (const auto& entry : entries) {
+        if (entry.table == 'm' && entryString(entry.key) == "a113") {
+            EXPECT_EQ("asset a113", entryString(entry.value));
+            EXPECT_EQ(0u, entry.blob.size());
+            found = true;
+        }
+    }
+    EXPECT_TRUE(found);
+    EXPECT_EQ(0u, pack.findBlock('a', pointer("z")));
+}
+
+TEST(PackFileTest, RejectsOutOfOrder) {
+    fs::path path = makeEmptyFile("PackFile_test_out_of_order");
+    Confab::PackFile pack;
+    ASSERT_TRUE(pack.create(path, 0));
+    ASSERT_TRUE(pack.add('m', pointer("b"), pointer("1")));
+    EXPECT_FALSE(pack.add('m', pointer("a"), pointer("2")));
+    EXPECT_FALSE(pack.add('m', pointer("b"), pointer("3")));
+    EXPECT_FALSE(pack.add('d', pointer("c"), pointer("4")));
+    EXPECT_TRUE(pack.add('m', pointer("c"), pointer("5")));
+    EXPECT_TRUE(pack.finish());
+}
+
+TEST(PackFileTest, DetectsCorruption) {
+    fs::path path = makeEmptyFile("PackFile_test_corruption");
+    {
+        Confab::PackFile pack;
+        ASSERT_TRUE(pack.create(path, 0));
+        ASSERT_TRUE(pack.add('m', pointer("key"), pointer("a value long enough to flip a byte in")));
+        ASSERT_TRUE(pack.finish());
+    }
+
+    // Flip a byte in the middle of the only block, which the index and footer don't cover.
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekg(24 + 24 + 13 + 3 + 10);
+        char byte = 0;
+        file.read(&byte, 1);
+        byte ^= 0x20;
+        file.seekp(24 + 24 + 13 + 3 + 10);
+        file.write(&byte, 1);
+    }
+    Confab::PackFile pack;
+    ASSERT_TRUE(pack.open(path));
+    std::vector<Confab::PackFile::Entry> entries;
+    EXPECT_FALSE(pack.readBlock(0, entries));
+    EXPECT_TRUE(entries.empty());
+
+    // A truncated file has no footer.
+    fs::resize_file(path, fs::file_size(path) - 1);
+    EXPECT_FALSE(pack.open(path));
+}
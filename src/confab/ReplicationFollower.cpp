@@ -0,0 +1,220 @@
+#include "ReplicationFollower.hpp"
+
+#include "Asset.hpp"
+#include "Constants.hpp"
+#include "HttpClient.hpp"
+
+#include "glog/logging.h"
+#include "libbase64.h"
+
+#include <map>
+#include <sstream>
+#include <utility>
+
+namespace {
+
+/*! HTTP status codes of replication log responses the follower acts on.
+ */
+static const int kHttpOk = 200;
+static const int kHttpGone = 410;
+
+}  // namespace
+
+namespace Confab {
+
+ReplicationFollower::ReplicationFollower(std::shared_ptr<AssetDatabase> assetDatabase,
+        std::shared_ptr<HttpClient> leaderClient, std::chrono::milliseconds pollInterval) :
+    m_assetDatabase(assetDatabase),
+    m_leaderClient(leaderClient),
+    m_pollInterval(pollInterval),
+    m_applied(0),
+    m_quit(false) {
+}
+
+ReplicationFollower::~ReplicationFollower() {
+    stop();
+}
+
+void ReplicationFollower::start() {
+    if (m_thread.joinable()) {
+        LOG(ERROR) << "replication follower already started.";
+        return;
+    }
+    m_applied = m_assetDatabase->replicationApplied();
+    {
+        std::lock_guard<std::mutex> lock(m_quitMutex);
+        m_quit = false;
+    }
+    LOG(INFO) << "starting replication from leader log after sequence " << m_applied;
+    m_thread = std::thread(&ReplicationFollower::follow, this);
+}
+
+void ReplicationFollower::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_quitMutex);
+        m_quit = true;
+    }
+    m_quitCondition.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void ReplicationFollower::follow() {
+    std::vector<AssetDatabase::ReplicationEntry> entries;
+    while (true) {
+        int code = 0;
+        std::string log;
+        m_leaderClient->getReplicationLog(m_applied, [&code, &log](int responseCode, const std::string& body) {
+            code = responseCode;
+            log = body;
+        });
+
+        if (code == kHttpGone) {
+            LOG(ERROR) << "leader no longer keeps its replication log after sequence " << m_applied
+                << ", stopping replication. Copy the leader database to start again.";
+            return;
+        }
+
+        uint64_t lastSequence = m_applied;
+        if (code != kHttpOk || !fetchBatch(log, entries, lastSequence)) {
+            if (!waitToPoll()) {
+                return;
+            }
+            continue;
+        }
+
+        if (lastSequence == m_applied) {
+            if (!waitToPoll()) {
+                return;
+            }
+            continue;
+        }
+
+        // The whole batch is applied before the position is recorded, so a batch interrupted by an error or restart is
+        // applied again from its start.
+        bool ok = true;
+        for (const auto& entry : entries) {
+            if (!m_assetDatabase->applyReplicationEntry(entry)) {
+                LOG(ERROR) << "failed to apply leader replication log entry " << entry.sequence;
+                ok = false;
+                break;
+            }
+        }
+        if (!ok || !m_assetDatabase->setReplicationApplied(lastSequence)) {
+            if (!waitToPoll()) {
+                return;
+            }
+            continue;
+        }
+        m_applied = lastSequence;
+        LOG(INFO) << "applied " << entries.size() << " leader replication log entries, through sequence "
+            << m_applied;
+
+        std::lock_guard<std::mutex> lock(m_quitMutex);
+        if (m_quit) {
+            return;
+        }
+    }
+}
+
+bool ReplicationFollower::fetchBatch(const std::string& log,
+    std::vector<AssetDatabase::ReplicationEntry>& entriesOut, uint64_t& lastSequenceOut) {
+    entriesOut.clear();
+    lastSequenceOut = m_applied;
+    std::istringstream lines(log);
+    std::string line;
+    char decoded[kPageSize];
+    std::vector<std::pair<uint64_t, uint64_t>> keyChunks;
+    while (std::getline(lines, line)) {
+        std::istringstream fields(line);
+        std::string sequence;
+        std::string op;
+        std::string key;
+        std::string argument;
+        std::string payload;
+        if (!(fields >> sequence >> op >> key >> argument) || op.size() != 1) {
+            LOG(ERROR) << "malformed leader replication log line '" << line << "'";
+            return false;
+        }
+        fields >> payload;
+
+        AssetDatabase::ReplicationEntry entry;
+        entry.sequence = Asset::stringToKey(sequence);
+        entry.op = static_cast<AssetDatabase::ReplicationOp>(op[0]);
+        entry.key = Asset::stringToKey(key);
+        entry.argument = Asset::stringToKey(argument);
+        entry.assetKey = 0;
+        if (entry.sequence != lastSequenceOut + 1) {
+            LOG(ERROR) << "leader replication log out of order at sequence " << sequence;
+            return false;
+        }
+        lastSequenceOut = entry.sequence;
+
+        switch (entry.op) {
+        case AssetDatabase::kReplicateAsset:
+        case AssetDatabase::kReplicateList: {
+            if (payload.size() >= kPageSize) {
+                LOG(ERROR) << "leader replication log entry " << sequence << " too large.";
+                return false;
+            }
+            size_t decodedSize = 0;
+            base64_decode(payload.data(), payload.size(), decoded, &decodedSize, 0);
+            entry.record.assign(decoded, decodedSize);
+            break;
+        }
+
+        case AssetDatabase::kReplicateAssetData:
+            // Chunks are not in the log, as they would take a response each anyway. They are downloaded together
+            // once the whole log response is parsed.
+            keyChunks.emplace_back(entry.key, entry.argument);
+            break;
+
+        case AssetDatabase::kReplicateListItem:
+            entry.assetKey = Asset::stringToKey(payload);
+            break;
+
+        default:
+            LOG(ERROR) << "unknown operation '" << op << "' in leader replication log entry " << sequence;
+            return false;
+        }
+
+        entriesOut.push_back(std::move(entry));
+    }
+
+    if (keyChunks.empty()) {
+        return true;
+    }
+    std::map<std::pair<uint64_t, uint64_t>, std::string> chunks;
+    m_leaderClient->getAssetDataBatch(keyChunks, [&chunks](uint64_t key, uint64_t chunk, RecordPtr record) {
+        if (!record->empty()) {
+            chunks[std::make_pair(key, chunk)].assign(record->data().dataChar(), record->data().size());
+        }
+    });
+    auto entry = entriesOut.begin();
+    while (entry != entriesOut.end()) {
+        if (entry->op != AssetDatabase::kReplicateAssetData) {
+            ++entry;
+            continue;
+        }
+        auto found = chunks.find(std::make_pair(entry->key, entry->argument));
+        if (found == chunks.end()) {
+            // Garbage collection on the leader may have since deleted the chunk, in which case the follower would
+            // delete it too, so it is skipped rather than holding up replication.
+            LOG(WARNING) << "skipping leader replication log entry " << entry->sequence << " for missing chunk "
+                << entry->argument << " of Asset " << Asset::keyToString(entry->key);
+            entry = entriesOut.erase(entry);
+            continue;
+        }
+        entry->record = std::move(found->second);
+        ++entry;
+    }
+    return true;
+}
+
+bool ReplicationFollower::waitToPoll() {
+    std::unique_lock<std::mutex> lock(m_quitMutex);
+    return !m_quitCondition.wait_for(lock, m_pollInterval, [this] { return m_quit; });
+}
+
+}  // namespace Confab
@@ -0,0 +1,85 @@
+#ifndef SRC_CONFAB_REPLICATION_FOLLOWER_HPP_
+#define SRC_CONFAB_REPLICATION_FOLLOWER_HPP_
+
+#include "AssetDatabase.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Confab {
+
+class HttpClient;
+
+/*! Keeps a follower database current by tailing the replication log of a leader confab-server over HTTP.
+ *
+ * Each request to the leader returns a batch of log entries, which are fetched in full, with AssetData chunks
+ * downloaded separately, and then applied in order before the position reached is durably recorded. A batch
+ * interrupted part way through is applied again from its start, which has no further effect on entries already
+ * applied. Once caught up, the leader is polled for new entries.
+ *
+ * A follower serves reads through an HttpEndpoint constructed to refuse writes. To take over from the leader, stop
+ * the follower and serve its database with writes accepted, as it holds every write the leader logged. If the
+ * follower also logs its own writes, other followers of the old leader can continue from the same sequence number,
+ * as long as the new leader began replicating from an empty database.
+ */
+class ReplicationFollower {
+public:
+    /*! Constructs a stopped follower.
+     *
+     * \param assetDatabase The follower database to apply entries to.
+     * \param leaderClient An HttpClient for the leader, with no replicas, used to read the log and download chunks.
+     * \param pollInterval The time to wait between requests once caught up, or after an error.
+     */
+    ReplicationFollower(std::shared_ptr<AssetDatabase> assetDatabase, std::shared_ptr<HttpClient> leaderClient,
+        std::chrono::milliseconds pollInterval);
+
+    /*! Stops the follower, if running.
+     */
+    ~ReplicationFollower();
+
+    /*! Starts the thread that tails the leader log.
+     */
+    void start();
+
+    /*! Stops the thread, waiting for any batch being applied to finish.
+     */
+    void stop();
+
+    /*! The sequence number of the last leader log entry applied.
+     *
+     * \return The last sequence number applied, or 0 if none.
+     */
+    uint64_t applied() const { return m_applied; }
+
+private:
+    // Loop of m_thread.
+    void follow();
+    // Parses a response from the leader log into entriesOut, downloading the records of any AssetData entries in one
+    // batch, and sets lastSequenceOut to the last sequence number read, including any entries skipped. Returns false
+    // on error.
+    bool fetchBatch(const std::string& log, std::vector<AssetDatabase::ReplicationEntry>& entriesOut,
+        uint64_t& lastSequenceOut);
+    // Waits for up to m_pollInterval, returning false if stop() was called.
+    bool waitToPoll();
+
+    std::shared_ptr<AssetDatabase> m_assetDatabase;
+    std::shared_ptr<HttpClient> m_leaderClient;
+    std::chrono::milliseconds m_pollInterval;
+    std::atomic<uint64_t> m_applied;
+
+    // Used only to wake the thread on stop().
+    std::mutex m_quitMutex;
+    std::condition_variable m_quitCondition;
+    bool m_quit;
+    std::thread m_thread;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_REPLICATION_FOLLOWER_HPP_
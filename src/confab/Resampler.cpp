@@ -0,0 +1,151 @@
+#include "Resampler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CONFAB_RESAMPLER_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CONFAB_RESAMPLER_NEON 1
+#endif
+
+namespace {
+
+/*! When converting down, the filter cutoff is this fraction of the output Nyquist frequency, leaving room for the
+ * transition band of a kTaps-long filter. Converting up keeps the full input bandwidth.
+ */
+static const double kCutoffScale = 0.94;
+
+/*! Computes the dot product of kTaps samples with kTaps filter coefficients.
+ */
+float dotProduct(const float* samples, const float* filter) {
+#if defined(CONFAB_RESAMPLER_SSE2)
+    __m128 sumVector = _mm_setzero_ps();
+    for (size_t i = 0; i < Confab::Resampler::kTaps; i += 4) {
+        sumVector = _mm_add_ps(sumVector, _mm_mul_ps(_mm_loadu_ps(samples + i), _mm_loadu_ps(filter + i)));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, sumVector);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(CONFAB_RESAMPLER_NEON)
+    float32x4_t sumVector = vdupq_n_f32(0.0f);
+    for (size_t i = 0; i < Confab::Resampler::kTaps; i += 4) {
+        sumVector = vmlaq_f32(sumVector, vld1q_f32(samples + i), vld1q_f32(filter + i));
+    }
+    float lanes[4];
+    vst1q_f32(lanes, sumVector);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#else
+    float sum = 0.0f;
+    for (size_t i = 0; i < Confab::Resampler::kTaps; ++i) {
+        sum += samples[i] * filter[i];
+    }
+    return sum;
+#endif
+}
+
+}  // namespace
+
+namespace Confab {
+
+constexpr size_t Resampler::kTaps;
+constexpr size_t Resampler::kPhases;
+
+Resampler::Resampler(int channels, double inputRate, double outputRate) :
+    m_channels(channels),
+    m_step(inputRate / outputRate),
+    m_filter((kPhases + 1) * kTaps),
+    m_buffers(channels),
+    m_bufferStart(0),
+    m_inputFrames(0),
+    m_outputFrames(0) {
+    // Tap k of phase p weights the input sample at offset (k - (kTaps / 2) + 1 - (p / kPhases)) from the output time.
+    double cutoff = outputRate < inputRate ? (outputRate / inputRate) * kCutoffScale : 1.0;
+    double halfWidth = kTaps / 2;
+    for (size_t phase = 0; phase <= kPhases; ++phase) {
+        double fraction = static_cast<double>(phase) / kPhases;
+        double sum = 0.0;
+        for (size_t tap = 0; tap < kTaps; ++tap) {
+            double x = static_cast<double>(tap) - halfWidth + 1.0 - fraction;
+            double sinc = x == 0.0 ? 1.0 : std::sin(M_PI * cutoff * x) / (M_PI * cutoff * x);
+            // Blackman window over the span of the filter.
+            double w = (x / halfWidth) + 1.0;
+            double window = w <= 0.0 || w >= 2.0 ? 0.0 :
+                0.42 - (0.5 * std::cos(M_PI * w)) + (0.08 * std::cos(2.0 * M_PI * w));
+            m_filter[(phase * kTaps) + tap] = sinc * window;
+            sum += sinc * window;
+        }
+        // Normalize each phase to unity gain at DC.
+        for (size_t tap = 0; tap < kTaps; ++tap) {
+            m_filter[(phase * kTaps) + tap] /= sum;
+        }
+    }
+
+    // Pad the start of the input with silence, so the first output sample is centered on the first input sample.
+    for (auto& buffer : m_buffers) {
+        buffer.assign((kTaps / 2) - 1, 0.0f);
+    }
+}
+
+void Resampler::process(const float* samples, size_t frames, std::vector<float>& samplesOut) {
+    for (auto channel = 0; channel < m_channels; ++channel) {
+        std::vector<float>& buffer = m_buffers[channel];
+        size_t offset = buffer.size();
+        buffer.resize(offset + frames);
+        for (size_t i = 0; i < frames; ++i) {
+            buffer[offset + i] = samples[(i * m_channels) + channel];
+        }
+    }
+    m_inputFrames += frames;
+    produce(samplesOut);
+}
+
+void Resampler::flush(std::vector<float>& samplesOut) {
+    uint64_t totalFrames = static_cast<uint64_t>(std::ceil(m_inputFrames / m_step));
+    // Pad the end of the input with enough silence to compute every remaining output sample.
+    while (m_outputFrames < totalFrames) {
+        for (auto& buffer : m_buffers) {
+            buffer.resize(buffer.size() + kTaps, 0.0f);
+        }
+        produce(samplesOut);
+    }
+    samplesOut.resize(samplesOut.size() - ((m_outputFrames - totalFrames) * m_channels));
+    m_outputFrames = totalFrames;
+}
+
+void Resampler::produce(std::vector<float>& samplesOut) {
+    size_t available = m_buffers.empty() ? 0 : m_buffers[0].size();
+    while (true) {
+        // Position of this output sample in input frames, relative to the first buffered frame.
+        double time = (m_outputFrames * m_step) - m_bufferStart;
+        size_t first = static_cast<size_t>(time);
+        if (first + kTaps > available) {
+            break;
+        }
+        double phase = (time - first) * kPhases;
+        size_t phaseIndex = std::min(static_cast<size_t>(phase), kPhases - 1);
+        float blend = static_cast<float>(phase - phaseIndex);
+        const float* lower = m_filter.data() + (phaseIndex * kTaps);
+        const float* upper = lower + kTaps;
+        for (auto channel = 0; channel < m_channels; ++channel) {
+            const float* samples = m_buffers[channel].data() + first;
+            float lowerSum = dotProduct(samples, lower);
+            float upperSum = dotProduct(samples, upper);
+            samplesOut.push_back(lowerSum + (blend * (upperSum - lowerSum)));
+        }
+        ++m_outputFrames;
+    }
+
+    // Drop input that no future output sample needs.
+    size_t consumed = std::min(static_cast<size_t>((m_outputFrames * m_step) - m_bufferStart), available);
+    if (consumed > 0) {
+        for (auto& buffer : m_buffers) {
+            buffer.erase(buffer.begin(), buffer.begin() + consumed);
+        }
+        m_bufferStart += consumed;
+    }
+}
+
+}  // namespace Confab
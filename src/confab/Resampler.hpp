@@ -0,0 +1,67 @@
+#ifndef SRC_CONFAB_RESAMPLER_HPP_
+#define SRC_CONFAB_RESAMPLER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Confab {
+
+/*! Streaming sample rate converter for interleaved float audio.
+ *
+ * Uses a polyphase windowed-sinc filter, with the impulse response tabulated at kPhases fractional offsets and output
+ * samples interpolated linearly between the two nearest phases. When converting down the filter cutoff is lowered to
+ * the output Nyquist frequency, so the result does not alias. Each output sample is a kTaps-long dot product, computed
+ * four samples at a time with SSE or NEON where available.
+ */
+class Resampler {
+public:
+    /*! Number of input samples contributing to each output sample.
+     */
+    static constexpr size_t kTaps = 32;
+
+    /*! Number of tabulated fractional offsets of the filter.
+     */
+    static constexpr size_t kPhases = 256;
+
+    /*! Constructs a Resampler.
+     *
+     * \param channels The number of interleaved channels in input and output.
+     * \param inputRate The sample rate of the input, in Hz.
+     * \param outputRate The desired sample rate of the output, in Hz.
+     */
+    Resampler(int channels, double inputRate, double outputRate);
+
+    /*! Converts a block of input, appending any output it completes to samplesOut.
+     *
+     * \param samples The interleaved input samples.
+     * \param frames The number of frames in samples.
+     * \param samplesOut A vector to append interleaved output samples to.
+     */
+    void process(const float* samples, size_t frames, std::vector<float>& samplesOut);
+
+    /*! Completes conversion after the last call to process(), appending the remaining output to samplesOut. Total
+     * output is the input length scaled by the rate ratio, rounded up.
+     *
+     * \param samplesOut A vector to append interleaved output samples to.
+     */
+    void flush(std::vector<float>& samplesOut);
+
+private:
+    // Produces every output sample that can be computed from the buffered input.
+    void produce(std::vector<float>& samplesOut);
+
+    int m_channels;
+    double m_step;
+    // Phase-major table of (kPhases + 1) * kTaps filter coefficients.
+    std::vector<float> m_filter;
+    // Buffered input for each channel, starting at input frame m_bufferStart - (kTaps / 2) + 1.
+    std::vector<std::vector<float>> m_buffers;
+    uint64_t m_bufferStart;
+    uint64_t m_inputFrames;
+    uint64_t m_outputFrames;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_RESAMPLER_HPP_
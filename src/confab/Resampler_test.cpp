@@ -0,0 +1,78 @@
+#include "Resampler.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+namespace {
+
+std::vector<float> makeSine(double frequency, double sampleRate, size_t frames, int channels) {
+    std::vector<float> samples(frames * channels);
+    for (size_t i = 0; i < frames; ++i) {
+        for (auto channel = 0; channel < channels; ++channel) {
+            samples[(i * channels) + channel] = (0.5 / (channel + 1)) * std::sin(2.0 * M_PI * frequency * i /
+                sampleRate);
+        }
+    }
+    return samples;
+}
+
+// Resamples in uneven blocks, to exercise buffering across calls to process().
+std::vector<float> resample(const std::vector<float>& input, int channels, double inputRate, double outputRate) {
+    Confab::Resampler resampler(channels, inputRate, outputRate);
+    std::vector<float> output;
+    size_t frames = input.size() / channels;
+    size_t offset = 0;
+    size_t blockSize = 1;
+    while (offset < frames) {
+        size_t block = std::min(blockSize, frames - offset);
+        resampler.process(input.data() + (offset * channels), block, output);
+        offset += block;
+        blockSize = (blockSize * 3) + 1;
+    }
+    resampler.flush(output);
+    return output;
+}
+
+}  // namespace
+
+TEST(ResamplerTest, SameRateIsIdentity) {
+    std::vector<float> input = makeSine(1000.0, 48000.0, 10000, 2);
+    std::vector<float> output = resample(input, 2, 48000.0, 48000.0);
+    ASSERT_EQ(input.size(), output.size());
+    for (size_t i = 0; i < input.size(); ++i) {
+        EXPECT_NEAR(input[i], output[i], 1e-5);
+    }
+}
+
+TEST(ResamplerTest, UpsampleSine) {
+    std::vector<float> input = makeSine(440.0, 44100.0, 44100, 2);
+    std::vector<float> output = resample(input, 2, 44100.0, 48000.0);
+    ASSERT_EQ(48000u * 2, output.size());
+    std::vector<float> expected = makeSine(440.0, 48000.0, 48000, 2);
+    // Skip the edges, where the filter overlaps the silence before and after the input.
+    for (size_t i = 100; i < 47900 * 2; ++i) {
+        EXPECT_NEAR(expected[i], output[i], 1e-3);
+    }
+}
+
+TEST(ResamplerTest, DownsampleSine) {
+    std::vector<float> input = makeSine(440.0, 96000.0, 96000, 1);
+    std::vector<float> output = resample(input, 1, 96000.0, 44100.0);
+    ASSERT_EQ(44100u, output.size());
+    std::vector<float> expected = makeSine(440.0, 44100.0, 44100, 1);
+    for (size_t i = 100; i < 44000; ++i) {
+        EXPECT_NEAR(expected[i], output[i], 1e-3);
+    }
+}
+
+TEST(ResamplerTest, DownsampleRejectsAliasing) {
+    // A tone above the output Nyquist frequency should be filtered out, not folded down in to the output.
+    std::vector<float> input = makeSine(30000.0, 96000.0, 96000, 1);
+    std::vector<float> output = resample(input, 1, 96000.0, 48000.0);
+    ASSERT_EQ(48000u, output.size());
+    for (size_t i = 100; i < 47900; ++i) {
+        EXPECT_NEAR(0.0f, output[i], 2e-3);
+    }
+}
@@ -0,0 +1,51 @@
+#include "ShardMap.hpp"
+
+#include "xxhash.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace Confab {
+
+ShardMap::ShardMap(const std::vector<std::string>& shards) :
+    m_shards(shards) {
+    std::sort(m_shards.begin(), m_shards.end());
+    m_shards.erase(std::unique(m_shards.begin(), m_shards.end()), m_shards.end());
+
+    m_ring.reserve(m_shards.size() * kPointsPerShard);
+    for (size_t i = 0; i < m_shards.size(); ++i) {
+        // The point number seeds the hash of the address, so each point of a shard lands somewhere different.
+        for (int point = 0; point < kPointsPerShard; ++point) {
+            m_ring.emplace_back(XXH64(m_shards[i].data(), m_shards[i].size(), point), i);
+        }
+    }
+    // Ties between shards, however unlikely, are broken by the sorted order of the addresses.
+    std::sort(m_ring.begin(), m_ring.end());
+}
+
+// static
+std::vector<std::string> ShardMap::parseAddresses(const std::string& addresses) {
+    std::vector<std::string> parsed;
+    std::istringstream addressStream(addresses);
+    std::string address;
+    while (std::getline(addressStream, address, ',')) {
+        if (address.size() > 0) {
+            parsed.push_back(address);
+        }
+    }
+    return parsed;
+}
+
+const std::string& ShardMap::shardFor(uint64_t key) const {
+    static const std::string kNoShard;
+    if (m_ring.empty()) {
+        return kNoShard;
+    }
+    auto point = std::lower_bound(m_ring.begin(), m_ring.end(), std::make_pair(key, static_cast<size_t>(0)));
+    if (point == m_ring.end()) {
+        point = m_ring.begin();
+    }
+    return m_shards[point->second];
+}
+
+}  // namespace Confab
@@ -0,0 +1,67 @@
+#ifndef SRC_CONFAB_SHARD_MAP_HPP_
+#define SRC_CONFAB_SHARD_MAP_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Confab {
+
+/*! Consistent hashing of Asset keys onto the confab-server shards that store them.
+ *
+ * Each shard, named by its address, is hashed to a number of points on a ring of 64-bit values, and a key belongs to
+ * the shard with the first point at or after it, wrapping around at the end. Asset keys are already uniformly
+ * distributed hashes, so they are placed on the ring directly. The map depends only on the set of shard addresses and
+ * not their order, so clients and servers configured with the same addresses agree on every key, and adding or
+ * removing a shard moves only the keys of that shard.
+ */
+class ShardMap {
+public:
+    /*! Number of ring points for each shard, which keeps the share of keys owned by each shard within a few percent.
+     */
+    static constexpr int kPointsPerShard = 128;
+
+    /*! Constructs a map of the provided shards.
+     *
+     * \param shards The addresses of the shards, such as "http://sclork-s02.local:9080". Duplicates are ignored. Can
+     *               be empty for an unsharded server.
+     */
+    explicit ShardMap(const std::vector<std::string>& shards = std::vector<std::string>());
+
+    /*! Splits a comma-separated list of server addresses, as supplied on the command line.
+     *
+     * \param addresses The comma-separated addresses.
+     * \return The addresses, leaving out any empty ones.
+     */
+    static std::vector<std::string> parseAddresses(const std::string& addresses);
+
+    /*! True if this map has no shards.
+     *
+     * \return true if there are no shards, false otherwise.
+     */
+    bool empty() const { return m_shards.empty(); }
+
+    /*! The shards in this map.
+     *
+     * \return The distinct shard addresses, in sorted order.
+     */
+    const std::vector<std::string>& shards() const { return m_shards; }
+
+    /*! Finds the shard that owns a key.
+     *
+     * \param key The Asset key to look up.
+     * \return The address of the owning shard, or an empty string if the map is empty.
+     */
+    const std::string& shardFor(uint64_t key) const;
+
+private:
+    std::vector<std::string> m_shards;
+    // Pairs of ring point and index into m_shards, in order of point.
+    std::vector<std::pair<uint64_t, size_t>> m_ring;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_SHARD_MAP_HPP_
@@ -0,0 +1,64 @@
+#include "ShardMap.hpp"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+TEST(ShardMapTest, Empty) {
+    Confab::ShardMap shardMap;
+    EXPECT_TRUE(shardMap.empty());
+    EXPECT_EQ("", shardMap.shardFor(0x1234));
+}
+
+TEST(ShardMapTest, ParseAddresses) {
+    std::vector<std::string> expected = { "http://a:9080", "http://b:9080" };
+    EXPECT_EQ(expected, Confab::ShardMap::parseAddresses("http://a:9080,,http://b:9080,"));
+    EXPECT_TRUE(Confab::ShardMap::parseAddresses("").empty());
+}
+
+TEST(ShardMapTest, IndependentOfOrder) {
+    Confab::ShardMap forward({ "http://a:9080", "http://b:9080", "http://c:9080" });
+    Confab::ShardMap backward({ "http://c:9080", "http://b:9080", "http://a:9080", "http://b:9080" });
+    EXPECT_EQ(3u, backward.shards().size());
+
+    std::mt19937_64 random(47);
+    for (int i = 0; i < 1000; ++i) {
+        uint64_t key = random();
+        EXPECT_EQ(forward.shardFor(key), backward.shardFor(key));
+    }
+}
+
+TEST(ShardMapTest, Balanced) {
+    Confab::ShardMap shardMap({ "http://a:9080", "http://b:9080", "http://c:9080", "http://d:9080" });
+    std::map<std::string, int> counts;
+    std::mt19937_64 random(47);
+    const int kKeys = 40000;
+    for (int i = 0; i < kKeys; ++i) {
+        ++counts[shardMap.shardFor(random())];
+    }
+    ASSERT_EQ(4u, counts.size());
+    for (const auto& count : counts) {
+        EXPECT_GT(count.second, kKeys / 4 * 3 / 4) << count.first;
+        EXPECT_LT(count.second, kKeys / 4 * 5 / 4) << count.first;
+    }
+}
+
+TEST(ShardMapTest, AddingShardMovesOnlyItsKeys) {
+    Confab::ShardMap before({ "http://a:9080", "http://b:9080", "http://c:9080" });
+    Confab::ShardMap after({ "http://a:9080", "http://b:9080", "http://c:9080", "http://d:9080" });
+    std::mt19937_64 random(47);
+    int moved = 0;
+    const int kKeys = 10000;
+    for (int i = 0; i < kKeys; ++i) {
+        uint64_t key = random();
+        if (before.shardFor(key) != after.shardFor(key)) {
+            EXPECT_EQ("http://d:9080", after.shardFor(key));
+            ++moved;
+        }
+    }
+    EXPECT_GT(moved, 0);
+    EXPECT_LT(moved, kKeys / 3);
+}
@@ -0,0 +1,263 @@
+#include "UpstreamQueue.hpp"
+
+#include "AssetDatabase.hpp"
+#include "Constants.hpp"
+#include "HttpClient.hpp"
+#include "schemas/FlatAsset_generated.h"
+
+#include "glog/logging.h"
+#include "xxhash.h"
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace {
+
+/*! Maximum number of AssetData chunks read from the database into memory at a time during an upload.
+ */
+static const uint64_t kUploadBatchChunks = 64;
+
+}  // namespace
+
+namespace Confab {
+
+UpstreamQueue::UpstreamQueue(std::shared_ptr<AssetDatabase> assetDatabase, std::shared_ptr<HttpClient> httpClient,
+        int numWorkers, std::chrono::milliseconds minBackoff, std::chrono::milliseconds maxBackoff) :
+    m_assetDatabase(assetDatabase),
+    m_httpClient(httpClient),
+    m_numWorkers(std::max(numWorkers, 1)),
+    m_minBackoff(minBackoff),
+    m_maxBackoff(std::max(minBackoff, maxBackoff)),
+    m_uploading(0),
+    m_quit(false),
+    m_distribution(0, std::numeric_limits<uint64_t>::max()) {
+}
+
+UpstreamQueue::~UpstreamQueue() {
+    stop();
+}
+
+void UpstreamQueue::start() {
+    auto entries = m_assetDatabase->loadUpstreamQueue();
+    LOG(INFO) << "starting " << m_numWorkers << " upload workers with " << entries.size()
+        << " Assets left to upload.";
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto now = std::chrono::steady_clock::now();
+        for (const auto& entry : entries) {
+            m_waiting.emplace(now, Entry{ entry.token, entry.key,
+                std::string(entry.asset->data().dataChar(), entry.asset->data().size()), 0 });
+        }
+        m_quit = false;
+    }
+    for (int i = 0; i < m_numWorkers; ++i) {
+        m_workers.emplace_back(&UpstreamQueue::workerLoop, this);
+    }
+}
+
+void UpstreamQueue::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_condition.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+    m_workers.clear();
+
+    // Anything still waiting is reloaded from the database on the next start().
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_waiting.size() > 0) {
+        LOG(INFO) << "stopped upload workers with " << m_waiting.size() << " Assets left to upload.";
+    }
+    m_waiting.clear();
+}
+
+uint64_t UpstreamQueue::addInlineAsset(Asset::Type type, const std::string& name, uint64_t author,
+        uint64_t deprecates, const std::string& listIds, uint64_t size, const uint8_t* inlineData) {
+    if (size > kSingleChunkDataSize) {
+        LOG(ERROR) << "attempt to add inline Asset of size " << size << " greater than max of "
+            << kSingleChunkDataSize;
+        return 0;
+    }
+
+    Asset asset(type);
+    asset.setName(name);
+    asset.setAuthor(author);
+    asset.setDeprecates(deprecates);
+    // For short assets we add some random salt to the hash, to help avoid hash collisions.
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        asset.setSalt(m_distribution(m_randomDevice));
+    }
+    uint64_t key = XXH64(inlineData, size, asset.salt());
+    asset.setKey(key);
+    asset.parseListIds(listIds);
+    asset.setSize(size);
+    flatbuffers::FlatBufferBuilder builder(kPageSize);
+    asset.flatten(builder, inlineData);
+
+    if (!m_assetDatabase->storeAsset(key, SizedPointer(builder.GetBufferPointer(), builder.GetSize()))) {
+        LOG(ERROR) << "failed to store new inline Asset " << Asset::keyToString(key);
+        return 0;
+    }
+    return enqueue(key, builder.GetBufferPointer(), builder.GetSize()) ? key : 0;
+}
+
+uint64_t UpstreamQueue::addFileAsset(Asset::Type type, const std::string& name, uint64_t author,
+        uint64_t deprecates, const std::string& listIds, const fs::path& assetFile) {
+    HttpClient::FileHash fileHash;
+    if (!HttpClient::hashFile(assetFile, fileHash)) {
+        return 0;
+    }
+    uint64_t key = fileHash.key;
+    size_t fileSize = fileHash.size;
+    std::string keyString = Asset::keyToString(key);
+
+    Asset asset(type);
+    asset.setKey(key);
+    asset.setName(name);
+    asset.setFileExtension(assetFile.extension());
+    asset.setAuthor(author);
+    asset.setDeprecates(deprecates);
+    asset.setSize(fileSize);
+    asset.setChunks((fileSize / kDataChunkSize) + 1);
+    asset.parseListIds(listIds);
+    flatbuffers::FlatBufferBuilder assetBuilder(kPageSize);
+    asset.flatten(assetBuilder);
+
+    // The Asset is stored before its chunks, as chunks are compressed according to the type of their Asset.
+    if (!m_assetDatabase->storeAsset(key, SizedPointer(assetBuilder.GetBufferPointer(), assetBuilder.GetSize()))) {
+        LOG(ERROR) << "failed to store new file Asset " << keyString;
+        return 0;
+    }
+
+    bool stored = HttpClient::buildFileChunks(assetFile, fileHash, [this, key, &keyString](uint64_t chunk,
+        const SizedPointer& flatAssetData) {
+        if (!m_assetDatabase->storeAssetDataChunk(key, chunk, flatAssetData)) {
+            LOG(ERROR) << "failed to store chunk " << chunk << " of new file Asset " << keyString;
+            return false;
+        }
+        return true;
+    });
+    if (!stored) {
+        LOG(ERROR) << "error storing file " << assetFile << " as Asset " << keyString;
+        return 0;
+    }
+
+    return enqueue(key, assetBuilder.GetBufferPointer(), assetBuilder.GetSize()) ? key : 0;
+}
+
+size_t UpstreamQueue::pending() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_waiting.size() + m_uploading;
+}
+
+bool UpstreamQueue::enqueue(uint64_t key, const uint8_t* flatAsset, size_t size) {
+    uint64_t token = m_assetDatabase->enqueueUpstream(key, SizedPointer(flatAsset, size));
+    if (token == 0) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_waiting.emplace(std::chrono::steady_clock::now(),
+            Entry{ token, key, std::string(reinterpret_cast<const char*>(flatAsset), size), 0 });
+    }
+    m_condition.notify_one();
+    LOG(INFO) << "queued Asset " << Asset::keyToString(key) << " for upload.";
+    return true;
+}
+
+void UpstreamQueue::workerLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_quit) {
+        if (m_waiting.empty()) {
+            m_condition.wait(lock);
+            continue;
+        }
+        auto next = m_waiting.begin();
+        if (next->first > std::chrono::steady_clock::now()) {
+            m_condition.wait_until(lock, next->first);
+            continue;
+        }
+
+        Entry entry = std::move(next->second);
+        m_waiting.erase(next);
+        ++m_uploading;
+        lock.unlock();
+
+        bool ok = upload(entry) && m_assetDatabase->removeUpstream(entry.token, entry.key);
+
+        lock.lock();
+        --m_uploading;
+        if (!ok) {
+            ++entry.failures;
+            auto delay = backoff(entry.failures);
+            LOG(WARNING) << "upload of Asset " << Asset::keyToString(entry.key) << " failed " << entry.failures
+                << " times, retrying in " << delay.count() << " ms.";
+            m_waiting.emplace(std::chrono::steady_clock::now() + delay, std::move(entry));
+            m_condition.notify_one();
+        }
+    }
+}
+
+bool UpstreamQueue::upload(const Entry& entry) {
+    auto verifier = flatbuffers::Verifier(reinterpret_cast<const uint8_t*>(entry.asset.data()), entry.asset.size());
+    if (!Data::VerifyFlatAssetBuffer(verifier)) {
+        // Retrying won't help, so drop the entry.
+        LOG(ERROR) << "dropping unreadable upload queue entry for Asset " << Asset::keyToString(entry.key);
+        return true;
+    }
+    auto flatAsset = Data::GetFlatAsset(entry.asset.data());
+
+    // The Asset goes first, as the server compresses chunks according to the type of their Asset.
+    if (!m_httpClient->postAsset(entry.key, SizedPointer(entry.asset.data(), entry.asset.size()))) {
+        return false;
+    }
+
+    if (!flatAsset->inlineData() && flatAsset->size() > 0) {
+        // Chunks are copied out in batches, each read with one sequential scan, and posted only once the scan is
+        // done, so the database iterator isn't held open across the blocking posts.
+        uint64_t chunks = (flatAsset->size() + kDataChunkSize - 1) / kDataChunkSize;
+        std::vector<std::string> batch;
+        for (uint64_t firstChunk = 0; firstChunk < chunks; firstChunk += batch.size()) {
+            batch.clear();
+            m_assetDatabase->loadAssetDataRange(entry.key, firstChunk, std::min(kUploadBatchChunks,
+                chunks - firstChunk), [&batch](uint64_t chunk, const SizedPointer& flatAssetData) {
+                    batch.emplace_back(reinterpret_cast<const char*>(flatAssetData.data()), flatAssetData.size());
+                    return true;
+                });
+            for (size_t i = 0; i < batch.size(); ++i) {
+                if (!m_httpClient->postAssetData(entry.key, firstChunk + i, SizedPointer(batch[i].data(),
+                    batch[i].size()))) {
+                    return false;
+                }
+            }
+            if (batch.empty()) {
+                LOG(ERROR) << "dropping upload of Asset " << Asset::keyToString(entry.key) << " missing chunk "
+                    << firstChunk;
+                return true;
+            }
+        }
+    }
+
+    LOG(INFO) << "completed upload of Asset " << Asset::keyToString(entry.key);
+    return true;
+}
+
+std::chrono::milliseconds UpstreamQueue::backoff(int failures) {
+    // Doubles with every failure up to the maximum, then adds up to half again of random jitter so that uploads
+    // failing together don't all retry together.
+    auto delay = m_minBackoff;
+    for (int i = 1; i < failures && delay < m_maxBackoff; ++i) {
+        delay *= 2;
+    }
+    delay = std::min(delay, m_maxBackoff);
+    uint64_t jitter = m_distribution(m_randomDevice) % static_cast<uint64_t>((delay.count() / 2) + 1);
+    return delay + std::chrono::milliseconds(jitter);
+}
+
+}  // namespace Confab
@@ -0,0 +1,124 @@
+#ifndef SRC_CONFAB_UPSTREAM_QUEUE_HPP_
+#define SRC_CONFAB_UPSTREAM_QUEUE_HPP_
+
+#include "Asset.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <experimental/filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::experimental::filesystem;
+
+namespace Confab {
+
+class AssetDatabase;
+class HttpClient;
+
+/*! Adds Assets locally first and uploads them to the server in the background.
+ *
+ * An added Asset, and any AssetData chunks, are stored in the local AssetDatabase along with an upstream queue entry
+ * before the add returns, so adds complete at disk speed and are not lost if the server can't be reached or confab
+ * restarts. A pool of worker threads drains the queue in parallel, uploading the Asset record and then each chunk, and
+ * deletes each entry only once the server has acknowledged every part of it. Failed uploads are retried with
+ * exponential backoff and random jitter.
+ */
+class UpstreamQueue {
+public:
+    /*! Constructs a stopped UpstreamQueue.
+     *
+     * \param assetDatabase The local database to store added Assets and the queue in.
+     * \param httpClient The HttpClient to upload Assets with.
+     * \param numWorkers The number of uploads to run at once.
+     * \param minBackoff The time to wait before retrying an upload after its first failure.
+     * \param maxBackoff The longest time to wait before retrying an upload, however many times it has failed.
+     */
+    UpstreamQueue(std::shared_ptr<AssetDatabase> assetDatabase, std::shared_ptr<HttpClient> httpClient,
+        int numWorkers, std::chrono::milliseconds minBackoff, std::chrono::milliseconds maxBackoff);
+
+    /*! Stops the workers, if running.
+     */
+    ~UpstreamQueue();
+
+    /*! Loads entries left in the queue from a previous run and starts the worker threads.
+     */
+    void start();
+
+    /*! Stops the worker threads, waiting for any uploads in progress to finish. Entries not yet uploaded stay in the
+     * database for the next start().
+     */
+    void stop();
+
+    /*! Adds a new Asset with inline data, and queues it for upload.
+     *
+     * \param type The Asset type.
+     * \param name The Asset name, can be "".
+     * \param author An optional Asset key.
+     * \param deprecates An optional Asset key.
+     * \param listIds A comma-separated concatenated string of list ids to add this asset to.
+     * \param size The size of the data pointed to by inlineData, should be smaller than kSingleChunkDataSize.
+     * \param inlineData The inline Asset data to serialize.
+     * \return The computed key for this Asset, or zero on error.
+     */
+    uint64_t addInlineAsset(Asset::Type type, const std::string& name, uint64_t author, uint64_t deprecates,
+        const std::string& listIds, uint64_t size, const uint8_t* inlineData);
+
+    /*! Adds a new Asset along with all AssetData chunks in the file, and queues it for upload.
+     *
+     * \param type The Asset type.
+     * \param name The Asset name, can be "".
+     * \param author An optional Asset key.
+     * \param deprecates An optional Asset key.
+     * \param listIds A comma-separated concatenated string of list ids to add this asset to.
+     * \param assetFile The path of the file to ingest.
+     * \return The computed key for this Asset, or zero on error.
+     */
+    uint64_t addFileAsset(Asset::Type type, const std::string& name, uint64_t author, uint64_t deprecates,
+        const std::string& listIds, const fs::path& assetFile);
+
+    /*! The number of Assets added but not yet acknowledged by the server.
+     *
+     * \return The number of pending uploads, including any in progress.
+     */
+    size_t pending();
+
+private:
+    struct Entry {
+        uint64_t token;
+        uint64_t key;
+        std::string asset;
+        int failures;
+    };
+
+    bool enqueue(uint64_t key, const uint8_t* flatAsset, size_t size);
+    void workerLoop();
+    bool upload(const Entry& entry);
+    std::chrono::milliseconds backoff(int failures);
+
+    std::shared_ptr<AssetDatabase> m_assetDatabase;
+    std::shared_ptr<HttpClient> m_httpClient;
+    int m_numWorkers;
+    std::chrono::milliseconds m_minBackoff;
+    std::chrono::milliseconds m_maxBackoff;
+
+    // Protects all members below. Entries waiting for upload are kept in order of the time they are next due, and
+    // entries being uploaded are only counted, as a worker holds them until done.
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::multimap<std::chrono::steady_clock::time_point, Entry> m_waiting;
+    size_t m_uploading;
+    bool m_quit;
+    std::vector<std::thread> m_workers;
+    std::random_device m_randomDevice;
+    std::uniform_int_distribution<uint64_t> m_distribution;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_UPSTREAM_QUEUE_HPP_
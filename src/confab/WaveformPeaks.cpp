@@ -0,0 +1,320 @@
+#include "WaveformPeaks.hpp"
+
+#include "AudioFile.hpp"
+
+#include "glog/logging.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CONFAB_PEAKS_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CONFAB_PEAKS_NEON 1
+#endif
+
+namespace {
+
+/*! Identifies a serialized overview, and its format version.
+ */
+static const uint32_t kPeaksMagic = 0x314b5043;  // "CPK1"
+
+/*! Smallest number of frames per bucket in the finest level.
+ */
+static const uint32_t kMinFramesPerBucket = 256;
+
+/*! The finest level has at most this many buckets, so longer files get more frames per bucket.
+ */
+static const uint64_t kMaxBuckets = 8192;
+
+/*! Coarser levels are added until the coarsest level has no more than this many buckets.
+ */
+static const uint64_t kMinBuckets = 32;
+
+/*! Number of frames read from the audio file at a time.
+ */
+static const size_t kReadFrames = 16384;
+
+/*! Header at the start of every serialized overview, followed by levelCount uint32_t bucket counts, then the Peak
+ * entries of each level in turn, finest first, each level in the same layout as WaveformPeaks::render() output.
+ */
+struct PeaksHeader {
+    uint32_t magic;
+    uint32_t channels;
+    uint64_t frames;
+    double sampleRate;
+    uint32_t framesPerBucket;
+    uint32_t levelCount;
+};
+
+/*! Unquantized bucket summary used while building levels.
+ */
+struct Bucket {
+    float min;
+    float max;
+    float meanSquare;
+};
+
+/*! Computes minimum, maximum and sum of squares over count contiguous samples, accumulating into the provided values.
+ */
+void accumulate(const float* samples, size_t count, float& min, float& max, float& sumSquares) {
+    size_t i = 0;
+#if defined(CONFAB_PEAKS_SSE2)
+    if (count >= 4) {
+        __m128 minVector = _mm_set1_ps(min);
+        __m128 maxVector = _mm_set1_ps(max);
+        __m128 sumVector = _mm_setzero_ps();
+        for (; i + 4 <= count; i += 4) {
+            __m128 values = _mm_loadu_ps(samples + i);
+            minVector = _mm_min_ps(minVector, values);
+            maxVector = _mm_max_ps(maxVector, values);
+            sumVector = _mm_add_ps(sumVector, _mm_mul_ps(values, values));
+        }
+        float lanes[4];
+        _mm_storeu_ps(lanes, minVector);
+        min = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+        _mm_storeu_ps(lanes, maxVector);
+        max = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+        _mm_storeu_ps(lanes, sumVector);
+        sumSquares += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+#elif defined(CONFAB_PEAKS_NEON)
+    if (count >= 4) {
+        float32x4_t minVector = vdupq_n_f32(min);
+        float32x4_t maxVector = vdupq_n_f32(max);
+        float32x4_t sumVector = vdupq_n_f32(0.0f);
+        for (; i + 4 <= count; i += 4) {
+            float32x4_t values = vld1q_f32(samples + i);
+            minVector = vminq_f32(minVector, values);
+            maxVector = vmaxq_f32(maxVector, values);
+            sumVector = vmlaq_f32(sumVector, values, values);
+        }
+        float lanes[4];
+        vst1q_f32(lanes, minVector);
+        min = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+        vst1q_f32(lanes, maxVector);
+        max = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+        vst1q_f32(lanes, sumVector);
+        sumSquares += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+#endif
+    for (; i < count; ++i) {
+        min = std::min(min, samples[i]);
+        max = std::max(max, samples[i]);
+        sumSquares += samples[i] * samples[i];
+    }
+}
+
+int16_t quantize(float value) {
+    return static_cast<int16_t>(std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f));
+}
+
+}  // namespace
+
+namespace Confab {
+
+// static
+bool WaveformPeaks::compute(const fs::path& audioFile, std::vector<uint8_t>& peaksOut) {
+    AudioFileReader reader;
+    if (!reader.open(audioFile)) {
+        return false;
+    }
+
+    int channels = reader.channels();
+    uint64_t frames = reader.frames();
+    uint64_t framesPerBucket = kMinFramesPerBucket;
+    while ((frames + framesPerBucket - 1) / framesPerBucket > kMaxBuckets) {
+        framesPerBucket *= 2;
+    }
+    if (framesPerBucket > std::numeric_limits<uint32_t>::max()) {
+        LOG(ERROR) << "audio file " << audioFile << " too long for waveform overview, " << frames << " frames.";
+        return false;
+    }
+
+    // Compute the finest level directly from the audio. Buckets can span multiple reads, so the running values for the
+    // current bucket are kept per channel between reads.
+    std::vector<std::vector<Bucket>> levels(1);
+    std::vector<float> interleaved(kReadFrames * channels);
+    std::vector<float> channelSamples(kReadFrames);
+    std::vector<float> mins(channels, std::numeric_limits<float>::max());
+    std::vector<float> maxes(channels, std::numeric_limits<float>::lowest());
+    std::vector<float> sums(channels, 0.0f);
+    uint64_t bucketFrames = 0;
+    uint64_t framesRead = 0;
+    size_t readFrames = 0;
+    while ((readFrames = reader.read(interleaved.data(), kReadFrames)) > 0) {
+        size_t offset = 0;
+        while (offset < readFrames) {
+            size_t spanFrames = std::min(static_cast<size_t>(framesPerBucket - bucketFrames), readFrames - offset);
+            for (auto channel = 0; channel < channels; ++channel) {
+                const float* samples = interleaved.data() + (offset * channels) + channel;
+                if (channels > 1) {
+                    for (size_t i = 0; i < spanFrames; ++i) {
+                        channelSamples[i] = samples[i * channels];
+                    }
+                    samples = channelSamples.data();
+                }
+                accumulate(samples, spanFrames, mins[channel], maxes[channel], sums[channel]);
+            }
+            offset += spanFrames;
+            bucketFrames += spanFrames;
+            if (bucketFrames == framesPerBucket) {
+                for (auto channel = 0; channel < channels; ++channel) {
+                    levels[0].push_back({ mins[channel], maxes[channel], sums[channel] / bucketFrames });
+                    mins[channel] = std::numeric_limits<float>::max();
+                    maxes[channel] = std::numeric_limits<float>::lowest();
+                    sums[channel] = 0.0f;
+                }
+                bucketFrames = 0;
+            }
+        }
+        framesRead += readFrames;
+    }
+    if (bucketFrames > 0) {
+        for (auto channel = 0; channel < channels; ++channel) {
+            levels[0].push_back({ mins[channel], maxes[channel], sums[channel] / bucketFrames });
+        }
+    }
+    if (framesRead != frames || levels[0].empty()) {
+        LOG(ERROR) << "read " << framesRead << " of " << frames << " frames from " << audioFile;
+        return false;
+    }
+
+    // Build each coarser level by merging adjacent pairs of buckets from the level before.
+    while (levels.back().size() / channels > kMinBuckets) {
+        const std::vector<Bucket>& finer = levels.back();
+        size_t finerCount = finer.size() / channels;
+        std::vector<Bucket> coarser;
+        coarser.reserve(((finerCount + 1) / 2) * channels);
+        for (size_t i = 0; i < finerCount; i += 2) {
+            for (auto channel = 0; channel < channels; ++channel) {
+                Bucket bucket = finer[(i * channels) + channel];
+                if (i + 1 < finerCount) {
+                    const Bucket& next = finer[((i + 1) * channels) + channel];
+                    bucket.min = std::min(bucket.min, next.min);
+                    bucket.max = std::max(bucket.max, next.max);
+                    bucket.meanSquare = 0.5f * (bucket.meanSquare + next.meanSquare);
+                }
+                coarser.push_back(bucket);
+            }
+        }
+        levels.push_back(std::move(coarser));
+    }
+
+    size_t totalBuckets = 0;
+    for (const auto& level : levels) {
+        totalBuckets += level.size();
+    }
+    peaksOut.resize(sizeof(PeaksHeader) + (levels.size() * sizeof(uint32_t)) + (totalBuckets * sizeof(Peak)));
+    PeaksHeader peaksHeader = { kPeaksMagic, static_cast<uint32_t>(channels), frames, reader.sampleRate(),
+        static_cast<uint32_t>(framesPerBucket), static_cast<uint32_t>(levels.size()) };
+    std::memcpy(peaksOut.data(), &peaksHeader, sizeof(PeaksHeader));
+    uint8_t* counts = peaksOut.data() + sizeof(PeaksHeader);
+    uint8_t* peaks = counts + (levels.size() * sizeof(uint32_t));
+    for (const auto& level : levels) {
+        uint32_t count = level.size() / channels;
+        std::memcpy(counts, &count, sizeof(uint32_t));
+        counts += sizeof(uint32_t);
+        for (const auto& bucket : level) {
+            Peak peak = { quantize(bucket.min), quantize(bucket.max), quantize(std::sqrt(bucket.meanSquare)) };
+            std::memcpy(peaks, &peak, sizeof(Peak));
+            peaks += sizeof(Peak);
+        }
+    }
+
+    LOG(INFO) << "computed waveform overview of " << audioFile << ", " << levels.size() << " levels, "
+        << peaksOut.size() << " bytes.";
+    return true;
+}
+
+WaveformPeaks::WaveformPeaks(const SizedPointer& peaks) :
+    m_peaks(peaks),
+    m_valid(false),
+    m_channels(0),
+    m_frames(0),
+    m_sampleRate(0.0),
+    m_framesPerBucket(0),
+    m_levelCount(0) {
+    // The buffer may not be aligned for the header, for instance when pointing in to a LevelDB value, so copy it out.
+    PeaksHeader peaksHeader;
+    if (m_peaks.size() < sizeof(PeaksHeader)) {
+        return;
+    }
+    std::memcpy(&peaksHeader, m_peaks.data(), sizeof(PeaksHeader));
+    if (peaksHeader.magic != kPeaksMagic || peaksHeader.channels == 0 || peaksHeader.levelCount == 0 ||
+        peaksHeader.framesPerBucket == 0) {
+        return;
+    }
+    size_t countsSize = peaksHeader.levelCount * sizeof(uint32_t);
+    if (m_peaks.size() < sizeof(PeaksHeader) + countsSize) {
+        return;
+    }
+    size_t totalBuckets = 0;
+    for (uint32_t i = 0; i < peaksHeader.levelCount; ++i) {
+        uint32_t count = 0;
+        std::memcpy(&count, m_peaks.data() + sizeof(PeaksHeader) + (i * sizeof(uint32_t)), sizeof(uint32_t));
+        if (count == 0) {
+            return;
+        }
+        totalBuckets += count;
+    }
+    if (m_peaks.size() != sizeof(PeaksHeader) + countsSize + (totalBuckets * peaksHeader.channels * sizeof(Peak))) {
+        return;
+    }
+
+    m_channels = peaksHeader.channels;
+    m_frames = peaksHeader.frames;
+    m_sampleRate = peaksHeader.sampleRate;
+    m_framesPerBucket = peaksHeader.framesPerBucket;
+    m_levelCount = peaksHeader.levelCount;
+    m_valid = true;
+}
+
+void WaveformPeaks::render(size_t width, std::vector<Peak>& peaksOut) const {
+    peaksOut.clear();
+    size_t channels = m_channels;
+    if (width == 0) {
+        return;
+    }
+
+    // Pick the coarsest level that still has at least one bucket per column, or the finest level if none do. Like the
+    // header, peaks may not be aligned in the buffer, so each is copied out rather than read in place.
+    double framesPerColumn = static_cast<double>(m_frames) / width;
+    const uint8_t* counts = m_peaks.data() + sizeof(PeaksHeader);
+    const uint8_t* level = counts + (m_levelCount * sizeof(uint32_t));
+    uint32_t bucketCount = 0;
+    std::memcpy(&bucketCount, counts, sizeof(uint32_t));
+    uint64_t framesPerBucket = m_framesPerBucket;
+    for (uint32_t i = 1; i < m_levelCount && (framesPerBucket * 2) <= framesPerColumn; ++i) {
+        level += bucketCount * channels * sizeof(Peak);
+        std::memcpy(&bucketCount, counts + (i * sizeof(uint32_t)), sizeof(uint32_t));
+        framesPerBucket *= 2;
+    }
+
+    peaksOut.reserve(width * channels);
+    for (size_t column = 0; column < width; ++column) {
+        size_t begin = std::min(static_cast<size_t>((column * bucketCount) / width),
+            static_cast<size_t>(bucketCount - 1));
+        size_t end = std::max(begin + 1, static_cast<size_t>(((column + 1) * bucketCount) / width));
+        for (size_t channel = 0; channel < channels; ++channel) {
+            int16_t min = std::numeric_limits<int16_t>::max();
+            int16_t max = std::numeric_limits<int16_t>::min();
+            float sumSquares = 0.0f;
+            for (size_t bucket = begin; bucket < end; ++bucket) {
+                Peak peak;
+                std::memcpy(&peak, level + (((bucket * channels) + channel) * sizeof(Peak)), sizeof(Peak));
+                min = std::min(min, peak.min);
+                max = std::max(max, peak.max);
+                sumSquares += static_cast<float>(peak.rms) * peak.rms;
+            }
+            peaksOut.push_back({ min, max,
+                static_cast<int16_t>(std::lround(std::sqrt(sumSquares / (end - begin)))) });
+        }
+    }
+}
+
+}  // namespace Confab
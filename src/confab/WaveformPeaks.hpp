@@ -0,0 +1,89 @@
+#ifndef SRC_CONFAB_WAVEFORM_PEAKS_HPP_
+#define SRC_CONFAB_WAVEFORM_PEAKS_HPP_
+
+#include "SizedPointer.hpp"
+
+#include <cstdint>
+#include <experimental/filesystem>
+#include <vector>
+
+namespace fs = std::experimental::filesystem;
+
+namespace Confab {
+
+/*! Read-only view of a serialized multi-resolution waveform overview, with computation of new overviews from audio.
+ *
+ * An overview holds the minimum, maximum, and RMS value of every channel over fixed-size buckets of frames, at a
+ * number of levels. The finest level has at most a few thousand buckets per channel, and each coarser level halves the
+ * bucket count of the one before it, so drawing a waveform at any view width only needs to combine a few buckets per
+ * pixel column, instead of reading every sample of the audio file.
+ */
+class WaveformPeaks {
+public:
+    /*! The summary of one channel over a span of frames. Values are scaled from [-1, 1] to [-32767, 32767].
+     */
+    struct Peak {
+        int16_t min;
+        int16_t max;
+        int16_t rms;
+    };
+
+    /*! Reads an audio file and computes its serialized overview.
+     *
+     * \param audioFile The path to an audio file readable by AudioFileReader.
+     * \param peaksOut A vector to replace the contents of with the serialized overview.
+     * \return true on success, false on error.
+     */
+    static bool compute(const fs::path& audioFile, std::vector<uint8_t>& peaksOut);
+
+    /*! Constructs a view on a serialized overview. Check valid() before using any other method.
+     *
+     * \param peaks A non-owning pointer to the serialized overview, which must outlive this object.
+     */
+    explicit WaveformPeaks(const SizedPointer& peaks);
+
+    /*! True if the serialized overview passed its consistency checks.
+     *
+     * \return true if valid.
+     */
+    bool valid() const { return m_valid; }
+
+    /*! The number of channels summarized.
+     *
+     * \return The channel count of the original audio.
+     */
+    int channels() const { return m_channels; }
+
+    /*! The number of frames summarized.
+     *
+     * \return The frame count of the original audio.
+     */
+    uint64_t frames() const { return m_frames; }
+
+    /*! The sample rate of the original audio.
+     *
+     * \return The sample rate in Hz.
+     */
+    double sampleRate() const { return m_sampleRate; }
+
+    /*! Combines buckets from the best-fitting level in to exactly width columns spanning the whole file.
+     *
+     * \param width The number of columns to render, typically the width in pixels of the waveform view.
+     * \param peaksOut A vector to replace the contents of with width * channels() Peak entries, with all channels of
+     *                 the first column followed by all channels of the second column, and so on.
+     */
+    void render(size_t width, std::vector<Peak>& peaksOut) const;
+
+private:
+    SizedPointer m_peaks;
+    bool m_valid;
+    int m_channels;
+    uint64_t m_frames;
+    double m_sampleRate;
+    uint64_t m_framesPerBucket;
+    uint32_t m_levelCount;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_WAVEFORM_PEAKS_HPP_
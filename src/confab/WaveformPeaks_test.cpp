@@ -0,0 +1,86 @@
+#include "WaveformPeaks.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+// Writes a 16-bit stereo WAV file, with a full-scale square wave at the Nyquist frequency on the left channel and
+// silence on the right.
+fs::path writeTestWav(size_t frames) {
+    fs::path path = fs::temp_directory_path() / "WaveformPeaks_test.wav";
+    std::ofstream outFile(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    uint32_t dataSize = frames * 4;
+    uint32_t riffSize = 36 + dataSize;
+    uint32_t formatSize = 16;
+    uint16_t formatTag = 1;
+    uint16_t channels = 2;
+    uint32_t sampleRate = 48000;
+    uint32_t byteRate = sampleRate * 4;
+    uint16_t blockAlign = 4;
+    uint16_t bitsPerSample = 16;
+    outFile.write("RIFF", 4);
+    outFile.write(reinterpret_cast<const char*>(&riffSize), 4);
+    outFile.write("WAVEfmt ", 8);
+    outFile.write(reinterpret_cast<const char*>(&formatSize), 4);
+    outFile.write(reinterpret_cast<const char*>(&formatTag), 2);
+    outFile.write(reinterpret_cast<const char*>(&channels), 2);
+    outFile.write(reinterpret_cast<const char*>(&sampleRate), 4);
+    outFile.write(reinterpret_cast<const char*>(&byteRate), 4);
+    outFile.write(reinterpret_cast<const char*>(&blockAlign), 2);
+    outFile.write(reinterpret_cast<const char*>(&bitsPerSample), 2);
+    outFile.write("data", 4);
+    outFile.write(reinterpret_cast<const char*>(&dataSize), 4);
+    for (size_t i = 0; i < frames; ++i) {
+        int16_t frame[2] = { static_cast<int16_t>(i % 2 ? 32767 : -32767), 0 };
+        outFile.write(reinterpret_cast<const char*>(frame), sizeof(frame));
+    }
+    return path;
+}
+
+}  // namespace
+
+TEST(WaveformPeaksTest, ComputeAndRender) {
+    fs::path path = writeTestWav(1000000);
+    std::vector<uint8_t> serialized;
+    ASSERT_TRUE(Confab::WaveformPeaks::compute(path, serialized));
+    fs::remove(path);
+
+    Confab::WaveformPeaks peaks(Confab::SizedPointer(serialized.data(), serialized.size()));
+    ASSERT_TRUE(peaks.valid());
+    EXPECT_EQ(2, peaks.channels());
+    EXPECT_EQ(1000000u, peaks.frames());
+    EXPECT_EQ(48000.0, peaks.sampleRate());
+
+    for (size_t width : { 1, 100, 733, 20000 }) {
+        std::vector<Confab::WaveformPeaks::Peak> columns;
+        peaks.render(width, columns);
+        ASSERT_EQ(width * 2, columns.size());
+        for (size_t i = 0; i < width; ++i) {
+            EXPECT_NEAR(-32767, columns[i * 2].min, 1);
+            EXPECT_NEAR(32767, columns[i * 2].max, 1);
+            EXPECT_NEAR(32767, columns[i * 2].rms, 1);
+            EXPECT_EQ(0, columns[(i * 2) + 1].min);
+            EXPECT_EQ(0, columns[(i * 2) + 1].max);
+            EXPECT_EQ(0, columns[(i * 2) + 1].rms);
+        }
+    }
+}
+
+TEST(WaveformPeaksTest, RejectsCorruptData) {
+    std::vector<uint8_t> garbage(100, 0xab);
+    Confab::WaveformPeaks peaks(Confab::SizedPointer(garbage.data(), garbage.size()));
+    EXPECT_FALSE(peaks.valid());
+
+    fs::path path = writeTestWav(1000);
+    std::vector<uint8_t> serialized;
+    ASSERT_TRUE(Confab::WaveformPeaks::compute(path, serialized));
+    fs::remove(path);
+    serialized.pop_back();
+    Confab::WaveformPeaks truncated(Confab::SizedPointer(serialized.data(), serialized.size()));
+    EXPECT_FALSE(truncated.valid());
+}
@@ -0,0 +1,353 @@
+#include "ClockEstimator.hpp"
+#include "Constants.hpp"
+#include "common/Version.hpp"
+
+#include "fmt/core.h"
+#include "gflags/gflags.h"
+#include "lo/lo.h"
+#include "spdlog/spdlog.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Command line flags for the benchmark.
+DEFINE_string(host, "", "Host of the /clockSyncGet responder to benchmark. If empty, benchmarks an in-process "
+    "responder over loopback.");
+DEFINE_int32(port, 4250, "UDP port of the /clockSyncGet responder, or to bind the in-process responder to.");
+DEFINE_int32(concurrency, 1, "Number of independent clients sending requests concurrently.");
+DEFINE_int32(rate, 50, "Requests per second sent by each client.");
+DEFINE_int32(duration, 10, "Length in seconds of each benchmark phase.");
+DEFINE_int32(burstSize, 8, "Number of round trips per ClockEstimator burst.");
+DEFINE_int32(timeoutMs, 250, "Time in milliseconds to wait for each response before counting it as lost.");
+DEFINE_int32(stressThreads, 0, "If nonzero, repeats the benchmark with this many threads spinning on the CPU.");
+
+namespace {
+
+// Local monotonic time in seconds, shared by the clients and the in-process responder so that on loopback the true
+// offset between them is exactly zero.
+double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void addDouble(lo_message message, double value) {
+    uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(double));
+    lo_message_add_int32(message, static_cast<int32_t>(bits >> 32));
+    lo_message_add_int32(message, static_cast<int32_t>(bits & 0xffffffff));
+}
+
+double doubleFromHalves(int32_t high, int32_t low) {
+    uint64_t bits = (static_cast<uint64_t>(static_cast<uint32_t>(high)) << 32) | static_cast<uint32_t>(low);
+    double value = 0.0;
+    std::memcpy(&value, &bits, sizeof(double));
+    return value;
+}
+
+void loError(int number, const char* message, const char* path) {
+    spdlog::error("lo error number: {}, message: {}, path: {}", number, message, path);
+}
+
+// Behaves as SCLOrkClockServer.prBindClockSync, replying to [ /clockSyncGet returnPort ] from the sender's address.
+int loHandleSyncGet(const char* path, const char* types, lo_arg** argv, int argc, lo_message message,
+        void* userData) {
+    double serverTime = now();
+    lo_server server = static_cast<lo_server>(userData);
+    lo_address source = lo_message_get_source(message);
+    lo_address returnAddress = lo_address_new(lo_address_get_hostname(source), std::to_string(argv[0]->i).data());
+    lo_message reply = lo_message_new();
+    addDouble(reply, serverTime);
+    lo_send_message_from(returnAddress, server, "/clockSyncSet", reply);
+    lo_message_free(reply);
+    lo_address_free(returnAddress);
+    return 0;
+}
+
+/*! Results collected by a single client over one benchmark phase.
+ */
+struct ClientResults {
+    int sent = 0;
+    std::vector<double> roundTripTimes;
+    std::vector<double> offsets;
+    std::vector<double> estimatorOffsets;
+};
+
+/*! One benchmark client, with its own socket so that responses to concurrent clients can't be confused.
+ *
+ * Runs the request loop on its own thread, with at most one request in flight as the protocol carries no request
+ * identifier. Received samples also feed a ClockEstimator in bursts, to measure the error of the smoothed estimate
+ * as well as that of individual round trips.
+ */
+class Client {
+public:
+    Client() :
+        m_server(nullptr),
+        m_address(nullptr),
+        m_awaiting(false),
+        m_received(false),
+        m_serverTime(0.0),
+        m_receiveTime(0.0),
+        m_estimator(64, 0.25) {
+    }
+
+    ~Client() {
+        if (m_server) {
+            lo_server_free(m_server);
+        }
+        if (m_address) {
+            lo_address_free(m_address);
+        }
+    }
+
+    bool create(const std::string& host, int port) {
+        m_server = lo_server_new(nullptr, loError);
+        if (!m_server) {
+            return false;
+        }
+        lo_server_add_method(m_server, "/clockSyncSet", "ii", loHandleSyncSet, this);
+        m_address = lo_address_new(host.data(), std::to_string(port).data());
+        return m_address != nullptr;
+    }
+
+    void start(std::chrono::steady_clock::time_point endTime) {
+        m_thread = std::thread(&Client::requestLoop, this, endTime);
+    }
+
+    void join() {
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+    const ClientResults& results() const { return m_results; }
+
+private:
+    static int loHandleSyncSet(const char* path, const char* types, lo_arg** argv, int argc, lo_message message,
+            void* userData) {
+        double receiveTime = now();
+        Client* client = static_cast<Client*>(userData);
+        if (!client->m_awaiting) {
+            return 0;
+        }
+        client->m_serverTime = doubleFromHalves(argv[0]->i, argv[1]->i);
+        client->m_receiveTime = receiveTime;
+        client->m_awaiting = false;
+        client->m_received = true;
+        return 0;
+    }
+
+    void requestLoop(std::chrono::steady_clock::time_point endTime) {
+        auto period = std::chrono::microseconds(1000000 / std::max(FLAGS_rate, 1));
+        auto nextSend = std::chrono::steady_clock::now();
+        int port = lo_server_get_port(m_server);
+        int burstCount = 0;
+        m_estimator.beginBurst();
+
+        while (nextSend < endTime) {
+            std::this_thread::sleep_until(nextSend);
+            nextSend += period;
+
+            m_awaiting = true;
+            m_received = false;
+            double sendTime = now();
+            if (lo_send_from(m_address, m_server, LO_TT_IMMEDIATE, "/clockSyncGet", "i", port) < 0) {
+                spdlog::error("failed to send /clockSyncGet.");
+                continue;
+            }
+            ++m_results.sent;
+
+            double deadline = sendTime + (FLAGS_timeoutMs / 1000.0);
+            double remaining = FLAGS_timeoutMs / 1000.0;
+            while (!m_received && remaining > 0.0) {
+                lo_server_recv_noblock(m_server, static_cast<int>(std::ceil(remaining * 1000.0)));
+                remaining = deadline - now();
+            }
+            // Any response arriving after this point is dropped by the handler.
+            m_awaiting = false;
+            if (!m_received) {
+                continue;
+            }
+
+            Confab::ClockSample sample = { sendTime, m_serverTime, m_receiveTime };
+            m_results.roundTripTimes.push_back(sample.roundTripTime());
+            m_results.offsets.push_back(sample.offset());
+            m_estimator.addSample(sample);
+            if (++burstCount == FLAGS_burstSize) {
+                double burstEnd = now();
+                if (m_estimator.endBurst(burstEnd)) {
+                    m_results.estimatorOffsets.push_back(m_estimator.localToServer(burstEnd) - burstEnd);
+                }
+                m_estimator.beginBurst();
+                burstCount = 0;
+            }
+        }
+    }
+
+    lo_server m_server;
+    lo_address m_address;
+    std::thread m_thread;
+
+    // Only accessed on the client thread, as the handler runs from lo_server_recv_noblock() within requestLoop().
+    bool m_awaiting;
+    bool m_received;
+    double m_serverTime;
+    double m_receiveTime;
+    Confab::ClockEstimator m_estimator;
+    ClientResults m_results;
+};
+
+// Expects values to be sorted.
+double percentile(const std::vector<double>& values, double fraction) {
+    if (values.empty()) {
+        return std::nan("");
+    }
+    size_t index = std::min(static_cast<size_t>(fraction * values.size()), values.size() - 1);
+    return values[index];
+}
+
+void printDistribution(const std::string& name, std::vector<double> values, double scale, const std::string& units) {
+    if (values.empty()) {
+        fmt::print("  {:<24} no samples\n", name);
+        return;
+    }
+    std::sort(values.begin(), values.end());
+    double mean = 0.0;
+    for (auto value : values) {
+        mean += value;
+    }
+    mean /= values.size();
+    fmt::print("  {:<24} n {:>7}  mean {:>9.3f}  p50 {:>9.3f}  p90 {:>9.3f}  p99 {:>9.3f}  p99.9 {:>9.3f}  "
+            "max {:>9.3f} {}\n", name, values.size(), mean * scale, percentile(values, 0.5) * scale,
+            percentile(values, 0.9) * scale, percentile(values, 0.99) * scale, percentile(values, 0.999) * scale,
+            values.back() * scale, units);
+}
+
+// Runs all clients concurrently for one phase, and prints the combined results. Returns false on setup error.
+bool runPhase(const std::string& name, const std::string& host, bool loopback) {
+    std::vector<std::unique_ptr<Client>> clients;
+    for (auto i = 0; i < FLAGS_concurrency; ++i) {
+        clients.emplace_back(new Client);
+        if (!clients.back()->create(host, FLAGS_port)) {
+            spdlog::error("failed to create benchmark client {}", i);
+            return false;
+        }
+    }
+
+    auto endTime = std::chrono::steady_clock::now() + std::chrono::seconds(FLAGS_duration);
+    for (auto& client : clients) {
+        client->start(endTime);
+    }
+    for (auto& client : clients) {
+        client->join();
+    }
+
+    int sent = 0;
+    std::vector<double> roundTripTimes;
+    std::vector<double> offsets;
+    std::vector<double> estimatorOffsets;
+    for (const auto& client : clients) {
+        const ClientResults& results = client->results();
+        sent += results.sent;
+        roundTripTimes.insert(roundTripTimes.end(), results.roundTripTimes.begin(), results.roundTripTimes.end());
+        offsets.insert(offsets.end(), results.offsets.begin(), results.offsets.end());
+        estimatorOffsets.insert(estimatorOffsets.end(), results.estimatorOffsets.begin(),
+                results.estimatorOffsets.end());
+    }
+    if (roundTripTimes.empty()) {
+        spdlog::error("no responses received from {}:{} during {} phase.", host, FLAGS_port, name);
+        return true;
+    }
+
+    // On loopback the responder shares our clock, so the true offset is zero. Against a remote responder the true
+    // offset is unknown, so errors are relative to the offset of the round trip with the least queueing delay.
+    double reference = 0.0;
+    if (!loopback) {
+        size_t minIndex = std::min_element(roundTripTimes.begin(), roundTripTimes.end()) - roundTripTimes.begin();
+        reference = offsets[minIndex];
+    }
+    for (auto& offset : offsets) {
+        offset = std::abs(offset - reference);
+    }
+    for (auto& offset : estimatorOffsets) {
+        offset = std::abs(offset - reference);
+    }
+
+    size_t received = roundTripTimes.size();
+    fmt::print("{} phase: {} clients at {} Hz for {}s, {} sent, {} received, {:.2f}% lost\n", name,
+            FLAGS_concurrency, FLAGS_rate, FLAGS_duration, sent, received,
+            sent > 0 ? 100.0 * (sent - received) / sent : 0.0);
+    printDistribution("round trip time", roundTripTimes, 1000.0, "ms");
+    printDistribution("sample offset error", offsets, 1000.0, "ms");
+    printDistribution("estimator offset error", estimatorOffsets, 1000.0, "ms");
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+    auto logger = spdlog::stdout_color_mt("console");
+    spdlog::set_default_logger(logger);
+    spdlog::info("Starting clock-bench v{}", Confab::confabVersion.toString());
+
+    bool loopback = FLAGS_host == "";
+    std::string host = loopback ? "127.0.0.1" : FLAGS_host;
+    lo_server_thread responderThread = nullptr;
+    if (loopback) {
+        responderThread = lo_server_thread_new(std::to_string(FLAGS_port).data(), loError);
+        if (!responderThread) {
+            spdlog::error("Unable to create in-process responder on UDP port {}", FLAGS_port);
+            return -1;
+        }
+        lo_server_thread_add_method(responderThread, "/clockSyncGet", "i", loHandleSyncGet,
+                lo_server_thread_get_server(responderThread));
+        if (lo_server_thread_start(responderThread) < 0) {
+            spdlog::error("Failed to start in-process responder thread.");
+            return -1;
+        }
+        spdlog::info("benchmarking in-process responder on loopback port {}", FLAGS_port);
+    } else {
+        spdlog::info("benchmarking responder at {}:{}", host, FLAGS_port);
+    }
+
+    if (!runPhase("baseline", host, loopback)) {
+        return -1;
+    }
+
+    if (FLAGS_stressThreads > 0) {
+        std::atomic<bool> quit(false);
+        std::vector<std::thread> stressThreads;
+        for (auto i = 0; i < FLAGS_stressThreads; ++i) {
+            stressThreads.emplace_back([&quit, i] {
+                volatile double sink = i;
+                while (!quit) {
+                    for (auto j = 0; j < 1000; ++j) {
+                        sink = std::sqrt(sink + j);
+                    }
+                }
+            });
+        }
+        bool ok = runPhase(fmt::format("stress ({} threads)", FLAGS_stressThreads), host, loopback);
+        quit = true;
+        for (auto& thread : stressThreads) {
+            thread.join();
+        }
+        if (!ok) {
+            return -1;
+        }
+    }
+
+    if (responderThread) {
+        lo_server_thread_stop(responderThread);
+        lo_server_thread_free(responderThread);
+    }
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "ChatServer.hpp"
+#include "ClockDiagnostics.hpp"
 #include "Constants.hpp"
 #include "common/Version.hpp"
 
@@ -15,6 +16,9 @@
 // Command line flags for the HTTP server.
 DEFINE_int32(chatPort, 61010, "OSC TCP port for incoming chat messgaes");
 DEFINE_int32(timeout, 10, "The timeout in seconds before automatically disconnecting an unresponsive client.");
+DEFINE_int32(clockDiagPort, 4252, "OSC UDP port for incoming SCLOrkClock diagnostic reports.");
+DEFINE_string(clockDiagCsv, "", "If set, path of a CSV file to write all retained clock diagnostic reports to on exit, "
+    "and on receipt of /clockDiagDump.");
 
 int main(int argc, char* argv[]) {
     gflags::ParseCommandLineFlags(&argc, &argv, true);
@@ -46,6 +50,17 @@ int main(int argc, char* argv[]) {
         return -1;
     }
 
+    Confab::ClockDiagnostics clockDiagnostics;
+    if (!clockDiagnostics.create(fmt::format("{}", FLAGS_clockDiagPort), FLAGS_clockDiagCsv)) {
+        spdlog::error("Failed to create clock diagnostics on port {}", FLAGS_clockDiagPort);
+        return -1;
+    }
+
+    if (!clockDiagnostics.run()) {
+        spdlog::error("Failed to run ClockDiagnostics thread.");
+        return -1;
+    }
+
     // Block until SIGINT
     sigemptyset(&signals);
     sigaddset(&signals, SIGINT);
@@ -60,6 +75,12 @@ int main(int argc, char* argv[]) {
         spdlog::error("got error from sigwait {}", status);
     }
 
+    clockDiagnostics.stop();
+    if (FLAGS_clockDiagCsv != "") {
+        clockDiagnostics.dumpCsv(FLAGS_clockDiagCsv);
+    }
+    clockDiagnostics.destroy();
+
     chatServer.stop();
     chatServer.destroy();
     return 0;
@@ -1,15 +1,21 @@
 #include "CacheManager.hpp"
+#include "ClockSync.hpp"
 #include "ConfabCommon.hpp"
 #include "Constants.hpp"
+#include "DirectoryIngester.hpp"
 #include "HttpClient.hpp"
 #include "OscHandler.hpp"
+#include "ShardMap.hpp"
+#include "UpstreamQueue.hpp"
 #include "common/Version.hpp"
 
 #include "gflags/gflags.h"
 #include "glog/logging.h"
 
+#include <chrono>
 #include <experimental/filesystem>
 #include <future>
+#include <iostream>
 #include <memory>
 
 DEFINE_bool(validate_file_cache, true, "If true confab will check the hash of every file in the cache, removing any "
@@ -20,6 +26,52 @@ DEFINE_int32(osc_listen_port, 4248, "UDP port on localhost to listen for incomin
 DEFINE_int32(osc_respond_port, 4249, "UDP port on localhost to send response messages to SuperCollider.");
 
 DEFINE_string(server_url, "http://sclork-s01.local:9080", "Address for HTTP communication with Confab server.");
+DEFINE_string(replica_urls, "", "Comma-separated addresses of follower Confab servers to spread Asset and List reads "
+        "across, along with --server_url.");
+DEFINE_string(shard_urls, "", "Comma-separated addresses of the Confab servers Asset keys are sharded across, which "
+        "must match the shards configured on those servers. If empty, every Asset is stored on --server_url.");
+
+// Command line flags for the background upload of added Assets.
+DEFINE_int32(upstream_workers, 4, "Number of added Assets to upload to the server at once.");
+DEFINE_int32(upstream_min_backoff_ms, 500, "Time in milliseconds to wait before retrying a failed upload.");
+DEFINE_int32(upstream_max_backoff_ms, 60000, "Longest time in milliseconds to wait before retrying a failed upload, "
+        "as the wait doubles with every failure.");
+
+// Command line flags for the clock sync estimator.
+DEFINE_string(clock_sync_host, "", "Hostname of the SCLOrkClockServer sync responder. If empty confab will not "
+        "estimate clock offset.");
+DEFINE_int32(clock_sync_port, 4250, "UDP port of the SCLOrkClockServer sync responder.");
+DEFINE_int32(clock_sync_burst_size, 8, "Number of /clockSyncGet round trips in each burst.");
+DEFINE_int32(clock_sync_burst_period_ms, 2000, "Time in milliseconds between the start of each sync burst.");
+DEFINE_int32(clock_sync_publish_hz, 10, "Rate at which to send /clockSyncUpdate messages to SuperCollider.");
+
+// Command line flags for publishing a directory of files instead of running as a daemon.
+DEFINE_string(add_directory, "", "If set, confab will upload every file in this directory tree as an Asset on the list "
+        "named by --add_directory_list, then exit.");
+DEFINE_string(add_directory_list, "", "Name of the list to add files in --add_directory to.");
+DEFINE_string(add_directory_type, "sample", "Asset type of the files in --add_directory.");
+DEFINE_string(add_directory_author, "", "Optional Asset key of the author of the files in --add_directory.");
+DEFINE_int32(add_directory_threads, 0, "Number of files to hash and upload at once, or 0 for one per core.");
+
+int addDirectory(std::shared_ptr<Confab::HttpClient> httpClient) {
+    Confab::Asset::Type type = Confab::Asset::typeStringToEnum(FLAGS_add_directory_type);
+    if (type == Confab::Asset::kInvalid || FLAGS_add_directory_list.size() == 0) {
+        LOG(ERROR) << "--add_directory requires a valid --add_directory_type and a --add_directory_list name.";
+        return -1;
+    }
+    uint64_t author = 0;
+    if (FLAGS_add_directory_author.size() > 0) {
+        author = Confab::Asset::stringToKey(FLAGS_add_directory_author);
+    }
+
+    Confab::DirectoryIngester ingester(httpClient, FLAGS_add_directory_threads);
+    Confab::DirectoryIngester::Summary summary;
+    bool ok = ingester.ingest(FLAGS_add_directory, type, FLAGS_add_directory_list, author, summary);
+    std::cout << "list " << FLAGS_add_directory_list << " " << Confab::Asset::keyToString(summary.listKey) << ": "
+        << summary.files << " files, " << summary.uploaded << " uploaded, " << summary.existing
+        << " already on server, " << summary.failed << " failed." << std::endl;
+    return ok ? 0 : -1;
+}
 
 int main(int argc, char* argv[]) {
     Confab::ConfabCommon common;
@@ -29,24 +81,59 @@ int main(int argc, char* argv[]) {
 
     LOG(INFO) << "Starting confab v" << Confab::confabVersion.toString() << " on pid " << getpid();
 
-    std::shared_ptr<Confab::HttpClient> httpClient(new Confab::HttpClient(FLAGS_server_url));
+    if (common.packMode()) {
+        int result = common.runPackMode();
+        common.shutdown();
+        return result;
+    }
+
+    std::shared_ptr<Confab::HttpClient> httpClient(new Confab::HttpClient(FLAGS_server_url,
+        Confab::ShardMap::parseAddresses(FLAGS_replica_urls), Confab::ShardMap::parseAddresses(FLAGS_shard_urls)));
+    if (FLAGS_add_directory.size() > 0) {
+        int result = addDirectory(httpClient);
+        httpClient->shutdown();
+        common.shutdown();
+        return result;
+    }
+
     uint64_t maxCache = static_cast<uint64_t>(FLAGS_max_cache_size_gb) * 1024ULL * 1024ULL * 1024ULL;
     std::shared_ptr<Confab::CacheManager> cacheManager(new Confab::CacheManager(FLAGS_data_directory + "/cache",
-        maxCache, httpClient));
+        maxCache, common.assetDatabase(), httpClient));
     std::async(std::launch::async, [&cacheManager] {
         cacheManager->checkExistingEntries(FLAGS_validate_file_cache);
     });
 
+    std::shared_ptr<Confab::UpstreamQueue> upstreamQueue(new Confab::UpstreamQueue(common.assetDatabase(), httpClient,
+        FLAGS_upstream_workers, std::chrono::milliseconds(FLAGS_upstream_min_backoff_ms),
+        std::chrono::milliseconds(FLAGS_upstream_max_backoff_ms)));
+    upstreamQueue->start();
+
     LOG(INFO) << "Opening up OSC ports for listen on " << FLAGS_osc_listen_port << " and respond on "
         << FLAGS_osc_respond_port;
     Confab::OscHandler osc(FLAGS_osc_listen_port, FLAGS_osc_respond_port, common.assetDatabase(), httpClient,
-        cacheManager);
+        cacheManager, upstreamQueue);
     osc.run();
 
+    std::unique_ptr<Confab::ClockSync> clockSync;
+    if (FLAGS_clock_sync_host.size() > 0) {
+        LOG(INFO) << "Starting clock sync against " << FLAGS_clock_sync_host << ":" << FLAGS_clock_sync_port;
+        clockSync.reset(new Confab::ClockSync(FLAGS_clock_sync_host, FLAGS_clock_sync_port, FLAGS_osc_respond_port,
+            FLAGS_clock_sync_burst_size, FLAGS_clock_sync_burst_period_ms, FLAGS_clock_sync_publish_hz));
+        if (!clockSync->create() || !clockSync->run()) {
+            LOG(ERROR) << "Failed to start clock sync.";
+            return -1;
+        }
+    }
+
     common.waitForTerminationSignal();
 
     LOG(INFO) << "Termination signal caught, stopping confab normally.";
+    if (clockSync) {
+        clockSync->stop();
+        clockSync->destroy();
+    }
     osc.shutdown();
+    upstreamQueue->stop();
     httpClient->shutdown();
     common.shutdown();
     return 0;
@@ -0,0 +1,207 @@
+// Build-time tool that reads the Unicode emoji-test.txt file and writes a C++ source file defining the compact emoji
+// search trie declared in EmojiIndex.hpp. Run by the build, see CMakeLists.txt.
+//
+// Usage: emoji-trie-gen <path/to/emoji-test.txt> <path/to/EmojiIndexData.cpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <queue>
+#include <regex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Emoji {
+    std::string emoji;
+    std::string description;
+};
+
+struct Node {
+    char label = 0;
+    // Indices into the sorted emoji list of emoji with a word ending at this node.
+    std::set<uint16_t> matches;
+    std::map<char, std::unique_ptr<Node>> children;
+
+    // Assigned during layout.
+    uint32_t index = 0;
+    uint32_t postingsBegin = 0;
+    uint32_t postingsEnd = 0;
+};
+
+// Same normalization as scripts/build_emoji_trie.scd, so search paths match those of the SCLOrkEmoji class.
+std::vector<std::string> splitWords(const std::string& description) {
+    std::vector<std::string> words;
+    std::string word;
+    for (char c : description + " ") {
+        if (c == ' ') {
+            if (word.size()) {
+                words.push_back(word);
+            }
+            word.clear();
+        } else if (c > 0 && std::isalnum(static_cast<unsigned char>(c))) {
+            word += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+    }
+    return words;
+}
+
+// Preorder traversal appending to postings, so every node's subtree occupies a contiguous range.
+void layoutPostings(Node* node, std::vector<uint16_t>& postings) {
+    node->postingsBegin = postings.size();
+    postings.insert(postings.end(), node->matches.begin(), node->matches.end());
+    for (auto& child : node->children) {
+        layoutPostings(child.second.get(), postings);
+    }
+    node->postingsEnd = postings.size();
+}
+
+// Writes a string as a C++ literal of octal escapes and printable characters, followed by a NUL terminator.
+void writeLiteral(std::ofstream& outFile, const std::string& value) {
+    outFile << "    \"";
+    for (unsigned char c : value) {
+        if (c >= 0x20 && c < 0x7f && c != '"' && c != '\\' && c != '?') {
+            outFile << c;
+        } else {
+            char escape[5];
+            std::snprintf(escape, sizeof(escape), "\\%03o", c);
+            outFile << escape;
+        }
+    }
+    outFile << "\\000\"\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cerr << "usage: emoji-trie-gen <emoji-test.txt> <output.cpp>" << std::endl;
+        return -1;
+    }
+
+    std::ifstream inFile(argv[1]);
+    if (!inFile) {
+        std::cerr << "error opening input file " << argv[1] << std::endl;
+        return -1;
+    }
+
+    // Data line format is some hexadecimal code points, a semicolon and the qualification status, then a #, the
+    // emoji itself, and a textual description. Only fully-qualified emoji are indexed.
+    std::regex lineRegex("([0-9A-F ]+); fully-qualified[ ]+# (\\S+) (.*)");
+    std::vector<Emoji> emoji;
+    std::string line;
+    while (std::getline(inFile, line)) {
+        std::smatch match;
+        if (line.size() && line[0] != '#' && std::regex_match(line, match, lineRegex)) {
+            std::string description = match[3].str();
+            // Condition description for non-printing characters.
+            size_t position = 0;
+            while ((position = description.find("\xe2\x80\x99", position)) != std::string::npos) {
+                description.replace(position, 3, "'");
+            }
+            std::transform(description.begin(), description.end(), description.begin(), [](char c) {
+                return c > 0 ? static_cast<char>(std::tolower(static_cast<unsigned char>(c))) : c;
+            });
+            emoji.push_back({ match[2].str(), description });
+        }
+    }
+    if (emoji.empty() || emoji.size() > UINT16_MAX) {
+        std::cerr << "unexpected count of " << emoji.size() << " emoji in " << argv[1] << std::endl;
+        return -1;
+    }
+
+    // Sorting by description means every match list, and so every lookup result, comes back in description order.
+    std::stable_sort(emoji.begin(), emoji.end(), [](const Emoji& a, const Emoji& b) {
+        return a.description < b.description;
+    });
+
+    Node root;
+    for (size_t i = 0; i < emoji.size(); ++i) {
+        for (const auto& word : splitWords(emoji[i].description)) {
+            Node* node = &root;
+            for (char c : word) {
+                auto& child = node->children[c];
+                if (!child) {
+                    child.reset(new Node);
+                    child->label = c;
+                }
+                node = child.get();
+            }
+            node->matches.insert(static_cast<uint16_t>(i));
+        }
+    }
+
+    std::vector<uint16_t> postings;
+    layoutPostings(&root, postings);
+
+    // Breadth-first node order keeps the children of each node contiguous in the node array.
+    std::vector<Node*> nodes;
+    std::queue<Node*> queue;
+    queue.push(&root);
+    while (!queue.empty()) {
+        Node* node = queue.front();
+        queue.pop();
+        node->index = nodes.size();
+        nodes.push_back(node);
+        for (auto& child : node->children) {
+            queue.push(child.second.get());
+        }
+    }
+
+    std::ofstream outFile(argv[2], std::ios::out | std::ios::trunc);
+    if (!outFile) {
+        std::cerr << "error opening output file " << argv[2] << std::endl;
+        return -1;
+    }
+
+    outFile << "// Generated file, produced by emoji-trie-gen from scripts/emoji-test.txt.\n"
+        << "#include \"EmojiIndex.hpp\"\n\n"
+        << "namespace Confab {\n\n"
+        << "const char EmojiIndex::kStrings[] =\n";
+    std::vector<uint32_t> emojiOffsets;
+    std::vector<uint32_t> descriptionOffsets;
+    uint32_t offset = 0;
+    for (const auto& entry : emoji) {
+        emojiOffsets.push_back(offset);
+        writeLiteral(outFile, entry.emoji);
+        offset += entry.emoji.size() + 1;
+        descriptionOffsets.push_back(offset);
+        writeLiteral(outFile, entry.description);
+        offset += entry.description.size() + 1;
+    }
+    outFile << ";\n\n";
+
+    outFile << "const EmojiIndex::Record EmojiIndex::kRecords[] = {\n";
+    for (size_t i = 0; i < emoji.size(); ++i) {
+        outFile << "    { " << emojiOffsets[i] << ", " << descriptionOffsets[i] << " },\n";
+    }
+    outFile << "};\n\nconst size_t EmojiIndex::kRecordCount = " << emoji.size() << ";\n\n";
+
+    outFile << "const EmojiIndex::Node EmojiIndex::kNodes[] = {\n";
+    for (const Node* node : nodes) {
+        uint32_t firstChild = node->children.size() ? node->children.begin()->second->index : 0;
+        outFile << "    { " << firstChild << ", " << node->postingsBegin << ", " << node->postingsEnd << ", "
+            << node->children.size() << ", '" << (node->label ? node->label : '\\')
+            << (node->label ? "" : "0") << "' },\n";
+    }
+    outFile << "};\n\nconst size_t EmojiIndex::kNodeCount = " << nodes.size() << ";\n\n";
+
+    outFile << "const uint16_t EmojiIndex::kPostings[] = {";
+    for (size_t i = 0; i < postings.size(); ++i) {
+        outFile << (i % 16 ? " " : "\n    ") << postings[i] << ",";
+    }
+    outFile << "\n};\n\n}  // namespace Confab\n";
+
+    if (!outFile) {
+        std::cerr << "error writing output file " << argv[2] << std::endl;
+        return -1;
+    }
+    return 0;
+}